@@ -0,0 +1,572 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* Throughput benchmark for the filters in gst/
+ *
+ * Every case pushes frames through one element in a GstHarness and times
+ * each push until the output is available. Only that time is measured,
+ * preparing the writable input frame is not. With several threads each one
+ * runs its own instance of the element, so the results show how the element
+ * scales when a pipeline has several of them, e.g. one per camera.
+ *
+ * Results are written as JSON, one entry per case, resolution and thread
+ * count:
+ *
+ *   gst-vision-benchmark --resolutions=fhd,4k --threads=1,4 --output=b.json
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+#include <gst/video/video.h>
+
+typedef struct
+{
+  const gchar *name;
+  /* launch line of the element under test */
+  const gchar *element;
+  /* input caps, completed with width, height and framerate */
+  const gchar *caps;
+  /* mask applied to 16-bit input samples, 0 for random bytes */
+  guint16 mask;
+} BenchCase;
+
+static const BenchCase bench_cases[] = {
+  {"videolevels-manual", "videolevels auto=off lower-input-level=0 "
+        "upper-input-level=4095", "video/x-raw,format=GRAY16_LE,bpp=12",
+      0x0fff},
+  {"videolevels-auto", "videolevels auto=continuous",
+      "video/x-raw,format=GRAY16_LE,bpp=12", 0x0fff},
+  {"extractcolor-8", "extractcolor component=green",
+      "video/x-raw,format=BGRA", 0},
+  {"extractcolor-16", "extractcolor component=green",
+      "video/x-raw,format=ARGB64", 0},
+  {"misbirpack", "misbirpack", "video/x-raw,format=GRAY16_LE", 0xffff},
+  {"misbirunpack-v210", "misbirunpack", "video/x-raw,format=v210", 0},
+  {"misbirunpack-uyvy", "misbirunpack", "video/x-raw,format=UYVY", 0},
+  {"bayer2gray-8", "bayer2gray", "video/x-bayer,format=rggb", 0},
+  {"bayer2gray-16", "bayer2gray",
+      "video/x-bayer,format=rggb16,endianness=1234,bpp=12", 0x0fff},
+  {"genicamunpack-10p", "genicamunpack",
+      "video/x-genicam-packed,format=Mono10p", 0},
+  {"genicamunpack-12p", "genicamunpack",
+      "video/x-genicam-packed,format=Mono12p", 0},
+  {"genicamunpack-12packed", "genicamunpack",
+      "video/x-genicam-packed,format=Mono12Packed", 0},
+  {"genicamunpack-bayer12p", "genicamunpack",
+      "video/x-genicam-packed,format=BayerRG12p", 0},
+  {"genicamunpack-12p-1thread", "genicamunpack n-threads=1",
+      "video/x-genicam-packed,format=Mono12p", 0},
+  {"genicamunpack-12p-c", "genicamunpack n-threads=1 simd=false",
+      "video/x-genicam-packed,format=Mono12p", 0},
+  {"select", "select offset=0 skip=0", "video/x-raw,format=GRAY8", 0},
+  {"klvinject", "klvinject", "video/x-raw,format=GRAY8", 0},
+  {"klvtimestamp", "klvtimestamp", "video/x-raw,format=GRAY8", 0},
+  {"klvinspect", "klvinspect", "video/x-raw,format=GRAY8", 0},
+};
+
+typedef struct
+{
+  const gchar *name;
+  gint width;
+  gint height;
+} BenchResolution;
+
+static const BenchResolution bench_resolutions[] = {
+  {"vga", 640, 480},
+  {"hd", 1280, 720},
+  {"fhd", 1920, 1080},
+  {"4k", 3840, 2160},
+  {"8k", 7680, 4320},
+};
+
+/* shared by the workers of one run, so they all start timing together */
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  guint ready;
+  gboolean go;
+} BenchBarrier;
+
+typedef struct
+{
+  const BenchCase *bcase;
+  const gchar *caps;
+  gsize frame_size;
+  guint frames;
+  guint warmup;
+  BenchBarrier *barrier;
+
+  /* results */
+  GstClockTime *latencies;
+  GstClockTime busy;
+  gchar *error;
+} BenchWorker;
+
+static guint opt_frames = 100;
+static guint opt_warmup = 10;
+static gchar *opt_resolutions = NULL;
+static gchar *opt_threads = NULL;
+static gchar *opt_filter = NULL;
+static gchar *opt_output = NULL;
+
+static GOptionEntry bench_options[] = {
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &opt_frames,
+      "Timed frames per thread (default 100)", "N"},
+  {"warmup", 'w', 0, G_OPTION_ARG_INT, &opt_warmup,
+      "Untimed frames pushed first (default 10)", "N"},
+  {"resolutions", 'r', 0, G_OPTION_ARG_STRING, &opt_resolutions,
+        "Comma separated resolutions out of vga, hd, fhd, 4k, 8k or WxH "
+        "(default all)", "LIST"},
+  {"threads", 't', 0, G_OPTION_ARG_STRING, &opt_threads,
+      "Comma separated thread counts (default 1 and all processors)", "LIST"},
+  {"filter", 'f', 0, G_OPTION_ARG_STRING, &opt_filter,
+      "Only run cases whose name contains this string", "STRING"},
+  {"output", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output,
+      "Write JSON here instead of stdout", "FILE"},
+  {NULL}
+};
+
+static gsize
+bench_frame_size (GstCaps * caps)
+{
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+
+  if (gst_structure_has_name (s, "video/x-raw")) {
+    GstVideoInfo vinfo;
+
+    if (!gst_video_info_from_caps (&vinfo, caps))
+      return 0;
+    return GST_VIDEO_INFO_SIZE (&vinfo);
+  } else if (gst_structure_has_name (s, "video/x-bayer")) {
+    const gchar *format = gst_structure_get_string (s, "format");
+    gint width = 0, height = 0;
+
+    gst_structure_get_int (s, "width", &width);
+    gst_structure_get_int (s, "height", &height);
+    return (gsize) GST_ROUND_UP_4 (width) * height *
+        (format && g_str_has_suffix (format, "16") ? 2 : 1);
+  } else if (gst_structure_has_name (s, "video/x-genicam-packed")) {
+    const gchar *format = gst_structure_get_string (s, "format");
+    gint width = 0, height = 0;
+    gint bits = format && g_str_has_suffix (format, "10p") ? 10 : 12;
+
+    gst_structure_get_int (s, "width", &width);
+    gst_structure_get_int (s, "height", &height);
+    return ((guint64) width * height * bits + 7) / 8;
+  }
+
+  return 0;
+}
+
+static GstBuffer *
+bench_create_input (const BenchCase * bcase, gsize size)
+{
+  GstBuffer *buf;
+  GstMapInfo minfo;
+  guint32 state = 0x9e3779b9;
+  gsize i;
+
+  buf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
+
+  /* xorshift, reproducible and fast enough for 8K frames */
+  for (i = 0; i + 4 <= size; i += 4) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    memcpy (minfo.data + i, &state, 4);
+  }
+
+  if (bcase->mask) {
+    guint16 *samples = (guint16 *) minfo.data;
+    for (i = 0; i < size / 2; i++)
+      samples[i] &= GUINT16_TO_LE (bcase->mask);
+  }
+
+  gst_buffer_unmap (buf, &minfo);
+
+  return buf;
+}
+
+static gpointer
+bench_worker_run (gpointer data)
+{
+  BenchWorker *worker = (BenchWorker *) data;
+  BenchBarrier *barrier = worker->barrier;
+  GstHarness *h;
+  GstBuffer *input;
+  GstClockTime duration = GST_SECOND / 30;
+  guint i, total = worker->warmup + worker->frames;
+
+  h = gst_harness_new_parse (worker->bcase->element);
+  gst_harness_set_src_caps_str (h, worker->caps);
+  input = bench_create_input (worker->bcase, worker->frame_size);
+
+  for (i = 0; i < total; i++) {
+    GstBuffer *buf, *outbuf;
+    GstClockTime start;
+    GstFlowReturn ret;
+
+    if (i == worker->warmup) {
+      g_mutex_lock (&barrier->lock);
+      barrier->ready++;
+      g_cond_broadcast (&barrier->cond);
+      while (!barrier->go)
+        g_cond_wait (&barrier->cond, &barrier->lock);
+      g_mutex_unlock (&barrier->lock);
+    }
+
+    /* in place elements need a writable frame, as from a capture pool */
+    buf = gst_buffer_copy_deep (input);
+    GST_BUFFER_PTS (buf) = i * duration;
+    GST_BUFFER_DURATION (buf) = duration;
+    GST_BUFFER_OFFSET (buf) = i;
+
+    start = gst_util_get_timestamp ();
+    ret = gst_harness_push (h, buf);
+    /* every element here works in the streaming thread, so the output (if
+     * any, select may drop) is ready once push returns */
+    outbuf = gst_harness_try_pull (h);
+    if (i >= worker->warmup) {
+      GstClockTime latency = gst_util_get_timestamp () - start;
+      worker->latencies[i - worker->warmup] = latency;
+      worker->busy += latency;
+    }
+
+    if (outbuf)
+      gst_buffer_unref (outbuf);
+
+    if (ret != GST_FLOW_OK) {
+      worker->error = g_strdup_printf ("push returned %s",
+          gst_flow_get_name (ret));
+      break;
+    }
+  }
+
+  /* don't leave the others waiting if we failed during warmup */
+  if (i < worker->warmup) {
+    g_mutex_lock (&barrier->lock);
+    barrier->ready++;
+    g_cond_broadcast (&barrier->cond);
+    g_mutex_unlock (&barrier->lock);
+  }
+
+  gst_buffer_unref (input);
+  gst_harness_teardown (h);
+
+  return NULL;
+}
+
+static int
+bench_compare_time (gconstpointer a, gconstpointer b)
+{
+  GstClockTime ta = *(const GstClockTime *) a;
+  GstClockTime tb = *(const GstClockTime *) b;
+
+  return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+static GstClockTime
+bench_percentile (const GstClockTime * sorted, guint n, guint percent)
+{
+  guint index;
+
+  if (n == 0)
+    return 0;
+
+  /* nearest rank */
+  index = (n * percent + 99) / 100;
+  return sorted[MAX (index, 1) - 1];
+}
+
+static gboolean
+bench_run (GString * json, gboolean * first, const BenchCase * bcase,
+    const BenchResolution * res, guint n_threads)
+{
+  BenchBarrier barrier;
+  BenchWorker *workers;
+  GThread **threads;
+  GstClockTime *latencies;
+  GstCaps *caps;
+  gchar *caps_str;
+  gsize frame_size;
+  gdouble fps = 0;
+  guint n = 0, i;
+  gchar *error = NULL;
+
+  caps = gst_caps_from_string (bcase->caps);
+  gst_caps_set_simple (caps, "width", G_TYPE_INT, res->width,
+      "height", G_TYPE_INT, res->height,
+      "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+  caps_str = gst_caps_to_string (caps);
+  frame_size = bench_frame_size (caps);
+  gst_caps_unref (caps);
+
+  if (frame_size == 0) {
+    g_printerr ("%s: can't compute frame size of %s\n", bcase->name, caps_str);
+    g_free (caps_str);
+    return FALSE;
+  }
+
+  g_printerr ("%s %dx%d, %u thread(s)\n", bcase->name, res->width,
+      res->height, n_threads);
+
+  g_mutex_init (&barrier.lock);
+  g_cond_init (&barrier.cond);
+  barrier.ready = 0;
+  barrier.go = FALSE;
+
+  workers = g_new0 (BenchWorker, n_threads);
+  threads = g_new0 (GThread *, n_threads);
+  latencies = g_new (GstClockTime, (gsize) n_threads * opt_frames);
+
+  for (i = 0; i < n_threads; i++) {
+    workers[i].bcase = bcase;
+    workers[i].caps = caps_str;
+    workers[i].frame_size = frame_size;
+    workers[i].frames = opt_frames;
+    workers[i].warmup = opt_warmup;
+    workers[i].barrier = &barrier;
+    workers[i].latencies = latencies + (gsize) i * opt_frames;
+    threads[i] = g_thread_new ("bench", bench_worker_run, &workers[i]);
+  }
+
+  g_mutex_lock (&barrier.lock);
+  while (barrier.ready < n_threads)
+    g_cond_wait (&barrier.cond, &barrier.lock);
+  barrier.go = TRUE;
+  g_cond_broadcast (&barrier.cond);
+  g_mutex_unlock (&barrier.lock);
+
+  for (i = 0; i < n_threads; i++) {
+    g_thread_join (threads[i]);
+    if (workers[i].error && error == NULL)
+      error = g_strdup (workers[i].error);
+    if (workers[i].busy > 0)
+      fps += (gdouble) opt_frames * GST_SECOND / workers[i].busy;
+    g_free (workers[i].error);
+  }
+  n = error ? 0 : n_threads * opt_frames;
+
+  qsort (latencies, n, sizeof (GstClockTime), bench_compare_time);
+
+  g_string_append_printf (json, "%s\n    {\"case\": \"%s\", "
+      "\"element\": \"%s\", \"caps\": \"%s\", \"width\": %d, \"height\": %d, "
+      "\"frame_bytes\": %" G_GSIZE_FORMAT ", \"threads\": %u, ",
+      *first ? "" : ",", bcase->name, bcase->element, caps_str, res->width,
+      res->height, frame_size, n_threads);
+  if (error) {
+    g_string_append_printf (json, "\"error\": \"%s\"}", error);
+  } else {
+    gchar fps_str[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar mbps_str[G_ASCII_DTOSTR_BUF_SIZE];
+
+    /* locale independent, JSON needs a decimal point */
+    g_ascii_formatd (fps_str, sizeof (fps_str), "%.1f", fps);
+    g_ascii_formatd (mbps_str, sizeof (mbps_str), "%.1f",
+        fps * frame_size / 1e6);
+    g_string_append_printf (json, "\"frames\": %u, \"fps\": %s, "
+        "\"mb_per_s\": %s, \"latency_p50_us\": %" G_GUINT64_FORMAT ", "
+        "\"latency_p99_us\": %" G_GUINT64_FORMAT ", "
+        "\"latency_max_us\": %" G_GUINT64_FORMAT "}", n, fps_str, mbps_str,
+        bench_percentile (latencies, n, 50) / GST_USECOND,
+        bench_percentile (latencies, n, 99) / GST_USECOND,
+        n ? latencies[n - 1] / GST_USECOND : 0);
+  }
+  *first = FALSE;
+
+  g_free (error);
+  g_free (latencies);
+  g_free (threads);
+  g_free (workers);
+  g_mutex_clear (&barrier.lock);
+  g_cond_clear (&barrier.cond);
+  g_free (caps_str);
+
+  return TRUE;
+}
+
+static GArray *
+bench_parse_resolutions (const gchar * list)
+{
+  GArray *resolutions = g_array_new (FALSE, FALSE, sizeof (BenchResolution));
+  gchar **names;
+  guint i, j;
+
+  if (list == NULL) {
+    g_array_append_vals (resolutions, bench_resolutions,
+        G_N_ELEMENTS (bench_resolutions));
+    return resolutions;
+  }
+
+  names = g_strsplit (list, ",", -1);
+  for (i = 0; names[i]; i++) {
+    BenchResolution res = { NULL, 0, 0 };
+
+    for (j = 0; j < G_N_ELEMENTS (bench_resolutions); j++) {
+      if (g_ascii_strcasecmp (names[i], bench_resolutions[j].name) == 0)
+        res = bench_resolutions[j];
+    }
+    if (res.name == NULL &&
+        sscanf (names[i], "%dx%d", &res.width, &res.height) == 2 &&
+        res.width > 0 && res.height > 0) {
+      res.name = "custom";
+    }
+
+    if (res.name)
+      g_array_append_val (resolutions, res);
+    else
+      g_printerr ("Ignoring unknown resolution '%s'\n", names[i]);
+  }
+  g_strfreev (names);
+
+  return resolutions;
+}
+
+static GArray *
+bench_parse_threads (const gchar * list)
+{
+  GArray *threads = g_array_new (FALSE, FALSE, sizeof (guint));
+  gchar **counts;
+  guint i;
+
+  if (list == NULL) {
+    guint n = 1;
+    g_array_append_val (threads, n);
+    n = g_get_num_processors ();
+    if (n > 1)
+      g_array_append_val (threads, n);
+    return threads;
+  }
+
+  counts = g_strsplit (list, ",", -1);
+  for (i = 0; counts[i]; i++) {
+    guint n = (guint) g_ascii_strtoull (counts[i], NULL, 10);
+    if (n > 0)
+      g_array_append_val (threads, n);
+    else
+      g_printerr ("Ignoring thread count '%s'\n", counts[i]);
+  }
+  g_strfreev (counts);
+
+  return threads;
+}
+
+static gboolean
+bench_element_available (const gchar * launch)
+{
+  GstElementFactory *factory;
+  gchar *name;
+
+  name = g_strndup (launch, strcspn (launch, " "));
+  factory = gst_element_factory_find (name);
+  g_free (name);
+
+  if (factory == NULL)
+    return FALSE;
+
+  gst_object_unref (factory);
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GArray *resolutions, *threads;
+  GString *json, *skipped;
+  gboolean first = TRUE;
+  guint c, r, t;
+
+  ctx = g_option_context_new ("- benchmark gst-plugins-vision filters");
+  g_option_context_add_main_entries (ctx, bench_options, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (opt_frames == 0) {
+    g_printerr ("At least one frame must be timed\n");
+    return 1;
+  }
+
+  resolutions = bench_parse_resolutions (opt_resolutions);
+  threads = bench_parse_threads (opt_threads);
+
+  json = g_string_new (NULL);
+  skipped = g_string_new (NULL);
+  g_string_append_printf (json, "{\n  \"gstreamer\": \"%s\",\n"
+      "  \"frames_per_thread\": %u,\n  \"warmup_frames\": %u,\n"
+      "  \"results\": [", gst_version_string (), opt_frames, opt_warmup);
+
+  for (c = 0; c < G_N_ELEMENTS (bench_cases); c++) {
+    const BenchCase *bcase = &bench_cases[c];
+
+    if (opt_filter && !strstr (bcase->name, opt_filter))
+      continue;
+
+    /* e.g. KLV elements are only built with ENABLE_KLV */
+    if (!bench_element_available (bcase->element)) {
+      g_printerr ("%s: element not found, skipping\n", bcase->name);
+      g_string_append_printf (skipped, "%s\"%s\"", skipped->len ? ", " : "",
+          bcase->name);
+      continue;
+    }
+
+    for (r = 0; r < resolutions->len; r++) {
+      for (t = 0; t < threads->len; t++) {
+        bench_run (json, &first, bcase,
+            &g_array_index (resolutions, BenchResolution, r),
+            g_array_index (threads, guint, t));
+      }
+    }
+  }
+
+  g_string_append_printf (json, "\n  ],\n  \"skipped\": [%s]\n}\n",
+      skipped->str);
+
+  if (opt_output) {
+    if (!g_file_set_contents (opt_output, json->str, json->len, &err)) {
+      g_printerr ("Failed to write %s: %s\n", opt_output, err->message);
+      g_clear_error (&err);
+    }
+  } else {
+    fputs (json->str, stdout);
+  }
+
+  g_string_free (skipped, TRUE);
+  g_string_free (json, TRUE);
+  g_array_free (threads, TRUE);
+  g_array_free (resolutions, TRUE);
+
+  return 0;
+}
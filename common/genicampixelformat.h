@@ -35,6 +35,20 @@
   "height = " GST_VIDEO_SIZE_RANGE ", "                    \
   "framerate = " GST_VIDEO_FPS_RANGE
 
+/* pixels packed back to back without padding, not even at the end of a
+ * line, see the genicamunpack element */
+#define GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED(format)                     \
+  "video/x-genicam-packed, "                               \
+  "format = (string) " format ", "                     \
+  "width = " GST_VIDEO_SIZE_RANGE ", "                     \
+  "height = " GST_VIDEO_SIZE_RANGE ", "                    \
+  "framerate = " GST_VIDEO_FPS_RANGE
+
+#define GST_GENICAM_PIXEL_FORMAT_CAPS_PACKED                         \
+  GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("{ Mono10p, Mono12p, Mono12Packed, " \
+      "BayerBG10p, BayerGR10p, BayerRG10p, BayerGB10p, "   \
+      "BayerBG12p, BayerGR12p, BayerRG12p, BayerGB12p }")
+
 typedef struct
 {
     const char *pixel_format;
@@ -138,6 +152,30 @@ GstGenicamPixelFormatInfo gst_genicam_pixel_format_infos[] = {
   ,
   /* Formats from Kaya */
   {"YUV422_8", "YUV422_8", 0, GST_VIDEO_CAPS_MAKE("UYVY"), 16, 16, 4}
+  ,
+  /* Packed formats, listed last so they are only picked when asked for */
+  {"Mono10p", "Mono 10p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("Mono10p"), 10, 10, 1}
+  ,
+  {"Mono12p", "Mono 12p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("Mono12p"), 12, 12, 1}
+  ,
+  // Mono12Packed is GigE Vision specific, nibbles are ordered differently to Mono12p
+  {"Mono12Packed", "Mono 12 Packed", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("Mono12Packed"), 12, 12, 1}
+  ,
+  {"BayerBG10p", "Bayer BG 10p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerBG10p"), 10, 10, 1}
+  ,
+  {"BayerGR10p", "Bayer GR 10p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerGR10p"), 10, 10, 1}
+  ,
+  {"BayerRG10p", "Bayer RG 10p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerRG10p"), 10, 10, 1}
+  ,
+  {"BayerGB10p", "Bayer GB 10p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerGB10p"), 10, 10, 1}
+  ,
+  {"BayerBG12p", "Bayer BG 12p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerBG12p"), 12, 12, 1}
+  ,
+  {"BayerGR12p", "Bayer GR 12p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerGR12p"), 12, 12, 1}
+  ,
+  {"BayerRG12p", "Bayer RG 12p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerRG12p"), 12, 12, 1}
+  ,
+  {"BayerGB12p", "Bayer GB 12p", 0, GST_GENICAM_PIXEL_FORMAT_MAKE_PACKED ("BayerGB12p"), 12, 12, 1}
 };
 
 int strcmp_ignore_whitespace (const char *s1, const char *s2)
@@ -256,8 +294,9 @@ static int
 gst_genicam_pixel_format_get_stride (const char *pixel_format,
     int endianness, int width)
 {
-  return width * gst_genicam_pixel_format_get_depth (pixel_format,
-      endianness) / 8;
+  /* round up, packed formats don't fill whole bytes for every width */
+  return (width * gst_genicam_pixel_format_get_depth (pixel_format,
+      endianness) + 7) / 8;
 }
 
 static GstCaps *
@@ -0,0 +1,414 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* Maps a device timestamp counter onto the pipeline clock.
+ *
+ * Sources feed one sample per frame of (device ticks, host monotonic time
+ * and pipeline clock time at which the frame was retrieved). A least squares
+ * line through the most recent samples gives offset and drift of the device
+ * clock against the host clock, so retrieval jitter of a single frame doesn't
+ * end up in its timestamp. The pipeline clock may be slaved to the network
+ * or another device, so it is only related to the host clock by the offset
+ * of the latest sample. Samples that are far off the line (a late wakeup, a
+ * stalled driver) are left out of the fit, and a counter narrower than 64
+ * bits is extended across wraps.
+ *
+ * Usage:
+ *   gst_vision_clock_mapper_init (&src->clock_mapper, tick_frequency, 32, 0);
+ *   ...
+ *   clock_time = gst_vision_clock_mapper_add_sample_full (&src->clock_mapper,
+ *       device_ticks, g_get_monotonic_time () * GST_USECOND,
+ *       gst_clock_get_time (clock));
+ *   pts = gst_vision_clock_mapper_running_time (GST_ELEMENT (src),
+ *       clock_time);
+ *
+ * Not thread safe, callers serialize access.
+ */
+
+#ifndef _GST_VISION_CLOCK_MAPPER_H_
+#define _GST_VISION_CLOCK_MAPPER_H_
+
+#include <math.h>
+#include <gst/gst.h>
+
+#define GST_VISION_CLOCK_MAPPER_MAX_SAMPLES 64
+#define GST_VISION_CLOCK_MAPPER_DEFAULT_WINDOW 32
+
+/* samples needed before outliers are rejected */
+#define GST_VISION_CLOCK_MAPPER_MIN_FIT_SAMPLES 8
+/* a sample is an outlier when further than this many RMS residuals away */
+#define GST_VISION_CLOCK_MAPPER_OUTLIER_FACTOR 4.0
+/* ...but never reject samples within this distance of the fit */
+#define GST_VISION_CLOCK_MAPPER_MIN_OUTLIER_NS (200 * GST_USECOND)
+/* with fewer samples the RMS means little, a sample this far off is an
+ * outlier */
+#define GST_VISION_CLOCK_MAPPER_EARLY_OUTLIER_NS (5 * GST_MSECOND)
+
+typedef struct
+{
+  /* configuration */
+  gdouble tick_frequency;       /* device ticks per second */
+  guint counter_bits;           /* width of the device counter */
+  guint window;                 /* number of samples in the fit */
+
+  /* counter rollover extension */
+  guint64 last_raw_ticks;
+  guint64 tick_offset;
+  gboolean have_ticks;
+
+  /* sample ring, of device ticks against host time */
+  guint64 ticks[GST_VISION_CLOCK_MAPPER_MAX_SAMPLES];
+  GstClockTime clock_times[GST_VISION_CLOCK_MAPPER_MAX_SAMPLES];
+  guint num_samples;
+  guint sample_index;
+
+  /* pipeline clock minus host time at the latest sample */
+  GstClockTimeDiff clock_offset;
+
+  /* current fit in host time, relative to the oldest sample in the window */
+  guint64 tick0;
+  GstClockTime clock0;
+  gdouble mean_x;
+  gdouble mean_y;
+  gdouble slope;
+  gdouble rms;
+
+  /* output is kept monotonic */
+  GstClockTime last_output;
+
+  /* diagnostics */
+  guint consecutive_outliers;
+  guint64 num_outliers;
+  guint64 num_resets;
+  guint64 num_rollovers;
+} GstVisionClockMapper;
+
+/* forget all samples, keeping the configuration and diagnostics */
+static inline void
+gst_vision_clock_mapper_reset (GstVisionClockMapper * mapper)
+{
+  mapper->have_ticks = FALSE;
+  mapper->last_raw_ticks = 0;
+  mapper->tick_offset = 0;
+  mapper->num_samples = 0;
+  mapper->sample_index = 0;
+  mapper->clock_offset = 0;
+  mapper->tick0 = 0;
+  mapper->clock0 = 0;
+  mapper->mean_x = 0.0;
+  mapper->mean_y = 0.0;
+  mapper->slope = 1.0;
+  mapper->rms = 0.0;
+  mapper->last_output = GST_CLOCK_TIME_NONE;
+  mapper->consecutive_outliers = 0;
+}
+
+/* @tick_frequency: device ticks per second, an estimate is fine since drift
+ *   is corrected by the fit
+ * @counter_bits: width of the device counter, 64 if it doesn't wrap
+ * @window: number of samples to fit, 0 for the default */
+static inline void
+gst_vision_clock_mapper_init (GstVisionClockMapper * mapper,
+    gdouble tick_frequency, guint counter_bits, guint window)
+{
+  mapper->tick_frequency = tick_frequency > 0.0 ? tick_frequency : 1e9;
+  mapper->counter_bits = CLAMP (counter_bits, 1, 64);
+  if (window == 0)
+    window = GST_VISION_CLOCK_MAPPER_DEFAULT_WINDOW;
+  mapper->window = CLAMP (window, 2, GST_VISION_CLOCK_MAPPER_MAX_SAMPLES);
+  mapper->num_outliers = 0;
+  mapper->num_resets = 0;
+  mapper->num_rollovers = 0;
+  gst_vision_clock_mapper_reset (mapper);
+}
+
+/* extend a raw counter value to 64 bits, returns FALSE if the counter went
+ * backwards by more than a wrap explains, i.e. the device was reset */
+static inline gboolean
+gst_vision_clock_mapper_extend (GstVisionClockMapper * mapper,
+    guint64 raw_ticks, guint64 * ticks)
+{
+  if (mapper->counter_bits < 64) {
+    const guint64 range = G_GUINT64_CONSTANT (1) << mapper->counter_bits;
+    raw_ticks &= range - 1;
+
+    if (mapper->have_ticks && raw_ticks < mapper->last_raw_ticks) {
+      if (mapper->last_raw_ticks - raw_ticks > range / 2) {
+        mapper->tick_offset += range;
+        mapper->num_rollovers++;
+      } else {
+        return FALSE;
+      }
+    }
+  } else if (mapper->have_ticks && raw_ticks < mapper->last_raw_ticks) {
+    return FALSE;
+  }
+
+  mapper->last_raw_ticks = raw_ticks;
+  mapper->have_ticks = TRUE;
+  *ticks = mapper->tick_offset + raw_ticks;
+
+  return TRUE;
+}
+
+static inline gdouble
+gst_vision_clock_mapper_ticks_to_x (GstVisionClockMapper * mapper,
+    guint64 ticks)
+{
+  return (gdouble) (gint64) (ticks - mapper->tick0) * GST_SECOND /
+      mapper->tick_frequency;
+}
+
+static inline void
+gst_vision_clock_mapper_fit (GstVisionClockMapper * mapper)
+{
+  const guint max_samples = mapper->window;
+  gdouble sxx = 0.0, sxy = 0.0, syy = 0.0;
+  guint oldest, i;
+
+  /* use the oldest sample as origin to keep precision in doubles */
+  oldest = (mapper->sample_index + max_samples - mapper->num_samples)
+      % max_samples;
+  mapper->tick0 = mapper->ticks[oldest];
+  mapper->clock0 = mapper->clock_times[oldest];
+
+  mapper->mean_x = 0.0;
+  mapper->mean_y = 0.0;
+  for (i = 0; i < mapper->num_samples; i++) {
+    mapper->mean_x +=
+        gst_vision_clock_mapper_ticks_to_x (mapper, mapper->ticks[i]);
+    mapper->mean_y +=
+        (gdouble) GST_CLOCK_DIFF (mapper->clock0, mapper->clock_times[i]);
+  }
+  mapper->mean_x /= mapper->num_samples;
+  mapper->mean_y /= mapper->num_samples;
+
+  for (i = 0; i < mapper->num_samples; i++) {
+    gdouble dx = gst_vision_clock_mapper_ticks_to_x (mapper, mapper->ticks[i])
+        - mapper->mean_x;
+    gdouble dy =
+        (gdouble) GST_CLOCK_DIFF (mapper->clock0, mapper->clock_times[i]) -
+        mapper->mean_y;
+    sxx += dx * dx;
+    sxy += dx * dy;
+    syy += dy * dy;
+  }
+
+  /* over a few frames the nominal tick rate is much closer than the slope
+   * through a few jittered samples */
+  mapper->slope = 1.0;
+  if (mapper->num_samples >= GST_VISION_CLOCK_MAPPER_MIN_FIT_SAMPLES &&
+      sxx > 0.0)
+    mapper->slope = sxy / sxx;
+
+  /* residual sum of squares of the line */
+  mapper->rms = sqrt (MAX (syy - 2.0 * mapper->slope * sxy +
+          mapper->slope * mapper->slope * sxx, 0.0) / mapper->num_samples);
+}
+
+/* signed distance of the fitted line from the window origin, in ns */
+static inline gdouble
+gst_vision_clock_mapper_predict (GstVisionClockMapper * mapper, guint64 ticks)
+{
+  gdouble x = gst_vision_clock_mapper_ticks_to_x (mapper, ticks);
+  return mapper->mean_y + mapper->slope * (x - mapper->mean_x);
+}
+
+/* host time of a distance from the window origin, moved to the pipeline
+ * clock */
+static inline GstClockTime
+gst_vision_clock_mapper_to_clock_time (GstVisionClockMapper * mapper,
+    gdouble y)
+{
+  y += (gdouble) mapper->clock_offset;
+  if (y < 0.0 && (GstClockTime) (-y) > mapper->clock0)
+    return 0;
+  return mapper->clock0 + (GstClockTimeDiff) y;
+}
+
+/**
+ * gst_vision_clock_mapper_convert:
+ * @mapper: a #GstVisionClockMapper
+ * @ticks: extended device ticks, as returned in a previous sample
+ *
+ * Returns: the pipeline clock time of @ticks under the current fit, or
+ * GST_CLOCK_TIME_NONE if there are no samples yet
+ */
+static inline GstClockTime
+gst_vision_clock_mapper_convert (GstVisionClockMapper * mapper, guint64 ticks)
+{
+  if (mapper->num_samples == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  return gst_vision_clock_mapper_to_clock_time (mapper,
+      gst_vision_clock_mapper_predict (mapper, ticks));
+}
+
+/**
+ * gst_vision_clock_mapper_add_sample_full:
+ * @mapper: a #GstVisionClockMapper
+ * @raw_ticks: device counter value of the frame
+ * @host_time: monotonic host time the frame was retrieved at, in ns
+ * @clock_time: pipeline clock time read together with @host_time
+ *
+ * Adds a sample and maps @raw_ticks to the pipeline clock. The device clock
+ * is fitted against @host_time, which only carries the retrieval jitter, and
+ * moved to the pipeline clock by the offset of this sample. The result never
+ * goes backwards, unless the device counter is reset.
+ *
+ * Returns: the pipeline clock time of the frame
+ */
+static inline GstClockTime
+gst_vision_clock_mapper_add_sample_full (GstVisionClockMapper * mapper,
+    guint64 raw_ticks, GstClockTime host_time, GstClockTime clock_time)
+{
+  guint64 ticks;
+  GstClockTime result;
+
+  /* device was reset or counter was cleared, start over */
+  if (!gst_vision_clock_mapper_extend (mapper, raw_ticks, &ticks)) {
+    mapper->num_resets++;
+    gst_vision_clock_mapper_reset (mapper);
+    gst_vision_clock_mapper_extend (mapper, raw_ticks, &ticks);
+  }
+
+  mapper->clock_offset = GST_CLOCK_DIFF (host_time, clock_time);
+
+  if (mapper->num_samples > 0) {
+    gdouble residual = (gdouble) GST_CLOCK_DIFF (mapper->clock0, host_time) -
+        gst_vision_clock_mapper_predict (mapper, ticks);
+    gdouble limit;
+
+    if (mapper->num_samples >= GST_VISION_CLOCK_MAPPER_MIN_FIT_SAMPLES)
+      limit = MAX (GST_VISION_CLOCK_MAPPER_OUTLIER_FACTOR * mapper->rms,
+          (gdouble) GST_VISION_CLOCK_MAPPER_MIN_OUTLIER_NS);
+    else
+      limit = (gdouble) GST_VISION_CLOCK_MAPPER_EARLY_OUTLIER_NS;
+
+    if (residual < -limit &&
+        mapper->num_samples < GST_VISION_CLOCK_MAPPER_MIN_FIT_SAMPLES) {
+      /* frames are only ever retrieved late, so it's the few samples so far
+       * that were off, start over from this one */
+      mapper->num_outliers += mapper->num_samples;
+      gst_vision_clock_mapper_reset (mapper);
+      gst_vision_clock_mapper_extend (mapper, raw_ticks, &ticks);
+      mapper->clock_offset = GST_CLOCK_DIFF (host_time, clock_time);
+    } else if (fabs (residual) > limit) {
+      mapper->num_outliers++;
+      mapper->consecutive_outliers++;
+
+      /* a run of outliers means the relation itself changed */
+      if (mapper->consecutive_outliers < mapper->window / 2) {
+        result = gst_vision_clock_mapper_convert (mapper, ticks);
+        goto done;
+      }
+
+      mapper->num_resets++;
+      gst_vision_clock_mapper_reset (mapper);
+      gst_vision_clock_mapper_extend (mapper, raw_ticks, &ticks);
+      mapper->clock_offset = GST_CLOCK_DIFF (host_time, clock_time);
+    }
+  }
+  mapper->consecutive_outliers = 0;
+
+  mapper->ticks[mapper->sample_index] = ticks;
+  mapper->clock_times[mapper->sample_index] = host_time;
+  mapper->sample_index = (mapper->sample_index + 1) % mapper->window;
+  if (mapper->num_samples < mapper->window)
+    mapper->num_samples++;
+
+  gst_vision_clock_mapper_fit (mapper);
+  result = gst_vision_clock_mapper_convert (mapper, ticks);
+
+done:
+  if (GST_CLOCK_TIME_IS_VALID (mapper->last_output) &&
+      result < mapper->last_output) {
+    result = mapper->last_output;
+  }
+  mapper->last_output = result;
+
+  return result;
+}
+
+/**
+ * gst_vision_clock_mapper_add_sample:
+ * @mapper: a #GstVisionClockMapper
+ * @raw_ticks: device counter value of the frame
+ * @clock_time: pipeline clock time the frame was retrieved at
+ *
+ * Like gst_vision_clock_mapper_add_sample_full(), for when the pipeline clock
+ * is the only clock at hand and is fitted against directly.
+ *
+ * Returns: the pipeline clock time of the frame
+ */
+static inline GstClockTime
+gst_vision_clock_mapper_add_sample (GstVisionClockMapper * mapper,
+    guint64 raw_ticks, GstClockTime clock_time)
+{
+  return gst_vision_clock_mapper_add_sample_full (mapper, raw_ticks,
+      clock_time, clock_time);
+}
+
+/**
+ * gst_vision_clock_mapper_running_time:
+ * @element: the element timestamping the frame
+ * @clock_time: pipeline clock time of the frame
+ *
+ * Returns: the running time of @clock_time in @element, or
+ * GST_CLOCK_TIME_NONE if it is invalid or from before the element started
+ * running, rather than a negative difference wrapped into a huge PTS
+ */
+static inline GstClockTime
+gst_vision_clock_mapper_running_time (GstElement * element,
+    GstClockTime clock_time)
+{
+  GstClockTime base_time = gst_element_get_base_time (element);
+
+  if (!GST_CLOCK_TIME_IS_VALID (clock_time) ||
+      !GST_CLOCK_TIME_IS_VALID (base_time) || clock_time < base_time)
+    return GST_CLOCK_TIME_NONE;
+
+  return clock_time - base_time;
+}
+
+/**
+ * gst_vision_clock_mapper_get_skew:
+ * @mapper: a #GstVisionClockMapper
+ *
+ * Returns: the estimated rate of the device clock relative to the pipeline
+ * clock, in parts per million, positive if the device clock runs slow
+ */
+static inline gdouble
+gst_vision_clock_mapper_get_skew (GstVisionClockMapper * mapper)
+{
+  return (mapper->slope - 1.0) * 1e6;
+}
+
+/**
+ * gst_vision_clock_mapper_get_jitter:
+ * @mapper: a #GstVisionClockMapper
+ *
+ * Returns: RMS distance of the samples from the fit, in nanoseconds
+ */
+static inline gdouble
+gst_vision_clock_mapper_get_jitter (GstVisionClockMapper * mapper)
+{
+  return mapper->rms;
+}
+
+#endif
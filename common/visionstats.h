@@ -0,0 +1,388 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* Acquisition statistics shared by the sources.
+ *
+ * Sources count frames as they go and expose the totals the same way:
+ *  - a read-only "stats" property holding a vision-stats GstStructure
+ *  - a "stats-interval" property, the period in ms of vision-stats element
+ *    messages posted on the bus (0 disables them)
+ *  - a "vision-stats" GstTracerRecord logged for every frame, also with
+ *    messages disabled, so GST_TRACERS based monitoring sees them without
+ *    element debug logs (GStreamer 1.8 and later)
+ *
+ * The vision-stats structure has these fields:
+ *  - frames-delivered (guint64): frames pushed downstream
+ *  - frames-dropped (guint64): frames lost before reaching the host, i.e.
+ *    gaps in the device frame counter or missed by the grabber
+ *  - frames-overwritten (guint64): frames discarded by the source because
+ *    its queue was full
+ *  - timeouts (guint64): waits for a frame that timed out
+ *  - queue-depth (guint): frames waiting to be pushed
+ *  - latency-max (guint64): largest capture to push latency in ns
+ *  - latency-mean (guint64): mean capture to push latency in ns
+ *  - latency-histogram (GstValueArray of guint64): capture to push latency,
+ *    bin i counts latencies in [2^i, 2^(i+1)) us, first and last bins are
+ *    open ended
+ *
+ * All functions are thread safe.
+ */
+
+#ifndef _GST_VISION_STATS_H_
+#define _GST_VISION_STATS_H_
+
+/* the tracer record API is unstable, gst/gst.h only declares it when
+ * GST_USE_UNSTABLE_API is defined before its first inclusion */
+#if defined (GST_USE_UNSTABLE_API) || !defined (__GST_H__)
+#define GST_VISION_STATS_UNSTABLE_API_DECLARED
+#endif
+#ifndef GST_USE_UNSTABLE_API
+#define GST_USE_UNSTABLE_API
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+
+#if GST_CHECK_VERSION (1, 8, 0)
+#if defined (GST_VISION_STATS_UNSTABLE_API_DECLARED)
+#define GST_VISION_STATS_HAVE_TRACER_RECORD
+#elif !defined (GST_DISABLE_GST_DEBUG)
+/* most sources include gst/gst.h first, declare the two unstable functions
+ * used here rather than require it for the whole build */
+#define GST_VISION_STATS_HAVE_TRACER_RECORD
+G_BEGIN_DECLS
+GstTracerRecord *gst_tracer_record_new (const gchar * name,
+    const gchar * firstfield, ...) G_GNUC_NULL_TERMINATED;
+void gst_tracer_record_log (GstTracerRecord * self, ...);
+G_END_DECLS
+#endif
+#endif
+
+#define GST_VISION_STATS_LATENCY_BINS 16
+#define GST_VISION_STATS_DEFAULT_INTERVAL 1000
+
+typedef struct
+{
+  GMutex lock;
+
+  guint64 frames_delivered;
+  guint64 frames_dropped;
+  guint64 frames_overwritten;
+  guint64 timeouts;
+  guint queue_depth;
+
+  guint64 latency_histogram[GST_VISION_STATS_LATENCY_BINS];
+  GstClockTime latency_max;
+  GstClockTime latency_total;
+  guint64 latency_count;
+
+  /* periodic messages */
+  guint interval;
+  GstClockTime last_post_time;
+} GstVisionStats;
+
+/* zero all counters, keeping the interval */
+static inline void
+gst_vision_stats_reset (GstVisionStats * stats)
+{
+  g_mutex_lock (&stats->lock);
+  stats->frames_delivered = 0;
+  stats->frames_dropped = 0;
+  stats->frames_overwritten = 0;
+  stats->timeouts = 0;
+  stats->queue_depth = 0;
+  memset (stats->latency_histogram, 0, sizeof (stats->latency_histogram));
+  stats->latency_max = 0;
+  stats->latency_total = 0;
+  stats->latency_count = 0;
+  stats->last_post_time = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline void
+gst_vision_stats_init (GstVisionStats * stats)
+{
+  g_mutex_init (&stats->lock);
+  stats->interval = GST_VISION_STATS_DEFAULT_INTERVAL;
+  gst_vision_stats_reset (stats);
+}
+
+static inline void
+gst_vision_stats_clear (GstVisionStats * stats)
+{
+  g_mutex_clear (&stats->lock);
+}
+
+/* Returns: @now - @capture, or GST_CLOCK_TIME_NONE if either is invalid or
+ * the capture time is ahead of @now, e.g. after device clock drift */
+static inline GstClockTime
+gst_vision_stats_latency (GstClockTime capture, GstClockTime now)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (capture) || !GST_CLOCK_TIME_IS_VALID (now) ||
+      now < capture)
+    return GST_CLOCK_TIME_NONE;
+
+  return now - capture;
+}
+
+/* @latency: capture to push latency, or GST_CLOCK_TIME_NONE if unknown */
+static inline void
+gst_vision_stats_add_delivered (GstVisionStats * stats, GstClockTime latency)
+{
+  g_mutex_lock (&stats->lock);
+  stats->frames_delivered++;
+  if (GST_CLOCK_TIME_IS_VALID (latency)) {
+    guint64 us = latency / GST_USECOND;
+    guint bin = 0;
+    while (us > 1 && bin < GST_VISION_STATS_LATENCY_BINS - 1) {
+      us >>= 1;
+      bin++;
+    }
+    stats->latency_histogram[bin]++;
+    stats->latency_max = MAX (stats->latency_max, latency);
+    stats->latency_total += latency;
+    stats->latency_count++;
+  }
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline void
+gst_vision_stats_add_dropped (GstVisionStats * stats, guint64 count)
+{
+  g_mutex_lock (&stats->lock);
+  stats->frames_dropped += count;
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline void
+gst_vision_stats_add_overwritten (GstVisionStats * stats, guint64 count)
+{
+  g_mutex_lock (&stats->lock);
+  stats->frames_overwritten += count;
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline void
+gst_vision_stats_add_timeout (GstVisionStats * stats)
+{
+  g_mutex_lock (&stats->lock);
+  stats->timeouts++;
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline void
+gst_vision_stats_set_queue_depth (GstVisionStats * stats, guint depth)
+{
+  g_mutex_lock (&stats->lock);
+  stats->queue_depth = depth;
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline void
+gst_vision_stats_set_interval (GstVisionStats * stats, guint interval)
+{
+  g_mutex_lock (&stats->lock);
+  stats->interval = interval;
+  g_mutex_unlock (&stats->lock);
+}
+
+static inline guint
+gst_vision_stats_get_interval (GstVisionStats * stats)
+{
+  guint interval;
+
+  g_mutex_lock (&stats->lock);
+  interval = stats->interval;
+  g_mutex_unlock (&stats->lock);
+
+  return interval;
+}
+
+/* called with lock held */
+static inline GstStructure *
+gst_vision_stats_to_structure_unlocked (GstVisionStats * stats)
+{
+  GstStructure *s;
+  GValue histogram = G_VALUE_INIT;
+  GValue bin = G_VALUE_INIT;
+  guint i;
+
+  s = gst_structure_new ("vision-stats",
+      "frames-delivered", G_TYPE_UINT64, stats->frames_delivered,
+      "frames-dropped", G_TYPE_UINT64, stats->frames_dropped,
+      "frames-overwritten", G_TYPE_UINT64, stats->frames_overwritten,
+      "timeouts", G_TYPE_UINT64, stats->timeouts,
+      "queue-depth", G_TYPE_UINT, stats->queue_depth,
+      "latency-max", G_TYPE_UINT64, (guint64) stats->latency_max,
+      "latency-mean", G_TYPE_UINT64, stats->latency_count > 0 ?
+      (guint64) (stats->latency_total / stats->latency_count) : 0, NULL);
+
+  gst_value_array_init (&histogram, GST_VISION_STATS_LATENCY_BINS);
+  g_value_init (&bin, G_TYPE_UINT64);
+  for (i = 0; i < GST_VISION_STATS_LATENCY_BINS; i++) {
+    g_value_set_uint64 (&bin, stats->latency_histogram[i]);
+    gst_value_array_append_value (&histogram, &bin);
+  }
+  g_value_unset (&bin);
+  gst_structure_take_value (s, "latency-histogram", &histogram);
+
+  return s;
+}
+
+/* Returns: (transfer full): a vision-stats structure, for the "stats"
+ * property */
+static inline GstStructure *
+gst_vision_stats_get_structure (GstVisionStats * stats)
+{
+  GstStructure *s;
+
+  g_mutex_lock (&stats->lock);
+  s = gst_vision_stats_to_structure_unlocked (stats);
+  g_mutex_unlock (&stats->lock);
+
+  return s;
+}
+
+#ifdef GST_VISION_STATS_HAVE_TRACER_RECORD
+static inline GstTracerRecord *
+gst_vision_stats_get_tracer_record (void)
+{
+  static GstTracerRecord *record = NULL;
+
+  if (g_once_init_enter (&record)) {
+    GstTracerRecord *r = gst_tracer_record_new ("vision-stats.class",
+        "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+            "type", G_TYPE_GTYPE, G_TYPE_STRING,
+            "related", GST_TYPE_TRACER_VALUE_SCOPE,
+            GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+        "frames-delivered", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "Frames pushed downstream", NULL),
+        "frames-dropped", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "Frames lost before the host", NULL),
+        "frames-overwritten", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "Frames discarded by a full queue",
+            NULL),
+        "timeouts", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "Waits for a frame that timed out",
+            NULL),
+        "queue-depth", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT,
+            "description", G_TYPE_STRING, "Frames waiting to be pushed", NULL),
+        "latency-max", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "Largest capture to push latency",
+            NULL), NULL);
+    GST_OBJECT_FLAG_SET (r, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+    g_once_init_leave (&record, r);
+  }
+
+  return record;
+}
+#endif
+
+/* Log the counters to the vision-stats tracer record, if debug output is
+ * active at all, whether or not messages are posted */
+static inline void
+gst_vision_stats_log_tracer (GstVisionStats * stats, GstElement * element)
+{
+#ifdef GST_VISION_STATS_HAVE_TRACER_RECORD
+  guint64 delivered, dropped, overwritten, timeouts;
+  guint queue_depth;
+  GstClockTime latency_max;
+  gchar *name;
+
+  if (!gst_debug_is_active ())
+    return;
+
+  g_mutex_lock (&stats->lock);
+  delivered = stats->frames_delivered;
+  dropped = stats->frames_dropped;
+  overwritten = stats->frames_overwritten;
+  timeouts = stats->timeouts;
+  queue_depth = stats->queue_depth;
+  latency_max = stats->latency_max;
+  g_mutex_unlock (&stats->lock);
+
+  name = gst_object_get_name (GST_OBJECT (element));
+  gst_tracer_record_log (gst_vision_stats_get_tracer_record (), name,
+      delivered, dropped, overwritten, timeouts, queue_depth,
+      (guint64) latency_max);
+  g_free (name);
+#endif
+}
+
+/* Log the tracer record, and post a vision-stats element message if the
+ * interval has passed since the last one. @clock_time is the current
+ * pipeline clock time, source specific fields can be appended as a NULL
+ * terminated list of name, type, value. Returns TRUE if a message was
+ * posted. */
+static inline gboolean
+gst_vision_stats_post (GstVisionStats * stats, GstElement * element,
+    GstClockTime clock_time, const gchar * firstfield, ...)
+{
+  GstStructure *s;
+  va_list varargs;
+
+  gst_vision_stats_log_tracer (stats, element);
+
+  g_mutex_lock (&stats->lock);
+  if (stats->interval == 0 || !GST_CLOCK_TIME_IS_VALID (clock_time) ||
+      (GST_CLOCK_TIME_IS_VALID (stats->last_post_time) &&
+          clock_time < stats->last_post_time +
+          stats->interval * GST_MSECOND)) {
+    g_mutex_unlock (&stats->lock);
+    return FALSE;
+  }
+  stats->last_post_time = clock_time;
+  s = gst_vision_stats_to_structure_unlocked (stats);
+  g_mutex_unlock (&stats->lock);
+
+  if (firstfield) {
+    va_start (varargs, firstfield);
+    gst_structure_set_valist (s, firstfield, varargs);
+    va_end (varargs);
+  }
+
+  gst_element_post_message (element,
+      gst_message_new_element (GST_OBJECT (element), s));
+
+  return TRUE;
+}
+
+/* Install the "stats" and "stats-interval" properties with the given IDs */
+static inline void
+gst_vision_stats_install_properties (GObjectClass * gobject_class,
+    guint prop_stats, guint prop_stats_interval)
+{
+  g_object_class_install_property (gobject_class, prop_stats,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Acquisition statistics, as a vision-stats structure",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, prop_stats_interval,
+      g_param_spec_uint ("stats-interval", "Statistics interval (ms)",
+          "Interval in ms between vision-stats element messages "
+          "(0 to disable)", 0, G_MAXUINT, GST_VISION_STATS_DEFAULT_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+}
+
+#endif
@@ -0,0 +1,831 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:gstvisiongrabbersrc
+ *
+ * Base class for sources where a driver callback delivers frames and
+ * create () hands them downstream. The driver side calls
+ * gst_vision_grabber_src_push_frame (), which never blocks or takes a lock
+ * unless the streaming thread is asleep waiting for a frame. Frames go
+ * through a preallocated single producer, single consumer ring sized by the
+ * queue-size property, and the overflow property decides which frame is
+ * discarded when it is full.
+ *
+ * The base class takes care of unlock and flushing, wraps driver memory
+ * zero-copy unless the subclass fills buffers itself, answers latency
+ * queries and keeps the vision-stats counters.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstvisiongrabbersrc.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vision_grabber_src_debug);
+#define GST_CAT_DEFAULT gst_vision_grabber_src_debug
+
+enum
+{
+  PROP_0,
+  PROP_QUEUE_SIZE,
+  PROP_OVERFLOW,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
+};
+
+#define DEFAULT_PROP_QUEUE_SIZE 8
+#define DEFAULT_PROP_OVERFLOW GST_VISION_GRABBER_OVERFLOW_DROP_OLDEST
+
+/* one per start/stop cycle, so buffers of a new cycle don't hold back the
+ * memory freed at the end of the previous one. Outlives the cycle while
+ * buffers still reference it. */
+typedef struct
+{
+  gint outstanding;
+  GSList *pending_free;
+  gboolean ended;
+} GstVisionGrabberSession;
+
+typedef struct
+{
+  GstVisionGrabberSrc *src;
+  GstVisionGrabberSession *session;
+  GstVisionGrabberFrame frame;
+} GstVisionGrabberWrappedFrame;
+
+typedef struct
+{
+  GDestroyNotify free_func;
+  gpointer data;
+} GstVisionGrabberPendingFree;
+
+static void gst_vision_grabber_src_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vision_grabber_src_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vision_grabber_src_finalize (GObject * object);
+
+static gboolean gst_vision_grabber_src_start (GstBaseSrc * bsrc);
+static gboolean gst_vision_grabber_src_stop (GstBaseSrc * bsrc);
+static gboolean gst_vision_grabber_src_unlock (GstBaseSrc * bsrc);
+static gboolean gst_vision_grabber_src_unlock_stop (GstBaseSrc * bsrc);
+static gboolean gst_vision_grabber_src_query (GstBaseSrc * bsrc,
+    GstQuery * query);
+
+static GstFlowReturn gst_vision_grabber_src_create (GstPushSrc * psrc,
+    GstBuffer ** buf);
+
+#define gst_vision_grabber_src_parent_class parent_class
+G_DEFINE_ABSTRACT_TYPE (GstVisionGrabberSrc, gst_vision_grabber_src,
+    GST_TYPE_PUSH_SRC);
+
+GType
+gst_vision_grabber_overflow_get_type (void)
+{
+  static gsize overflow_type = 0;
+  static const GEnumValue overflow_types[] = {
+    {GST_VISION_GRABBER_OVERFLOW_DROP_OLDEST, "Drop the oldest queued frame",
+        "drop-oldest"},
+    {GST_VISION_GRABBER_OVERFLOW_DROP_NEWEST, "Drop the incoming frame",
+        "drop-newest"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&overflow_type)) {
+    GType tmp = g_enum_register_static ("GstVisionGrabberOverflow",
+        overflow_types);
+    g_once_init_leave (&overflow_type, tmp);
+  }
+
+  return (GType) overflow_type;
+}
+
+static void
+gst_vision_grabber_src_class_init (GstVisionGrabberSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
+  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "visiongrabbersrc", 0,
+      "Frame grabber source base class");
+
+  gobject_class->set_property = gst_vision_grabber_src_set_property;
+  gobject_class->get_property = gst_vision_grabber_src_get_property;
+  gobject_class->finalize = gst_vision_grabber_src_finalize;
+
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_vision_grabber_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_vision_grabber_src_stop);
+  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_vision_grabber_src_unlock);
+  gstbasesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_vision_grabber_src_unlock_stop);
+  gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_vision_grabber_src_query);
+
+  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_vision_grabber_src_create);
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_SIZE,
+      g_param_spec_uint ("queue-size", "Queue size",
+          "Number of frames that can wait to be pushed downstream, rounded "
+          "up to a power of two", 1, 1024, DEFAULT_PROP_QUEUE_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_OVERFLOW,
+      g_param_spec_enum ("overflow", "Overflow",
+          "Frame to drop when the queue is full",
+          GST_TYPE_VISION_GRABBER_OVERFLOW, DEFAULT_PROP_OVERFLOW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
+}
+
+static void
+gst_vision_grabber_src_init (GstVisionGrabberSrc * src)
+{
+  /* set source as live (no preroll) */
+  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
+
+  /* override default of BYTES to operate in time mode */
+  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
+
+  src->timeout = GST_CLOCK_TIME_NONE;
+  src->queue_size = DEFAULT_PROP_QUEUE_SIZE;
+  src->overflow = DEFAULT_PROP_OVERFLOW;
+
+  src->ring = NULL;
+  src->ring_mask = 0;
+  src->read_index = 0;
+  src->write_index = 0;
+  src->waiting = 0;
+  src->flushing = 0;
+  src->session = g_slice_new0 (GstVisionGrabberSession);
+  src->acquisition_started = FALSE;
+  src->last_frame_number = GST_VISION_GRABBER_FRAME_NUMBER_NONE;
+
+  g_mutex_init (&src->lock);
+  g_cond_init (&src->cond);
+  gst_vision_stats_init (&src->stats);
+}
+
+static void
+gst_vision_grabber_src_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (object);
+
+  switch (property_id) {
+    case PROP_QUEUE_SIZE:
+      src->queue_size = g_value_get_uint (value);
+      break;
+    case PROP_OVERFLOW:
+      src->overflow = (GstVisionGrabberOverflow) g_value_get_enum (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vision_grabber_src_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (object);
+
+  switch (property_id) {
+    case PROP_QUEUE_SIZE:
+      g_value_set_uint (value, src->queue_size);
+      break;
+    case PROP_OVERFLOW:
+      g_value_set_enum (value, src->overflow);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vision_grabber_src_run_pending_free (GSList * pending)
+{
+  GSList *l;
+
+  for (l = pending; l != NULL; l = l->next) {
+    GstVisionGrabberPendingFree *p = (GstVisionGrabberPendingFree *) l->data;
+
+    p->free_func (p->data);
+    g_slice_free (GstVisionGrabberPendingFree, p);
+  }
+  g_slist_free (pending);
+}
+
+/* called with the lock, TRUE if the session's last buffer was released after
+ * it ended, so nothing references it anymore */
+static gboolean
+gst_vision_grabber_src_session_release (GstVisionGrabberSession * session,
+    GSList ** pending)
+{
+  session->outstanding--;
+  if (session->outstanding > 0)
+    return FALSE;
+
+  *pending = g_slist_reverse (session->pending_free);
+  session->pending_free = NULL;
+
+  return session->ended;
+}
+
+static void
+gst_vision_grabber_src_finalize (GObject * object)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (object);
+  GstVisionGrabberSession *session = (GstVisionGrabberSession *) src->session;
+
+  /* every wrapped buffer holds a ref, so nothing can be outstanding here */
+  gst_vision_grabber_src_run_pending_free (g_slist_reverse
+      (session->pending_free));
+  g_slice_free (GstVisionGrabberSession, session);
+  src->session = NULL;
+
+  g_free (src->ring);
+  src->ring = NULL;
+
+  g_mutex_clear (&src->lock);
+  g_cond_clear (&src->cond);
+  gst_vision_stats_clear (&src->stats);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/**
+ * gst_vision_grabber_frame_init:
+ * @frame: a #GstVisionGrabberFrame
+ *
+ * Clear @frame, with no capture time or frame number.
+ */
+void
+gst_vision_grabber_frame_init (GstVisionGrabberFrame * frame)
+{
+  memset (frame, 0, sizeof (GstVisionGrabberFrame));
+  frame->clock_time = GST_CLOCK_TIME_NONE;
+  frame->frame_number = GST_VISION_GRABBER_FRAME_NUMBER_NONE;
+}
+
+static void
+gst_vision_grabber_src_release (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame)
+{
+  GstVisionGrabberSrcClass *klass = GST_VISION_GRABBER_SRC_GET_CLASS (src);
+
+  if (frame->buffer) {
+    gst_buffer_unref (frame->buffer);
+    frame->buffer = NULL;
+  } else if (klass->release_frame) {
+    klass->release_frame (src, frame);
+  }
+}
+
+/* consumer side, a frame is only taken once the read index moves past it,
+ * as the producer may claim the same slot when dropping the oldest frame */
+static gboolean
+gst_vision_grabber_src_ring_pop (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame)
+{
+  guint r, w;
+
+  do {
+    r = (guint) g_atomic_int_get (&src->read_index);
+    w = (guint) g_atomic_int_get (&src->write_index);
+    if (r == w)
+      return FALSE;
+    *frame = src->ring[r & src->ring_mask];
+  } while (!g_atomic_int_compare_and_exchange (&src->read_index, (gint) r,
+          (gint) (r + 1)));
+
+  return TRUE;
+}
+
+static guint
+gst_vision_grabber_src_ring_depth (GstVisionGrabberSrc * src)
+{
+  return (guint) g_atomic_int_get (&src->write_index) -
+      (guint) g_atomic_int_get (&src->read_index);
+}
+
+static void
+gst_vision_grabber_src_ring_drain (GstVisionGrabberSrc * src)
+{
+  GstVisionGrabberFrame frame;
+  guint n = 0;
+
+  if (src->ring == NULL)
+    return;
+
+  while (gst_vision_grabber_src_ring_pop (src, &frame)) {
+    gst_vision_grabber_src_release (src, &frame);
+    g_atomic_int_inc (&src->discarded);
+    n++;
+  }
+
+  if (n > 0)
+    GST_DEBUG_OBJECT (src, "Discarded %d queued frames", n);
+}
+
+/**
+ * gst_vision_grabber_src_push_frame:
+ * @src: a #GstVisionGrabberSrc
+ * @frame: the captured frame
+ *
+ * Queue @frame for create, called from the driver's callback thread. Only
+ * one thread may push at a time. If the ring is full the overflow policy
+ * picks a frame to release, and it is counted as overwritten.
+ *
+ * Returns: %TRUE if @frame was queued, %FALSE if it was released
+ */
+gboolean
+gst_vision_grabber_src_push_frame (GstVisionGrabberSrc * src,
+    const GstVisionGrabberFrame * frame)
+{
+  GstVisionGrabberFrame victim;
+  guint r, w;
+
+  g_return_val_if_fail (GST_IS_VISION_GRABBER_SRC (src), FALSE);
+  g_return_val_if_fail (frame != NULL, FALSE);
+
+  if (G_UNLIKELY (src->ring == NULL)) {
+    GST_WARNING_OBJECT (src, "Frame pushed while stopped, releasing it");
+    victim = *frame;
+    gst_vision_grabber_src_release (src, &victim);
+    return FALSE;
+  }
+
+  w = (guint) g_atomic_int_get (&src->write_index);
+  r = (guint) g_atomic_int_get (&src->read_index);
+  if (w - r > src->ring_mask) {
+    if (src->overflow == GST_VISION_GRABBER_OVERFLOW_DROP_NEWEST) {
+      GST_LOG_OBJECT (src, "Queue full, dropping newest frame");
+      gst_vision_stats_add_overwritten (&src->stats, 1);
+      g_atomic_int_inc (&src->discarded);
+      victim = *frame;
+      gst_vision_grabber_src_release (src, &victim);
+      return FALSE;
+    }
+
+    /* if create took it first there is room now anyway */
+    victim = src->ring[r & src->ring_mask];
+    if (g_atomic_int_compare_and_exchange (&src->read_index, (gint) r,
+            (gint) (r + 1))) {
+      GST_LOG_OBJECT (src, "Queue full, dropping oldest frame");
+      gst_vision_stats_add_overwritten (&src->stats, 1);
+      g_atomic_int_inc (&src->discarded);
+      gst_vision_grabber_src_release (src, &victim);
+    }
+  }
+
+  src->ring[w & src->ring_mask] = *frame;
+  g_atomic_int_set (&src->write_index, (gint) (w + 1));
+
+  /* create sets waiting before its final check of the ring, so either it
+   * sees this frame or we see it waiting */
+  if (g_atomic_int_get (&src->waiting)) {
+    g_mutex_lock (&src->lock);
+    g_cond_signal (&src->cond);
+    g_mutex_unlock (&src->lock);
+  }
+
+  return TRUE;
+}
+
+/**
+ * gst_vision_grabber_src_drop_frame:
+ * @src: a #GstVisionGrabberSrc
+ * @frame: a frame the driver delivered but that can't be used
+ *
+ * Release @frame right away, e.g. if the driver reported an error for it,
+ * and count it as dropped. Its frame number isn't counted again as a gap.
+ * Called from the driver's callback thread instead of
+ * gst_vision_grabber_src_push_frame ().
+ */
+void
+gst_vision_grabber_src_drop_frame (GstVisionGrabberSrc * src,
+    const GstVisionGrabberFrame * frame)
+{
+  GstVisionGrabberFrame victim = *frame;
+
+  gst_vision_stats_add_dropped (&src->stats, 1);
+  g_atomic_int_inc (&src->discarded);
+  gst_vision_grabber_src_release (src, &victim);
+}
+
+/**
+ * gst_vision_grabber_src_get_clock_time:
+ * @src: a #GstVisionGrabberSrc
+ *
+ * Convenience for driver callbacks stamping the capture time of a frame.
+ *
+ * Returns: the current time of the element clock, or GST_CLOCK_TIME_NONE if
+ * there is no clock
+ */
+GstClockTime
+gst_vision_grabber_src_get_clock_time (GstVisionGrabberSrc * src)
+{
+  GstClock *clock;
+  GstClockTime clock_time = GST_CLOCK_TIME_NONE;
+
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock) {
+    clock_time = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+  }
+
+  return clock_time;
+}
+
+/**
+ * gst_vision_grabber_src_wait_outstanding:
+ * @src: a #GstVisionGrabberSrc
+ * @timeout: how long to wait
+ *
+ * Wait for downstream to free the buffers of the current, or last stopped,
+ * start/stop cycle that wrap driver memory.
+ *
+ * Returns: the number of buffers still outstanding
+ */
+guint
+gst_vision_grabber_src_wait_outstanding (GstVisionGrabberSrc * src,
+    GstClockTime timeout)
+{
+  GstVisionGrabberSession *session;
+  gint64 end_time;
+  guint outstanding;
+
+  end_time = g_get_monotonic_time () + timeout / GST_USECOND;
+
+  g_mutex_lock (&src->lock);
+  session = (GstVisionGrabberSession *) src->session;
+  while (session->outstanding > 0) {
+    if (!g_cond_wait_until (&src->cond, &src->lock, end_time))
+      break;
+  }
+  outstanding = (guint) session->outstanding;
+  g_mutex_unlock (&src->lock);
+
+  return outstanding;
+}
+
+/**
+ * gst_vision_grabber_src_free_when_released:
+ * @src: a #GstVisionGrabberSrc
+ * @free_func: function freeing @data
+ * @data: driver memory, or a session owning it
+ *
+ * Free @data once no buffer of the last stopped start/stop cycle wraps
+ * driver memory anymore. That is right away if none is outstanding,
+ * otherwise when downstream releases the last one, on whatever thread that
+ * happens. Buffers of a later cycle don't delay it. Subclasses call this
+ * from stop, after chaining up, instead of waiting for downstream.
+ */
+void
+gst_vision_grabber_src_free_when_released (GstVisionGrabberSrc * src,
+    GDestroyNotify free_func, gpointer data)
+{
+  GstVisionGrabberSession *session;
+  GstVisionGrabberPendingFree *p;
+  gint outstanding;
+
+  g_return_if_fail (GST_IS_VISION_GRABBER_SRC (src));
+  g_return_if_fail (free_func != NULL);
+
+  g_mutex_lock (&src->lock);
+  session = (GstVisionGrabberSession *) src->session;
+  outstanding = session->outstanding;
+  if (outstanding > 0) {
+    p = g_slice_new (GstVisionGrabberPendingFree);
+    p->free_func = free_func;
+    p->data = data;
+    session->pending_free = g_slist_prepend (session->pending_free, p);
+  }
+  g_mutex_unlock (&src->lock);
+
+  if (outstanding > 0) {
+    GST_DEBUG_OBJECT (src, "%d buffers still held downstream, freeing "
+        "when the last is released", outstanding);
+  } else {
+    free_func (data);
+  }
+}
+
+static gboolean
+gst_vision_grabber_src_start (GstBaseSrc * bsrc)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (bsrc);
+  GstVisionGrabberSession *session;
+  guint capacity;
+
+  /* the previous cycle's session stays with its buffers still downstream,
+   * the last of them frees it */
+  g_mutex_lock (&src->lock);
+  session = (GstVisionGrabberSession *) src->session;
+  if (session->outstanding > 0) {
+    session->ended = TRUE;
+    src->session = g_slice_new0 (GstVisionGrabberSession);
+  }
+  g_mutex_unlock (&src->lock);
+
+  capacity = 1 << g_bit_storage (MAX (src->queue_size, 1) - 1);
+  GST_DEBUG_OBJECT (src, "Allocating ring of %d frames", capacity);
+
+  g_free (src->ring);
+  src->ring = g_new0 (GstVisionGrabberFrame, capacity);
+  src->ring_mask = capacity - 1;
+  g_atomic_int_set (&src->read_index, 0);
+  g_atomic_int_set (&src->write_index, 0);
+  g_atomic_int_set (&src->flushing, 0);
+
+  src->acquisition_started = FALSE;
+  src->last_frame_number = GST_VISION_GRABBER_FRAME_NUMBER_NONE;
+  g_atomic_int_set (&src->discarded, 0);
+  src->discarded_pending = 0;
+  gst_vision_stats_reset (&src->stats);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_grabber_src_stop (GstBaseSrc * bsrc)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (bsrc);
+
+  /* the driver is stopped, nothing else pushes frames, buffers still held
+   * downstream keep their frames until the subclass' deferred free */
+  gst_vision_grabber_src_ring_drain (src);
+  g_free (src->ring);
+  src->ring = NULL;
+  src->ring_mask = 0;
+
+  src->acquisition_started = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_grabber_src_unlock (GstBaseSrc * bsrc)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (bsrc);
+
+  GST_LOG_OBJECT (src, "unlock");
+
+  g_mutex_lock (&src->lock);
+  g_atomic_int_set (&src->flushing, 1);
+  g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_grabber_src_unlock_stop (GstBaseSrc * bsrc)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (bsrc);
+
+  GST_LOG_OBJECT (src, "unlock_stop");
+
+  /* create isn't running, so we can act as the consumer and throw away
+   * frames captured before the flush */
+  gst_vision_grabber_src_ring_drain (src);
+  g_atomic_int_set (&src->flushing, 0);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_grabber_src_query (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (bsrc);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:{
+      GstCaps *caps;
+      gint fps_n = 0, fps_d = 1;
+      GstClockTime min, max;
+
+      caps = gst_pad_get_current_caps (GST_BASE_SRC_PAD (bsrc));
+      if (caps) {
+        gst_structure_get_fraction (gst_caps_get_structure (caps, 0),
+            "framerate", &fps_n, &fps_d);
+        gst_caps_unref (caps);
+      }
+
+      /* a frame is pushed at least one frame period after capture starts,
+       * and can wait in every ring slot on top of that */
+      if (fps_n > 0) {
+        min = gst_util_uint64_scale_int (GST_SECOND, fps_d, fps_n);
+        max = min * (src->ring_mask + 2);
+      } else {
+        min = 0;
+        max = GST_CLOCK_TIME_NONE;
+      }
+
+      GST_DEBUG_OBJECT (src, "Reporting latency min %" GST_TIME_FORMAT
+          " max %" GST_TIME_FORMAT, GST_TIME_ARGS (min), GST_TIME_ARGS (max));
+      gst_query_set_latency (query, TRUE, min, max);
+      return TRUE;
+    }
+    default:
+      return GST_BASE_SRC_CLASS (parent_class)->query (bsrc, query);
+  }
+}
+
+static void
+gst_vision_grabber_src_release_wrapped (GstVisionGrabberWrappedFrame * wrapped)
+{
+  GstVisionGrabberSrc *src = wrapped->src;
+  GstVisionGrabberSession *session = wrapped->session;
+  GSList *pending = NULL;
+  gboolean free_session;
+
+  gst_vision_grabber_src_release (src, &wrapped->frame);
+  g_slice_free (GstVisionGrabberWrappedFrame, wrapped);
+
+  /* decremented under the lock, so stop either sees this buffer outstanding
+   * and defers its free, or sees it released */
+  g_mutex_lock (&src->lock);
+  free_session = gst_vision_grabber_src_session_release (session, &pending);
+  if (session->outstanding == 0)
+    g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->lock);
+
+  gst_vision_grabber_src_run_pending_free (pending);
+  if (free_session)
+    g_slice_free (GstVisionGrabberSession, session);
+
+  gst_object_unref (src);
+}
+
+static GstFlowReturn
+gst_vision_grabber_src_wait_frame (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame)
+{
+  gint64 end_time = -1;
+  gboolean timed_out = FALSE;
+
+  if (GST_CLOCK_TIME_IS_VALID (src->timeout))
+    end_time = g_get_monotonic_time () + src->timeout / GST_USECOND;
+
+  while (TRUE) {
+    if (g_atomic_int_get (&src->flushing))
+      return GST_FLOW_FLUSHING;
+
+    if (gst_vision_grabber_src_ring_pop (src, frame))
+      return GST_FLOW_OK;
+
+    if (timed_out) {
+      gst_vision_stats_add_timeout (&src->stats);
+      GST_ELEMENT_ERROR (src, RESOURCE, READ,
+          ("Failed to get a frame in %" GST_TIME_FORMAT,
+              GST_TIME_ARGS (src->timeout)), (NULL));
+      return GST_FLOW_ERROR;
+    }
+
+    g_mutex_lock (&src->lock);
+    g_atomic_int_set (&src->waiting, 1);
+    if (!g_atomic_int_get (&src->flushing) &&
+        gst_vision_grabber_src_ring_depth (src) == 0) {
+      if (end_time < 0) {
+        g_cond_wait (&src->cond, &src->lock);
+      } else if (!g_cond_wait_until (&src->cond, &src->lock, end_time)) {
+        timed_out = TRUE;
+      }
+    }
+    g_atomic_int_set (&src->waiting, 0);
+    g_mutex_unlock (&src->lock);
+  }
+}
+
+static GstFlowReturn
+gst_vision_grabber_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+{
+  GstVisionGrabberSrc *src = GST_VISION_GRABBER_SRC (psrc);
+  GstVisionGrabberSrcClass *klass = GST_VISION_GRABBER_SRC_GET_CLASS (src);
+  GstVisionGrabberFrame frame;
+  GstFlowReturn ret;
+  GstClockTime base_time, now;
+
+  if (G_UNLIKELY (!src->acquisition_started)) {
+    if (klass->start_acquisition && !klass->start_acquisition (src)) {
+      /* error already posted */
+      return GST_FLOW_ERROR;
+    }
+    src->acquisition_started = TRUE;
+  }
+
+  ret = gst_vision_grabber_src_wait_frame (src, &frame);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  /* gaps left by frames we overwrote or flushed ourselves aren't device
+   * drops */
+  src->discarded_pending +=
+      g_atomic_int_and ((guint *) & src->discarded, 0);
+
+  if (frame.frame_number != GST_VISION_GRABBER_FRAME_NUMBER_NONE) {
+    if (src->last_frame_number != GST_VISION_GRABBER_FRAME_NUMBER_NONE &&
+        frame.frame_number > src->last_frame_number + 1) {
+      guint64 dropped = frame.frame_number - src->last_frame_number - 1;
+      guint64 ours = MIN (dropped, src->discarded_pending);
+
+      src->discarded_pending -= ours;
+      dropped -= ours;
+      if (dropped > 0) {
+        gst_vision_stats_add_dropped (&src->stats, dropped);
+        GST_WARNING_OBJECT (src, "Dropped %" G_GUINT64_FORMAT " frames",
+            dropped);
+      }
+    } else if (src->last_frame_number != GST_VISION_GRABBER_FRAME_NUMBER_NONE
+        && frame.frame_number <= src->last_frame_number) {
+      GST_WARNING_OBJECT (src, "Frame number non-monotonic, signal disrupted?");
+    }
+    src->last_frame_number = frame.frame_number;
+  }
+
+  if (frame.buffer) {
+    *buf = frame.buffer;
+  } else if (klass->fill) {
+    ret = klass->fill (src, &frame, buf);
+    gst_vision_grabber_src_release (src, &frame);
+    if (ret != GST_FLOW_OK)
+      return ret;
+  } else {
+    GstVisionGrabberWrappedFrame *wrapped;
+
+    wrapped = g_slice_new (GstVisionGrabberWrappedFrame);
+    wrapped->src = gst_object_ref (src);
+    wrapped->frame = frame;
+
+    /* start and stop don't run concurrently with create, but the lock
+     * orders this against releases on other threads */
+    g_mutex_lock (&src->lock);
+    wrapped->session = (GstVisionGrabberSession *) src->session;
+    wrapped->session->outstanding++;
+    g_mutex_unlock (&src->lock);
+
+    *buf = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY, frame.data,
+        frame.size, 0, frame.size, wrapped,
+        (GDestroyNotify) gst_vision_grabber_src_release_wrapped);
+  }
+
+  base_time = gst_element_get_base_time (GST_ELEMENT (src));
+  if (GST_CLOCK_TIME_IS_VALID (frame.clock_time) &&
+      frame.clock_time >= base_time) {
+    GST_BUFFER_PTS (*buf) = frame.clock_time - base_time;
+  }
+  if (frame.frame_number != GST_VISION_GRABBER_FRAME_NUMBER_NONE) {
+    GST_BUFFER_OFFSET (*buf) = frame.frame_number;
+    GST_BUFFER_OFFSET_END (*buf) = frame.frame_number + 1;
+  }
+
+  if (klass->prepare_buffer) {
+    ret = klass->prepare_buffer (src, &frame, *buf);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (*buf);
+      *buf = NULL;
+      return ret;
+    }
+  }
+
+  now = gst_vision_grabber_src_get_clock_time (src);
+  gst_vision_stats_set_queue_depth (&src->stats,
+      gst_vision_grabber_src_ring_depth (src));
+  gst_vision_stats_add_delivered (&src->stats,
+      gst_vision_stats_latency (frame.clock_time, now));
+  gst_vision_stats_post (&src->stats, GST_ELEMENT (src), now, NULL);
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,203 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_VISION_GRABBER_SRC_H_
+#define _GST_VISION_GRABBER_SRC_H_
+
+#include <gst/base/gstpushsrc.h>
+
+#include "common/visionstats.h"
+
+#if defined (_MSC_VER)
+  #define GST_VISION_GRABBER_EXPORT __declspec(dllexport)
+  #define GST_VISION_GRABBER_IMPORT __declspec(dllimport)
+#elif defined (__GNUC__)
+  #define GST_VISION_GRABBER_EXPORT __attribute__((visibility("default")))
+  #define GST_VISION_GRABBER_IMPORT
+#else
+  #define GST_VISION_GRABBER_EXPORT
+  #define GST_VISION_GRABBER_IMPORT
+#endif
+
+#ifdef BUILDING_GST_VISION_GRABBER
+#define GST_VISION_GRABBER_API GST_VISION_GRABBER_EXPORT
+#else
+#define GST_VISION_GRABBER_API GST_VISION_GRABBER_IMPORT
+#endif
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VISION_GRABBER_SRC   (gst_vision_grabber_src_get_type())
+#define GST_VISION_GRABBER_SRC(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VISION_GRABBER_SRC,GstVisionGrabberSrc))
+#define GST_VISION_GRABBER_SRC_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VISION_GRABBER_SRC,GstVisionGrabberSrcClass))
+#define GST_VISION_GRABBER_SRC_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj),GST_TYPE_VISION_GRABBER_SRC,GstVisionGrabberSrcClass))
+#define GST_IS_VISION_GRABBER_SRC(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VISION_GRABBER_SRC))
+#define GST_IS_VISION_GRABBER_SRC_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VISION_GRABBER_SRC))
+
+#define GST_TYPE_VISION_GRABBER_OVERFLOW (gst_vision_grabber_overflow_get_type())
+
+/* frame counter value for devices that don't number their frames */
+#define GST_VISION_GRABBER_FRAME_NUMBER_NONE G_MAXUINT64
+
+typedef struct _GstVisionGrabberSrc GstVisionGrabberSrc;
+typedef struct _GstVisionGrabberSrcClass GstVisionGrabberSrcClass;
+
+/**
+ * GstVisionGrabberOverflow:
+ * @GST_VISION_GRABBER_OVERFLOW_DROP_OLDEST: discard the oldest queued frame
+ * @GST_VISION_GRABBER_OVERFLOW_DROP_NEWEST: discard the frame being pushed
+ *
+ * What to do with a frame pushed while the ring is full. Frames are pushed
+ * from driver callbacks, which must never block, so there is no blocking
+ * policy.
+ */
+typedef enum {
+  GST_VISION_GRABBER_OVERFLOW_DROP_OLDEST,
+  GST_VISION_GRABBER_OVERFLOW_DROP_NEWEST
+} GstVisionGrabberOverflow;
+
+/**
+ * GstVisionGrabberFrame:
+ * @data: frame memory owned by the driver
+ * @size: size of @data in bytes
+ * @buffer: (nullable): a buffer the subclass already filled, pushed as is
+ *   instead of @data
+ * @clock_time: pipeline clock time of capture, or GST_CLOCK_TIME_NONE
+ * @frame_number: device frame counter, or GST_VISION_GRABBER_FRAME_NUMBER_NONE
+ * @user_data: driver handle for the subclass, e.g. the buffer index
+ *
+ * A frame handed from the driver to the streaming thread. It is copied by
+ * value into the ring, so it must not point to anything on the callback's
+ * stack.
+ */
+typedef struct {
+  gpointer data;
+  gsize size;
+  GstBuffer *buffer;
+  GstClockTime clock_time;
+  guint64 frame_number;
+  gpointer user_data;
+} GstVisionGrabberFrame;
+
+struct _GstVisionGrabberSrc
+{
+  GstPushSrc parent;
+
+  /*< protected >*/
+  /* how long create waits for a frame, GST_CLOCK_TIME_NONE for ever, set by
+   * the subclass */
+  GstClockTime timeout;
+  GstVisionStats stats;
+
+  /*< private >*/
+  guint queue_size;
+  GstVisionGrabberOverflow overflow;
+
+  /* single producer single consumer ring, indices only ever increase and
+   * are masked when used */
+  GstVisionGrabberFrame *ring;
+  guint ring_mask;
+  gint read_index;
+  gint write_index;
+
+  /* only used to sleep when the ring is empty */
+  GMutex lock;
+  GCond cond;
+  gint waiting;
+  gint flushing;
+
+  /* buffers of the current start/stop cycle still wrapping driver memory,
+   * and what to free once the last of them is released, protected by lock */
+  gpointer session;
+
+  gboolean acquisition_started;
+  guint64 last_frame_number;
+
+  /* frames released by overflow or flush, so their numbers are skipped */
+  gint discarded;
+  guint64 discarded_pending;
+};
+
+/**
+ * GstVisionGrabberSrcClass:
+ * @start_acquisition: optional, called from the first create, when the
+ *   element clock is available
+ * @release_frame: return a frame's @data to the driver. Called for frames
+ *   discarded by the overflow policy or a flush, after @fill, or when the
+ *   buffer wrapping the frame is freed. May run on any thread.
+ * @fill: optional, produce a buffer from the frame, e.g. to copy with a
+ *   different stride. If not set, @data is wrapped without copying and
+ *   released when downstream frees the buffer.
+ * @prepare_buffer: optional, adjust the buffer before it is pushed. PTS and
+ *   offsets are already set from the frame.
+ *
+ * Subclasses override GstBaseSrc start and stop and chain up. start must
+ * chain up before the driver can push frames, stop must stop the driver
+ * before chaining up and hand frame memory to
+ * gst_vision_grabber_src_free_when_released () afterwards.
+ */
+struct _GstVisionGrabberSrcClass
+{
+  GstPushSrcClass parent_class;
+
+  gboolean      (*start_acquisition) (GstVisionGrabberSrc * src);
+  void          (*release_frame)     (GstVisionGrabberSrc * src,
+                                      GstVisionGrabberFrame * frame);
+  GstFlowReturn (*fill)              (GstVisionGrabberSrc * src,
+                                      GstVisionGrabberFrame * frame,
+                                      GstBuffer ** buf);
+  GstFlowReturn (*prepare_buffer)    (GstVisionGrabberSrc * src,
+                                      GstVisionGrabberFrame * frame,
+                                      GstBuffer * buf);
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GST_VISION_GRABBER_API
+GType         gst_vision_grabber_src_get_type (void);
+
+GST_VISION_GRABBER_API
+GType         gst_vision_grabber_overflow_get_type (void);
+
+GST_VISION_GRABBER_API
+void          gst_vision_grabber_frame_init (GstVisionGrabberFrame * frame);
+
+GST_VISION_GRABBER_API
+gboolean      gst_vision_grabber_src_push_frame (GstVisionGrabberSrc * src,
+                                                 const GstVisionGrabberFrame * frame);
+
+GST_VISION_GRABBER_API
+void          gst_vision_grabber_src_drop_frame (GstVisionGrabberSrc * src,
+                                                 const GstVisionGrabberFrame * frame);
+
+GST_VISION_GRABBER_API
+GstClockTime  gst_vision_grabber_src_get_clock_time (GstVisionGrabberSrc * src);
+
+GST_VISION_GRABBER_API
+guint         gst_vision_grabber_src_wait_outstanding (GstVisionGrabberSrc * src,
+                                                       GstClockTime timeout);
+
+GST_VISION_GRABBER_API
+void          gst_vision_grabber_src_free_when_released (GstVisionGrabberSrc * src,
+                                                         GDestroyNotify free_func,
+                                                         gpointer data);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,748 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-genicamunpack
+ *
+ * The genicamunpack element expands the packed GenICam pixel formats
+ * Mono10p, Mono12p and Mono12Packed to GRAY16_LE, and BayerXX10p and
+ * BayerXX12p to 16-bit Bayer, keeping the pixel values and announcing the
+ * bit depth with the bpp field. Packed formats save a fifth to over a third
+ * of the link bandwidth, so cameras can be left packed and unpacked here.
+ *
+ * Pixels are packed back to back over the whole frame, a line doesn't have
+ * to end on a byte boundary. Frames are unpacked with SSSE3 or AVX2 when the
+ * CPU supports it, in horizontal stripes on several threads.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 visiontestsrc pixel-format=Mono12p ! genicamunpack ! videolevels ! autovideosink
+ * ]|
+ * Unpacks 12-bit packed monochrome video and scales it to 8 bits
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstgenicamunpack.h"
+
+#if defined (HAVE_GENICAM_UNPACK_X86) && defined (_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (gst_genicam_unpack_debug);
+#define GST_CAT_DEFAULT gst_genicam_unpack_debug
+
+#include "genicampixelformat.h"
+
+/* prototypes */
+static void gst_genicam_unpack_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_genicam_unpack_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_genicam_unpack_finalize (GObject * object);
+
+static gboolean gst_genicam_unpack_stop (GstBaseTransform * trans);
+static GstCaps *gst_genicam_unpack_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static gboolean gst_genicam_unpack_set_caps (GstBaseTransform * trans,
+    GstCaps * incaps, GstCaps * outcaps);
+static gboolean gst_genicam_unpack_transform_size (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, gsize size, GstCaps * othercaps,
+    gsize * othersize);
+static GstFlowReturn gst_genicam_unpack_transform (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer * outbuf);
+
+enum
+{
+  PROP_0,
+  PROP_N_THREADS,
+  PROP_SIMD
+};
+
+#define DEFAULT_PROP_N_THREADS 0
+#define DEFAULT_PROP_SIMD TRUE
+
+#define MAX_THREADS 64
+/* don't bother waking a thread for less output than this */
+#define MIN_STRIPE_SIZE (256 * 1024)
+
+/* pad templates */
+
+static GstStaticPadTemplate gst_genicam_unpack_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_GENICAM_PIXEL_FORMAT_CAPS_PACKED)
+    );
+
+static GstStaticPadTemplate gst_genicam_unpack_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("GRAY16_LE") ";"
+        GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER16
+        ("{ bggr16, grbg16, rggb16, gbrg16 }", "1234"))
+    );
+
+typedef struct
+{
+  const gchar *name;
+  GstGenicamUnpackLayout layout;
+  gint bpp;
+  /* video/x-bayer format, or NULL for GRAY16_LE */
+  const gchar *bayer_format;
+} GstGenicamUnpackFormat;
+
+static const GstGenicamUnpackFormat gst_genicam_unpack_formats[] = {
+  {"Mono10p", GST_GENICAM_UNPACK_LAYOUT_10P, 10, NULL},
+  {"Mono12p", GST_GENICAM_UNPACK_LAYOUT_12P, 12, NULL},
+  {"Mono12Packed", GST_GENICAM_UNPACK_LAYOUT_12_PACKED, 12, NULL},
+  {"BayerBG10p", GST_GENICAM_UNPACK_LAYOUT_10P, 10, "bggr16"},
+  {"BayerGR10p", GST_GENICAM_UNPACK_LAYOUT_10P, 10, "grbg16"},
+  {"BayerRG10p", GST_GENICAM_UNPACK_LAYOUT_10P, 10, "rggb16"},
+  {"BayerGB10p", GST_GENICAM_UNPACK_LAYOUT_10P, 10, "gbrg16"},
+  {"BayerBG12p", GST_GENICAM_UNPACK_LAYOUT_12P, 12, "bggr16"},
+  {"BayerGR12p", GST_GENICAM_UNPACK_LAYOUT_12P, 12, "grbg16"},
+  {"BayerRG12p", GST_GENICAM_UNPACK_LAYOUT_12P, 12, "rggb16"},
+  {"BayerGB12p", GST_GENICAM_UNPACK_LAYOUT_12P, 12, "gbrg16"}
+};
+
+typedef void (*GstGenicamUnpackGroupsFunc) (const guint8 * src,
+    guint16 * dest, gint n_groups);
+
+typedef struct
+{
+  gint bits;
+  gint group_pixels;
+  gint group_bytes;
+  GstGenicamUnpackGroupsFunc unpack_groups;
+} GstGenicamUnpackLayoutInfo;
+
+typedef struct
+{
+  GstGenicamUnpack *filter;
+  const guint8 *in;
+  guint8 *out;
+  gint y0;
+  gint y1;
+} GstGenicamUnpackStripe;
+
+/* CPU features, detected once in class_init */
+static gboolean have_ssse3 = FALSE;
+static gboolean have_avx2 = FALSE;
+
+/* class initialization */
+
+G_DEFINE_TYPE (GstGenicamUnpack, gst_genicam_unpack, GST_TYPE_BASE_TRANSFORM);
+
+static void
+gst_genicam_unpack_detect_cpu (void)
+{
+#if defined (HAVE_GENICAM_UNPACK_X86) && defined (_MSC_VER)
+  int info[4];
+  int max_leaf;
+
+  __cpuid (info, 0);
+  max_leaf = info[0];
+  __cpuid (info, 1);
+  have_ssse3 = (info[2] & (1 << 9)) != 0;
+
+  /* AVX2 also needs the OS to save the YMM registers */
+  if (max_leaf >= 7 && (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+      (_xgetbv (0) & 0x6) == 0x6) {
+    __cpuidex (info, 7, 0);
+    have_avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#elif defined (HAVE_GENICAM_UNPACK_X86)
+  __builtin_cpu_init ();
+  have_ssse3 = __builtin_cpu_supports ("ssse3");
+  have_avx2 = __builtin_cpu_supports ("avx2");
+#endif
+}
+
+static void
+gst_genicam_unpack_class_init (GstGenicamUnpackClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *gstbasetransform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_genicam_unpack_debug, "genicamunpack", 0,
+      "debug category for genicamunpack element");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_genicam_unpack_sink_template));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_genicam_unpack_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "GenICam packed pixel unpacker", "Filter/Converter/Video",
+      "Unpacks 10- and 12-bit packed GenICam pixel formats to 16 bits",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+
+  gobject_class->set_property = gst_genicam_unpack_set_property;
+  gobject_class->get_property = gst_genicam_unpack_get_property;
+  gobject_class->finalize = gst_genicam_unpack_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to unpack each frame with, 0 for one per CPU",
+          0, MAX_THREADS, DEFAULT_PROP_N_THREADS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SIMD,
+      g_param_spec_boolean ("simd", "SIMD",
+          "Use SSSE3 or AVX2 when the CPU supports them, takes effect on the "
+          "next caps", DEFAULT_PROP_SIMD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  gstbasetransform_class->stop = GST_DEBUG_FUNCPTR (gst_genicam_unpack_stop);
+  gstbasetransform_class->transform_caps =
+      GST_DEBUG_FUNCPTR (gst_genicam_unpack_transform_caps);
+  gstbasetransform_class->set_caps =
+      GST_DEBUG_FUNCPTR (gst_genicam_unpack_set_caps);
+  gstbasetransform_class->transform_size =
+      GST_DEBUG_FUNCPTR (gst_genicam_unpack_transform_size);
+  gstbasetransform_class->transform =
+      GST_DEBUG_FUNCPTR (gst_genicam_unpack_transform);
+
+  gst_genicam_unpack_detect_cpu ();
+  GST_DEBUG ("CPU supports SSSE3: %d, AVX2: %d", have_ssse3, have_avx2);
+}
+
+static void
+gst_genicam_unpack_init (GstGenicamUnpack * filter)
+{
+  filter->n_threads = DEFAULT_PROP_N_THREADS;
+  filter->simd = DEFAULT_PROP_SIMD;
+
+  g_mutex_init (&filter->lock);
+  g_cond_init (&filter->cond);
+
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), FALSE);
+}
+
+static void
+gst_genicam_unpack_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (object);
+
+  GST_DEBUG_OBJECT (filter, "set_property");
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (filter);
+      filter->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_SIMD:
+      GST_OBJECT_LOCK (filter);
+      filter->simd = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_genicam_unpack_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (object);
+
+  GST_DEBUG_OBJECT (filter, "get_property");
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->n_threads);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_SIMD:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_boolean (value, filter->simd);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_genicam_unpack_finalize (GObject * object)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (object);
+
+  g_mutex_clear (&filter->lock);
+  g_cond_clear (&filter->cond);
+
+  G_OBJECT_CLASS (gst_genicam_unpack_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_genicam_unpack_stop (GstBaseTransform * trans)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (trans);
+
+  if (filter->pool) {
+    /* no stripes are queued outside of transform */
+    g_thread_pool_free (filter->pool, FALSE, TRUE);
+    filter->pool = NULL;
+  }
+
+  return TRUE;
+}
+
+/* scalar kernels, also used for the groups the SIMD kernels leave */
+
+static void
+gst_genicam_unpack_10p_c (const guint8 * src, guint16 * dest, gint n_groups)
+{
+  for (; n_groups > 0; n_groups--, src += 5, dest += 4) {
+    dest[0] = GUINT16_TO_LE (src[0] | (src[1] & 0x03) << 8);
+    dest[1] = GUINT16_TO_LE (src[1] >> 2 | (src[2] & 0x0f) << 6);
+    dest[2] = GUINT16_TO_LE (src[2] >> 4 | (src[3] & 0x3f) << 4);
+    dest[3] = GUINT16_TO_LE (src[3] >> 6 | src[4] << 2);
+  }
+}
+
+static void
+gst_genicam_unpack_12p_c (const guint8 * src, guint16 * dest, gint n_groups)
+{
+  for (; n_groups > 0; n_groups--, src += 3, dest += 2) {
+    dest[0] = GUINT16_TO_LE (src[0] | (src[1] & 0x0f) << 8);
+    dest[1] = GUINT16_TO_LE (src[1] >> 4 | src[2] << 4);
+  }
+}
+
+static void
+gst_genicam_unpack_12_packed_c (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  for (; n_groups > 0; n_groups--, src += 3, dest += 2) {
+    dest[0] = GUINT16_TO_LE (src[0] << 4 | (src[1] & 0x0f));
+    dest[1] = GUINT16_TO_LE (src[2] << 4 | src[1] >> 4);
+  }
+}
+
+static const GstGenicamUnpackLayoutInfo gst_genicam_unpack_layouts[] = {
+  {10, 4, 5, gst_genicam_unpack_10p_c},
+  {12, 2, 3, gst_genicam_unpack_12p_c},
+  {12, 2, 3, gst_genicam_unpack_12_packed_c}
+};
+
+static GstGenicamUnpackSimdFunc
+gst_genicam_unpack_get_simd_func (GstGenicamUnpackLayout layout)
+{
+#if defined (HAVE_GENICAM_UNPACK_X86)
+  if (have_avx2) {
+    switch (layout) {
+      case GST_GENICAM_UNPACK_LAYOUT_10P:
+        return gst_genicam_unpack_10p_avx2;
+      case GST_GENICAM_UNPACK_LAYOUT_12P:
+        return gst_genicam_unpack_12p_avx2;
+      case GST_GENICAM_UNPACK_LAYOUT_12_PACKED:
+        return gst_genicam_unpack_12_packed_avx2;
+    }
+  } else if (have_ssse3) {
+    switch (layout) {
+      case GST_GENICAM_UNPACK_LAYOUT_10P:
+        return gst_genicam_unpack_10p_ssse3;
+      case GST_GENICAM_UNPACK_LAYOUT_12P:
+        return gst_genicam_unpack_12p_ssse3;
+      case GST_GENICAM_UNPACK_LAYOUT_12_PACKED:
+        return gst_genicam_unpack_12_packed_ssse3;
+    }
+  }
+#endif
+
+  return NULL;
+}
+
+static guint16
+gst_genicam_unpack_pixel (GstGenicamUnpackLayout layout, const guint8 * in,
+    guint64 index)
+{
+  const guint8 *src;
+
+  switch (layout) {
+    case GST_GENICAM_UNPACK_LAYOUT_10P:
+      src = in + index * 10 / 8;
+      return (src[0] | src[1] << 8) >> (index * 10 % 8) & 0x3ff;
+    case GST_GENICAM_UNPACK_LAYOUT_12P:
+      src = in + index / 2 * 3;
+      if (index % 2)
+        return src[1] >> 4 | src[2] << 4;
+      return src[0] | (src[1] & 0x0f) << 8;
+    case GST_GENICAM_UNPACK_LAYOUT_12_PACKED:
+      src = in + index / 2 * 3;
+      if (index % 2)
+        return src[2] << 4 | src[1] >> 4;
+      return src[0] << 4 | (src[1] & 0x0f);
+  }
+
+  return 0;
+}
+
+/* Unpack one line. Lines only start on a group boundary for some widths,
+ * so pixels before the first and after the last whole group are unpacked
+ * one by one. */
+static void
+gst_genicam_unpack_line (GstGenicamUnpack * filter, const guint8 * in,
+    guint16 * dest, guint64 first)
+{
+  const GstGenicamUnpackLayoutInfo *info =
+      &gst_genicam_unpack_layouts[filter->layout];
+  const guint8 *src;
+  gint n = filter->width;
+  gint n_groups, done = 0;
+
+  for (; n > 0 && first % info->group_pixels; n--, first++)
+    *dest++ = GUINT16_TO_LE (gst_genicam_unpack_pixel (filter->layout, in,
+            first));
+
+  src = in + first / info->group_pixels * info->group_bytes;
+  n_groups = n / info->group_pixels;
+  if (filter->simd_func)
+    done = filter->simd_func (src, dest, n_groups);
+  info->unpack_groups (src + done * info->group_bytes,
+      dest + done * info->group_pixels, n_groups - done);
+
+  dest += n_groups * info->group_pixels;
+  first += n_groups * info->group_pixels;
+  n -= n_groups * info->group_pixels;
+
+  for (; n > 0; n--, first++)
+    *dest++ = GUINT16_TO_LE (gst_genicam_unpack_pixel (filter->layout, in,
+            first));
+}
+
+static void
+gst_genicam_unpack_stripe (GstGenicamUnpackStripe * stripe)
+{
+  GstGenicamUnpack *filter = stripe->filter;
+  gint y;
+
+  for (y = stripe->y0; y < stripe->y1; y++) {
+    gst_genicam_unpack_line (filter, stripe->in,
+        (guint16 *) (stripe->out + (gsize) y * filter->out_stride),
+        (guint64) y * filter->width);
+  }
+}
+
+static void
+gst_genicam_unpack_stripe_func (gpointer data, gpointer user_data)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (user_data);
+
+  gst_genicam_unpack_stripe ((GstGenicamUnpackStripe *) data);
+
+  g_mutex_lock (&filter->lock);
+  if (--filter->pending == 0)
+    g_cond_signal (&filter->cond);
+  g_mutex_unlock (&filter->lock);
+}
+
+static const GstGenicamUnpackFormat *
+gst_genicam_unpack_find_format (const gchar * name)
+{
+  guint i;
+
+  if (name == NULL)
+    return NULL;
+
+  for (i = 0; i < G_N_ELEMENTS (gst_genicam_unpack_formats); i++) {
+    if (g_strcmp0 (name, gst_genicam_unpack_formats[i].name) == 0)
+      return &gst_genicam_unpack_formats[i];
+  }
+
+  return NULL;
+}
+
+/* the structure one side of the element has for a format, without size */
+static GstStructure *
+gst_genicam_unpack_format_structure (const GstGenicamUnpackFormat * format,
+    gboolean packed)
+{
+  if (packed)
+    return gst_structure_new ("video/x-genicam-packed",
+        "format", G_TYPE_STRING, format->name, NULL);
+
+  if (format->bayer_format)
+    return gst_structure_new ("video/x-bayer",
+        "format", G_TYPE_STRING, format->bayer_format,
+        "endianness", G_TYPE_INT, G_LITTLE_ENDIAN,
+        "bpp", G_TYPE_INT, format->bpp, NULL);
+
+  return gst_structure_new ("video/x-raw",
+      "format", G_TYPE_STRING, "GRAY16_LE",
+      "bpp", G_TYPE_INT, format->bpp, NULL);
+}
+
+static GstCaps *
+gst_genicam_unpack_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter_caps)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (trans);
+  static const gchar *copied_fields[] = { "width", "height", "framerate",
+    "pixel-aspect-ratio"
+  };
+  GstCaps *other_caps = gst_caps_new_empty ();
+  guint i, j, k;
+
+  GST_LOG_OBJECT (filter, "transforming caps from %" GST_PTR_FORMAT, caps);
+
+  /* match every structure against every format on this side, and add that
+   * format's structure from the other side with the same size */
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    const GstStructure *s = gst_caps_get_structure (caps, i);
+
+    for (j = 0; j < G_N_ELEMENTS (gst_genicam_unpack_formats); j++) {
+      const GstGenicamUnpackFormat *format = &gst_genicam_unpack_formats[j];
+      GstStructure *this_side, *other_side;
+      gboolean matches;
+
+      this_side = gst_genicam_unpack_format_structure (format,
+          direction == GST_PAD_SINK);
+      matches = gst_structure_can_intersect (s, this_side);
+      gst_structure_free (this_side);
+      if (!matches)
+        continue;
+
+      other_side = gst_genicam_unpack_format_structure (format,
+          direction != GST_PAD_SINK);
+      for (k = 0; k < G_N_ELEMENTS (copied_fields); k++) {
+        const GValue *value = gst_structure_get_value (s, copied_fields[k]);
+        if (value)
+          gst_structure_set_value (other_side, copied_fields[k], value);
+      }
+      other_caps = gst_caps_merge_structure (other_caps, other_side);
+    }
+  }
+
+  if (!gst_caps_is_empty (other_caps) && filter_caps) {
+    GstCaps *tmp = gst_caps_intersect_full (filter_caps, other_caps,
+        GST_CAPS_INTERSECT_FIRST);
+    gst_caps_replace (&other_caps, tmp);
+    gst_caps_unref (tmp);
+  }
+
+  GST_LOG_OBJECT (filter, "transformed caps to %" GST_PTR_FORMAT, other_caps);
+
+  return other_caps;
+}
+
+/* size of a frame with fixed caps from either side, 0 if unknown */
+static gsize
+gst_genicam_unpack_get_frame_size (GstCaps * caps, gint * stride)
+{
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  gint width = 0, height = 0;
+
+  if (gst_structure_has_name (s, "video/x-raw")) {
+    GstVideoInfo vinfo;
+
+    if (!gst_video_info_from_caps (&vinfo, caps))
+      return 0;
+    if (stride)
+      *stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
+    return GST_VIDEO_INFO_SIZE (&vinfo);
+  }
+
+  if (!gst_structure_get_int (s, "width", &width) ||
+      !gst_structure_get_int (s, "height", &height))
+    return 0;
+
+  if (gst_structure_has_name (s, "video/x-bayer")) {
+    if (stride)
+      *stride = GST_ROUND_UP_4 (width * 2);
+    return (gsize) GST_ROUND_UP_4 (width * 2) * height;
+  } else {
+    const GstGenicamUnpackFormat *format =
+        gst_genicam_unpack_find_format (gst_structure_get_string (s,
+            "format"));
+
+    if (format == NULL)
+      return 0;
+    if (stride)
+      *stride = 0;
+    return ((guint64) width * height * format->bpp + 7) / 8;
+  }
+}
+
+static gboolean
+gst_genicam_unpack_set_caps (GstBaseTransform * trans, GstCaps * incaps,
+    GstCaps * outcaps)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (trans);
+  GstStructure *s = gst_caps_get_structure (incaps, 0);
+  const GstGenicamUnpackFormat *format;
+  gboolean simd;
+
+  GST_DEBUG_OBJECT (filter,
+      "set_caps: in '%" GST_PTR_FORMAT "' out '%" GST_PTR_FORMAT "'", incaps,
+      outcaps);
+
+  format = gst_genicam_unpack_find_format (gst_structure_get_string (s,
+          "format"));
+  if (format == NULL ||
+      !gst_structure_get_int (s, "width", &filter->width) ||
+      !gst_structure_get_int (s, "height", &filter->height))
+    goto unsupported_caps;
+
+  filter->layout = format->layout;
+  filter->in_size = gst_genicam_unpack_get_frame_size (incaps, NULL);
+  if (gst_genicam_unpack_get_frame_size (outcaps, &filter->out_stride) == 0)
+    goto unsupported_caps;
+
+  GST_OBJECT_LOCK (filter);
+  simd = filter->simd;
+  GST_OBJECT_UNLOCK (filter);
+  filter->simd_func = simd ? gst_genicam_unpack_get_simd_func (format->layout)
+      : NULL;
+
+  GST_DEBUG_OBJECT (filter, "Unpacking %s, %dx%d, %s kernel", format->name,
+      filter->width, filter->height, filter->simd_func ?
+      (have_avx2 ? "AVX2" : "SSSE3") : "C");
+
+  return TRUE;
+
+unsupported_caps:
+  GST_ERROR_OBJECT (filter, "Unsupported caps: %" GST_PTR_FORMAT, incaps);
+  return FALSE;
+}
+
+static gboolean
+gst_genicam_unpack_transform_size (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, gsize size, GstCaps * othercaps,
+    gsize * othersize)
+{
+  /* packed frames may carry chunk data after the image, so the size on the
+   * other side only depends on its caps */
+  *othersize = gst_genicam_unpack_get_frame_size (othercaps, NULL);
+
+  return *othersize != 0;
+}
+
+static GstFlowReturn
+gst_genicam_unpack_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstGenicamUnpack *filter = GST_GENICAM_UNPACK (trans);
+  GstGenicamUnpackStripe stripes[MAX_THREADS];
+  GstMapInfo minfo_in, minfo_out;
+  guint n_threads, n_stripes, i;
+  gsize out_size;
+
+  if (!gst_buffer_map (inbuf, &minfo_in, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (filter, STREAM, FAILED, ("Failed to map input buffer"),
+        (NULL));
+    return GST_FLOW_ERROR;
+  }
+  if (!gst_buffer_map (outbuf, &minfo_out, GST_MAP_WRITE)) {
+    gst_buffer_unmap (inbuf, &minfo_in);
+    GST_ELEMENT_ERROR (filter, STREAM, FAILED, ("Failed to map output buffer"),
+        (NULL));
+    return GST_FLOW_ERROR;
+  }
+
+  out_size = (gsize) filter->out_stride * filter->height;
+  if (minfo_in.size < filter->in_size || minfo_out.size < out_size) {
+    GST_ELEMENT_ERROR (filter, STREAM, FORMAT, ("Buffer too small"),
+        ("Input %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes, output %"
+            G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes", minfo_in.size,
+            filter->in_size, minfo_out.size, out_size));
+    gst_buffer_unmap (inbuf, &minfo_in);
+    gst_buffer_unmap (outbuf, &minfo_out);
+    return GST_FLOW_ERROR;
+  }
+
+  GST_OBJECT_LOCK (filter);
+  n_threads = filter->n_threads;
+  GST_OBJECT_UNLOCK (filter);
+  if (n_threads == 0)
+    n_threads = MIN (g_get_num_processors (), MAX_THREADS);
+
+  n_stripes = MIN (n_threads, MAX (out_size / MIN_STRIPE_SIZE, 1));
+  n_stripes = MIN (n_stripes, (guint) filter->height);
+  n_stripes = MAX (n_stripes, 1);
+
+  for (i = 0; i < n_stripes; i++) {
+    stripes[i].filter = filter;
+    stripes[i].in = minfo_in.data;
+    stripes[i].out = minfo_out.data;
+    stripes[i].y0 = (gint) ((guint64) filter->height * i / n_stripes);
+    stripes[i].y1 = (gint) ((guint64) filter->height * (i + 1) / n_stripes);
+  }
+
+  if (n_stripes > 1) {
+    if (filter->pool == NULL) {
+      filter->pool = g_thread_pool_new (gst_genicam_unpack_stripe_func,
+          filter, n_stripes - 1, FALSE, NULL);
+    } else if (g_thread_pool_get_max_threads (filter->pool) <
+        (gint) n_stripes - 1) {
+      g_thread_pool_set_max_threads (filter->pool, n_stripes - 1, NULL);
+    }
+
+    filter->pending = n_stripes - 1;
+    for (i = 1; i < n_stripes; i++)
+      g_thread_pool_push (filter->pool, &stripes[i], NULL);
+  }
+
+  /* the streaming thread does the first stripe itself */
+  gst_genicam_unpack_stripe (&stripes[0]);
+
+  if (n_stripes > 1) {
+    g_mutex_lock (&filter->lock);
+    while (filter->pending > 0)
+      g_cond_wait (&filter->cond, &filter->lock);
+    g_mutex_unlock (&filter->lock);
+  }
+
+  gst_buffer_unmap (inbuf, &minfo_in);
+  gst_buffer_unmap (outbuf, &minfo_out);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  gst_element_register (plugin, "genicamunpack", GST_RANK_NONE,
+      gst_genicam_unpack_get_type ());
+
+  return TRUE;
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    genicamunpack,
+    "Unpacks packed GenICam pixel formats",
+    plugin_init, GST_PACKAGE_VERSION, GST_PACKAGE_LICENSE, GST_PACKAGE_NAME,
+    GST_PACKAGE_ORIGIN)
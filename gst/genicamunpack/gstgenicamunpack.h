@@ -0,0 +1,78 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_GENICAM_UNPACK_H_
+#define _GST_GENICAM_UNPACK_H_
+
+#include <gst/base/gstbasetransform.h>
+#include <gst/video/video.h>
+
+#include "gstgenicamunpackkernels.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_GENICAM_UNPACK   (gst_genicam_unpack_get_type())
+#define GST_GENICAM_UNPACK(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_GENICAM_UNPACK,GstGenicamUnpack))
+#define GST_GENICAM_UNPACK_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_GENICAM_UNPACK,GstGenicamUnpackClass))
+#define GST_IS_GENICAM_UNPACK(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_GENICAM_UNPACK))
+#define GST_IS_GENICAM_UNPACK_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_GENICAM_UNPACK))
+
+typedef struct _GstGenicamUnpack GstGenicamUnpack;
+typedef struct _GstGenicamUnpackClass GstGenicamUnpackClass;
+
+/* how pixels are packed, every layout packs a group of pixels into whole
+ * bytes */
+typedef enum {
+  GST_GENICAM_UNPACK_LAYOUT_10P,
+  GST_GENICAM_UNPACK_LAYOUT_12P,
+  GST_GENICAM_UNPACK_LAYOUT_12_PACKED
+} GstGenicamUnpackLayout;
+
+struct _GstGenicamUnpack
+{
+  GstBaseTransform base_genicamunpack;
+
+  /* properties */
+  guint n_threads;
+  gboolean simd;
+
+  /* negotiated format */
+  GstGenicamUnpackLayout layout;
+  gint width;
+  gint height;
+  gint out_stride;
+  gsize in_size;
+  GstGenicamUnpackSimdFunc simd_func;
+
+  /* stripes run on the pool, the streaming thread does the last one */
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint pending;
+};
+
+struct _GstGenicamUnpackClass
+{
+  GstBaseTransformClass base_genicamunpack_class;
+};
+
+GType gst_genicam_unpack_get_type (void);
+
+G_END_DECLS
+
+#endif
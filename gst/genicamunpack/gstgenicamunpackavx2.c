@@ -0,0 +1,105 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* Built with AVX2 enabled, only called when the CPU supports it.
+ *
+ * The same as the SSSE3 kernels, with the two 128-bit halves loaded from
+ * consecutive steps since vpshufb doesn't cross them. What is left at the
+ * end is handed to the SSSE3 kernels. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgenicamunpackkernels.h"
+
+#include <immintrin.h>
+
+static inline __m256i
+load_halves (const guint8 * src, gint step)
+{
+  __m128i lo = _mm_loadu_si128 ((const __m128i *) src);
+  __m128i hi = _mm_loadu_si128 ((const __m128i *) (src + step));
+
+  return _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+}
+
+gint
+gst_genicam_unpack_10p_avx2 (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  const __m256i shuffle = _mm256_setr_epi8 (0, 1, 1, 2, 2, 3, 3, 4,
+      5, 6, 6, 7, 7, 8, 8, 9, 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+  const __m256i scale = _mm256_setr_epi16 (64, 16, 4, 1, 64, 16, 4, 1,
+      64, 16, 4, 1, 64, 16, 4, 1);
+  gint done = 0;
+
+  /* the second half loads 16 bytes from 10 bytes in */
+  for (; (n_groups - done) * 5 >= 10 + 16; done += 4, src += 20, dest += 16) {
+    __m256i v = load_halves (src, 10);
+    v = _mm256_shuffle_epi8 (v, shuffle);
+    v = _mm256_srli_epi16 (_mm256_mullo_epi16 (v, scale), 6);
+    _mm256_storeu_si256 ((__m256i *) dest, v);
+  }
+
+  return done + gst_genicam_unpack_10p_ssse3 (src, dest, n_groups - done);
+}
+
+gint
+gst_genicam_unpack_12p_avx2 (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  const __m256i shuffle = _mm256_setr_epi8 (0, 1, 1, 2, 3, 4, 4, 5,
+      6, 7, 7, 8, 9, 10, 10, 11, 0, 1, 1, 2, 3, 4, 4, 5,
+      6, 7, 7, 8, 9, 10, 10, 11);
+  const __m256i scale = _mm256_setr_epi16 (16, 1, 16, 1, 16, 1, 16, 1,
+      16, 1, 16, 1, 16, 1, 16, 1);
+  gint done = 0;
+
+  for (; (n_groups - done) * 3 >= 12 + 16; done += 8, src += 24, dest += 16) {
+    __m256i v = load_halves (src, 12);
+    v = _mm256_shuffle_epi8 (v, shuffle);
+    v = _mm256_srli_epi16 (_mm256_mullo_epi16 (v, scale), 4);
+    _mm256_storeu_si256 ((__m256i *) dest, v);
+  }
+
+  return done + gst_genicam_unpack_12p_ssse3 (src, dest, n_groups - done);
+}
+
+gint
+gst_genicam_unpack_12_packed_avx2 (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  const __m256i shuffle = _mm256_setr_epi8 (1, 0, 1, 2, 4, 3, 4, 5,
+      7, 6, 7, 8, 10, 9, 10, 11, 1, 0, 1, 2, 4, 3, 4, 5,
+      7, 6, 7, 8, 10, 9, 10, 11);
+  const __m256i high_mask = _mm256_set1_epi32 ((gint) 0xfffffff0);
+  const __m256i low_mask = _mm256_set1_epi32 (0x0000000f);
+  gint done = 0;
+
+  for (; (n_groups - done) * 3 >= 12 + 16; done += 8, src += 24, dest += 16) {
+    __m256i v = load_halves (src, 12);
+    __m256i high;
+    v = _mm256_shuffle_epi8 (v, shuffle);
+    high = _mm256_and_si256 (_mm256_srli_epi16 (v, 4), high_mask);
+    v = _mm256_or_si256 (high, _mm256_and_si256 (v, low_mask));
+    _mm256_storeu_si256 ((__m256i *) dest, v);
+  }
+
+  return done + gst_genicam_unpack_12_packed_ssse3 (src, dest, n_groups - done);
+}
@@ -0,0 +1,52 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_GENICAM_UNPACK_KERNELS_H_
+#define _GST_GENICAM_UNPACK_KERNELS_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Unpacks up to @n_groups groups of packed pixels from @src to 16-bit
+ * little endian pixels in @dest, and returns how many groups were done. A
+ * group is 4 pixels in 5 bytes for 10p, and 2 pixels in 3 bytes for 12p
+ * and 12Packed. Kernels never read past the last group, so they leave a
+ * few groups at the end for the caller. */
+typedef gint (*GstGenicamUnpackSimdFunc) (const guint8 * src, guint16 * dest,
+    gint n_groups);
+
+#if defined (HAVE_GENICAM_UNPACK_X86)
+gint gst_genicam_unpack_10p_ssse3       (const guint8 * src, guint16 * dest,
+                                         gint n_groups);
+gint gst_genicam_unpack_12p_ssse3       (const guint8 * src, guint16 * dest,
+                                         gint n_groups);
+gint gst_genicam_unpack_12_packed_ssse3 (const guint8 * src, guint16 * dest,
+                                         gint n_groups);
+
+gint gst_genicam_unpack_10p_avx2        (const guint8 * src, guint16 * dest,
+                                         gint n_groups);
+gint gst_genicam_unpack_12p_avx2        (const guint8 * src, guint16 * dest,
+                                         gint n_groups);
+gint gst_genicam_unpack_12_packed_avx2  (const guint8 * src, guint16 * dest,
+                                         gint n_groups);
+#endif
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,103 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* Built with SSSE3 enabled, only called when the CPU supports it.
+ *
+ * Each 16-bit output lane gathers the two bytes holding its pixel with
+ * pshufb, the pixel is then moved to the bottom of the lane with shifts
+ * that are the same for every lane. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgenicamunpackkernels.h"
+
+#include <tmmintrin.h>
+
+gint
+gst_genicam_unpack_10p_ssse3 (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  /* pixel i of a group starts at bit 2 * i of its byte pair, shift it to
+   * the top of the lane with a multiply and back down */
+  const __m128i shuffle = _mm_setr_epi8 (0, 1, 1, 2, 2, 3, 3, 4,
+      5, 6, 6, 7, 7, 8, 8, 9);
+  const __m128i scale = _mm_setr_epi16 (64, 16, 4, 1, 64, 16, 4, 1);
+  gint done = 0;
+
+  /* 2 groups in 10 bytes per step, but 16 bytes are loaded */
+  for (; (n_groups - done) * 5 >= 16; done += 2, src += 10, dest += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+    v = _mm_shuffle_epi8 (v, shuffle);
+    v = _mm_srli_epi16 (_mm_mullo_epi16 (v, scale), 6);
+    _mm_storeu_si128 ((__m128i *) dest, v);
+  }
+
+  return done;
+}
+
+gint
+gst_genicam_unpack_12p_ssse3 (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  /* even pixels are the low 12 bits of their byte pair, odd pixels the
+   * high 12 bits */
+  const __m128i shuffle = _mm_setr_epi8 (0, 1, 1, 2, 3, 4, 4, 5,
+      6, 7, 7, 8, 9, 10, 10, 11);
+  const __m128i scale = _mm_setr_epi16 (16, 1, 16, 1, 16, 1, 16, 1);
+  gint done = 0;
+
+  /* 4 groups in 12 bytes per step, but 16 bytes are loaded */
+  for (; (n_groups - done) * 3 >= 16; done += 4, src += 12, dest += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+    v = _mm_shuffle_epi8 (v, shuffle);
+    v = _mm_srli_epi16 (_mm_mullo_epi16 (v, scale), 4);
+    _mm_storeu_si128 ((__m128i *) dest, v);
+  }
+
+  return done;
+}
+
+gint
+gst_genicam_unpack_12_packed_ssse3 (const guint8 * src, guint16 * dest,
+    gint n_groups)
+{
+  /* even pixels are byte 0 above the low nibble of byte 1, odd pixels
+   * byte 2 above the high nibble of byte 1, so the even lanes load the
+   * bytes swapped and take their low nibble from before the shift */
+  const __m128i shuffle = _mm_setr_epi8 (1, 0, 1, 2, 4, 3, 4, 5,
+      7, 6, 7, 8, 10, 9, 10, 11);
+  const __m128i high_mask = _mm_setr_epi16 ((gint16) 0xfff0, (gint16) 0xffff,
+      (gint16) 0xfff0, (gint16) 0xffff, (gint16) 0xfff0, (gint16) 0xffff,
+      (gint16) 0xfff0, (gint16) 0xffff);
+  const __m128i low_mask = _mm_setr_epi16 (0x000f, 0, 0x000f, 0,
+      0x000f, 0, 0x000f, 0);
+  gint done = 0;
+
+  for (; (n_groups - done) * 3 >= 16; done += 4, src += 12, dest += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) src);
+    __m128i high;
+    v = _mm_shuffle_epi8 (v, shuffle);
+    high = _mm_and_si128 (_mm_srli_epi16 (v, 4), high_mask);
+    v = _mm_or_si128 (high, _mm_and_si128 (v, low_mask));
+    _mm_storeu_si128 ((__m128i *) dest, v);
+  }
+
+  return done;
+}
@@ -0,0 +1,1153 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+/**
+ * SECTION:element-visiontestsrc
+ *
+ * The visiontestsrc element produces frames in the pixel formats machine
+ * vision cameras deliver, using the GenICam pixel format names, without any
+ * hardware. Besides test patterns and noise it can drop frames, jitter
+ * timestamps and deliver frames in bursts, to exercise downstream elements
+ * the way a real frame grabber does.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 visiontestsrc pixel-format=Mono12 pattern=ramp-moving noise=16 ! videolevels ! autovideosink
+ * ]|
+ * Shows a noisy moving 12-bit ramp scaled to 8 bits
+ * |[
+ * gst-launch-1.0 visiontestsrc pixel-format=BayerRG12 width=4096 height=3000 is-live=false cache-frames=4 num-buffers=1000 ! fakesink
+ * ]|
+ * Pushes 12-bit Bayer frames as fast as downstream accepts them
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideopool.h>
+
+#include "gstvisiontestsrc.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vision_test_src_debug);
+#define GST_CAT_DEFAULT gst_vision_test_src_debug
+
+#include "genicampixelformat.h"
+
+/* prototypes */
+static void gst_vision_test_src_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vision_test_src_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vision_test_src_finalize (GObject * object);
+
+static gboolean gst_vision_test_src_start (GstBaseSrc * src);
+static gboolean gst_vision_test_src_stop (GstBaseSrc * src);
+static GstCaps *gst_vision_test_src_get_caps (GstBaseSrc * src,
+    GstCaps * filter);
+static gboolean gst_vision_test_src_set_caps (GstBaseSrc * src,
+    GstCaps * caps);
+static gboolean gst_vision_test_src_decide_allocation (GstBaseSrc * src,
+    GstQuery * query);
+static gboolean gst_vision_test_src_query (GstBaseSrc * src, GstQuery * query);
+static gboolean gst_vision_test_src_unlock (GstBaseSrc * src);
+static gboolean gst_vision_test_src_unlock_stop (GstBaseSrc * src);
+
+static GstFlowReturn gst_vision_test_src_create (GstPushSrc * src,
+    GstBuffer ** buf);
+
+enum
+{
+  PROP_0,
+  PROP_PIXEL_FORMAT,
+  PROP_ENDIANNESS,
+  PROP_WIDTH,
+  PROP_HEIGHT,
+  PROP_FRAMERATE,
+  PROP_PATTERN,
+  PROP_NOISE,
+  PROP_DROP_PROBABILITY,
+  PROP_JITTER,
+  PROP_BURST,
+  PROP_CACHE_FRAMES,
+  PROP_SEED,
+  PROP_IS_LIVE
+};
+
+#define DEFAULT_PROP_PIXEL_FORMAT "Mono8"
+#define DEFAULT_PROP_ENDIANNESS G_LITTLE_ENDIAN
+#define DEFAULT_PROP_WIDTH 640
+#define DEFAULT_PROP_HEIGHT 480
+#define DEFAULT_PROP_FPS_N 30
+#define DEFAULT_PROP_FPS_D 1
+#define DEFAULT_PROP_PATTERN GST_VISION_TEST_SRC_PATTERN_RAMP_HORIZONTAL
+#define DEFAULT_PROP_NOISE 0
+#define DEFAULT_PROP_DROP_PROBABILITY 0.0
+#define DEFAULT_PROP_JITTER 0
+#define DEFAULT_PROP_BURST 1
+#define DEFAULT_PROP_CACHE_FRAMES 0
+#define DEFAULT_PROP_SEED 0
+#define DEFAULT_PROP_IS_LIVE TRUE
+
+/* moving ramp advances this many pixels per frame */
+#define RAMP_MOVING_STEP 4
+/* checkers square size is 1 << CHECKERS_SHIFT pixels */
+#define CHECKERS_SHIFT 3
+
+#define GST_TYPE_VISION_TEST_SRC_PATTERN (gst_vision_test_src_pattern_get_type())
+static GType
+gst_vision_test_src_pattern_get_type (void)
+{
+  static GType vision_test_src_pattern_type = 0;
+  static const GEnumValue vision_test_src_pattern[] = {
+    {GST_VISION_TEST_SRC_PATTERN_SOLID, "Solid half scale", "solid"},
+    {GST_VISION_TEST_SRC_PATTERN_RAMP_HORIZONTAL, "Horizontal ramp",
+        "ramp-horizontal"},
+    {GST_VISION_TEST_SRC_PATTERN_RAMP_VERTICAL, "Vertical ramp",
+        "ramp-vertical"},
+    {GST_VISION_TEST_SRC_PATTERN_RAMP_MOVING,
+        "Horizontal ramp moving every frame", "ramp-moving"},
+    {GST_VISION_TEST_SRC_PATTERN_CHECKERS, "Full scale checkers", "checkers"},
+    {GST_VISION_TEST_SRC_PATTERN_NOISE, "Uniform full scale noise", "noise"},
+    {0, NULL, NULL},
+  };
+
+  if (!vision_test_src_pattern_type) {
+    vision_test_src_pattern_type =
+        g_enum_register_static ("GstVisionTestSrcPattern",
+        vision_test_src_pattern);
+  }
+  return vision_test_src_pattern_type;
+}
+
+/* pad templates */
+
+static GstStaticPadTemplate gst_vision_test_src_src_template =
+    GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
+        ("{ GRAY8, GRAY16_LE, GRAY16_BE, RGB, BGR, RGBA, BGRA, UYVY, YUY2, IYU2 }")
+        ";"
+        GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER8 ("{ bggr, grbg, rggb, gbrg }") ";"
+        GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER16
+        ("{ bggr16, grbg16, rggb16, gbrg16 }", "1234") ";"
+        GST_GENICAM_PIXEL_FORMAT_CAPS_PACKED)
+    );
+
+/* class initialization */
+
+G_DEFINE_TYPE (GstVisionTestSrc, gst_vision_test_src, GST_TYPE_PUSH_SRC);
+
+static void
+gst_vision_test_src_class_init (GstVisionTestSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
+  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+  gobject_class->set_property = gst_vision_test_src_set_property;
+  gobject_class->get_property = gst_vision_test_src_get_property;
+  gobject_class->finalize = gst_vision_test_src_finalize;
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_vision_test_src_src_template));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "Vision test source", "Source/Video",
+      "Synthetic machine vision camera for testing and benchmarking",
+      "Joshua M. Doe <oss@nvl.army.mil>");
+
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_vision_test_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_vision_test_src_stop);
+  gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_vision_test_src_get_caps);
+  gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_vision_test_src_set_caps);
+  gstbasesrc_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_vision_test_src_decide_allocation);
+  gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_vision_test_src_query);
+  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_vision_test_src_unlock);
+  gstbasesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_vision_test_src_unlock_stop);
+
+  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_vision_test_src_create);
+
+  /* Install GObject properties */
+  g_object_class_install_property (gobject_class, PROP_PIXEL_FORMAT,
+      g_param_spec_string ("pixel-format", "Pixel format",
+          "GenICam pixel format name, e.g. Mono12 or BayerRG10",
+          DEFAULT_PROP_PIXEL_FORMAT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_ENDIANNESS,
+      g_param_spec_int ("endianness", "Endianness",
+          "Byte order of pixel formats wider than 8 bits (1234 or 4321)",
+          G_LITTLE_ENDIAN, G_BIG_ENDIAN, DEFAULT_PROP_ENDIANNESS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_WIDTH,
+      g_param_spec_int ("width", "Width", "Frame width in pixels", 1,
+          G_MAXINT, DEFAULT_PROP_WIDTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_HEIGHT,
+      g_param_spec_int ("height", "Height", "Frame height in pixels", 1,
+          G_MAXINT, DEFAULT_PROP_HEIGHT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_FRAMERATE,
+      gst_param_spec_fraction ("framerate", "Framerate",
+          "Frame rate, frames are paced to it when live", 1, G_MAXINT,
+          G_MAXINT, 1, DEFAULT_PROP_FPS_N, DEFAULT_PROP_FPS_D,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_PATTERN,
+      g_param_spec_enum ("pattern", "Pattern", "Test pattern to generate",
+          GST_TYPE_VISION_TEST_SRC_PATTERN, DEFAULT_PROP_PATTERN,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_NOISE,
+      g_param_spec_uint ("noise", "Noise",
+          "Amplitude in digital numbers of uniform noise added to the pattern",
+          0, G_MAXUINT16, DEFAULT_PROP_NOISE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_DROP_PROBABILITY,
+      g_param_spec_double ("drop-probability", "Drop probability",
+          "Probability of dropping each frame, dropped frames leave a gap in "
+          "offsets and timestamps", 0.0, 1.0, DEFAULT_PROP_DROP_PROBABILITY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_JITTER,
+      g_param_spec_uint64 ("jitter", "Jitter",
+          "Maximum random offset in ns added to or subtracted from timestamps",
+          0, G_MAXUINT64, DEFAULT_PROP_JITTER,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_BURST,
+      g_param_spec_uint ("burst", "Burst",
+          "Frames delivered back to back once the last of them is due, only "
+          "when live", 1, G_MAXUINT, DEFAULT_PROP_BURST,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_CACHE_FRAMES,
+      g_param_spec_uint ("cache-frames", "Cache frames",
+          "Render this many frames once and push them again without copying "
+          "(0 renders every frame)", 0, 1024, DEFAULT_PROP_CACHE_FRAMES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_SEED,
+      g_param_spec_uint ("seed", "Seed",
+          "Seed of the generator for noise, drops and jitter", 0, G_MAXUINT,
+          DEFAULT_PROP_SEED,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_IS_LIVE,
+      g_param_spec_boolean ("is-live", "Is live",
+          "Pace frames to the framerate, otherwise push as fast as possible",
+          DEFAULT_PROP_IS_LIVE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+}
+
+static void
+gst_vision_test_src_reset (GstVisionTestSrc * src)
+{
+  guint i;
+
+  if (src->cache) {
+    for (i = 0; i < src->cache_frames; i++) {
+      if (src->cache[i])
+        gst_buffer_unref (src->cache[i]);
+    }
+    g_free (src->cache);
+    src->cache = NULL;
+  }
+
+  g_free (src->line);
+  src->line = NULL;
+
+  if (src->rand) {
+    g_rand_free (src->rand);
+    src->rand = NULL;
+  }
+
+  src->stride = 0;
+  src->frame_size = 0;
+  src->n_frames = 0;
+  src->n_dropped = 0;
+  src->burst_end = 0;
+  src->discont = FALSE;
+  src->running_time_offset = GST_CLOCK_TIME_NONE;
+}
+
+static void
+gst_vision_test_src_init (GstVisionTestSrc * src)
+{
+  /* override default of BYTES to operate in time mode */
+  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
+
+  /* initialize member variables */
+  src->pixel_format = g_strdup (DEFAULT_PROP_PIXEL_FORMAT);
+  src->endianness = DEFAULT_PROP_ENDIANNESS;
+  src->width = DEFAULT_PROP_WIDTH;
+  src->height = DEFAULT_PROP_HEIGHT;
+  src->fps_n = DEFAULT_PROP_FPS_N;
+  src->fps_d = DEFAULT_PROP_FPS_D;
+  src->pattern = DEFAULT_PROP_PATTERN;
+  src->noise = DEFAULT_PROP_NOISE;
+  src->drop_probability = DEFAULT_PROP_DROP_PROBABILITY;
+  src->jitter = DEFAULT_PROP_JITTER;
+  src->burst = DEFAULT_PROP_BURST;
+  src->cache_frames = DEFAULT_PROP_CACHE_FRAMES;
+  src->seed = DEFAULT_PROP_SEED;
+  src->is_live = DEFAULT_PROP_IS_LIVE;
+  gst_base_src_set_live (GST_BASE_SRC (src), src->is_live);
+
+  src->cache = NULL;
+  src->line = NULL;
+  src->rand = NULL;
+  src->clock_id = NULL;
+  src->flushing = FALSE;
+
+  gst_vision_test_src_reset (src);
+}
+
+void
+gst_vision_test_src_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVisionTestSrc *src;
+
+  src = GST_VISION_TEST_SRC (object);
+
+  switch (property_id) {
+    case PROP_PIXEL_FORMAT:
+      g_free (src->pixel_format);
+      src->pixel_format = g_value_dup_string (value);
+      break;
+    case PROP_ENDIANNESS:
+      src->endianness = g_value_get_int (value);
+      break;
+    case PROP_WIDTH:
+      src->width = g_value_get_int (value);
+      break;
+    case PROP_HEIGHT:
+      src->height = g_value_get_int (value);
+      break;
+    case PROP_FRAMERATE:
+      src->fps_n = gst_value_get_fraction_numerator (value);
+      src->fps_d = gst_value_get_fraction_denominator (value);
+      break;
+    case PROP_PATTERN:
+      src->pattern = g_value_get_enum (value);
+      break;
+    case PROP_NOISE:
+      src->noise = g_value_get_uint (value);
+      break;
+    case PROP_DROP_PROBABILITY:
+      src->drop_probability = g_value_get_double (value);
+      break;
+    case PROP_JITTER:
+      src->jitter = g_value_get_uint64 (value);
+      break;
+    case PROP_BURST:
+      src->burst = g_value_get_uint (value);
+      break;
+    case PROP_CACHE_FRAMES:
+      src->cache_frames = g_value_get_uint (value);
+      break;
+    case PROP_SEED:
+      src->seed = g_value_get_uint (value);
+      break;
+    case PROP_IS_LIVE:
+      src->is_live = g_value_get_boolean (value);
+      gst_base_src_set_live (GST_BASE_SRC (src), src->is_live);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vision_test_src_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVisionTestSrc *src;
+
+  g_return_if_fail (GST_IS_VISION_TEST_SRC (object));
+  src = GST_VISION_TEST_SRC (object);
+
+  switch (property_id) {
+    case PROP_PIXEL_FORMAT:
+      g_value_set_string (value, src->pixel_format);
+      break;
+    case PROP_ENDIANNESS:
+      g_value_set_int (value, src->endianness);
+      break;
+    case PROP_WIDTH:
+      g_value_set_int (value, src->width);
+      break;
+    case PROP_HEIGHT:
+      g_value_set_int (value, src->height);
+      break;
+    case PROP_FRAMERATE:
+      gst_value_set_fraction (value, src->fps_n, src->fps_d);
+      break;
+    case PROP_PATTERN:
+      g_value_set_enum (value, src->pattern);
+      break;
+    case PROP_NOISE:
+      g_value_set_uint (value, src->noise);
+      break;
+    case PROP_DROP_PROBABILITY:
+      g_value_set_double (value, src->drop_probability);
+      break;
+    case PROP_JITTER:
+      g_value_set_uint64 (value, src->jitter);
+      break;
+    case PROP_BURST:
+      g_value_set_uint (value, src->burst);
+      break;
+    case PROP_CACHE_FRAMES:
+      g_value_set_uint (value, src->cache_frames);
+      break;
+    case PROP_SEED:
+      g_value_set_uint (value, src->seed);
+      break;
+    case PROP_IS_LIVE:
+      g_value_set_boolean (value, src->is_live);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vision_test_src_finalize (GObject * object)
+{
+  GstVisionTestSrc *src;
+
+  g_return_if_fail (GST_IS_VISION_TEST_SRC (object));
+  src = GST_VISION_TEST_SRC (object);
+
+  /* clean up object here */
+  gst_vision_test_src_reset (src);
+  g_free (src->pixel_format);
+
+  G_OBJECT_CLASS (gst_vision_test_src_parent_class)->finalize (object);
+}
+
+static GstCaps *
+gst_vision_test_src_create_caps (GstVisionTestSrc * src)
+{
+  const GstGenicamPixelFormatInfo *info;
+  GstCaps *caps;
+
+  info = gst_genicam_pixel_format_get_info (src->pixel_format,
+      src->endianness);
+  if (info == NULL || g_str_equal (info->pixel_format, "JPEG"))
+    return NULL;
+
+  caps = gst_genicam_pixel_format_caps_from_pixel_format (info->pixel_format,
+      src->endianness, src->width, src->height, src->fps_n, src->fps_d, 1, 1);
+  if (caps == NULL)
+    return NULL;
+
+  /* GRAY16 doesn't say how many bits are used, elements like videolevels
+   * read it from bpp as with 16-bit Bayer */
+  if (g_str_has_prefix (info->pixel_format, "Mono") && info->depth == 16) {
+    gst_caps_set_simple (caps, "bpp", G_TYPE_INT, info->bpp, NULL);
+  }
+
+  return caps;
+}
+
+static gboolean
+gst_vision_test_src_start (GstBaseSrc * bsrc)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+  GstCaps *caps;
+
+  GST_DEBUG_OBJECT (src, "start");
+
+  caps = gst_vision_test_src_create_caps (src);
+  if (caps == NULL) {
+    GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS,
+        ("Unsupported pixel format '%s' (endianness %d)", src->pixel_format,
+            src->endianness), (NULL));
+    return FALSE;
+  }
+  gst_caps_unref (caps);
+
+  gst_vision_test_src_reset (src);
+
+  src->rand = g_rand_new_with_seed (src->seed);
+  /* xorshift must never be seeded with zero */
+  src->noise_state = g_rand_int (src->rand) | 1;
+  if (!src->is_live)
+    src->running_time_offset = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_test_src_stop (GstBaseSrc * bsrc)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+
+  GST_DEBUG_OBJECT (src, "stop");
+
+  if (src->n_dropped > 0) {
+    GST_INFO_OBJECT (src, "Dropped %" G_GUINT64_FORMAT " of %"
+        G_GUINT64_FORMAT " frames", src->n_dropped, src->n_frames);
+  }
+
+  gst_vision_test_src_reset (src);
+
+  return TRUE;
+}
+
+static GstCaps *
+gst_vision_test_src_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+  GstCaps *caps;
+
+  caps = gst_vision_test_src_create_caps (src);
+  if (caps == NULL) {
+    caps = gst_pad_get_pad_template_caps (GST_BASE_SRC_PAD (src));
+  }
+
+  GST_DEBUG_OBJECT (src, "The caps before filtering are %" GST_PTR_FORMAT,
+      caps);
+
+  if (filter && caps) {
+    GstCaps *tmp = gst_caps_intersect (caps, filter);
+    gst_caps_unref (caps);
+    caps = tmp;
+  }
+
+  GST_DEBUG_OBJECT (src, "The caps after filtering are %" GST_PTR_FORMAT, caps);
+
+  return caps;
+}
+
+static gboolean
+gst_vision_test_src_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  gint bpp = 0;
+  guint i;
+
+  GST_DEBUG_OBJECT (src, "The caps being set are %" GST_PTR_FORMAT, caps);
+
+  gst_structure_get_int (s, "bpp", &bpp);
+
+  if (gst_structure_has_name (s, "video/x-raw")) {
+    GstVideoInfo vinfo;
+
+    if (!gst_video_info_from_caps (&vinfo, caps))
+      goto unsupported_caps;
+
+    switch (GST_VIDEO_INFO_FORMAT (&vinfo)) {
+      case GST_VIDEO_FORMAT_GRAY8:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_GRAY8;
+        break;
+      case GST_VIDEO_FORMAT_GRAY16_LE:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_GRAY16_LE;
+        break;
+      case GST_VIDEO_FORMAT_GRAY16_BE:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_GRAY16_BE;
+        break;
+      case GST_VIDEO_FORMAT_RGB:
+      case GST_VIDEO_FORMAT_BGR:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_RGB;
+        break;
+      case GST_VIDEO_FORMAT_RGBA:
+      case GST_VIDEO_FORMAT_BGRA:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_RGBA;
+        break;
+      case GST_VIDEO_FORMAT_UYVY:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_UYVY;
+        break;
+      case GST_VIDEO_FORMAT_YUY2:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_YUY2;
+        break;
+      case GST_VIDEO_FORMAT_IYU2:
+        src->layout = GST_VISION_TEST_SRC_LAYOUT_IYU2;
+        break;
+      default:
+        goto unsupported_caps;
+    }
+
+    src->is_raw = TRUE;
+    src->stride = GST_VIDEO_INFO_PLANE_STRIDE (&vinfo, 0);
+    src->frame_size = GST_VIDEO_INFO_SIZE (&vinfo);
+    if (bpp == 0)
+      bpp = GST_VIDEO_INFO_COMP_DEPTH (&vinfo, 0);
+  } else if (gst_structure_has_name (s, "video/x-bayer")) {
+    const gchar *format = gst_structure_get_string (s, "format");
+    gint endianness = G_LITTLE_ENDIAN;
+
+    if (format == NULL)
+      goto unsupported_caps;
+
+    gst_structure_get_int (s, "endianness", &endianness);
+    if (g_str_has_suffix (format, "16")) {
+      src->layout = endianness == G_BIG_ENDIAN ?
+          GST_VISION_TEST_SRC_LAYOUT_GRAY16_BE :
+          GST_VISION_TEST_SRC_LAYOUT_GRAY16_LE;
+      src->stride = GST_ROUND_UP_4 (src->width * 2);
+      if (bpp == 0)
+        bpp = 16;
+    } else {
+      src->layout = GST_VISION_TEST_SRC_LAYOUT_GRAY8;
+      src->stride = GST_ROUND_UP_4 (src->width);
+      bpp = 8;
+    }
+
+    src->is_raw = FALSE;
+    src->frame_size = (gsize) src->stride * src->height;
+  } else if (gst_structure_has_name (s, "video/x-genicam-packed")) {
+    const gchar *format = gst_structure_get_string (s, "format");
+
+    if (format == NULL)
+      goto unsupported_caps;
+
+    if (g_str_has_suffix (format, "10p"))
+      src->layout = GST_VISION_TEST_SRC_LAYOUT_PACKED_10P;
+    else if (g_str_has_suffix (format, "12p"))
+      src->layout = GST_VISION_TEST_SRC_LAYOUT_PACKED_12P;
+    else if (g_str_has_suffix (format, "12Packed"))
+      src->layout = GST_VISION_TEST_SRC_LAYOUT_PACKED_12_PACKED;
+    else
+      goto unsupported_caps;
+
+    /* lines are packed back to back, they can only be rendered one at a
+     * time when each ends on a byte boundary */
+    bpp = gst_genicam_pixel_format_get_depth (format, 0);
+    if (bpp == 0 || (src->width * bpp) % 8 != 0)
+      goto unsupported_caps;
+
+    src->stride = src->width * bpp / 8;
+    src->is_raw = FALSE;
+    src->frame_size = (gsize) src->stride * src->height;
+  } else {
+    goto unsupported_caps;
+  }
+
+  if (bpp < 1 || bpp > 16)
+    goto unsupported_caps;
+  src->max_value = (1 << bpp) - 1;
+
+  /* a renegotiation invalidates any frames rendered so far */
+  if (src->cache) {
+    for (i = 0; i < src->cache_frames; i++) {
+      if (src->cache[i])
+        gst_buffer_unref (src->cache[i]);
+    }
+    g_free (src->cache);
+    src->cache = NULL;
+  }
+  if (src->cache_frames > 0)
+    src->cache = g_new0 (GstBuffer *, src->cache_frames);
+
+  g_free (src->line);
+  src->line = g_new (guint16, src->width);
+
+  GST_DEBUG_OBJECT (src, "Frames are %" G_GSIZE_FORMAT " bytes, stride %d, "
+      "max value %d", src->frame_size, src->stride, src->max_value);
+
+  return TRUE;
+
+unsupported_caps:
+  GST_ERROR_OBJECT (src, "Unsupported caps: %" GST_PTR_FORMAT, caps);
+  return FALSE;
+}
+
+static gboolean
+gst_vision_test_src_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstCaps *caps;
+  guint size, min, max;
+  gboolean update;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+
+  if (gst_query_get_n_allocation_pools (query) > 0) {
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+    update = TRUE;
+  } else {
+    size = min = max = 0;
+    update = FALSE;
+  }
+  size = MAX (size, src->frame_size);
+
+  if (pool == NULL) {
+    if (src->is_raw)
+      pool = gst_video_buffer_pool_new ();
+    else
+      pool = gst_buffer_pool_new ();
+  }
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_ERROR_OBJECT (src, "Failed to configure buffer pool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+
+  if (update)
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+  else
+    gst_query_add_allocation_pool (query, pool, size, min, max);
+
+  gst_object_unref (pool);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_test_src_query (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:
+      if (src->is_live) {
+        GstClockTime latency;
+
+        /* a burst is only delivered once its last frame is due, and jitter
+         * may put a timestamp that much earlier */
+        latency = gst_util_uint64_scale (src->burst,
+            (guint64) src->fps_d * GST_SECOND, src->fps_n) + src->jitter;
+
+        GST_DEBUG_OBJECT (src, "Reporting latency of %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (latency));
+        gst_query_set_latency (query, TRUE, latency, latency);
+        return TRUE;
+      }
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_SRC_CLASS (gst_vision_test_src_parent_class)->query (bsrc,
+      query);
+}
+
+static gboolean
+gst_vision_test_src_unlock (GstBaseSrc * bsrc)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+
+  GST_LOG_OBJECT (src, "unlock");
+
+  GST_OBJECT_LOCK (src);
+  src->flushing = TRUE;
+  if (src->clock_id)
+    gst_clock_id_unschedule (src->clock_id);
+  GST_OBJECT_UNLOCK (src);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vision_test_src_unlock_stop (GstBaseSrc * bsrc)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (bsrc);
+
+  GST_LOG_OBJECT (src, "unlock_stop");
+
+  GST_OBJECT_LOCK (src);
+  src->flushing = FALSE;
+  GST_OBJECT_UNLOCK (src);
+
+  return TRUE;
+}
+
+static inline guint32
+gst_vision_test_src_xorshift (guint32 * state)
+{
+  guint32 x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+
+  return x;
+}
+
+/* pattern values for one row, before noise and packing */
+static void
+gst_vision_test_src_fill_line (GstVisionTestSrc * src, guint16 * line,
+    gint y, guint64 frame)
+{
+  const guint max_value = src->max_value;
+  const gint width = src->width;
+  const guint wmax = MAX (width - 1, 1);
+  gint x;
+
+  switch (src->pattern) {
+    case GST_VISION_TEST_SRC_PATTERN_SOLID:
+      for (x = 0; x < width; x++)
+        line[x] = max_value / 2;
+      break;
+    case GST_VISION_TEST_SRC_PATTERN_RAMP_HORIZONTAL:
+      for (x = 0; x < width; x++)
+        line[x] = (guint64) x * max_value / wmax;
+      break;
+    case GST_VISION_TEST_SRC_PATTERN_RAMP_VERTICAL:
+    {
+      guint16 value = (guint64) y * max_value / MAX (src->height - 1, 1);
+      for (x = 0; x < width; x++)
+        line[x] = value;
+      break;
+    }
+    case GST_VISION_TEST_SRC_PATTERN_RAMP_MOVING:
+    {
+      guint shift = (guint) ((frame * RAMP_MOVING_STEP) % width);
+      for (x = 0; x < width; x++)
+        line[x] = (guint64) ((x + shift) % width) * max_value / wmax;
+      break;
+    }
+    case GST_VISION_TEST_SRC_PATTERN_CHECKERS:
+      for (x = 0; x < width; x++)
+        line[x] = ((x >> CHECKERS_SHIFT) ^ (y >> CHECKERS_SHIFT)) & 1 ?
+            max_value : 0;
+      break;
+    case GST_VISION_TEST_SRC_PATTERN_NOISE:
+      for (x = 0; x < width; x++)
+        line[x] = ((guint64) gst_vision_test_src_xorshift (&src->noise_state) *
+            (max_value + 1)) >> 32;
+      break;
+  }
+
+  if (src->noise > 0 && src->pattern != GST_VISION_TEST_SRC_PATTERN_NOISE) {
+    const guint span = 2 * src->noise + 1;
+    for (x = 0; x < width; x++) {
+      gint value = line[x] - (gint) src->noise +
+          (gint) (((guint64) gst_vision_test_src_xorshift (&src->noise_state) *
+              span) >> 32);
+      line[x] = CLAMP (value, 0, (gint) max_value);
+    }
+  }
+}
+
+/* pack pattern values into the negotiated format */
+static void
+gst_vision_test_src_pack_line (GstVisionTestSrc * src, guint8 * dest,
+    const guint16 * line)
+{
+  const gint width = src->width;
+  gint x;
+
+  switch (src->layout) {
+    case GST_VISION_TEST_SRC_LAYOUT_GRAY8:
+      for (x = 0; x < width; x++)
+        dest[x] = (guint8) line[x];
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_GRAY16_LE:
+      for (x = 0; x < width; x++)
+        GST_WRITE_UINT16_LE (dest + 2 * x, line[x]);
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_GRAY16_BE:
+      for (x = 0; x < width; x++)
+        GST_WRITE_UINT16_BE (dest + 2 * x, line[x]);
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_RGB:
+      for (x = 0; x < width; x++) {
+        dest[3 * x] = dest[3 * x + 1] = dest[3 * x + 2] = (guint8) line[x];
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_RGBA:
+      for (x = 0; x < width; x++) {
+        dest[4 * x] = dest[4 * x + 1] = dest[4 * x + 2] = (guint8) line[x];
+        dest[4 * x + 3] = 0xff;
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_UYVY:
+      for (x = 0; x < width; x++) {
+        dest[2 * x] = 0x80;
+        dest[2 * x + 1] = (guint8) line[x];
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_YUY2:
+      for (x = 0; x < width; x++) {
+        dest[2 * x] = (guint8) line[x];
+        dest[2 * x + 1] = 0x80;
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_IYU2:
+      for (x = 0; x < width; x++) {
+        dest[3 * x] = 0x80;
+        dest[3 * x + 1] = (guint8) line[x];
+        dest[3 * x + 2] = 0x80;
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_PACKED_10P:
+      for (x = 0; x < width; x += 4, dest += 5) {
+        dest[0] = (guint8) line[x];
+        dest[1] = (guint8) (line[x] >> 8 | line[x + 1] << 2);
+        dest[2] = (guint8) (line[x + 1] >> 6 | line[x + 2] << 4);
+        dest[3] = (guint8) (line[x + 2] >> 4 | line[x + 3] << 6);
+        dest[4] = (guint8) (line[x + 3] >> 2);
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_PACKED_12P:
+      for (x = 0; x < width; x += 2, dest += 3) {
+        dest[0] = (guint8) line[x];
+        dest[1] = (guint8) (line[x] >> 8 | line[x + 1] << 4);
+        dest[2] = (guint8) (line[x + 1] >> 4);
+      }
+      break;
+    case GST_VISION_TEST_SRC_LAYOUT_PACKED_12_PACKED:
+      for (x = 0; x < width; x += 2, dest += 3) {
+        dest[0] = (guint8) (line[x] >> 4);
+        dest[1] = (guint8) ((line[x] & 0x0f) | (line[x + 1] & 0x0f) << 4);
+        dest[2] = (guint8) (line[x + 1] >> 4);
+      }
+      break;
+  }
+}
+
+static gboolean
+gst_vision_test_src_render (GstVisionTestSrc * src, GstBuffer * buf,
+    guint64 frame)
+{
+  GstMapInfo minfo;
+  gboolean rows_differ;
+  gint y;
+
+  if (!gst_buffer_map (buf, &minfo, GST_MAP_WRITE)) {
+    GST_ERROR_OBJECT (src, "Failed to map buffer");
+    return FALSE;
+  }
+
+  if (minfo.size < src->frame_size) {
+    GST_ERROR_OBJECT (src, "Buffer of %" G_GSIZE_FORMAT " bytes too small "
+        "for frame of %" G_GSIZE_FORMAT, minfo.size, src->frame_size);
+    gst_buffer_unmap (buf, &minfo);
+    return FALSE;
+  }
+
+  rows_differ = src->noise > 0 ||
+      src->pattern == GST_VISION_TEST_SRC_PATTERN_RAMP_VERTICAL ||
+      src->pattern == GST_VISION_TEST_SRC_PATTERN_CHECKERS ||
+      src->pattern == GST_VISION_TEST_SRC_PATTERN_NOISE;
+
+  if (rows_differ) {
+    for (y = 0; y < src->height; y++) {
+      gst_vision_test_src_fill_line (src, src->line, y, frame);
+      gst_vision_test_src_pack_line (src, minfo.data + y * src->stride,
+          src->line);
+    }
+  } else {
+    /* pack one row, the rest is memory bandwidth */
+    gst_vision_test_src_fill_line (src, src->line, 0, frame);
+    gst_vision_test_src_pack_line (src, minfo.data, src->line);
+    for (y = 1; y < src->height; y++) {
+      memcpy (minfo.data + y * src->stride, minfo.data, src->stride);
+    }
+  }
+
+  gst_buffer_unmap (buf, &minfo);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_vision_test_src_wait (GstVisionTestSrc * src, GstClockTime running_time)
+{
+  GstClock *clock;
+  GstClockTime base_time;
+  GstClockReturn clock_ret;
+
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock == NULL)
+    return GST_FLOW_OK;
+  base_time = gst_element_get_base_time (GST_ELEMENT (src));
+
+  GST_OBJECT_LOCK (src);
+  if (src->flushing) {
+    GST_OBJECT_UNLOCK (src);
+    gst_object_unref (clock);
+    return GST_FLOW_FLUSHING;
+  }
+  src->clock_id = gst_clock_new_single_shot_id (clock,
+      base_time + running_time);
+  GST_OBJECT_UNLOCK (src);
+
+  clock_ret = gst_clock_id_wait (src->clock_id, NULL);
+
+  GST_OBJECT_LOCK (src);
+  gst_clock_id_unref (src->clock_id);
+  src->clock_id = NULL;
+  GST_OBJECT_UNLOCK (src);
+
+  gst_object_unref (clock);
+
+  if (clock_ret == GST_CLOCK_UNSCHEDULED)
+    return GST_FLOW_FLUSHING;
+
+  return GST_FLOW_OK;
+}
+
+static GstClockTime
+gst_vision_test_src_frame_time (GstVisionTestSrc * src, guint64 frame)
+{
+  return src->running_time_offset + gst_util_uint64_scale (frame,
+      (guint64) src->fps_d * GST_SECOND, src->fps_n);
+}
+
+static GstFlowReturn
+gst_vision_test_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+{
+  GstVisionTestSrc *src = GST_VISION_TEST_SRC (psrc);
+  GstFlowReturn ret;
+  GstBuffer *outbuf;
+  GstClockTime pts;
+
+  if (G_UNLIKELY (!GST_CLOCK_TIME_IS_VALID (src->running_time_offset))) {
+    GstClock *clock = gst_element_get_clock (GST_ELEMENT (src));
+
+    /* live frames start at the running time we were started at */
+    src->running_time_offset = 0;
+    if (clock) {
+      GstClockTime now = gst_clock_get_time (clock);
+      GstClockTime base_time = gst_element_get_base_time (GST_ELEMENT (src));
+      if (now > base_time)
+        src->running_time_offset = now - base_time;
+      gst_object_unref (clock);
+    }
+  }
+
+  while (TRUE) {
+    if (src->is_live && src->n_frames >= src->burst_end) {
+      src->burst_end = (src->n_frames / src->burst + 1) * src->burst;
+      ret = gst_vision_test_src_wait (src,
+          gst_vision_test_src_frame_time (src, src->burst_end));
+      if (ret != GST_FLOW_OK)
+        return ret;
+    }
+
+    if (src->drop_probability <= 0.0 ||
+        g_rand_double (src->rand) >= src->drop_probability)
+      break;
+
+    /* like a frame lost by the grabber, its number and time slot are gone */
+    GST_LOG_OBJECT (src, "Dropping frame %" G_GUINT64_FORMAT, src->n_frames);
+    src->n_frames++;
+    src->n_dropped++;
+    src->discont = TRUE;
+
+    if (!src->is_live) {
+      gboolean flushing;
+
+      GST_OBJECT_LOCK (src);
+      flushing = src->flushing;
+      GST_OBJECT_UNLOCK (src);
+      if (flushing)
+        return GST_FLOW_FLUSHING;
+    }
+  }
+
+  if (src->cache) {
+    guint index = src->n_frames % src->cache_frames;
+
+    if (src->cache[index] == NULL) {
+      src->cache[index] = gst_buffer_new_allocate (NULL, src->frame_size, NULL);
+      if (!gst_vision_test_src_render (src, src->cache[index], src->n_frames)) {
+        gst_buffer_unref (src->cache[index]);
+        src->cache[index] = NULL;
+        return GST_FLOW_ERROR;
+      }
+    }
+
+    /* shares the memory, downstream copies if it writes */
+    outbuf = gst_buffer_copy (src->cache[index]);
+  } else {
+    ret = GST_BASE_SRC_CLASS (gst_vision_test_src_parent_class)->alloc
+        (GST_BASE_SRC (src), src->n_frames, src->frame_size, &outbuf);
+    if (ret != GST_FLOW_OK)
+      return ret;
+
+    if (!gst_vision_test_src_render (src, outbuf, src->n_frames)) {
+      gst_buffer_unref (outbuf);
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  pts = gst_vision_test_src_frame_time (src, src->n_frames);
+  if (src->jitter > 0) {
+    gint64 jitter = (gint64) g_rand_double_range (src->rand,
+        -(gdouble) src->jitter, (gdouble) src->jitter);
+    if (jitter < 0 && (GstClockTime) (-jitter) > pts)
+      pts = 0;
+    else
+      pts += jitter;
+  }
+
+  GST_BUFFER_PTS (outbuf) = pts;
+  GST_BUFFER_DURATION (outbuf) = gst_util_uint64_scale (1,
+      (guint64) src->fps_d * GST_SECOND, src->fps_n);
+  GST_BUFFER_OFFSET (outbuf) = src->n_frames;
+  GST_BUFFER_OFFSET_END (outbuf) = src->n_frames + 1;
+  if (src->discont) {
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+    src->discont = FALSE;
+  }
+
+  src->n_frames++;
+
+  *buf = outbuf;
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  GST_DEBUG_CATEGORY_INIT (gst_vision_test_src_debug, "visiontestsrc", 0,
+      "debug category for visiontestsrc element");
+  gst_element_register (plugin, "visiontestsrc", GST_RANK_NONE,
+      gst_vision_test_src_get_type ());
+
+  return TRUE;
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    visiontestsrc,
+    "Synthetic machine vision camera source",
+    plugin_init, GST_PACKAGE_VERSION, GST_PACKAGE_LICENSE, GST_PACKAGE_NAME,
+    GST_PACKAGE_ORIGIN)
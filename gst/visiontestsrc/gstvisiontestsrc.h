@@ -0,0 +1,111 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_VISION_TEST_SRC_H_
+#define _GST_VISION_TEST_SRC_H_
+
+#include <gst/base/gstpushsrc.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VISION_TEST_SRC   (gst_vision_test_src_get_type())
+#define GST_VISION_TEST_SRC(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VISION_TEST_SRC,GstVisionTestSrc))
+#define GST_VISION_TEST_SRC_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VISION_TEST_SRC,GstVisionTestSrcClass))
+#define GST_IS_VISION_TEST_SRC(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VISION_TEST_SRC))
+#define GST_IS_VISION_TEST_SRC_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VISION_TEST_SRC))
+
+typedef struct _GstVisionTestSrc GstVisionTestSrc;
+typedef struct _GstVisionTestSrcClass GstVisionTestSrcClass;
+
+typedef enum {
+  GST_VISION_TEST_SRC_PATTERN_SOLID,
+  GST_VISION_TEST_SRC_PATTERN_RAMP_HORIZONTAL,
+  GST_VISION_TEST_SRC_PATTERN_RAMP_VERTICAL,
+  GST_VISION_TEST_SRC_PATTERN_RAMP_MOVING,
+  GST_VISION_TEST_SRC_PATTERN_CHECKERS,
+  GST_VISION_TEST_SRC_PATTERN_NOISE
+} GstVisionTestSrcPattern;
+
+/* how one pixel value is written to memory */
+typedef enum {
+  GST_VISION_TEST_SRC_LAYOUT_GRAY8,
+  GST_VISION_TEST_SRC_LAYOUT_GRAY16_LE,
+  GST_VISION_TEST_SRC_LAYOUT_GRAY16_BE,
+  GST_VISION_TEST_SRC_LAYOUT_RGB,
+  GST_VISION_TEST_SRC_LAYOUT_RGBA,
+  GST_VISION_TEST_SRC_LAYOUT_UYVY,
+  GST_VISION_TEST_SRC_LAYOUT_YUY2,
+  GST_VISION_TEST_SRC_LAYOUT_IYU2,
+  GST_VISION_TEST_SRC_LAYOUT_PACKED_10P,
+  GST_VISION_TEST_SRC_LAYOUT_PACKED_12P,
+  GST_VISION_TEST_SRC_LAYOUT_PACKED_12_PACKED
+} GstVisionTestSrcLayout;
+
+struct _GstVisionTestSrc
+{
+  GstPushSrc base_visiontestsrc;
+
+  /* properties */
+  gchar *pixel_format;
+  gint endianness;
+  gint width;
+  gint height;
+  gint fps_n;
+  gint fps_d;
+  GstVisionTestSrcPattern pattern;
+  guint noise;
+  gdouble drop_probability;
+  GstClockTime jitter;
+  guint burst;
+  guint cache_frames;
+  guint seed;
+  gboolean is_live;
+
+  /* negotiated format */
+  GstVisionTestSrcLayout layout;
+  gboolean is_raw;
+  gint stride;
+  gsize frame_size;
+  guint max_value;
+
+  /* streaming state */
+  guint64 n_frames;
+  guint64 n_dropped;
+  guint64 burst_end;
+  gboolean discont;
+  GstClockTime running_time_offset;
+  GRand *rand;
+  guint32 noise_state;
+  guint16 *line;
+  GstBuffer **cache;
+
+  GstClockID clock_id;
+  gboolean flushing;
+};
+
+struct _GstVisionTestSrcClass
+{
+  GstPushSrcClass base_visiontestsrc_class;
+};
+
+GType gst_vision_test_src_get_type (void);
+
+G_END_DECLS
+
+#endif
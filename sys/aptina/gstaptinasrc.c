@@ -45,6 +45,7 @@
 #endif
 
 #include "gstaptinasrc.h"
+#include "common/visionclockmapper.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_aptinasrc_debug);
 #define GST_CAT_DEFAULT gst_aptinasrc_debug
@@ -64,7 +65,9 @@ static gboolean gst_aptinasrc_set_caps (GstBaseSrc * src, GstCaps * caps);
 static gboolean gst_aptinasrc_unlock (GstBaseSrc * src);
 static gboolean gst_aptinasrc_unlock_stop (GstBaseSrc * src);
 
-static GstFlowReturn gst_aptinasrc_fill (GstPushSrc * src, GstBuffer * buf);
+static GstFlowReturn gst_aptinasrc_create (GstPushSrc * src, GstBuffer ** buf);
+
+static void gst_aptinasrc_stop_threads (GstAptinaSrc * src);
 
 enum
 {
@@ -72,13 +75,20 @@ enum
   PROP_DEVICE_INDEX,
   PROP_CONFIG_FILE,
   PROP_CONFIG_PRESET,
-  PROP_XSDAT_FILE
+  PROP_XSDAT_FILE,
+  PROP_NUM_GRAB_BUFFERS,
+  PROP_RAW_BAYER,
+  PROP_DROPPED_FRAMES,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_DEVICE_INDEX 0
 #define DEFAULT_PROP_CONFIG_FILE ""
 #define DEFAULT_PROP_CONFIG_PRESET ""
 #define DEFAULT_PROP_XSDAT_FILE ""
+#define DEFAULT_PROP_NUM_GRAB_BUFFERS 3
+#define DEFAULT_PROP_RAW_BAYER TRUE
 
 /* pad templates */
 
@@ -126,7 +136,7 @@ gst_aptinasrc_class_init (GstAptinaSrcClass * klass)
   gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_aptinasrc_unlock);
   gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_aptinasrc_unlock_stop);
 
-  gstpushsrc_class->fill = GST_DEBUG_FUNCPTR (gst_aptinasrc_fill);
+  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_aptinasrc_create);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_DEVICE_INDEX,
@@ -151,6 +161,27 @@ gst_aptinasrc_class_init (GstAptinaSrcClass * klass)
           DEFAULT_PROP_CONFIG_PRESET,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_NUM_GRAB_BUFFERS,
+      g_param_spec_uint ("num-grab-buffers", "Number of grab buffers",
+          "Number of raw frames grabbed ahead of downstream, the oldest is "
+          "dropped when all are full", 2, G_MAXUINT,
+          DEFAULT_PROP_NUM_GRAB_BUFFERS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_RAW_BAYER,
+      g_param_spec_boolean ("raw-bayer", "Raw Bayer",
+          "Output Bayer sensors as video/x-bayer for downstream demosaicing, "
+          "otherwise run the ApBase color pipe", DEFAULT_PROP_RAW_BAYER,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DROPPED_FRAMES,
+      g_param_spec_uint ("dropped-frames", "Dropped frames",
+          "Number of frames lost before reaching the host; deprecated, use "
+          "frames-dropped of the stats property", 0, G_MAXUINT, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static void
@@ -163,7 +194,7 @@ gst_aptinasrc_reset (GstAptinaSrc * src)
   src->is_started = FALSE;
 
   src->last_frame_count = 0;
-  src->total_dropped_frames = 0;
+  gst_vision_stats_reset (&src->stats);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -190,12 +221,27 @@ gst_aptinasrc_init (GstAptinaSrc * src)
   src->config_file = g_strdup (DEFAULT_PROP_CONFIG_FILE);
   src->config_preset = g_strdup (DEFAULT_PROP_CONFIG_PRESET);
   src->xsdat_file = g_strdup (DEFAULT_PROP_XSDAT_FILE);
+  src->num_grab_buffers = DEFAULT_PROP_NUM_GRAB_BUFFERS;
+  src->raw_bayer = DEFAULT_PROP_RAW_BAYER;
 
   src->apbase = NULL;
   src->stop_requested = FALSE;
   src->caps = NULL;
   src->buffer = NULL;
 
+  src->frames = NULL;
+  src->free_frames = g_async_queue_new ();
+  src->raw_frames = g_async_queue_new ();
+  src->out_buffers = g_async_queue_new_full ((GDestroyNotify) gst_buffer_unref);
+  src->grab_thread = NULL;
+  src->color_thread = NULL;
+  g_mutex_init (&src->mutex);
+  g_cond_init (&src->cond);
+  src->num_outstanding = 0;
+  src->pending_frames = NULL;
+  src->num_pending_frames = 0;
+  gst_vision_stats_init (&src->stats);
+
   gst_aptinasrc_reset (src);
 }
 
@@ -223,6 +269,15 @@ gst_aptinasrc_set_property (GObject * object, guint property_id,
       g_free (src->xsdat_file);
       src->xsdat_file = g_strdup (g_value_get_string (value));
       break;
+    case PROP_NUM_GRAB_BUFFERS:
+      src->num_grab_buffers = g_value_get_uint (value);
+      break;
+    case PROP_RAW_BAYER:
+      src->raw_bayer = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -251,6 +306,24 @@ gst_aptinasrc_get_property (GObject * object, guint property_id,
     case PROP_XSDAT_FILE:
       g_value_set_string (value, src->xsdat_file);
       break;
+    case PROP_NUM_GRAB_BUFFERS:
+      g_value_set_uint (value, src->num_grab_buffers);
+      break;
+    case PROP_RAW_BAYER:
+      g_value_set_boolean (value, src->raw_bayer);
+      break;
+    case PROP_DROPPED_FRAMES:
+      g_mutex_lock (&src->stats.lock);
+      g_value_set_uint (value,
+          (guint) MIN (src->stats.frames_dropped, G_MAXUINT));
+      g_mutex_unlock (&src->stats.lock);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -288,6 +361,13 @@ gst_aptinasrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
+  g_async_queue_unref (src->free_frames);
+  g_async_queue_unref (src->raw_frames);
+  g_async_queue_unref (src->out_buffers);
+  g_mutex_clear (&src->mutex);
+  g_cond_clear (&src->cond);
+  gst_vision_stats_clear (&src->stats);
+
   G_OBJECT_CLASS (gst_aptinasrc_parent_class)->finalize (object);
 }
 
@@ -353,6 +433,11 @@ gst_aptinasrc_calculate_caps (GstAptinaSrc * src)
         "Image format not supported yet, will convert to BGRx");
   }
 
+  if (bayer_bpp != 0 && !src->raw_bayer) {
+    GST_DEBUG_OBJECT (src, "Raw Bayer output disabled, using color pipe");
+    bayer_bpp = 0;
+  }
+
   if (format == GST_VIDEO_FORMAT_UNKNOWN && bayer_bpp == 0) {
     ap_u32 rgb_width = 0, rgb_height = 0, rgb_depth = 0;
     src->convert_to_rgb = TRUE;
@@ -443,6 +528,16 @@ gst_aptinasrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  g_mutex_lock (&src->mutex);
+  if (src->pending_frames) {
+    g_mutex_unlock (&src->mutex);
+    GST_ELEMENT_ERROR (src, RESOURCE, BUSY,
+        ("Buffers from the previous acquisition are still in use"),
+        ("%d buffers have not been released", src->num_outstanding));
+    return FALSE;
+  }
+  g_mutex_unlock (&src->mutex);
+
   ap_DeviceProbe (src->xsdat_file);
 
   //src->apbase = ap_CreateFromImageFile("C:\\temp\\1.jpg");
@@ -492,9 +587,203 @@ gst_aptinasrc_start (GstBaseSrc * bsrc)
     return FALSE;
   }
 
+  /* raw frames are pushed without copying, so they must hold a whole
+   * output frame */
+  if (!src->convert_to_rgb && src->raw_framesize < (gint) src->out_framesize) {
+    GST_ELEMENT_ERROR (src, STREAM, FAILED,
+        ("Grabbed frame is %d bytes, expected at least %d",
+            src->raw_framesize, src->out_framesize), (NULL));
+    return FALSE;
+  }
+
   return TRUE;
 }
 
+static GstClockTime
+gst_aptinasrc_get_clock_time (GstAptinaSrc * src)
+{
+  GstClock *clock;
+  GstClockTime clock_time = GST_CLOCK_TIME_NONE;
+
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock) {
+    clock_time = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+  }
+
+  return clock_time;
+}
+
+/* create checks the queues with the mutex held before it waits, so taking it
+ * here means the frame just queued is either seen or signalled */
+static void
+gst_aptinasrc_wake (GstAptinaSrc * src)
+{
+  g_mutex_lock (&src->mutex);
+  g_cond_signal (&src->cond);
+  g_mutex_unlock (&src->mutex);
+}
+
+/* Grab into free raw frames as fast as the camera delivers them. When
+ * downstream falls behind the oldest grabbed frame is reused. */
+static gpointer
+gst_aptinasrc_grab_thread (GstAptinaSrc * src)
+{
+  GstAptinaSrcFrame *frame;
+  ap_s32 ret;
+
+  while (!g_atomic_int_get (&src->thread_stop)) {
+    frame = (GstAptinaSrcFrame *) g_async_queue_try_pop (src->free_frames);
+    if (!frame) {
+      frame = (GstAptinaSrcFrame *) g_async_queue_try_pop (src->raw_frames);
+      if (frame) {
+        gst_vision_stats_add_overwritten (&src->stats, 1);
+        GST_DEBUG_OBJECT (src, "Downstream too slow, dropping frame %"
+            G_GUINT64_FORMAT, frame->index);
+      }
+    }
+    if (!frame) {
+      /* everything is held downstream */
+      frame = (GstAptinaSrcFrame *) g_async_queue_timeout_pop
+          (src->free_frames, 100 * G_TIME_SPAN_MILLISECOND);
+      if (!frame)
+        continue;
+    }
+
+    ret = ap_GrabFrame (src->apbase, frame->data, src->raw_framesize);
+    if (ret == 0) {
+      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+          ("Grabbing failed with error %d", ap_GetLastError ()), (NULL));
+      g_async_queue_push (src->free_frames, frame);
+      g_mutex_lock (&src->mutex);
+      src->grab_flow = GST_FLOW_ERROR;
+      g_cond_signal (&src->cond);
+      g_mutex_unlock (&src->mutex);
+      break;
+    }
+
+    frame->clock_time = gst_aptinasrc_get_clock_time (src);
+    frame->index = src->frame_index++;
+    g_async_queue_push (src->raw_frames, frame);
+    gst_aptinasrc_wake (src);
+  }
+
+  return NULL;
+}
+
+/* Run the color pipe on raw frames while the next one is being grabbed.
+ * The color pipe output is owned by ApBase, so it is copied once into the
+ * output buffer and the raw frame recycled right away. */
+static gpointer
+gst_aptinasrc_color_thread (GstAptinaSrc * src)
+{
+  GstAptinaSrcFrame *frame;
+  GstBuffer *buf;
+  GstMapInfo minfo;
+  guint8 *unpacked;
+
+  while (!g_atomic_int_get (&src->thread_stop)) {
+    ap_u32 rgb_width = 0, rgb_height = 0, rgb_depth = 0;
+
+    frame = (GstAptinaSrcFrame *) g_async_queue_timeout_pop (src->raw_frames,
+        100 * G_TIME_SPAN_MILLISECOND);
+    if (!frame)
+      continue;
+
+    unpacked =
+        ap_ColorPipe (src->apbase, frame->data, src->raw_framesize,
+        &rgb_width, &rgb_height, &rgb_depth);
+
+    buf = gst_buffer_new_allocate (NULL, src->out_framesize, NULL);
+    gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
+    orc_memcpy (minfo.data, unpacked, (int) minfo.size);
+    gst_buffer_unmap (buf, &minfo);
+    GST_BUFFER_TIMESTAMP (buf) = frame->clock_time;
+    GST_BUFFER_OFFSET (buf) = frame->index;
+    g_async_queue_push (src->free_frames, frame);
+
+    g_async_queue_lock (src->out_buffers);
+    if (g_async_queue_length_unlocked (src->out_buffers) >=
+        (gint) src->num_grab_buffers) {
+      gst_buffer_unref ((GstBuffer *)
+          g_async_queue_try_pop_unlocked (src->out_buffers));
+      gst_vision_stats_add_overwritten (&src->stats, 1);
+      GST_DEBUG_OBJECT (src, "Downstream too slow, dropping converted frame");
+    }
+    g_async_queue_push_unlocked (src->out_buffers, buf);
+    g_async_queue_unlock (src->out_buffers);
+    gst_aptinasrc_wake (src);
+  }
+
+  return NULL;
+}
+
+static void
+gst_aptinasrc_start_threads (GstAptinaSrc * src)
+{
+  guint i;
+
+  src->frames = g_new0 (GstAptinaSrcFrame, src->num_grab_buffers);
+  for (i = 0; i < src->num_grab_buffers; ++i) {
+    src->frames[i].data = (guint8 *) g_malloc (src->raw_framesize);
+    g_async_queue_push (src->free_frames, &src->frames[i]);
+  }
+
+  g_atomic_int_set (&src->thread_stop, FALSE);
+  src->grab_flow = GST_FLOW_OK;
+  src->frame_index = 0;
+  src->grab_thread = g_thread_new ("aptinasrc-grab",
+      (GThreadFunc) gst_aptinasrc_grab_thread, src);
+  if (src->convert_to_rgb) {
+    src->color_thread = g_thread_new ("aptinasrc-color",
+        (GThreadFunc) gst_aptinasrc_color_thread, src);
+  }
+}
+
+static void
+gst_aptinasrc_free_frames (GstAptinaSrcFrame * frames, guint num_frames)
+{
+  guint i;
+
+  for (i = 0; i < num_frames; ++i)
+    g_free (frames[i].data);
+  g_free (frames);
+}
+
+static void
+gst_aptinasrc_stop_threads (GstAptinaSrc * src)
+{
+  GstBuffer *buf;
+
+  g_atomic_int_set (&src->thread_stop, TRUE);
+  if (src->grab_thread) {
+    g_thread_join (src->grab_thread);
+    src->grab_thread = NULL;
+  }
+  if (src->color_thread) {
+    g_thread_join (src->color_thread);
+    src->color_thread = NULL;
+  }
+
+  while ((buf = (GstBuffer *) g_async_queue_try_pop (src->out_buffers)))
+    gst_buffer_unref (buf);
+  while (g_async_queue_try_pop (src->raw_frames));
+
+  /* frames still held downstream are freed when the last one is released */
+  g_mutex_lock (&src->mutex);
+  while (g_async_queue_try_pop (src->free_frames));
+  if (src->frames && src->num_outstanding > 0) {
+    GST_DEBUG_OBJECT (src, "%d buffers still held downstream, freeing frames "
+        "when they are released", src->num_outstanding);
+    src->pending_frames = src->frames;
+    src->num_pending_frames = src->num_grab_buffers;
+  } else if (src->frames) {
+    gst_aptinasrc_free_frames (src->frames, src->num_grab_buffers);
+  }
+  src->frames = NULL;
+  g_mutex_unlock (&src->mutex);
+}
+
 static gboolean
 gst_aptinasrc_stop (GstBaseSrc * bsrc)
 {
@@ -502,6 +791,8 @@ gst_aptinasrc_stop (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "stop");
 
+  gst_aptinasrc_stop_threads (src);
+
   ap_Destroy (src->apbase);
   ap_Finalize ();
 
@@ -565,7 +856,10 @@ gst_aptinasrc_unlock (GstBaseSrc * bsrc)
 
   GST_LOG_OBJECT (src, "unlock");
 
+  g_mutex_lock (&src->mutex);
   src->stop_requested = TRUE;
+  g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->mutex);
 
   return TRUE;
 }
@@ -577,69 +871,119 @@ gst_aptinasrc_unlock_stop (GstBaseSrc * bsrc)
 
   GST_LOG_OBJECT (src, "unlock_stop");
 
+  g_mutex_lock (&src->mutex);
   src->stop_requested = FALSE;
+  g_mutex_unlock (&src->mutex);
 
   return TRUE;
 }
 
+typedef struct
+{
+  GstAptinaSrc *src;
+  GstAptinaSrcFrame *frame;
+} VideoFrame;
+
+static void
+buffer_release (void *data)
+{
+  VideoFrame *vf = (VideoFrame *) data;
+  GstAptinaSrc *src = vf->src;
+
+  g_mutex_lock (&src->mutex);
+  src->num_outstanding--;
+  if (src->pending_frames == NULL) {
+    g_async_queue_push (src->free_frames, vf->frame);
+  } else if (src->num_outstanding == 0) {
+    GST_DEBUG_OBJECT (src, "Last buffer released, freeing frames");
+    gst_aptinasrc_free_frames (src->pending_frames, src->num_pending_frames);
+    src->pending_frames = NULL;
+    src->num_pending_frames = 0;
+  }
+  g_mutex_unlock (&src->mutex);
+
+  gst_object_unref (src);
+  g_free (vf);
+}
+
 static GstFlowReturn
-gst_aptinasrc_fill (GstPushSrc * psrc, GstBuffer * buf)
+gst_aptinasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 {
   GstAptinaSrc *src = GST_APTINA_SRC (psrc);
-  ap_s32 ret;
-  GstMapInfo minfo;
-  GstClock *clock;
-  GstClockTime clock_time;
-  char *pBuffer = NULL;
-  static int temp_ugly_buf_index = 0;
+  GstAptinaSrcFrame *frame = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstClockTime now;
 
   GST_LOG_OBJECT (src, "create");
 
   if (!src->is_started) {
     /* TODO: check timestamps on buffers vs start time */
-    src->acq_start_time =
-        gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src)));
+    src->acq_start_time = gst_aptinasrc_get_clock_time (src);
 
+    gst_aptinasrc_start_threads (src);
     src->is_started = TRUE;
   }
 
-  ret = ap_GrabFrame (src->apbase, src->buffer, src->raw_framesize);
-  if (ret == 0) {
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        ("Grabbing failed with error %d", ap_GetLastError ()), (NULL));
-    return GST_FLOW_ERROR;
-  }
+  *buf = NULL;
+  g_mutex_lock (&src->mutex);
+  while (TRUE) {
+    if (src->stop_requested) {
+      ret = GST_FLOW_FLUSHING;
+      break;
+    }
+    if (src->grab_flow != GST_FLOW_OK) {
+      ret = src->grab_flow;
+      break;
+    }
 
-  clock = gst_element_get_clock (GST_ELEMENT (src));
-  clock_time = gst_clock_get_time (clock);
-  gst_object_unref (clock);
+    if (src->convert_to_rgb) {
+      *buf = (GstBuffer *) g_async_queue_try_pop (src->out_buffers);
+      if (*buf)
+        break;
+    } else {
+      frame = (GstAptinaSrcFrame *) g_async_queue_try_pop (src->raw_frames);
+      if (frame) {
+        src->num_outstanding++;
+        break;
+      }
+    }
 
-  gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
-  if (src->convert_to_rgb) {
-    guint8 *unpacked;
-    ap_u32 rgb_width = 0, rgb_height = 0, rgb_depth = 0;
-    unpacked =
-        ap_ColorPipe (src->apbase, src->buffer, src->raw_framesize, &rgb_width,
-        &rgb_height, &rgb_depth);
-    orc_memcpy (minfo.data, unpacked, (int) minfo.size);
-  } else {
-    orc_memcpy (minfo.data, src->buffer, (int) minfo.size);
+    g_cond_wait (&src->cond, &src->mutex);
+  }
+  g_mutex_unlock (&src->mutex);
+
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  if (frame) {
+    VideoFrame *vf = g_new0 (VideoFrame, 1);
+    vf->src = (GstAptinaSrc *) gst_object_ref (src);
+    vf->frame = frame;
+
+    *buf =
+        gst_buffer_new_wrapped_full ((GstMemoryFlags)
+        GST_MEMORY_FLAG_READONLY, frame->data, src->raw_framesize, 0,
+        src->out_framesize, vf, (GDestroyNotify) buffer_release);
+    GST_BUFFER_TIMESTAMP (*buf) = frame->clock_time;
+    GST_BUFFER_OFFSET (*buf) = frame->index;
   }
-  gst_buffer_unmap (buf, &minfo);
 
-  GST_BUFFER_TIMESTAMP (buf) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      clock_time);
-  GST_BUFFER_OFFSET (buf) = temp_ugly_buf_index++;
+  now = gst_aptinasrc_get_clock_time (src);
+  gst_vision_stats_set_queue_depth (&src->stats,
+      g_async_queue_length (src->convert_to_rgb ? src->out_buffers :
+          src->raw_frames));
+  gst_vision_stats_add_delivered (&src->stats,
+      gst_vision_stats_latency (GST_BUFFER_TIMESTAMP (*buf), now));
+  gst_vision_stats_post (&src->stats, GST_ELEMENT (src), now, NULL);
 
-  if (src->stop_requested) {
-    return GST_FLOW_FLUSHING;
-  }
+  GST_BUFFER_TIMESTAMP (*buf) =
+      gst_vision_clock_mapper_running_time (GST_ELEMENT (src),
+      GST_BUFFER_TIMESTAMP (*buf));
+  GST_BUFFER_OFFSET_END (*buf) = GST_BUFFER_OFFSET (*buf) + 1;
 
   return GST_FLOW_OK;
 }
 
-
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
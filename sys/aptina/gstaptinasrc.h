@@ -24,6 +24,8 @@
 
 #include "apbase.h"
 
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_APTINA_SRC   (gst_aptinasrc_get_type())
@@ -35,6 +37,14 @@ G_BEGIN_DECLS
 typedef struct _GstAptinaSrc GstAptinaSrc;
 typedef struct _GstAptinaSrcClass GstAptinaSrcClass;
 
+/* a raw grab buffer and the clock time it was grabbed at */
+typedef struct
+{
+  guint8 *data;
+  GstClockTime clock_time;
+  guint64 index;
+} GstAptinaSrcFrame;
+
 struct _GstAptinaSrc
 {
   GstPushSrc base_aptinasrc;
@@ -47,10 +57,12 @@ struct _GstAptinaSrc
   gchar *config_file;
   gchar *config_preset;
   gchar *xsdat_file;
+  guint num_grab_buffers;
+  gboolean raw_bayer;
 
   GstClockTime acq_start_time;
   guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  GstVisionStats stats;
 
   GstCaps *caps;
   gint raw_framesize;
@@ -58,6 +70,26 @@ struct _GstAptinaSrc
   gboolean convert_to_rgb;
   guint8 *buffer;
 
+  /* grab thread fills raw frames, color thread converts them if needed */
+  GstAptinaSrcFrame *frames;
+  GAsyncQueue *free_frames;
+  GAsyncQueue *raw_frames;
+  GAsyncQueue *out_buffers;
+  GThread *grab_thread;
+  GThread *color_thread;
+  gint thread_stop;
+  GstFlowReturn grab_flow;
+  guint64 frame_index;
+
+  /* raw frames pushed downstream without copying, frames of a stopped
+   * acquisition are freed by the last buffer released. cond wakes create
+   * when a frame is queued, the grab thread fails or on unlock. */
+  GMutex mutex;
+  GCond cond;
+  guint num_outstanding;
+  GstAptinaSrcFrame *pending_frames;
+  guint num_pending_frames;
+
   gboolean stop_requested;
 };
 
@@ -38,6 +38,12 @@
 #include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
+#ifdef HAVE_ORC
+#include <orc/orc.h>
+#else
+#define orc_memcpy memcpy
+#endif
+
 #include "gstbitflowsrc.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_bitflowsrc_debug);
@@ -69,13 +75,19 @@ enum
   PROP_CAMERA_FILE,
   PROP_NUM_CAPTURE_BUFFERS,
   PROP_BOARD,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_ZERO_COPY,
+  PROP_RESERVE_BUFFERS,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_CAMERA_FILE ""
 #define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 3
 #define DEFAULT_PROP_BOARD 0
 #define DEFAULT_PROP_TIMEOUT 1000
+#define DEFAULT_PROP_ZERO_COPY FALSE
+#define DEFAULT_PROP_RESERVE_BUFFERS 2
 
 /* pad templates */
 
@@ -142,7 +154,22 @@ gst_bitflowsrc_class_init (GstBitflowSrcClass * klass)
           "Timeout (ms)",
           "Timeout in ms (0 to use default)", 0, G_MAXINT,
           DEFAULT_PROP_TIMEOUT, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
-
+  g_object_class_install_property (gobject_class, PROP_ZERO_COPY,
+      g_param_spec_boolean ("zero-copy", "Zero copy",
+          "Push circular buffers without copying, they are made available "
+          "to the grabber again when downstream releases them",
+          DEFAULT_PROP_ZERO_COPY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_RESERVE_BUFFERS,
+      g_param_spec_uint ("reserve-buffers", "Reserve buffers",
+          "In zero-copy mode, number of circular buffers always left to the "
+          "grabber, frames are copied instead when downstream holds the rest",
+          1, G_MAXUINT, DEFAULT_PROP_RESERVE_BUFFERS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static void
@@ -152,7 +179,9 @@ gst_bitflowsrc_reset (GstBitflowSrc * src)
   memset (&src->buffer_array, 0, sizeof (src->buffer_array));
   src->error_string[0] = 0;
   src->last_frame_count = 0;
-  src->total_dropped_frames = 0;
+  gst_vision_stats_reset (&src->stats);
+  src->acquiring = FALSE;
+  gst_vision_clock_mapper_init (&src->clock_mapper, 1e9, 64, 0);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -174,7 +203,13 @@ gst_bitflowsrc_init (GstBitflowSrc * src)
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
   src->board_index = DEFAULT_PROP_BOARD;
   src->timeout = DEFAULT_PROP_TIMEOUT;
+  src->zero_copy = DEFAULT_PROP_ZERO_COPY;
+  src->reserve_buffers = DEFAULT_PROP_RESERVE_BUFFERS;
 
+  g_mutex_init (&src->mutex);
+  src->num_outstanding = 0;
+  src->pending_board = NULL;
+  gst_vision_stats_init (&src->stats);
   src->stop_requested = FALSE;
   src->caps = NULL;
 
@@ -203,6 +238,15 @@ gst_bitflowsrc_set_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
       break;
+    case PROP_ZERO_COPY:
+      src->zero_copy = g_value_get_boolean (value);
+      break;
+    case PROP_RESERVE_BUFFERS:
+      src->reserve_buffers = g_value_get_uint (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -231,6 +275,18 @@ gst_bitflowsrc_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_int (value, src->timeout);
       break;
+    case PROP_ZERO_COPY:
+      g_value_set_boolean (value, src->zero_copy);
+      break;
+    case PROP_RESERVE_BUFFERS:
+      g_value_set_uint (value, src->reserve_buffers);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -261,6 +317,9 @@ gst_bitflowsrc_finalize (GObject * object)
   /* clean up object here */
   g_free (src->camera_file);
 
+  g_mutex_clear (&src->mutex);
+  gst_vision_stats_clear (&src->stats);
+
   if (src->caps) {
     gst_caps_unref (src->caps);
     src->caps = NULL;
@@ -279,6 +338,16 @@ gst_bitflowsrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  g_mutex_lock (&src->mutex);
+  if (src->pending_board) {
+    g_mutex_unlock (&src->mutex);
+    GST_ELEMENT_ERROR (src, RESOURCE, BUSY,
+        ("Buffers from the previous acquisition are still in use"),
+        ("%d buffers have not been released", src->num_outstanding));
+    return FALSE;
+  }
+  g_mutex_unlock (&src->mutex);
+
   if (strlen (src->camera_file)) {
     if (!g_file_test (src->camera_file, G_FILE_TEST_EXISTS)) {
       GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
@@ -392,6 +461,22 @@ gst_bitflowsrc_start (GstBaseSrc * bsrc)
   src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
   src->bf_stride = stride;
 
+  if (src->zero_copy && src->num_capture_buffers <= src->reserve_buffers) {
+    GST_ELEMENT_WARNING (src, RESOURCE, SETTINGS,
+        ("num-capture-buffers (%d) must exceed reserve-buffers (%d) for "
+            "zero-copy, frames will be copied", src->num_capture_buffers,
+            src->reserve_buffers), (NULL));
+  }
+  if (src->zero_copy && src->gst_stride != src->bf_stride) {
+    GST_ELEMENT_WARNING (src, RESOURCE, SETTINGS,
+        ("Grabber stride %d differs from video stride %d, frames will be "
+            "copied", src->bf_stride, src->gst_stride), (NULL));
+  }
+
+  g_mutex_lock (&src->mutex);
+  src->acquiring = TRUE;
+  g_mutex_unlock (&src->mutex);
+
   GST_DEBUG_OBJECT (src, "starting acquisition");
   ret = BiCirControl (src->board, &src->buffer_array, BISTART, BiWait);
   if (ret != BI_OK) {
@@ -411,6 +496,31 @@ gst_bitflowsrc_start (GstBaseSrc * bsrc)
   return TRUE;
 }
 
+/* Frees the circular buffers and closes the board, must only be called
+ * once no buffer wraps a circular buffer anymore */
+static void
+gst_bitflowsrc_close_board (GstBitflowSrc * src, Bd board,
+    BIBA * buffer_array)
+{
+  BFRC ret;
+
+  ret = BiCircCleanUp (board, buffer_array);
+  if (ret != BI_OK) {
+    GST_WARNING_OBJECT (src, "Failed to cleanup circular acquisition: %d",
+        ret);
+  }
+
+  ret = BiBufferFree (board, buffer_array);
+  if (ret != BI_OK) {
+    GST_WARNING_OBJECT (src, "Failed to free buffer array: %d", ret);
+  }
+
+  ret = BiBrdClose (board);
+  if (ret != BI_OK) {
+    GST_WARNING_OBJECT (src, "Failed to close board: %d", ret);
+  }
+}
+
 static gboolean
 gst_bitflowsrc_stop (GstBaseSrc * bsrc)
 {
@@ -418,23 +528,25 @@ gst_bitflowsrc_stop (GstBaseSrc * bsrc)
   BFRC ret;
   GST_DEBUG_OBJECT (src, "stop");
 
-  ret = BiCircCleanUp (src->board, &src->buffer_array);
-  if (ret != BI_OK) {
-    GST_WARNING_OBJECT (src, "Failed to cleanup circular acquisition: %s",
-        gst_bitflowsrc_get_error_string (src, ret));
-  }
+  g_mutex_lock (&src->mutex);
+  src->acquiring = FALSE;
 
-  ret = BiBufferFree (src->board, &src->buffer_array);
+  ret = BiCirControl (src->board, &src->buffer_array, BISTOP, BiWait);
   if (ret != BI_OK) {
-    GST_WARNING_OBJECT (src, "Failed to free buffer array: %s",
+    GST_WARNING_OBJECT (src, "Failed to stop acquisition: %s",
         gst_bitflowsrc_get_error_string (src, ret));
   }
 
-  ret = BiBrdClose (src->board);
-  if (ret != BI_OK) {
-    GST_WARNING_OBJECT (src, "Failed to free buffer array: %s",
-        gst_bitflowsrc_get_error_string (src, ret));
+  /* circular buffers can't be freed while downstream still holds them */
+  if (src->num_outstanding > 0) {
+    GST_DEBUG_OBJECT (src, "%d buffers still held downstream, closing board "
+        "when they are released", src->num_outstanding);
+    src->pending_board = src->board;
+    src->pending_buffer_array = src->buffer_array;
+  } else {
+    gst_bitflowsrc_close_board (src, src->board, &src->buffer_array);
   }
+  g_mutex_unlock (&src->mutex);
 
   gst_bitflowsrc_reset (src);
 
@@ -515,6 +627,72 @@ gst_bitflowsrc_unlock_stop (GstBaseSrc * bsrc)
   return TRUE;
 }
 
+typedef struct
+{
+  GstBitflowSrc *src;
+  BiCirHandle circ_handle;
+} VideoFrame;
+
+static void
+buffer_release (void *data)
+{
+  VideoFrame *frame = (VideoFrame *) data;
+  GstBitflowSrc *src = frame->src;
+
+  GST_TRACE_OBJECT (src, "Releasing buffer %d",
+      frame->circ_handle.BufferNumber);
+
+  g_mutex_lock (&src->mutex);
+  if (src->acquiring) {
+    BiCirStatusSet (src->board, &src->buffer_array, frame->circ_handle,
+        BIAVAILABLE);
+  }
+  src->num_outstanding--;
+  if (src->num_outstanding == 0 && src->pending_board) {
+    GST_DEBUG_OBJECT (src, "Last buffer released, closing board");
+    gst_bitflowsrc_close_board (src, src->pending_board,
+        &src->pending_buffer_array);
+    src->pending_board = NULL;
+  }
+  g_mutex_unlock (&src->mutex);
+
+  gst_object_unref (src);
+  g_free (frame);
+}
+
+/* Returns a buffer wrapping the circular buffer, which stays unavailable to
+ * the grabber until the buffer is freed, or NULL if it must be copied */
+static GstBuffer *
+gst_bitflowsrc_wrap_circ_handle (GstBitflowSrc * src,
+    BiCirHandle * circ_handle)
+{
+  VideoFrame *vf;
+  gsize size = src->height * src->gst_stride;
+
+  if (!src->zero_copy || src->gst_stride != src->bf_stride) {
+    return NULL;
+  }
+
+  g_mutex_lock (&src->mutex);
+  if (src->num_outstanding + src->reserve_buffers >=
+      src->num_capture_buffers) {
+    g_mutex_unlock (&src->mutex);
+    GST_LOG_OBJECT (src, "%d buffers held downstream, copying frame",
+        src->num_outstanding);
+    return NULL;
+  }
+  src->num_outstanding++;
+  g_mutex_unlock (&src->mutex);
+
+  vf = g_new0 (VideoFrame, 1);
+  vf->src = (GstBitflowSrc *) gst_object_ref (src);
+  vf->circ_handle = *circ_handle;
+
+  return gst_buffer_new_wrapped_full ((GstMemoryFlags)
+      GST_MEMORY_FLAG_READONLY, circ_handle->pBufData, size, 0, size, vf,
+      (GDestroyNotify) buffer_release);
+}
+
 static GstBuffer *
 gst_bitflowsrc_create_buffer_from_circ_handle (GstBitflowSrc * src,
     BiCirHandle * circ_handle)
@@ -535,14 +713,13 @@ gst_bitflowsrc_create_buffer_from_circ_handle (GstBitflowSrc * src,
       circ_handle->HiResTimeStamp.hour, circ_handle->HiResTimeStamp.min,
       circ_handle->HiResTimeStamp.sec, circ_handle->HiResTimeStamp.usec);
 
-  /* TODO: use orc_memcpy */
   if (src->gst_stride == src->bf_stride) {
-    memcpy (minfo.data, ((guint8 *) circ_handle->pBufData), minfo.size);
+    orc_memcpy (minfo.data, ((guint8 *) circ_handle->pBufData), minfo.size);
   } else {
     int i;
     GST_LOG_OBJECT (src, "Image strides not identical, copy will be slower.");
     for (i = 0; i < src->height; i++) {
-      memcpy (minfo.data + i * src->gst_stride,
+      orc_memcpy (minfo.data + i * src->gst_stride,
           ((guint8 *) circ_handle->pBufData) +
           i * src->bf_stride, src->bf_stride);
     }
@@ -558,9 +735,9 @@ gst_bitflowsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   GstBitflowSrc *src = GST_BITFLOW_SRC (psrc);
   BFRC ret;
   BiCirHandle circ_handle;
-  guint32 dropped_frames;
+  gint32 dropped_frames;
   GstClock *clock;
-  GstClockTime clock_time;
+  GstClockTime clock_time, hw_time, now;
 
   GST_LOG_OBJECT (src, "create");
 
@@ -575,35 +752,51 @@ gst_bitflowsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   }
 
   clock = gst_element_get_clock (GST_ELEMENT (src));
-  clock_time = gst_clock_get_time (clock);
+  clock_time = now = gst_clock_get_time (clock);
   gst_object_unref (clock);
 
   /* check for dropped frames and disrupted signal */
-  dropped_frames = (circ_handle.FrameCount - src->last_frame_count) - 1;
+  dropped_frames =
+      (gint32) (circ_handle.FrameCount - src->last_frame_count) - 1;
   if (dropped_frames > 0) {
-    src->total_dropped_frames += dropped_frames;
-    GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-        src->total_dropped_frames);
+    gst_vision_stats_add_dropped (&src->stats, dropped_frames);
+    GST_WARNING_OBJECT (src, "Dropped %d frames", dropped_frames);
   } else if (dropped_frames < 0) {
     GST_WARNING_OBJECT (src, "Frame count non-monotonic, signal disrupted?");
   }
   src->last_frame_count = circ_handle.FrameCount;
 
-  /* create GstBuffer then release circ buffer back to acquisition */
-  *buf = gst_bitflowsrc_create_buffer_from_circ_handle (src, &circ_handle);
-  ret =
-      BiCirStatusSet (src->board, &src->buffer_array, circ_handle, BIAVAILABLE);
-  if (ret != BI_OK) {
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        ("Failed to release buffer: %s", gst_bitflowsrc_get_error_string (src,
-                ret)), (NULL));
-    return GST_FLOW_ERROR;
+  *buf = gst_bitflowsrc_wrap_circ_handle (src, &circ_handle);
+  if (*buf == NULL) {
+    /* create GstBuffer then release circ buffer back to acquisition */
+    *buf = gst_bitflowsrc_create_buffer_from_circ_handle (src, &circ_handle);
+    ret =
+        BiCirStatusSet (src->board, &src->buffer_array, circ_handle,
+        BIAVAILABLE);
+    if (ret != BI_OK) {
+      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+          ("Failed to release buffer: %s",
+              gst_bitflowsrc_get_error_string (src, ret)), (NULL));
+      gst_buffer_unref (*buf);
+      *buf = NULL;
+      return GST_FLOW_ERROR;
+    }
   }
 
-  /* TODO: understand why timestamps for circ_handle are sometimes 0 */
-  //GST_BUFFER_TIMESTAMP (*buf) =
-  //    GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-  //    src->acq_start_time + circ_handle.HiResTimeStamp.totalSec * GST_SECOND);
+  /* map the high resolution hardware timestamp onto the pipeline clock
+   * through a fit over recent frames, so drift between the two is
+   * corrected. It is sometimes 0, so fall back to the receive time */
+  hw_time = (GstClockTime) (circ_handle.HiResTimeStamp.totalSec * GST_SECOND);
+  if (hw_time != 0) {
+    guint64 num_resets = src->clock_mapper.num_resets;
+    clock_time = gst_vision_clock_mapper_add_sample (&src->clock_mapper,
+        hw_time, clock_time);
+    if (src->clock_mapper.num_resets != num_resets) {
+      GST_DEBUG_OBJECT (src, "Hardware timestamps jumped, resetting mapping");
+    }
+  } else {
+    GST_LOG_OBJECT (src, "Invalid hardware timestamp, using clock time");
+  }
   GST_BUFFER_TIMESTAMP (*buf) =
       GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
       clock_time);
@@ -617,6 +810,10 @@ gst_bitflowsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     return GST_FLOW_FLUSHING;
   }
 
+  gst_vision_stats_add_delivered (&src->stats,
+      gst_vision_stats_latency (clock_time, now));
+  gst_vision_stats_post (&src->stats, GST_ELEMENT (src), now, NULL);
+
   return GST_FLOW_OK;
 }
 
@@ -24,6 +24,9 @@
 
 #include "BiApi.h"
 
+#include "common/visionclockmapper.h"
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_BITFLOW_SRC   (gst_bitflowsrc_get_type())
@@ -49,10 +52,24 @@ struct _GstBitflowSrc
   guint num_capture_buffers;
   guint board_index;
   gint timeout;
+  gboolean zero_copy;
+  guint reserve_buffers;
+
+  /* circular buffers held downstream in zero-copy mode, protected by mutex.
+   * A board stopped while buffers are outstanding is closed by the last
+   * buffer released. */
+  GMutex mutex;
+  guint num_outstanding;
+  gboolean acquiring;
+  Bd pending_board;
+  BIBA pending_buffer_array;
+
+  /* maps the high resolution hardware timestamp onto the pipeline clock */
+  GstVisionClockMapper clock_mapper;
 
   GstClockTime acq_start_time;
   guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  GstVisionStats stats;
 
   GstCaps *caps;
   gint height;
@@ -28,6 +28,10 @@
  * ]|
  * Outputs test video on the default EDT Camera Link channel.
  * </refsect2>
+ *
+ * Frames are queued to the simulator and sent asynchronously, up to
+ * #GstEdtPdvSink:queue-depth at a time. Upstream is offered the DMA ring
+ * buffers through a buffer pool so frames can be produced in place.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -48,6 +52,7 @@ static void gst_edt_pdv_sink_set_property (GObject * object,
 static void gst_edt_pdv_sink_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
 static void gst_edt_pdv_sink_dispose (GObject * object);
+static void gst_edt_pdv_sink_finalize (GObject * object);
 
 /* GstBaseSink prototypes */
 static gboolean gst_edt_pdv_sink_start (GstBaseSink * basesink);
@@ -58,12 +63,28 @@ static gboolean gst_edt_pdv_sink_set_caps (GstBaseSink * basesink,
     GstCaps * caps);
 static GstFlowReturn gst_edt_pdv_sink_render (GstBaseSink * basesink,
     GstBuffer * buffer);
+static gboolean gst_edt_pdv_sink_unlock (GstBaseSink * basesink);
+static gboolean gst_edt_pdv_sink_unlock_stop (GstBaseSink * basesink);
+static gboolean gst_edt_pdv_sink_propose_allocation (GstBaseSink * basesink,
+    GstQuery * query);
+
+static void gst_edt_pdv_sink_destroy_ring (GstEdtPdvSink * pdvsink,
+    gboolean close_device);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_QUEUE_DEPTH,
+  PROP_FRAMES_SENT,
+  PROP_UNDERRUNS,
+  PROP_LATE_FRAMES
 };
 
+#define DEFAULT_PROP_QUEUE_DEPTH 3
+
+/* longest a DMA wait blocks, so a stop is noticed even if nothing is sent */
+#define GST_EDT_PDV_SINK_DMA_TIMEOUT_MS 1000
+
 
 /* pad templates */
 
@@ -82,6 +103,167 @@ GST_DEBUG_CATEGORY_STATIC (edtpdvsink_debug);
 
 G_DEFINE_TYPE (GstEdtPdvSink, gst_edt_pdv_sink, GST_TYPE_BASE_SINK);
 
+/* Buffer pool whose buffers are the EDT ring buffers themselves. The driver
+ * always starts the next buffer in the ring, so buffers are handed out in
+ * ring order and only once their previous DMA has completed. When the device
+ * is closed while upstream still holds buffers, the pool takes over the
+ * device and closes it once the last buffer has been released. */
+typedef struct
+{
+  GstBufferPool parent;
+  GstEdtPdvSink *sink;
+  PdvDev *dev;
+} GstEdtPdvSinkPool;
+
+typedef struct
+{
+  GstBufferPoolClass parent_class;
+} GstEdtPdvSinkPoolClass;
+
+#define GST_TYPE_EDT_PDV_SINK_POOL (gst_edt_pdv_sink_pool_get_type())
+#define GST_EDT_PDV_SINK_POOL(obj) ((GstEdtPdvSinkPool *) (obj))
+
+static GType gst_edt_pdv_sink_pool_get_type (void);
+
+G_DEFINE_TYPE (GstEdtPdvSinkPool, gst_edt_pdv_sink_pool,
+    GST_TYPE_BUFFER_POOL);
+
+static GQuark gst_edt_pdv_sink_slot_quark;
+
+static gboolean
+gst_edt_pdv_sink_pool_start (GstBufferPool * bpool)
+{
+  /* buffers already exist as ring buffers, nothing to preallocate */
+  return TRUE;
+}
+
+static gboolean
+gst_edt_pdv_sink_pool_stop (GstBufferPool * bpool)
+{
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_edt_pdv_sink_pool_acquire_buffer (GstBufferPool * bpool,
+    GstBuffer ** buffer, GstBufferPoolAcquireParams * params)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK_POOL (bpool)->sink;
+  gboolean dontwait = params &&
+      (params->flags & GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT);
+  int index;
+
+  g_mutex_lock (&pdvsink->mutex);
+  while (TRUE) {
+    if (GST_BUFFER_POOL_IS_FLUSHING (bpool) || bpool != pdvsink->pool) {
+      g_mutex_unlock (&pdvsink->mutex);
+      return GST_FLOW_FLUSHING;
+    }
+    index = pdvsink->next_fill;
+    if (pdvsink->slot_states[index] == GST_EDT_PDV_SINK_SLOT_FREE &&
+        pdvsink->slot_buffers[index]) {
+      break;
+    }
+    if (dontwait) {
+      g_mutex_unlock (&pdvsink->mutex);
+      return GST_FLOW_EOS;
+    }
+    g_cond_wait (&pdvsink->cond, &pdvsink->mutex);
+  }
+
+  pdvsink->slot_states[index] = GST_EDT_PDV_SINK_SLOT_FILLING;
+  pdvsink->next_fill = (index + 1) % pdvsink->n_buffers;
+  *buffer = pdvsink->slot_buffers[index];
+  pdvsink->slot_buffers[index] = NULL;
+  g_mutex_unlock (&pdvsink->mutex);
+
+  GST_LOG_OBJECT (pdvsink, "Handing out ring buffer %d", index);
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_edt_pdv_sink_pool_release_buffer (GstBufferPool * bpool,
+    GstBuffer * buffer)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK_POOL (bpool)->sink;
+  int index = GPOINTER_TO_INT (gst_mini_object_get_qdata (GST_MINI_OBJECT
+          (buffer), gst_edt_pdv_sink_slot_quark)) - 1;
+  int i;
+
+  g_mutex_lock (&pdvsink->mutex);
+  if (bpool != pdvsink->pool) {
+    /* ring was destroyed while upstream held this buffer */
+    g_mutex_unlock (&pdvsink->mutex);
+    gst_buffer_unref (buffer);
+    return;
+  }
+  pdvsink->slot_buffers[index] = buffer;
+
+  /* a queued buffer is freed by the completion thread, anything still
+   * filling was never rendered (dropped or flushed) */
+  if (pdvsink->slot_states[index] == GST_EDT_PDV_SINK_SLOT_FILLING) {
+    pdvsink->slot_states[index] = GST_EDT_PDV_SINK_SLOT_FREE;
+
+    /* once nothing is held upstream, realign the pool with the ring so
+     * that buffers skipped by a drop don't force render to copy */
+    for (i = 0; i < pdvsink->n_buffers; ++i) {
+      if (pdvsink->slot_states[i] == GST_EDT_PDV_SINK_SLOT_FILLING)
+        break;
+    }
+    if (i == pdvsink->n_buffers)
+      pdvsink->next_fill = pdvsink->cur_buffer;
+  }
+  g_cond_broadcast (&pdvsink->cond);
+  g_mutex_unlock (&pdvsink->mutex);
+}
+
+static void
+gst_edt_pdv_sink_pool_flush_start (GstBufferPool * bpool)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK_POOL (bpool)->sink;
+
+  g_mutex_lock (&pdvsink->mutex);
+  g_cond_broadcast (&pdvsink->cond);
+  g_mutex_unlock (&pdvsink->mutex);
+}
+
+static void
+gst_edt_pdv_sink_pool_finalize (GObject * object)
+{
+  GstEdtPdvSinkPool *pool = GST_EDT_PDV_SINK_POOL (object);
+
+  if (pool->dev) {
+    GST_DEBUG_OBJECT (pool->sink, "Last buffer of old pool released, "
+        "closing device");
+    pdv_close (pool->dev);
+  }
+
+  gst_object_unref (pool->sink);
+
+  G_OBJECT_CLASS (gst_edt_pdv_sink_pool_parent_class)->finalize (object);
+}
+
+static void
+gst_edt_pdv_sink_pool_class_init (GstEdtPdvSinkPoolClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBufferPoolClass *pool_class = GST_BUFFER_POOL_CLASS (klass);
+
+  gobject_class->finalize = gst_edt_pdv_sink_pool_finalize;
+
+  pool_class->start = gst_edt_pdv_sink_pool_start;
+  pool_class->stop = gst_edt_pdv_sink_pool_stop;
+  pool_class->acquire_buffer = gst_edt_pdv_sink_pool_acquire_buffer;
+  pool_class->release_buffer = gst_edt_pdv_sink_pool_release_buffer;
+  pool_class->flush_start = gst_edt_pdv_sink_pool_flush_start;
+}
+
+static void
+gst_edt_pdv_sink_pool_init (GstEdtPdvSinkPool * pool)
+{
+  pool->dev = NULL;
+}
+
 static void
 gst_edt_pdv_sink_class_init (GstEdtPdvSinkClass * klass)
 {
@@ -95,6 +277,7 @@ gst_edt_pdv_sink_class_init (GstEdtPdvSinkClass * klass)
   gobject_class->set_property = gst_edt_pdv_sink_set_property;
   gobject_class->get_property = gst_edt_pdv_sink_get_property;
   gobject_class->dispose = gst_edt_pdv_sink_dispose;
+  gobject_class->finalize = gst_edt_pdv_sink_finalize;
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_edt_pdv_sink_sink_template));
@@ -109,6 +292,37 @@ gst_edt_pdv_sink_class_init (GstEdtPdvSinkClass * klass)
   gstbasesink_class->set_caps = GST_DEBUG_FUNCPTR (gst_edt_pdv_sink_set_caps);
   gstbasesink_class->get_caps = GST_DEBUG_FUNCPTR (gst_edt_pdv_sink_get_caps);
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_edt_pdv_sink_render);
+  gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_edt_pdv_sink_unlock);
+  gstbasesink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_edt_pdv_sink_unlock_stop);
+  gstbasesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_edt_pdv_sink_propose_allocation);
+
+  gst_edt_pdv_sink_slot_quark =
+      g_quark_from_static_string ("GstEdtPdvSinkSlot");
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_int ("queue-depth", "Queue depth",
+          "Number of DMA ring buffers, frames are output asynchronously "
+          "until this many are waiting to be sent", 2, G_MAXINT,
+          DEFAULT_PROP_QUEUE_DEPTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_FRAMES_SENT,
+      g_param_spec_uint64 ("frames-sent", "Frames sent",
+          "Number of frames the simulator has finished sending", 0,
+          G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_UNDERRUNS,
+      g_param_spec_uint64 ("underruns", "Underruns",
+          "Number of times the output queue ran empty for longer than a "
+          "frame before the next frame arrived", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATE_FRAMES,
+      g_param_spec_uint64 ("late-frames", "Late frames",
+          "Number of frames queued for output after their end time", 0,
+          G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void
@@ -116,8 +330,21 @@ gst_edt_pdv_sink_init (GstEdtPdvSink * pdvsink)
 {
   pdvsink->dev = NULL;
   pdvsink->buffers = NULL;
-  pdvsink->n_buffers = 2;
+  pdvsink->n_buffers = DEFAULT_PROP_QUEUE_DEPTH;
   pdvsink->cur_buffer = 0;
+  pdvsink->next_fill = 0;
+  pdvsink->next_done = 0;
+  pdvsink->num_queued = 0;
+  pdvsink->slot_states = NULL;
+  pdvsink->slot_buffers = NULL;
+  pdvsink->pool = NULL;
+  pdvsink->completion_thread = NULL;
+  pdvsink->completion_stop = FALSE;
+  pdvsink->stop_requested = FALSE;
+  pdvsink->idle_since = 0;
+
+  g_mutex_init (&pdvsink->mutex);
+  g_cond_init (&pdvsink->cond);
 
   /* TODO: put these in properties */
   pdvsink->unit = 0;
@@ -134,6 +361,9 @@ gst_edt_pdv_sink_set_property (GObject * object, guint property_id,
   pdvsink = GST_EDT_PDV_SINK (object);
 
   switch (property_id) {
+    case PROP_QUEUE_DEPTH:
+      pdvsink->n_buffers = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -150,6 +380,24 @@ gst_edt_pdv_sink_get_property (GObject * object, guint property_id,
   pdvsink = GST_EDT_PDV_SINK (object);
 
   switch (property_id) {
+    case PROP_QUEUE_DEPTH:
+      g_value_set_int (value, pdvsink->n_buffers);
+      break;
+    case PROP_FRAMES_SENT:
+      g_mutex_lock (&pdvsink->mutex);
+      g_value_set_uint64 (value, pdvsink->total_sent);
+      g_mutex_unlock (&pdvsink->mutex);
+      break;
+    case PROP_UNDERRUNS:
+      g_mutex_lock (&pdvsink->mutex);
+      g_value_set_uint64 (value, pdvsink->total_underruns);
+      g_mutex_unlock (&pdvsink->mutex);
+      break;
+    case PROP_LATE_FRAMES:
+      g_mutex_lock (&pdvsink->mutex);
+      g_value_set_uint64 (value, pdvsink->total_late);
+      g_mutex_unlock (&pdvsink->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -169,6 +417,62 @@ gst_edt_pdv_sink_dispose (GObject * object)
   G_OBJECT_CLASS (gst_edt_pdv_sink_parent_class)->dispose (object);
 }
 
+void
+gst_edt_pdv_sink_finalize (GObject * object)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK (object);
+
+  g_mutex_clear (&pdvsink->mutex);
+  g_cond_clear (&pdvsink->cond);
+
+  G_OBJECT_CLASS (gst_edt_pdv_sink_parent_class)->finalize (object);
+}
+
+/* Wait for each started ring buffer to be sent, in ring order, and make it
+ * available to be filled again. When stopping, a wait that times out aborts
+ * the DMA of the buffers still queued. */
+static gpointer
+gst_edt_pdv_sink_completion_thread (GstEdtPdvSink * pdvsink)
+{
+  int timeouts;
+
+  g_mutex_lock (&pdvsink->mutex);
+  while (TRUE) {
+    while (pdvsink->num_queued == 0 && !pdvsink->completion_stop)
+      g_cond_wait (&pdvsink->cond, &pdvsink->mutex);
+    if (pdvsink->num_queued == 0)
+      break;
+    g_mutex_unlock (&pdvsink->mutex);
+
+    timeouts = edt_timeouts (pdvsink->dev);
+    edt_wait_for_buffers (pdvsink->dev, 1);
+
+    g_mutex_lock (&pdvsink->mutex);
+    if (edt_timeouts (pdvsink->dev) != timeouts) {
+      if (pdvsink->completion_stop) {
+        GST_WARNING_OBJECT (pdvsink, "Device stopped sending, aborting DMA "
+            "of %d ring buffers", pdvsink->num_queued);
+        edt_abort_dma (pdvsink->dev);
+        break;
+      }
+      GST_DEBUG_OBJECT (pdvsink, "Still waiting for ring buffer %d",
+          pdvsink->next_done);
+      continue;
+    }
+    GST_LOG_OBJECT (pdvsink, "Ring buffer %d sent", pdvsink->next_done);
+    pdvsink->slot_states[pdvsink->next_done] = GST_EDT_PDV_SINK_SLOT_FREE;
+    pdvsink->next_done = (pdvsink->next_done + 1) % pdvsink->n_buffers;
+    pdvsink->num_queued--;
+    pdvsink->total_sent++;
+    if (pdvsink->num_queued == 0)
+      pdvsink->idle_since = g_get_monotonic_time ();
+    g_cond_broadcast (&pdvsink->cond);
+  }
+  g_mutex_unlock (&pdvsink->mutex);
+
+  return NULL;
+}
+
 gboolean
 gst_edt_pdv_sink_start (GstBaseSink * basesink)
 {
@@ -190,8 +494,7 @@ gst_edt_pdv_sink_start (GstBaseSink * basesink)
     pdv_close (pdvsink->dev);
   }
 
-  /* FIXME: set timeout to wait forever, shouldn't do this of course */
-  edt_set_wtimeout (pdvsink->dev, 0);
+  edt_set_wtimeout (pdvsink->dev, GST_EDT_PDV_SINK_DMA_TIMEOUT_MS);
   edt_set_rtimeout (pdvsink->dev, 0);
 
   pdv_flush_fifo (pdvsink->dev);
@@ -200,6 +503,10 @@ gst_edt_pdv_sink_start (GstBaseSink * basesink)
   pdv_cls_set_datacnt (pdvsink->dev, 0);
 
   pdvsink->cur_buffer = 0;
+  pdvsink->idle_since = 0;
+  pdvsink->total_sent = 0;
+  pdvsink->total_underruns = 0;
+  pdvsink->total_late = 0;
 
   return TRUE;
 }
@@ -209,12 +516,87 @@ gst_edt_pdv_sink_stop (GstBaseSink * basesink)
 {
   GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK (basesink);
 
-  if (pdvsink->dev)
-    pdv_close (pdvsink->dev);
+  gst_edt_pdv_sink_destroy_ring (pdvsink, TRUE);
 
   return TRUE;
 }
 
+/* Number of ring buffers handed out through the pool and not released yet,
+ * must be called with mutex held */
+static int
+gst_edt_pdv_sink_num_outstanding_unlocked (GstEdtPdvSink * pdvsink)
+{
+  int i, num = 0;
+
+  for (i = 0; i < pdvsink->n_buffers && pdvsink->slot_buffers; ++i) {
+    if (pdvsink->slot_buffers[i] == NULL)
+      num++;
+  }
+
+  return num;
+}
+
+/* Let queued frames finish sending, unless the device stops sending for a
+ * DMA timeout, then free the ring and its pool. Closing the device frees the
+ * ring memory, so if upstream still holds pool buffers the old pool closes
+ * it once they have all been released. */
+void
+gst_edt_pdv_sink_destroy_ring (GstEdtPdvSink * pdvsink, gboolean close_device)
+{
+  GstBufferPool *pool;
+  int i, num_outstanding;
+
+  if (pdvsink->completion_thread) {
+    g_mutex_lock (&pdvsink->mutex);
+    pdvsink->completion_stop = TRUE;
+    g_cond_broadcast (&pdvsink->cond);
+    g_mutex_unlock (&pdvsink->mutex);
+    g_thread_join (pdvsink->completion_thread);
+    pdvsink->completion_thread = NULL;
+    pdvsink->completion_stop = FALSE;
+  }
+
+  g_mutex_lock (&pdvsink->mutex);
+  num_outstanding = gst_edt_pdv_sink_num_outstanding_unlocked (pdvsink);
+  for (i = 0; i < pdvsink->n_buffers && pdvsink->slot_buffers; ++i) {
+    if (pdvsink->slot_buffers[i]) {
+      gst_buffer_unref (pdvsink->slot_buffers[i]);
+    }
+  }
+  g_free (pdvsink->slot_states);
+  g_free (pdvsink->slot_buffers);
+  pdvsink->slot_states = NULL;
+  pdvsink->slot_buffers = NULL;
+  pdvsink->buffers = NULL;
+  pdvsink->cur_buffer = 0;
+  pdvsink->next_fill = 0;
+  pdvsink->next_done = 0;
+  pdvsink->num_queued = 0;
+  pdvsink->idle_since = 0;
+
+  /* outstanding pool buffers are freed when upstream releases them */
+  pool = pdvsink->pool;
+  pdvsink->pool = NULL;
+  g_cond_broadcast (&pdvsink->cond);
+  g_mutex_unlock (&pdvsink->mutex);
+
+  if (close_device && pdvsink->dev) {
+    if (pool && num_outstanding > 0) {
+      GST_DEBUG_OBJECT (pdvsink, "%d ring buffers still held upstream, "
+          "closing device when they are released", num_outstanding);
+      GST_EDT_PDV_SINK_POOL (pool)->dev = pdvsink->dev;
+    } else {
+      pdv_close (pdvsink->dev);
+    }
+    pdvsink->dev = NULL;
+  }
+
+  if (pool) {
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
+  }
+}
+
 GstCaps *
 gst_edt_pdv_sink_get_caps (GstBaseSink * basesink, GstCaps * filter_caps)
 {
@@ -257,24 +639,79 @@ gst_edt_pdv_sink_set_caps (GstBaseSink * basesink, GstCaps * caps)
   int buffer_size;
   gint depth;
   int taps;
+  int i;
   GstVideoInfo vinfo;
 
   GST_DEBUG_OBJECT (pdvsink, "Caps being set");
 
   gst_video_info_from_caps (&vinfo, caps);
 
+  /* the ring is reallocated below, which frees the memory of any pool
+   * buffer upstream still holds */
+  g_mutex_lock (&pdvsink->mutex);
+  if (gst_edt_pdv_sink_num_outstanding_unlocked (pdvsink) > 0) {
+    g_mutex_unlock (&pdvsink->mutex);
+    if (gst_video_info_is_equal (&vinfo, &pdvsink->vinfo)) {
+      GST_DEBUG_OBJECT (pdvsink, "Caps unchanged, keeping ring buffers");
+      return TRUE;
+    }
+    GST_ELEMENT_ERROR (pdvsink, CORE, NEGOTIATION,
+        ("Can't change caps while upstream holds ring buffers"), (NULL));
+    return FALSE;
+  }
+  g_mutex_unlock (&pdvsink->mutex);
+
+  /* let frames already queued go out before reconfiguring the ring */
+  gst_edt_pdv_sink_destroy_ring (pdvsink, FALSE);
+
   depth = GST_VIDEO_INFO_COMP_DEPTH (&vinfo, 0);
-  buffer_size = vinfo.height * pdv_bytes_per_line (vinfo.width, depth);
+  pdvsink->pdv_stride = pdv_bytes_per_line (vinfo.width, depth);
+  buffer_size = vinfo.height * pdvsink->pdv_stride;
+  pdvsink->buffer_size = buffer_size;
+  pdvsink->vinfo = vinfo;
 
   GST_DEBUG_OBJECT (pdvsink,
       "Configuring EDT ring buffer with %d buffers each of size %d",
       pdvsink->n_buffers, buffer_size);
 
-  /* we'll use just two buffers and ping pong between them */
+  /* frames are queued and sent asynchronously, in ring order */
   edt_configure_ring_buffers (pdvsink->dev, buffer_size, pdvsink->n_buffers,
       EDT_WRITE, NULL);
 
+  g_mutex_lock (&pdvsink->mutex);
   pdvsink->buffers = edt_buffer_addresses (pdvsink->dev);
+  pdvsink->slot_states = g_new0 (GstEdtPdvSinkSlotState, pdvsink->n_buffers);
+  pdvsink->slot_buffers = g_new0 (GstBuffer *, pdvsink->n_buffers);
+  for (i = 0; i < pdvsink->n_buffers; ++i) {
+    gsize size = MIN ((gsize) buffer_size, GST_VIDEO_INFO_SIZE (&vinfo));
+
+    pdvsink->slot_buffers[i] = gst_buffer_new ();
+    gst_buffer_append_memory (pdvsink->slot_buffers[i],
+        gst_memory_new_wrapped ((GstMemoryFlags) 0, pdvsink->buffers[i],
+            buffer_size, 0, size, NULL, NULL));
+    gst_mini_object_set_qdata (GST_MINI_OBJECT (pdvsink->slot_buffers[i]),
+        gst_edt_pdv_sink_slot_quark, GINT_TO_POINTER (i + 1), NULL);
+    pdvsink->slot_states[i] = GST_EDT_PDV_SINK_SLOT_FREE;
+  }
+
+  /* upstream can only write directly into ring buffers when they are laid
+   * out the way GstVideoInfo expects, otherwise render copies */
+  if (pdvsink->pdv_stride == GST_VIDEO_INFO_PLANE_STRIDE (&vinfo, 0) &&
+      buffer_size >= (int) GST_VIDEO_INFO_SIZE (&vinfo)) {
+    GstEdtPdvSinkPool *pool = (GstEdtPdvSinkPool *)
+        g_object_new (GST_TYPE_EDT_PDV_SINK_POOL, NULL);
+    pool->sink = (GstEdtPdvSink *) gst_object_ref (pdvsink);
+    pdvsink->pool = GST_BUFFER_POOL (pool);
+  } else {
+    GST_DEBUG_OBJECT (pdvsink, "Ring stride %d differs from video stride %d, "
+        "frames will be copied", pdvsink->pdv_stride,
+        GST_VIDEO_INFO_PLANE_STRIDE (&vinfo, 0));
+  }
+  g_mutex_unlock (&pdvsink->mutex);
+
+  pdvsink->completion_thread =
+      g_thread_new ("edtpdvsink-completion",
+      (GThreadFunc) gst_edt_pdv_sink_completion_thread, pdvsink);
 
   taps = pdvsink->dev->dd_p->cls.taps;
 
@@ -300,21 +737,187 @@ gst_edt_pdv_sink_set_caps (GstBaseSink * basesink, GstCaps * caps)
   return TRUE;
 }
 
+gboolean
+gst_edt_pdv_sink_propose_allocation (GstBaseSink * basesink, GstQuery * query)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK (basesink);
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstVideoInfo info;
+  GstCaps *caps;
+  gboolean need_pool;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (caps == NULL || !gst_video_info_from_caps (&info, caps)) {
+    return FALSE;
+  }
+
+  g_mutex_lock (&pdvsink->mutex);
+  if (pdvsink->pool && GST_VIDEO_INFO_FORMAT (&info) ==
+      GST_VIDEO_INFO_FORMAT (&pdvsink->vinfo) &&
+      GST_VIDEO_INFO_SIZE (&info) == GST_VIDEO_INFO_SIZE (&pdvsink->vinfo)) {
+    pool = (GstBufferPool *) gst_object_ref (pdvsink->pool);
+  }
+  g_mutex_unlock (&pdvsink->mutex);
+
+  if (pool == NULL) {
+    GST_DEBUG_OBJECT (pdvsink, "Not offering ring buffer pool, will copy");
+    return TRUE;
+  }
+
+  if (need_pool && !gst_buffer_pool_is_active (pool)) {
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, info.size, 0,
+        pdvsink->n_buffers);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_WARNING_OBJECT (pdvsink, "Failed to configure ring buffer pool");
+    }
+  }
+
+  gst_query_add_allocation_pool (query, need_pool ? pool : NULL, info.size,
+      0, pdvsink->n_buffers);
+  gst_object_unref (pool);
+
+  return TRUE;
+}
+
+/* Count frames whose end time has already passed by the time they are
+ * queued, the simulator will send them late */
+static void
+gst_edt_pdv_sink_check_late (GstEdtPdvSink * pdvsink, GstBuffer * buffer)
+{
+  GstBaseSink *basesink = GST_BASE_SINK (pdvsink);
+  GstClock *clock;
+  GstClockTime running_time, end_time;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer))
+    return;
+
+  running_time = gst_segment_to_running_time (&basesink->segment,
+      GST_FORMAT_TIME, GST_BUFFER_PTS (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return;
+
+  clock = gst_element_get_clock (GST_ELEMENT (pdvsink));
+  if (clock == NULL)
+    return;
+
+  end_time = running_time + gst_element_get_base_time (GST_ELEMENT (pdvsink))
+      + gst_base_sink_get_latency (basesink);
+  if (GST_BUFFER_DURATION_IS_VALID (buffer))
+    end_time += GST_BUFFER_DURATION (buffer);
+
+  if (gst_clock_get_time (clock) > end_time) {
+    g_mutex_lock (&pdvsink->mutex);
+    pdvsink->total_late++;
+    g_mutex_unlock (&pdvsink->mutex);
+  }
+  gst_object_unref (clock);
+}
+
 GstFlowReturn
 gst_edt_pdv_sink_render (GstBaseSink * basesink, GstBuffer * buffer)
 {
   GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK (basesink);
   GstMapInfo minfo;
+  GstClockTime frame_duration = GST_CLOCK_TIME_NONE;
+  int index = -1;
+  int target;
 
   GST_LOG_OBJECT (pdvsink, "Rendering buffer");
 
-  gst_buffer_map (buffer, &minfo, GST_MAP_WRITE);
-  /* TODO: fix stride? */
-  memcpy (pdvsink->buffers[pdvsink->cur_buffer], minfo.data, minfo.size);
-  gst_buffer_unmap (buffer, &minfo);
+  if (pdvsink->pool && buffer->pool == pdvsink->pool) {
+    index = GPOINTER_TO_INT (gst_mini_object_get_qdata (GST_MINI_OBJECT
+            (buffer), gst_edt_pdv_sink_slot_quark)) - 1;
+  }
 
+  /* the driver sends the next ring buffer, wait until it is ours or has
+   * been sent and can be copied into */
+  g_mutex_lock (&pdvsink->mutex);
+  target = pdvsink->cur_buffer;
+  while (target != index &&
+      pdvsink->slot_states[target] != GST_EDT_PDV_SINK_SLOT_FREE &&
+      !pdvsink->stop_requested) {
+    GST_LOG_OBJECT (pdvsink, "Waiting for ring buffer %d", target);
+    g_cond_wait (&pdvsink->cond, &pdvsink->mutex);
+  }
+  if (pdvsink->stop_requested) {
+    g_mutex_unlock (&pdvsink->mutex);
+    GST_DEBUG_OBJECT (pdvsink, "stop requested, flushing");
+    return GST_FLOW_FLUSHING;
+  }
+  pdvsink->slot_states[target] = GST_EDT_PDV_SINK_SLOT_FILLING;
+  g_mutex_unlock (&pdvsink->mutex);
+
+  if (target != index) {
+    if (index >= 0) {
+      GST_DEBUG_OBJECT (pdvsink, "Buffer %d is out of ring order, copying "
+          "into %d", index, target);
+    }
+
+    gst_buffer_map (buffer, &minfo, GST_MAP_READ);
+    if (minfo.size == (gsize) pdvsink->buffer_size) {
+      memcpy (pdvsink->buffers[target], minfo.data, minfo.size);
+    } else {
+      int i;
+      int gst_stride = GST_VIDEO_INFO_PLANE_STRIDE (&pdvsink->vinfo, 0);
+      int row_size = MIN (gst_stride, pdvsink->pdv_stride);
+      for (i = 0; i < GST_VIDEO_INFO_HEIGHT (&pdvsink->vinfo); ++i) {
+        memcpy (pdvsink->buffers[target] + i * pdvsink->pdv_stride,
+            minfo.data + i * gst_stride, row_size);
+      }
+    }
+    gst_buffer_unmap (buffer, &minfo);
+  }
+
+  gst_edt_pdv_sink_check_late (pdvsink, buffer);
+
+  if (GST_BUFFER_DURATION_IS_VALID (buffer)) {
+    frame_duration = GST_BUFFER_DURATION (buffer);
+  } else if (GST_VIDEO_INFO_FPS_N (&pdvsink->vinfo) > 0) {
+    frame_duration = gst_util_uint64_scale_int (GST_SECOND,
+        GST_VIDEO_INFO_FPS_D (&pdvsink->vinfo),
+        GST_VIDEO_INFO_FPS_N (&pdvsink->vinfo));
+  }
+
+  g_mutex_lock (&pdvsink->mutex);
+  if (pdvsink->num_queued == 0 && pdvsink->idle_since > 0 &&
+      GST_CLOCK_TIME_IS_VALID (frame_duration) &&
+      (g_get_monotonic_time () - pdvsink->idle_since) * GST_USECOND >
+      frame_duration) {
+    /* simulator sent everything and had nothing to send for more than a
+     * frame, an idle gap shorter than that is just upstream pacing */
+    pdvsink->total_underruns++;
+  }
+  pdvsink->slot_states[target] = GST_EDT_PDV_SINK_SLOT_QUEUED;
   edt_start_buffers (pdvsink->dev, 1);
-  pdvsink->cur_buffer = (pdvsink->cur_buffer + 1) % pdvsink->n_buffers;
+  pdvsink->cur_buffer = (target + 1) % pdvsink->n_buffers;
+  pdvsink->num_queued++;
+  g_cond_broadcast (&pdvsink->cond);
+  g_mutex_unlock (&pdvsink->mutex);
 
   return GST_FLOW_OK;
 }
+
+gboolean
+gst_edt_pdv_sink_unlock (GstBaseSink * basesink)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK (basesink);
+
+  g_mutex_lock (&pdvsink->mutex);
+  pdvsink->stop_requested = TRUE;
+  g_cond_broadcast (&pdvsink->cond);
+  g_mutex_unlock (&pdvsink->mutex);
+
+  return TRUE;
+}
+
+gboolean
+gst_edt_pdv_sink_unlock_stop (GstBaseSink * basesink)
+{
+  GstEdtPdvSink *pdvsink = GST_EDT_PDV_SINK (basesink);
+
+  pdvsink->stop_requested = FALSE;
+
+  return TRUE;
+}
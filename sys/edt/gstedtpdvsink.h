@@ -21,6 +21,7 @@
 #define _GST_EDT_PDV_SINK_H_
 
 #include <gst/base/gstbasesink.h>
+#include <gst/video/video.h>
 #include <edtinc.h>
 
 G_BEGIN_DECLS
@@ -34,6 +35,12 @@ G_BEGIN_DECLS
 typedef struct _GstEdtPdvSink GstEdtPdvSink;
 typedef struct _GstEdtPdvSinkClass GstEdtPdvSinkClass;
 
+typedef enum {
+    GST_EDT_PDV_SINK_SLOT_FREE,     /* sent, can be filled again */
+    GST_EDT_PDV_SINK_SLOT_FILLING,  /* handed to upstream through the pool */
+    GST_EDT_PDV_SINK_SLOT_QUEUED    /* started, waiting for DMA to complete */
+} GstEdtPdvSinkSlotState;
+
 struct _GstEdtPdvSink
 {
   GstBaseSink base;
@@ -42,9 +49,34 @@ struct _GstEdtPdvSink
   int unit;
   int channel;
 
+  GstVideoInfo vinfo;
+  int buffer_size;
+  int pdv_stride;
+
+  /* ring buffers, started strictly in ring order by edt_start_buffers */
   unsigned char **buffers;
   int n_buffers;
-  int cur_buffer;
+  int cur_buffer;               /* next buffer to start */
+  int next_fill;                /* next buffer handed out by the pool */
+  int next_done;                /* next buffer to complete */
+  int num_queued;
+  GstEdtPdvSinkSlotState *slot_states;
+  GstBuffer **slot_buffers;
+  GstBufferPool *pool;
+
+  /* waits for DMA completion and recycles buffers */
+  GThread *completion_thread;
+  gboolean completion_stop;
+
+  GMutex mutex;
+  GCond cond;
+  gboolean stop_requested;
+
+  /* statistics, protected by mutex */
+  gint64 idle_since;            /* monotonic time the queue ran empty */
+  guint64 total_sent;
+  guint64 total_underruns;
+  guint64 total_late;
 };
 
 struct _GstEdtPdvSinkClass
@@ -38,6 +38,12 @@
 #include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
+#ifdef HAVE_ORC
+#include <orc/orc.h>
+#else
+#define orc_memcpy memcpy
+#endif
+
 #include "gstedtpdvsrc.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_edt_pdv_src_debug);
@@ -55,6 +61,8 @@ static gboolean gst_edt_pdv_src_start (GstBaseSrc * src);
 static gboolean gst_edt_pdv_src_stop (GstBaseSrc * src);
 static GstCaps *gst_edt_pdv_src_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_edt_pdv_src_set_caps (GstBaseSrc * src, GstCaps * caps);
+static gboolean gst_edt_pdv_src_unlock (GstBaseSrc * src);
+static gboolean gst_edt_pdv_src_unlock_stop (GstBaseSrc * src);
 
 static GstFlowReturn gst_edt_pdv_src_create (GstPushSrc * src,
     GstBuffer ** buf);
@@ -67,7 +75,10 @@ enum
   PROP_UNIT,
   PROP_CHANNEL,
   PROP_CONFIG_FILE,
-  PROP_NUM_RING_BUFFERS
+  PROP_NUM_RING_BUFFERS,
+  PROP_TIMEOUTS,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_UNIT 0
@@ -115,6 +126,9 @@ gst_edt_pdv_src_class_init (GstEdtPdvSrcClass * klass)
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_edt_pdv_src_stop);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_edt_pdv_src_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_edt_pdv_src_set_caps);
+  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_edt_pdv_src_unlock);
+  gstbasesrc_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_edt_pdv_src_unlock_stop);
 
   gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_edt_pdv_src_create);
 
@@ -137,10 +151,17 @@ gst_edt_pdv_src_class_init (GstEdtPdvSrcClass * klass)
               GST_PARAM_MUTABLE_READY)));
   g_object_class_install_property (gobject_class, PROP_NUM_RING_BUFFERS,
       g_param_spec_uint ("num-ring-buffers", "Number of ring buffers",
-          "Number of ring buffers to use for DMAing frames from card", 1,
-          G_MAXUINT, DEFAULT_PROP_NUM_RING_BUFFERS,
+          "Number of ring buffers to use for DMAing frames from card, frames "
+          "are pushed without copying so this should exceed the buffers held "
+          "downstream", 2, G_MAXUINT, DEFAULT_PROP_NUM_RING_BUFFERS,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_TIMEOUTS,
+      g_param_spec_int ("timeouts", "Timeouts",
+          "Number of image timeouts, each is pushed as a gap", 0, G_MAXINT, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static void
@@ -158,15 +179,30 @@ gst_edt_pdv_src_init (GstEdtPdvSrc * src)
   src->config_file_path = NULL;
   src->num_ring_buffers = DEFAULT_PROP_NUM_RING_BUFFERS;
 
+  g_mutex_init (&src->mutex);
+  g_cond_init (&src->cond);
+  src->slot_held = NULL;
+  src->num_held = 0;
+  src->pending_dev = NULL;
+  src->stop_requested = FALSE;
+  gst_vision_stats_init (&src->stats);
+
   gst_edt_pdv_src_reset (src);
 }
 
 static void
 gst_edt_pdv_src_reset (GstEdtPdvSrc * src)
 {
+  g_mutex_lock (&src->mutex);
   src->dev = NULL;
   src->total_timeouts = 0;
   src->acq_started = FALSE;
+  src->next_start = 0;
+  src->num_started = 0;
+  g_mutex_unlock (&src->mutex);
+
+  gst_vision_stats_reset (&src->stats);
+  gst_vision_clock_mapper_init (&src->clock_mapper, 1e9, 64, 0);
 }
 
 void
@@ -193,6 +229,9 @@ gst_edt_pdv_src_set_property (GObject * object, guint property_id,
     case PROP_NUM_RING_BUFFERS:
       src->num_ring_buffers = g_value_get_uint (value);
       break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -221,6 +260,15 @@ gst_edt_pdv_src_get_property (GObject * object, guint property_id,
     case PROP_NUM_RING_BUFFERS:
       g_value_set_uint (value, src->num_ring_buffers);
       break;
+    case PROP_TIMEOUTS:
+      g_value_set_int (value, src->total_timeouts);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -250,6 +298,10 @@ gst_edt_pdv_src_finalize (GObject * object)
 
   /* clean up object here */
 
+  g_mutex_clear (&src->mutex);
+  g_cond_clear (&src->cond);
+  gst_vision_stats_clear (&src->stats);
+
   G_OBJECT_CLASS (gst_edt_pdv_src_parent_class)->finalize (object);
 }
 
@@ -260,6 +312,16 @@ gst_edt_pdv_src_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  g_mutex_lock (&src->mutex);
+  if (src->pending_dev) {
+    g_mutex_unlock (&src->mutex);
+    GST_ELEMENT_ERROR (src, RESOURCE, BUSY,
+        ("Buffers from the previous acquisition are still in use"),
+        ("%d buffers have not been released", src->num_held));
+    return FALSE;
+  }
+  g_mutex_unlock (&src->mutex);
+
   if (src->config_file_path && strlen (src->config_file_path)) {
     Dependent *dd_p;
     Edtinfo edtinfo;
@@ -308,6 +370,11 @@ gst_edt_pdv_src_start (GstBaseSrc * bsrc)
     goto fail;
   }
 
+  g_mutex_lock (&src->mutex);
+  src->ring_addrs = (guint8 **) pdv_buffer_addresses (src->dev);
+  src->slot_held = g_new0 (gboolean, src->num_ring_buffers);
+  g_mutex_unlock (&src->mutex);
+
   return TRUE;
 
 fail:
@@ -318,18 +385,41 @@ fail:
   return FALSE;
 }
 
+/* Closes the device, which frees the ring buffers, so must only be called
+ * once none are held downstream. Must be called with mutex held. */
+static void
+gst_edt_pdv_src_close_unlocked (GstEdtPdvSrc * src, PdvDev * dev)
+{
+  if (pdv_close (dev)) {
+    GST_ERROR_OBJECT (src, "Failed to close device");
+  }
+  src->ring_addrs = NULL;
+  g_free (src->slot_held);
+  src->slot_held = NULL;
+}
+
 static gboolean
 gst_edt_pdv_src_stop (GstBaseSrc * bsrc)
 {
   GstEdtPdvSrc *src = GST_EDT_PDV_SRC (bsrc);
+  PdvDev *dev;
 
   GST_DEBUG_OBJECT (src, "stop");
 
-  g_assert (src->dev != NULL);
-  if (pdv_close (src->dev)) {
-    GST_ERROR_OBJECT (src, "Failed to close device");
-    return FALSE;
+  g_mutex_lock (&src->mutex);
+  dev = src->dev;
+  src->dev = NULL;
+  g_assert (dev != NULL);
+
+  /* ring buffers are freed on close, so leave that to the last release */
+  if (src->num_held > 0) {
+    GST_DEBUG_OBJECT (src, "%d buffers still held downstream, closing when "
+        "they are released", src->num_held);
+    src->pending_dev = dev;
+  } else {
+    gst_edt_pdv_src_close_unlocked (src, dev);
   }
+  g_mutex_unlock (&src->mutex);
 
   gst_edt_pdv_src_reset (src);
 
@@ -428,53 +518,236 @@ unsupported_caps:
   return FALSE;
 }
 
+static gboolean
+gst_edt_pdv_src_unlock (GstBaseSrc * bsrc)
+{
+  GstEdtPdvSrc *src = GST_EDT_PDV_SRC (bsrc);
+
+  GST_LOG_OBJECT (src, "unlock");
+
+  g_mutex_lock (&src->mutex);
+  src->stop_requested = TRUE;
+  g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->mutex);
+
+  return TRUE;
+}
+
+static gboolean
+gst_edt_pdv_src_unlock_stop (GstBaseSrc * bsrc)
+{
+  GstEdtPdvSrc *src = GST_EDT_PDV_SRC (bsrc);
+
+  GST_LOG_OBJECT (src, "unlock_stop");
+
+  g_mutex_lock (&src->mutex);
+  src->stop_requested = FALSE;
+  g_mutex_unlock (&src->mutex);
+
+  return TRUE;
+}
+
+/* Start acquisition into every ring buffer that is free, in ring order.
+ * pdv_start_image always fills the next buffer in the ring, so stop at the
+ * first one still held downstream. Must be called with mutex held. */
+static void
+gst_edt_pdv_src_start_free_buffers (GstEdtPdvSrc * src)
+{
+  while (src->dev && src->num_started + src->num_held < src->num_ring_buffers
+      && !src->slot_held[src->next_start]) {
+    pdv_start_image (src->dev);
+    src->next_start = (src->next_start + 1) % src->num_ring_buffers;
+    src->num_started++;
+  }
+  g_cond_broadcast (&src->cond);
+}
+
+typedef struct
+{
+  GstEdtPdvSrc *src;
+  guint index;
+} VideoFrame;
+
+static void
+buffer_release (void *data)
+{
+  VideoFrame *frame = (VideoFrame *) data;
+  GstEdtPdvSrc *src = frame->src;
+
+  GST_TRACE_OBJECT (src, "Releasing ring buffer %d", frame->index);
+
+  g_mutex_lock (&src->mutex);
+  src->slot_held[frame->index] = FALSE;
+  src->num_held--;
+  if (src->num_held == 0 && src->pending_dev) {
+    GST_DEBUG_OBJECT (src, "Last buffer released, closing device");
+    gst_edt_pdv_src_close_unlocked (src, src->pending_dev);
+    src->pending_dev = NULL;
+  } else {
+    gst_edt_pdv_src_start_free_buffers (src);
+  }
+  g_mutex_unlock (&src->mutex);
+
+  gst_object_unref (src);
+  g_free (frame);
+}
+
+static gint
+gst_edt_pdv_src_get_ring_index (GstEdtPdvSrc * src, guint8 * image)
+{
+  guint i;
+
+  for (i = 0; i < src->num_ring_buffers; ++i) {
+    if (src->ring_addrs[i] == image) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 static GstFlowReturn
 gst_edt_pdv_src_create (GstPushSrc * psrc, GstBuffer ** buf)
 {
   GstEdtPdvSrc *src = GST_EDT_PDV_SRC (psrc);
   GstMapInfo minfo;
   guint8 *image;
-  gint timeouts;
+  gint timeouts, index;
+  guint timestamp[2];
+  GstClock *clock;
+  GstClockTime now = GST_CLOCK_TIME_NONE;
+  GstClockTime pts = GST_CLOCK_TIME_NONE;
 
   if (!src->acq_started) {
-    /* start freerun/continuous capture */
-    pdv_start_images (src->dev, 0);
+    /* fill the whole ring, each buffer is restarted once released */
+    g_mutex_lock (&src->mutex);
+    gst_edt_pdv_src_start_free_buffers (src);
+    g_mutex_unlock (&src->mutex);
     src->acq_started = TRUE;
   }
 
+  /* if downstream holds the buffer next in the ring, nothing is being
+   * acquired until it is released */
+  g_mutex_lock (&src->mutex);
+  while (src->num_started == 0 && !src->stop_requested) {
+    GST_LOG_OBJECT (src, "Waiting for downstream to release ring buffer");
+    g_cond_wait (&src->cond, &src->mutex);
+  }
+  if (src->stop_requested) {
+    g_mutex_unlock (&src->mutex);
+    return GST_FLOW_FLUSHING;
+  }
+  g_mutex_unlock (&src->mutex);
+
   /* TODO: any way to know if this particular image is good? */
-  /* TODO: use pdv_ wait_image_timed to get rough timestamp */
-  image = pdv_wait_image (src->dev);
+  image = pdv_wait_image_timed (src->dev, timestamp);
+
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock) {
+    now = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+  }
+
+  g_mutex_lock (&src->mutex);
+  src->num_started--;
+  index = gst_edt_pdv_src_get_ring_index (src, image);
+  g_mutex_unlock (&src->mutex);
 
-  /* TODO: if there are timeouts, do we drop frame, return GST_FLOW_FATAL? */
   timeouts = pdv_timeouts (src->dev);
   if (timeouts > src->total_timeouts) {
     GST_WARNING_OBJECT (src,
         "Received timeout, data might be incomplete. Check cables and system bandwidth.");
     src->total_timeouts = timeouts;
+    gst_vision_stats_add_timeout (&src->stats);
 
     /* TODO: perhaps call twice as in take.c to be more robust */
     pdv_timeout_restart (src->dev, TRUE);
-  }
 
-  /* TODO: use allocator */
-  *buf = gst_buffer_new_and_alloc (src->height * src->gst_stride);
+    g_mutex_lock (&src->mutex);
+    gst_edt_pdv_src_start_free_buffers (src);
+    g_mutex_unlock (&src->mutex);
+
+    /* incomplete frame, output a blank frame flagged as gap so downstream
+     * knows nothing usable arrived for this time. Returning it from create
+     * keeps it behind the segment, and a gap buffer needs no valid pts. */
+    *buf = gst_buffer_new_and_alloc (src->height * src->gst_stride);
+    gst_buffer_memset (*buf, 0, 0, gst_buffer_get_size (*buf));
+    GST_BUFFER_FLAG_SET (*buf, GST_BUFFER_FLAG_GAP);
+    if (GST_CLOCK_TIME_IS_VALID (now)) {
+      GST_BUFFER_TIMESTAMP (*buf) =
+          MAX (GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
+              now), 0);
+    }
+
+    return GST_FLOW_OK;
+  }
 
-  /* Copy image to buffer from surface TODO: use orc_memcpy */
-  gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
+  if (GST_CLOCK_TIME_IS_VALID (now)) {
+    /* timestamp is system time the DMA completed, map it onto the pipeline
+     * clock, which need not be the system clock nor run at its rate */
+    guint64 num_resets = src->clock_mapper.num_resets;
+    GstClockTime capture_time =
+        gst_vision_clock_mapper_add_sample (&src->clock_mapper,
+        (guint64) timestamp[0] * GST_SECOND + timestamp[1], now);
+    if (src->clock_mapper.num_resets != num_resets) {
+      GST_DEBUG_OBJECT (src, "DMA timestamps jumped, resetting mapping");
+    }
+    pts = MAX (GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
+            capture_time), 0);
+  }
 
-  if (src->gst_stride == src->edt_stride) {
-    memcpy (minfo.data, image, minfo.size);
+  if (index >= 0 && src->gst_stride == src->edt_stride) {
+    VideoFrame *vf;
+    gsize size = src->height * src->gst_stride;
+
+    g_mutex_lock (&src->mutex);
+    src->slot_held[index] = TRUE;
+    src->num_held++;
+    g_mutex_unlock (&src->mutex);
+
+    vf = g_new0 (VideoFrame, 1);
+    vf->src = (GstEdtPdvSrc *) gst_object_ref (src);
+    vf->index = index;
+    *buf =
+        gst_buffer_new_wrapped_full ((GstMemoryFlags) GST_MEMORY_FLAG_READONLY,
+        image, size, 0, size, vf, (GDestroyNotify) buffer_release);
   } else {
-    int i;
-    GST_LOG_OBJECT (src, "Stride not a multiple of 4, extra copy needed");
-    for (i = 0; i < src->height; i++) {
-      memcpy (minfo.data + i * src->gst_stride,
-          image + i * src->edt_stride, src->edt_stride);
+    /* TODO: use allocator */
+    *buf = gst_buffer_new_and_alloc (src->height * src->gst_stride);
+
+    /* Copy image to buffer from surface */
+    gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
+    if (src->gst_stride == src->edt_stride) {
+      orc_memcpy (minfo.data, image, minfo.size);
+    } else {
+      int i;
+      GST_LOG_OBJECT (src, "Stride not a multiple of 4, extra copy needed");
+      for (i = 0; i < src->height; i++) {
+        orc_memcpy (minfo.data + i * src->gst_stride,
+            image + i * src->edt_stride, src->edt_stride);
+      }
     }
+    gst_buffer_unmap (*buf, &minfo);
+
+    g_mutex_lock (&src->mutex);
+    gst_edt_pdv_src_start_free_buffers (src);
+    g_mutex_unlock (&src->mutex);
   }
-  gst_buffer_unmap (*buf, &minfo);
 
+  GST_BUFFER_TIMESTAMP (*buf) = pts;
+
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock) {
+    now = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+
+    gst_vision_stats_add_delivered (&src->stats,
+        GST_CLOCK_TIME_IS_VALID (pts) ? gst_vision_stats_latency (pts +
+            gst_element_get_base_time (GST_ELEMENT (src)), now) :
+        GST_CLOCK_TIME_NONE);
+    gst_vision_stats_post (&src->stats, GST_ELEMENT (src), now, NULL);
+  } else {
+    gst_vision_stats_add_delivered (&src->stats, GST_CLOCK_TIME_NONE);
+  }
 
   return GST_FLOW_OK;
 }
@@ -24,6 +24,9 @@
 
 #include <edtinc.h>
 
+#include "common/visionclockmapper.h"
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_EDT_PDV_SRC   (gst_edt_pdv_src_get_type())
@@ -60,8 +63,25 @@ struct _GstEdtPdvSrc
   PdvDev *dev;
   gboolean acq_started;
 
+  /* last value of pdv_timeouts (), the driver's cumulative count */
   gint total_timeouts;
 
+  GstVisionStats stats;
+  GstVisionClockMapper clock_mapper;
+
+  /* ring buffers, a buffer is either being filled (started), held by a
+   * GstBuffer downstream, or free waiting for its turn to be started. A
+   * device stopped while buffers are held is closed by the last release. */
+  GMutex mutex;
+  GCond cond;
+  guint8 **ring_addrs;
+  gboolean *slot_held;
+  guint next_start;
+  guint num_started;
+  guint num_held;
+  PdvDev *pending_dev;
+  gboolean stop_requested;
+
   gint height;
   gint gst_stride;
   gint edt_stride;
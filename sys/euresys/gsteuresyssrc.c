@@ -35,8 +35,6 @@
  *   - once specific framegrabber is known, set caps to available set
  *   - once caps are negotiated set to framegrabber
  *   - possibly use SurfaceColorFormat to determine the format of each surface
- * - apply surface timestamp to buffer
- * - issue warning and message if a frame has dropped
  */
 
 #ifdef HAVE_CONFIG_H
@@ -57,13 +55,14 @@ static void gst_euresys_set_property (GObject * object,
 static void gst_euresys_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
 static void gst_euresys_dispose (GObject * object);
+static void gst_euresys_finalize (GObject * object);
 
 static gboolean gst_euresys_start (GstBaseSrc * src);
 static gboolean gst_euresys_stop (GstBaseSrc * src);
 static GstCaps *gst_euresys_get_caps (GstBaseSrc * bsrc, GstCaps * filter);
 static gboolean gst_euresys_set_caps (GstBaseSrc * bsrc, GstCaps * caps);
 
-static GstFlowReturn gst_euresys_fill (GstPushSrc * src, GstBuffer * buf);
+static GstFlowReturn gst_euresys_create (GstPushSrc * src, GstBuffer ** buf);
 
 enum
 {
@@ -73,7 +72,9 @@ enum
   PROP_CONNECTOR,
   PROP_COLOR_FORMAT,
   PROP_PIXEL_TIMING,
-  PROP_NUM_CAPTURE_BUFFERS
+  PROP_NUM_CAPTURE_BUFFERS,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_BOARD_INDEX  0
@@ -306,6 +307,7 @@ gst_euresys_class_init (GstEuresysClass * klass)
   gobject_class->set_property = gst_euresys_set_property;
   gobject_class->get_property = gst_euresys_get_property;
   gobject_class->dispose = gst_euresys_dispose;
+  gobject_class->finalize = gst_euresys_finalize;
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_BOARD_INDEX,
@@ -338,9 +340,12 @@ gst_euresys_class_init (GstEuresysClass * klass)
           GST_PARAM_MUTABLE_READY));
   g_object_class_install_property (gobject_class, PROP_NUM_CAPTURE_BUFFERS,
       g_param_spec_int ("num-capture-buffers", "Number of capture buffers",
-          "Number of capture buffers", 2, 4095,
+          "Number of surfaces (MC_SurfaceCount), surfaces are pushed without "
+          "copying so this must exceed the buffers held downstream", 2, 4095,
           DEFAULT_PROP_NUM_CAPTURE_BUFFERS,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_euresys_src_template));
@@ -355,7 +360,7 @@ gst_euresys_class_init (GstEuresysClass * klass)
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_euresys_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_euresys_set_caps);
 
-  gstpushsrc_class->fill = GST_DEBUG_FUNCPTR (gst_euresys_fill);
+  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_euresys_create);
 }
 
 static void
@@ -377,10 +382,15 @@ gst_euresys_init (GstEuresys * euresys)
 
   euresys->hChannel = 0;
 
+  g_mutex_init (&euresys->buffer_mutex);
+  euresys->num_outstanding = 0;
+  euresys->hPendingChannel = 0;
+
   euresys->acq_started = FALSE;
 
   euresys->last_time_code = -1;
-  euresys->dropped_frame_count = 0;
+  gst_vision_stats_init (&euresys->stats);
+  gst_vision_clock_mapper_init (&euresys->clock_mapper, 1e6, 64, 0);
 
   GST_INFO_OBJECT (euresys, "About to open driver");
   if (McOpenDriver (NULL) != MC_OK) {
@@ -417,6 +427,10 @@ gst_euresys_set_property (GObject * object, guint property_id,
     case PROP_NUM_CAPTURE_BUFFERS:
       euresys->num_capture_buffers = g_value_get_int (value);
       break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&euresys->stats,
+          g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -451,6 +465,13 @@ gst_euresys_get_property (GObject * object, guint property_id,
     case PROP_NUM_CAPTURE_BUFFERS:
       g_value_set_int (value, euresys->num_capture_buffers);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value,
+          gst_vision_stats_get_structure (&euresys->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&euresys->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -473,6 +494,21 @@ gst_euresys_dispose (GObject * object)
   G_OBJECT_CLASS (gst_euresys_parent_class)->dispose (object);
 }
 
+void
+gst_euresys_finalize (GObject * object)
+{
+  GstEuresys *euresys;
+
+  g_return_if_fail (GST_IS_EURESYS (object));
+  euresys = GST_EURESYS (object);
+
+  /* clean up object here */
+  gst_vision_stats_clear (&euresys->stats);
+  g_mutex_clear (&euresys->buffer_mutex);
+
+  G_OBJECT_CLASS (gst_euresys_parent_class)->finalize (object);
+}
+
 static gboolean
 gst_euresys_start (GstBaseSrc * bsrc)
 {
@@ -481,6 +517,16 @@ gst_euresys_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (euresys, "start");
 
+  g_mutex_lock (&euresys->buffer_mutex);
+  if (euresys->hPendingChannel) {
+    g_mutex_unlock (&euresys->buffer_mutex);
+    GST_ELEMENT_ERROR (euresys, RESOURCE, BUSY,
+        (("Buffers from the previous acquisition are still in use.")),
+        ("%d buffers have not been released", euresys->num_outstanding));
+    return FALSE;
+  }
+  g_mutex_unlock (&euresys->buffer_mutex);
+
   status =
       McGetParamInt (MC_BOARD + euresys->boardIdx, MC_BoardType,
       &euresys->boardType);
@@ -603,13 +649,23 @@ gst_euresys_stop (GstBaseSrc * src)
 
   /* Stop the acquisition */
   McSetParamInt (euresys->hChannel, MC_ChannelState, MC_ChannelState_IDLE);
+  euresys->acq_started = FALSE;
 
-  /* Delete the channel */
-  if (euresys->hChannel)
+  /* Delete the channel, or leave that to the last buffer still wrapping one
+   * of its surfaces */
+  g_mutex_lock (&euresys->buffer_mutex);
+  if (euresys->hChannel && euresys->num_outstanding > 0) {
+    GST_DEBUG_OBJECT (euresys, "Deferring channel deletion until %d buffers "
+        "are released", euresys->num_outstanding);
+    euresys->hPendingChannel = euresys->hChannel;
+  } else if (euresys->hChannel) {
     McDelete (euresys->hChannel);
+  }
   euresys->hChannel = 0;
+  g_mutex_unlock (&euresys->buffer_mutex);
 
-  euresys->dropped_frame_count = 0;
+  gst_vision_stats_reset (&euresys->stats);
+  gst_vision_clock_mapper_init (&euresys->clock_mapper, 1e6, 64, 0);
   euresys->last_time_code = -1;
 
   return TRUE;
@@ -693,8 +749,38 @@ gst_euresys_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
   return TRUE;
 }
 
+typedef struct
+{
+  GstEuresys *euresys;
+  MCHANDLE hSurface;
+  INT32 timeCode;
+} VideoFrame;
+
+static void
+surface_release (void *data)
+{
+  VideoFrame *frame = (VideoFrame *) data;
+  GstEuresys *euresys = frame->euresys;
+
+  /* surface can be filled again once downstream is done with it */
+  GST_TRACE_OBJECT (euresys, "Releasing surface #%05d", frame->timeCode);
+
+  g_mutex_lock (&euresys->buffer_mutex);
+  McSetParamInt (frame->hSurface, MC_SurfaceState, MC_SurfaceState_FREE);
+  euresys->num_outstanding--;
+  if (euresys->num_outstanding == 0 && euresys->hPendingChannel) {
+    GST_DEBUG_OBJECT (euresys, "Last buffer released, deleting channel");
+    McDelete (euresys->hPendingChannel);
+    euresys->hPendingChannel = 0;
+  }
+  g_mutex_unlock (&euresys->buffer_mutex);
+
+  gst_object_unref (euresys);
+  g_free (frame);
+}
+
 GstFlowReturn
-gst_euresys_fill (GstPushSrc * src, GstBuffer * buf)
+gst_euresys_create (GstPushSrc * src, GstBuffer ** buf)
 {
   GstEuresys *euresys = GST_EURESYS (src);
   MCSTATUS status = 0;
@@ -705,7 +791,10 @@ gst_euresys_fill (GstPushSrc * src, GstBuffer * buf)
   INT64 timeStamp;
   int newsize;
   int dropped_frame_count;
-  GstMapInfo minfo;
+  VideoFrame *vf;
+  GstClock *clock;
+  GstClockTime now = GST_CLOCK_TIME_NONE;
+  GstClockTime capture_time = GST_CLOCK_TIME_NONE;
 
   /* Start acquisition */
   if (!euresys->acq_started) {
@@ -725,6 +814,7 @@ gst_euresys_fill (GstPushSrc * src, GstBuffer * buf)
     /* Wait up to 5000 msecs for a signal */
     status = McWaitSignal (euresys->hChannel, MC_SIG_ANY, 5000, &siginfo);
     if (status == MC_TIMEOUT) {
+      gst_vision_stats_add_timeout (&euresys->stats);
       GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
           (("Timeout waiting for signal.")), (("Timeout waiting for signal.")));
       return GST_FLOW_ERROR;
@@ -758,29 +848,61 @@ gst_euresys_fill (GstPushSrc * src, GstBuffer * buf)
 
   GST_INFO ("Got surface #%05d", timeCode);
 
+  /* Wrap surface, it is set back to FREE when the buffer is released */
+  vf = g_new0 (VideoFrame, 1);
+  vf->euresys = (GstEuresys *) gst_object_ref (euresys);
+  vf->hSurface = hSurface;
+  vf->timeCode = timeCode;
+  *buf =
+      gst_buffer_new_wrapped_full ((GstMemoryFlags) GST_MEMORY_FLAG_READONLY,
+      (gpointer) pImage, newsize, 0, newsize, vf,
+      (GDestroyNotify) surface_release);
+  g_mutex_lock (&euresys->buffer_mutex);
+  euresys->num_outstanding++;
+  g_mutex_unlock (&euresys->buffer_mutex);
+
+  /* MC_TimeStamp_us is system UTC when the surface was filled, map it onto
+   * the pipeline clock, which need not be the system clock nor run at its
+   * rate */
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock) {
+    guint64 num_resets = euresys->clock_mapper.num_resets;
+    now = gst_clock_get_time (clock);
+    capture_time = gst_vision_clock_mapper_add_sample (&euresys->clock_mapper,
+        (guint64) timeStamp, now);
+    if (euresys->clock_mapper.num_resets != num_resets) {
+      GST_DEBUG_OBJECT (euresys, "Surface timestamps jumped, resetting mapping");
+    }
+    GST_BUFFER_TIMESTAMP (*buf) =
+        MAX (GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
+            capture_time), 0);
+    gst_object_unref (clock);
+  }
+
   dropped_frame_count = timeCode - (euresys->last_time_code + 1);
-  if (dropped_frame_count != 0) {
-    euresys->dropped_frame_count += dropped_frame_count;
-    GST_WARNING ("Dropped %d frames (%d total)", dropped_frame_count,
-        euresys->dropped_frame_count);
-    /* TODO: emit message here about dropped frames */
+  if (dropped_frame_count > 0) {
+    GstStructure *info_msg;
+    guint64 total_dropped;
+
+    gst_vision_stats_add_dropped (&euresys->stats, dropped_frame_count);
+    g_mutex_lock (&euresys->stats.lock);
+    total_dropped = euresys->stats.frames_dropped;
+    g_mutex_unlock (&euresys->stats.lock);
+    GST_WARNING_OBJECT (euresys, "Dropped %d frames (%" G_GUINT64_FORMAT
+        " total)", dropped_frame_count, total_dropped);
+
+    info_msg = gst_structure_new ("dropped-frames",
+        "num-dropped-frames", G_TYPE_INT, dropped_frame_count,
+        "total-dropped-frames", G_TYPE_INT, (gint) total_dropped,
+        "timestamp", GST_TYPE_CLOCK_TIME, GST_BUFFER_TIMESTAMP (*buf), NULL);
+    gst_element_post_message (GST_ELEMENT (euresys),
+        gst_message_new_element (GST_OBJECT (euresys), info_msg));
   }
   euresys->last_time_code = timeCode;
 
-  /* Copy image to buffer from surface */
-  gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
-  /* TODO: fix strides? */
-  g_assert (minfo.size == newsize);
-  memcpy (minfo.data, pImage, newsize);
-  gst_buffer_unmap (buf, &minfo);
-
-  /* TODO: set buffer timestamp based on MC_TimeStamp_us */
-  GST_BUFFER_TIMESTAMP (buf) =
-      gst_clock_get_time (GST_ELEMENT_CLOCK (src)) -
-      GST_ELEMENT_CAST (src)->base_time;
-
-  /* Done processing surface, release control */
-  McSetParamInt (hSurface, MC_SurfaceState, MC_SurfaceState_FREE);
+  gst_vision_stats_add_delivered (&euresys->stats,
+      gst_vision_stats_latency (capture_time, now));
+  gst_vision_stats_post (&euresys->stats, GST_ELEMENT (euresys), now, NULL);
 
   return GST_FLOW_OK;
 }
@@ -23,6 +23,9 @@
 #include <gst/base/gstpushsrc.h>
 #include <multicam.h>
 
+#include "common/visionclockmapper.h"
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_EURESYS   (gst_euresys_get_type())
@@ -72,13 +75,20 @@ struct _GstEuresys
 {
   GstPushSrc base_euresys;
 
-  gint dropped_frame_count;
+  GstVisionStats stats;
+  GstVisionClockMapper clock_mapper;
   gboolean acq_started;
 
   INT32 last_time_code;
   MCHANDLE hChannel;
   INT32 boardType;
 
+  /* surfaces wrapped in buffers that are still held downstream, a stopped
+   * channel is only deleted once the last of them has been released */
+  GMutex buffer_mutex;
+  guint num_outstanding;
+  MCHANDLE hPendingChannel;
+
   /* properties */
   INT32 boardIdx;
   GstEuresysCameraEnum cameraType;
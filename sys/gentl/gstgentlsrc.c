@@ -107,7 +107,9 @@ enum
   PROP_STREAM_INDEX,
   PROP_STREAM_ID,
   PROP_NUM_CAPTURE_BUFFERS,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_INTERFACE_INDEX 0
@@ -129,7 +131,8 @@ static GstStaticPadTemplate gst_gentlsrc_src_template =
         ("{ GRAY8, GRAY16_LE, GRAY16_BE, BGRA, UYVY }") ";"
         GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER8 ("{ bggr, grbg, rggb, gbrg }") ";"
         GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER16
-        ("{ bggr16, grbg16, rggb16, gbrg16 }", "1234")
+        ("{ bggr16, grbg16, rggb16, gbrg16 }", "1234") ";"
+        GST_GENICAM_PIXEL_FORMAT_CAPS_PACKED
     )
     );
 
@@ -348,15 +351,16 @@ gst_gentlsrc_class_init (GstGenTlSrcClass * klass)
           "Timeout (ms)",
           "Timeout in ms (0 to use default)", 0, G_MAXINT,
           DEFAULT_PROP_TIMEOUT, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
-
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static void
 gst_gentlsrc_reset (GstGenTlSrc * src)
 {
   src->error_string[0] = 0;
-  src->last_frame_count = 0;
-  src->total_dropped_frames = 0;
+  src->last_frame_id = G_MAXUINT64;
+  gst_vision_stats_reset (&src->stats);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -381,6 +385,7 @@ gst_gentlsrc_init (GstGenTlSrc * src)
 
   src->stop_requested = FALSE;
   src->caps = NULL;
+  gst_vision_stats_init (&src->stats);
 
   src->hTL = NULL;
   src->hIF = NULL;
@@ -426,6 +431,9 @@ gst_gentlsrc_set_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
       break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -466,6 +474,12 @@ gst_gentlsrc_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_int (value, src->timeout);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -500,6 +514,8 @@ gst_gentlsrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
+  gst_vision_stats_clear (&src->stats);
+
   G_OBJECT_CLASS (gst_gentlsrc_parent_class)->finalize (object);
 }
 
@@ -1074,6 +1090,39 @@ gst_gentlsrc_start (GstBaseSrc * bsrc)
       case 0x02180015:
         genicam_pixfmt = "BGR8Packed";
         break;
+      case 0x010A0046:
+        genicam_pixfmt = "Mono10p";
+        break;
+      case 0x010C0047:
+        genicam_pixfmt = "Mono12p";
+        break;
+      case 0x010C0006:
+        genicam_pixfmt = "Mono12Packed";
+        break;
+      case 0x010A0052:
+        genicam_pixfmt = "BayerBG10p";
+        break;
+      case 0x010A0054:
+        genicam_pixfmt = "BayerGB10p";
+        break;
+      case 0x010A0056:
+        genicam_pixfmt = "BayerGR10p";
+        break;
+      case 0x010A0058:
+        genicam_pixfmt = "BayerRG10p";
+        break;
+      case 0x010C0053:
+        genicam_pixfmt = "BayerBG12p";
+        break;
+      case 0x010C0055:
+        genicam_pixfmt = "BayerGB12p";
+        break;
+      case 0x010C0057:
+        genicam_pixfmt = "BayerGR12p";
+        break;
+      case 0x010C0059:
+        genicam_pixfmt = "BayerRG12p";
+        break;
       case 0x0210001F:
         genicam_pixfmt = "YUV422Packed";
         break;
@@ -1095,7 +1144,6 @@ gst_gentlsrc_start (GstBaseSrc * bsrc)
     src->caps =
         gst_genicam_pixel_format_caps_from_pixel_format (genicam_pixfmt,
         G_LITTLE_ENDIAN, width, height, 30, 1, 1, 1);
-    gst_video_info_from_caps (&vinfo, src->caps);
     if (!src->caps) {
       GST_ELEMENT_ERROR (src, STREAM, WRONG_TYPE,
           ("Unknown or unsupported pixel format (%s).", genicam_pixfmt),
@@ -1103,8 +1151,15 @@ gst_gentlsrc_start (GstBaseSrc * bsrc)
       goto error;
     }
 
-    src->height = vinfo.height;
-    src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
+    src->height = height;
+    if (gst_video_info_from_caps (&vinfo, src->caps)) {
+      src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
+    } else {
+      /* Bayer and packed formats */
+      src->gst_stride =
+          gst_genicam_pixel_format_get_stride (genicam_pixfmt,
+          G_LITTLE_ENDIAN, width);
+    }
   }
 
   if (!gst_gentlsrc_prepare_buffers (src)) {
@@ -1259,12 +1314,25 @@ gst_gentlsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
 
   GST_DEBUG_OBJECT (src, "The caps being set are %" GST_PTR_FORMAT, caps);
 
-  gst_video_info_from_caps (&vinfo, caps);
+  if (gst_structure_has_name (s, "video/x-raw")) {
+    gst_video_info_from_caps (&vinfo, caps);
 
-  if (GST_VIDEO_INFO_FORMAT (&vinfo) != GST_VIDEO_FORMAT_UNKNOWN) {
-    src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
+    if (GST_VIDEO_INFO_FORMAT (&vinfo) != GST_VIDEO_FORMAT_UNKNOWN) {
+      src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
+    } else {
+      goto unsupported_caps;
+    }
   } else {
-    goto unsupported_caps;
+    /* Bayer and packed formats aren't video/x-raw */
+    const char *pixel_format;
+    int endianness, width;
+
+    pixel_format = gst_genicam_pixel_format_from_caps (caps, &endianness);
+    if (!pixel_format || !gst_structure_get_int (s, "width", &width)) {
+      goto unsupported_caps;
+    }
+    src->gst_stride =
+        gst_genicam_pixel_format_get_stride (pixel_format, endianness, width);
   }
 
   return TRUE;
@@ -1316,6 +1384,9 @@ gst_gentlsrc_get_buffer (GstGenTlSrc * src)
   ret =
       GTL_EventGetData (src->hNewBufferEvent, &new_buffer_data, &datasize,
       src->timeout);
+  if (ret == GC_ERR_TIMEOUT) {
+    gst_vision_stats_add_timeout (&src->stats);
+  }
   HANDLE_GTL_ERROR ("Failed to get New Buffer event within timeout period");
 
   datasize = sizeof (payload_type);
@@ -1330,6 +1401,19 @@ gst_gentlsrc_get_buffer (GstGenTlSrc * src)
       BUFFER_INFO_FRAMEID, &datatype, &frame_id, &datasize);
   HANDLE_GTL_ERROR ("Failed to get frame id");
 
+  /* check for dropped frames and disrupted signal */
+  if (src->last_frame_id != G_MAXUINT64) {
+    if (frame_id > src->last_frame_id + 1) {
+      gst_vision_stats_add_dropped (&src->stats,
+          frame_id - src->last_frame_id - 1);
+      GST_WARNING_OBJECT (src, "Dropped %" G_GUINT64_FORMAT " frames",
+          (guint64) (frame_id - src->last_frame_id - 1));
+    } else if (frame_id <= src->last_frame_id) {
+      GST_WARNING_OBJECT (src, "Frame ID non-monotonic, signal disrupted?");
+    }
+  }
+  src->last_frame_id = frame_id;
+
   datasize = sizeof (buffer_is_incomplete);
   ret =
       GTL_DSGetBufferInfo (src->hDS, new_buffer_data.BufferHandle,
@@ -1382,7 +1466,6 @@ static GstFlowReturn
 gst_gentlsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 {
   GstGenTlSrc *src = GST_GENTL_SRC (psrc);
-  guint32 dropped_frames = 0;
   GstClock *clock;
   GstClockTime clock_time;
 
@@ -1397,17 +1480,6 @@ gst_gentlsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   clock_time = gst_clock_get_time (clock);
   gst_object_unref (clock);
 
-  /* check for dropped frames and disrupted signal */
-  //dropped_frames = (circ_handle.FrameCount - src->last_frame_count) - 1;
-  if (dropped_frames > 0) {
-    src->total_dropped_frames += dropped_frames;
-    GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-        src->total_dropped_frames);
-  } else if (dropped_frames < 0) {
-    GST_WARNING_OBJECT (src, "Frame count non-monotonic, signal disrupted?");
-  }
-  //src->last_frame_count = circ_handle.FrameCount;
-
   /* create GstBuffer then release circ buffer back to acquisition */
   //*buf = gst_gentlsrc_create_buffer_from_circ_handle (src, &circ_handle);
   //ret =
@@ -1436,6 +1508,10 @@ gst_gentlsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     return GST_FLOW_FLUSHING;
   }
 
+  /* frames are only timestamped after the copy, latency is unknown */
+  gst_vision_stats_add_delivered (&src->stats, GST_CLOCK_TIME_NONE);
+  gst_vision_stats_post (&src->stats, GST_ELEMENT (src), clock_time, NULL);
+
   return GST_FLOW_OK;
 
 error:
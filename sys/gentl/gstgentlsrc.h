@@ -25,6 +25,8 @@
 #undef __cplusplus
 #include "GenTL_v1_5.h"
 
+#include "common/visionstats.h"
+
 #define MAX_ERROR_STRING_LEN 256
 
 G_BEGIN_DECLS
@@ -62,8 +64,8 @@ struct _GstGenTlSrc
   gint timeout;
 
   GstClockTime acq_start_time;
-  guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  guint64 last_frame_id;
+  GstVisionStats stats;
 
   GstCaps *caps;
   gint height;
@@ -72,7 +72,9 @@ enum
   PROP_NUM_CAPTURE_BUFFERS,
   PROP_TIMEOUT,
   PROP_EXPOSURE,
-  PROP_FRAMERATE
+  PROP_FRAMERATE,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_CAMERA_ID 0
@@ -156,6 +158,8 @@ gst_idsueyesrc_class_init (GstIdsueyeSrcClass * klass)
           "Framerate in frames per second", 0, G_MAXDOUBLE,
           DEFAULT_PROP_FRAMERATE,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static void
@@ -164,8 +168,8 @@ gst_idsueyesrc_reset (GstIdsueyeSrc * src)
   src->hCam = 0;
   src->is_started = FALSE;
 
-  src->last_frame_count = 0;
-  src->total_dropped_frames = 0;
+  src->last_frame_number = G_MAXUINT64;
+  gst_vision_stats_reset (&src->stats);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -192,6 +196,7 @@ gst_idsueyesrc_init (GstIdsueyeSrc * src)
 
   src->stop_requested = FALSE;
   src->caps = NULL;
+  gst_vision_stats_init (&src->stats);
 
   gst_idsueyesrc_reset (src);
 }
@@ -230,6 +235,9 @@ gst_idsueyesrc_set_property (GObject * object, guint property_id,
         gst_idsueyesrc_set_framerate_exposure (src);
       }
       break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -264,6 +272,12 @@ gst_idsueyesrc_get_property (GObject * object, guint property_id,
     case PROP_FRAMERATE:
       g_value_set_double (value, src->framerate);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -294,6 +308,7 @@ gst_idsueyesrc_finalize (GObject * object)
   /* clean up object here */
 
   g_free (src->config_file);
+  gst_vision_stats_clear (&src->stats);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -699,7 +714,6 @@ gst_idsueyesrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   GstIdsueyeSrc *src = GST_IDSUEYE_SRC (psrc);
   INT ret;
   GstMapInfo minfo;
-  guint32 dropped_frames;
   GstClock *clock;
   GstClockTime clock_time;
   char *pBuffer = NULL;
@@ -744,6 +758,9 @@ gst_idsueyesrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 
       continue;
     } else {
+      if (ret == IS_TIMED_OUT) {
+        gst_vision_stats_add_timeout (&src->stats);
+      }
       GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
           ("Failed to acquire frame before timeout: %s",
               gst_idsueyesrc_get_error_string (src, ret)), (NULL));
@@ -755,21 +772,24 @@ gst_idsueyesrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   clock_time = gst_clock_get_time (clock);
   gst_object_unref (clock);
 
-
-  /* TODO: check for dropped frames and disrupted signal */
-  //dropped_frames = (circ_handle.FrameCount - src->last_frame_count) - 1;
-  //if (dropped_frames > 0) {
-  //  src->total_dropped_frames += dropped_frames;
-  //  GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-  //      src->total_dropped_frames);
-  //} else if (dropped_frames < 0) {
-  //  GST_WARNING_OBJECT (src, "Frame count non-monotonic, signal disrupted?");
-  //}
-  //src->last_frame_count = circ_handle.FrameCount;
-
-  // TODO: use is_GetImageInfo to get timestamp, dropped frames
+  /* check for dropped frames and disrupted signal */
   ret = is_GetImageInfo (src->hCam, nMemID, &imageInfo, sizeof (imageInfo));
-  GST_LOG_OBJECT (src, "frame number %d", imageInfo.u64FrameNumber);
+  if (ret == IS_SUCCESS) {
+    guint64 frame_number = imageInfo.u64FrameNumber;
+    GST_LOG_OBJECT (src, "frame number %" G_GUINT64_FORMAT, frame_number);
+    if (src->last_frame_number != G_MAXUINT64) {
+      if (frame_number > src->last_frame_number + 1) {
+        gst_vision_stats_add_dropped (&src->stats,
+            frame_number - src->last_frame_number - 1);
+        GST_WARNING_OBJECT (src, "Dropped %" G_GUINT64_FORMAT " frames",
+            frame_number - src->last_frame_number - 1);
+      } else if (frame_number <= src->last_frame_number) {
+        GST_WARNING_OBJECT (src,
+            "Frame count non-monotonic, signal disrupted?");
+      }
+    }
+    src->last_frame_number = frame_number;
+  }
 
   /* TODO: use allocator or use from pool */
   *buf =
@@ -802,6 +822,9 @@ gst_idsueyesrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     return GST_FLOW_FLUSHING;
   }
 
+  gst_vision_stats_add_delivered (&src->stats, GST_CLOCK_TIME_NONE);
+  gst_vision_stats_post (&src->stats, GST_ELEMENT (src), clock_time, NULL);
+
   return GST_FLOW_OK;
 }
 
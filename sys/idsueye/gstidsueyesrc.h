@@ -25,6 +25,8 @@
 #define _PURE_C
 #include "ueye.h"
 
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_IDSUEYE_SRC   (gst_idsueyesrc_get_type())
@@ -58,8 +60,8 @@ struct _GstIdsueyeSrc
   gdouble framerate;
 
   GstClockTime acq_start_time;
-  guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  guint64 last_frame_number;
+  GstVisionStats stats;
 
   GstCaps *caps;
   gint width;
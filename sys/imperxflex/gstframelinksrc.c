@@ -35,7 +35,6 @@
 #endif
 
 #include <gst/gst.h>
-#include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
 #include "gstframelinksrc.h"
@@ -55,11 +54,8 @@ static gboolean gst_framelinksrc_start (GstBaseSrc * src);
 static gboolean gst_framelinksrc_stop (GstBaseSrc * src);
 static GstCaps *gst_framelinksrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_framelinksrc_set_caps (GstBaseSrc * src, GstCaps * caps);
-static gboolean gst_framelinksrc_unlock (GstBaseSrc * src);
-static gboolean gst_framelinksrc_unlock_stop (GstBaseSrc * src);
 
-static GstFlowReturn gst_framelinksrc_create (GstPushSrc * src,
-    GstBuffer ** buf);
+static gboolean gst_framelinksrc_start_acquisition (GstVisionGrabberSrc * src);
 
 static GstCaps *gst_framelinksrc_create_caps (GstFramelinkSrc * src);
 enum
@@ -90,7 +86,8 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstFramelinkSrc, gst_framelinksrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstFramelinkSrc, gst_framelinksrc,
+    GST_TYPE_VISION_GRABBER_SRC);
 
 static void
 gst_framelinksrc_class_init (GstFramelinkSrcClass * klass)
@@ -98,7 +95,8 @@ gst_framelinksrc_class_init (GstFramelinkSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   gobject_class->set_property = gst_framelinksrc_set_property;
   gobject_class->get_property = gst_framelinksrc_get_property;
@@ -117,11 +115,9 @@ gst_framelinksrc_class_init (GstFramelinkSrcClass * klass)
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_framelinksrc_stop);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_framelinksrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_framelinksrc_set_caps);
-  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_framelinksrc_unlock);
-  gstbasesrc_class->unlock_stop =
-      GST_DEBUG_FUNCPTR (gst_framelinksrc_unlock_stop);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_framelinksrc_create);
+  grabber_class->start_acquisition =
+      GST_DEBUG_FUNCPTR (gst_framelinksrc_start_acquisition);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_FORMAT_FILE,
@@ -148,7 +144,6 @@ gst_framelinksrc_class_init (GstFramelinkSrcClass * klass)
           "Timeout (ms)",
           "Timeout in ms (0 to use default)", 0, G_MAXINT,
           DEFAULT_PROP_TIMEOUT, G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
-
 }
 
 static void
@@ -162,33 +157,28 @@ gst_framelinksrc_reset (GstFramelinkSrc * src)
     gst_caps_unref (src->caps);
     src->caps = NULL;
   }
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
 }
 
 static void
-gst_framelinksrc_init (GstFramelinkSrc * src)
+gst_framelinksrc_update_timeout (GstFramelinkSrc * src)
 {
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
+  gint timeout = src->timeout ? src->timeout : DEFAULT_PROP_TIMEOUT;
 
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
+  GST_VISION_GRABBER_SRC (src)->timeout = (GstClockTime) timeout * GST_MSECOND;
+}
 
+static void
+gst_framelinksrc_init (GstFramelinkSrc * src)
+{
   /* initialize member variables */
   src->format_file = g_strdup (DEFAULT_PROP_FORMAT_FILE);
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
   src->board = DEFAULT_PROP_BOARD;
   src->channel = DEFAULT_PROP_CHANNEL;
   src->timeout = DEFAULT_PROP_TIMEOUT;
+  gst_framelinksrc_update_timeout (src);
 
-  g_mutex_init (&src->mutex);
-  g_cond_init (&src->cond);
-  src->stop_requested = FALSE;
   src->caps = NULL;
-  src->buffer = NULL;
 
   gst_framelinksrc_reset (src);
 }
@@ -223,6 +213,7 @@ gst_framelinksrc_set_property (GObject * object, guint property_id,
       break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
+      gst_framelinksrc_update_timeout (src);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -271,9 +262,6 @@ gst_framelinksrc_dispose (GObject * object)
 
   /* clean up as possible.  may be called multiple times */
 
-  g_mutex_clear (&src->mutex);
-  g_cond_clear (&src->cond);
-
   G_OBJECT_CLASS (gst_framelinksrc_parent_class)->dispose (object);
 }
 
@@ -293,11 +281,6 @@ gst_framelinksrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
-
   G_OBJECT_CLASS (gst_framelinksrc_parent_class)->finalize (object);
 }
 
@@ -314,6 +297,9 @@ gst_framelinksrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  if (!GST_BASE_SRC_CLASS (gst_framelinksrc_parent_class)->start (bsrc))
+    return FALSE;
+
   if (!strlen (src->format_file)) {
     GST_ERROR_OBJECT (src, "Format file must be specified");
     return FALSE;
@@ -483,6 +469,9 @@ gst_framelinksrc_stop (GstBaseSrc * bsrc)
     src->grabber = NULL;
   }
 
+  /* the callback has stopped, discard what it queued */
+  GST_BASE_SRC_CLASS (gst_framelinksrc_parent_class)->stop (bsrc);
+
   gst_framelinksrc_reset (src);
 
   return TRUE;
@@ -538,33 +527,6 @@ unsupported_caps:
   return FALSE;
 }
 
-static gboolean
-gst_framelinksrc_unlock (GstBaseSrc * bsrc)
-{
-  GstFramelinkSrc *src = GST_FRAMELINK_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock");
-
-  g_mutex_lock (&src->mutex);
-  src->stop_requested = TRUE;
-  g_cond_signal (&src->cond);
-  g_mutex_unlock (&src->mutex);
-
-  return TRUE;
-}
-
-static gboolean
-gst_framelinksrc_unlock_stop (GstBaseSrc * bsrc)
-{
-  GstFramelinkSrc *src = GST_FRAMELINK_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock_stop");
-
-  src->stop_requested = FALSE;
-
-  return TRUE;
-}
-
 static GstBuffer *
 gst_framelinksrc_create_buffer_from_frameinfo (GstFramelinkSrc * src,
     VCECLB_FrameInfoEx * pFrameInfo)
@@ -636,23 +598,17 @@ static void __stdcall
 gst_framelinksrc_callback (void *lpUserData, VCECLB_FrameInfoEx * pFrameInfo)
 {
   GstFramelinkSrc *src = GST_FRAMELINK_SRC (lpUserData);
-  gint dropped_frames;
-  static guint64 last_frame_number = 0;
-  static guint64 buffers_processed = 0;
-  static guint64 total_dropped_frames = 0;
-  GstClock *clock;
-  GstClockTime timestamp;
+  GstVisionGrabberSrc *grabber = GST_VISION_GRABBER_SRC (lpUserData);
+  GstVisionGrabberFrame frame;
 
   g_assert (src != NULL);
 
-  clock = gst_element_get_clock (GST_ELEMENT (src));
-  timestamp = GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      gst_clock_get_time (clock));
-  gst_object_unref (clock);
+  gst_vision_grabber_frame_init (&frame);
+  frame.clock_time = gst_vision_grabber_src_get_clock_time (grabber);
 
   /* check for DMA errors */
   if (pFrameInfo->dma_status == VCECLB_DMA_STATUS_FRAME_DROP) {
-    /* TODO: save this in dropped frame total? */
+    gst_vision_stats_add_dropped (&grabber->stats, 1);
     GST_WARNING_OBJECT (src, "Frame dropped from DMA system.");
     return;
   } else if (pFrameInfo->dma_status == VCECLB_DMA_STATUS_FIFO_OVERRUN) {
@@ -669,94 +625,36 @@ gst_framelinksrc_callback (void *lpUserData, VCECLB_FrameInfoEx * pFrameInfo)
     return;
   }
 
-  /* check for dropped frames and disrupted signal */
-  dropped_frames = (pFrameInfo->number - last_frame_number) - 1;
-  if (dropped_frames > 0) {
-    total_dropped_frames += dropped_frames;
-    GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-        total_dropped_frames);
-  } else if (dropped_frames < 0) {
-    GST_WARNING_OBJECT (src,
-        "Signal disrupted, frames likely dropped and timestamps inaccurate");
-
-    /* frame timestamps reset, so adjust start time, accuracy reduced */
-    src->acq_start_time =
-        gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src))) -
-        pFrameInfo->timestamp * GST_USECOND;
-  }
-  last_frame_number = pFrameInfo->number;
-
-  g_mutex_lock (&src->mutex);
-
-  if (src->buffer) {
-    /* TODO: save this in dropped frame total? */
-    GST_WARNING_OBJECT (src,
-        "Got new buffer before old handled, dropping old.");
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
-
-  src->buffer = gst_framelinksrc_create_buffer_from_frameinfo (src, pFrameInfo);
-
-  GST_BUFFER_TIMESTAMP (src->buffer) = timestamp;
+  /* the raw buffer is only valid during the callback, so unpack it now */
+  frame.buffer = gst_framelinksrc_create_buffer_from_frameinfo (src,
+      pFrameInfo);
+  if (frame.buffer == NULL)
+    return;
 
-  GST_BUFFER_OFFSET (src->buffer) = buffers_processed;
-  ++buffers_processed;
+  /* gaps and resets in the frame number are accounted for by the base class */
+  frame.frame_number = pFrameInfo->number;
 
-  g_cond_signal (&src->cond);
-  g_mutex_unlock (&src->mutex);
+  gst_vision_grabber_src_push_frame (grabber, &frame);
 }
 
-static GstFlowReturn
-gst_framelinksrc_create (GstPushSrc * psrc, GstBuffer ** buf)
+static gboolean
+gst_framelinksrc_start_acquisition (GstVisionGrabberSrc * grabber)
 {
-  GstFramelinkSrc *src = GST_FRAMELINK_SRC (psrc);
+  GstFramelinkSrc *src = GST_FRAMELINK_SRC (grabber);
   VCECLB_Error err;
-  gint64 end_time;
-
-  GST_LOG_OBJECT (src, "create");
-
-  /* Start acquisition if not already started */
-  if (G_UNLIKELY (!src->acq_started)) {
-    GST_LOG_OBJECT (src, "starting acquisition");
-    src->acq_start_time =
-        gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src)));
-    err =
-        VCECLB_StartGrabEx (src->grabber, src->channel, 0,
-        gst_framelinksrc_callback, src);
-
-    if (err != VCECLB_Err_Success) {
-      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-          ("Failed to start grabbing (code %d)", err), (NULL));
-      return GST_FLOW_ERROR;
-    }
-    src->acq_started = TRUE;
-  }
 
-  /* wait for a buffer to be ready */
-  g_mutex_lock (&src->mutex);
-  end_time = g_get_monotonic_time () + src->timeout * G_TIME_SPAN_MILLISECOND;
-  while (!src->buffer && !src->stop_requested) {
-    if (!g_cond_wait_until (&src->cond, &src->mutex, end_time)) {
-      g_mutex_unlock (&src->mutex);
-      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-          ("Timeout, no data received after %d ms", src->timeout), (NULL));
-      return GST_FLOW_ERROR;
-    }
-  }
-  *buf = src->buffer;
-  src->buffer = NULL;
-  g_mutex_unlock (&src->mutex);
-
-  if (src->stop_requested) {
-    if (*buf != NULL) {
-      gst_buffer_unref (*buf);
-      *buf = NULL;
-    }
-    return GST_FLOW_FLUSHING;
+  GST_LOG_OBJECT (src, "starting acquisition");
+
+  err = VCECLB_StartGrabEx (src->grabber, src->channel, 0,
+      gst_framelinksrc_callback, src);
+  if (err != VCECLB_Err_Success) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Failed to start grabbing (code %d)", err), (NULL));
+    return FALSE;
   }
+  src->acq_started = TRUE;
 
-  return GST_FLOW_OK;
+  return TRUE;
 }
 
 static gboolean
@@ -20,7 +20,6 @@
 #ifndef _GST_FRAMELINK_SRC_H_
 #define _GST_FRAMELINK_SRC_H_
 
-#include <gst/base/gstpushsrc.h>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -28,6 +27,8 @@
 #define bool gboolean
 #include <VCECLB.h>
 
+#include "gstvisiongrabbersrc.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_FRAMELINK_SRC   (gst_framelinksrc_get_type())
@@ -41,7 +42,7 @@ typedef struct _GstFramelinkSrcClass GstFramelinkSrcClass;
 
 struct _GstFramelinkSrc
 {
-  GstPushSrc base_framelinksrc;
+  GstVisionGrabberSrc base_framelinksrc;
 
   gboolean acq_started;
 
@@ -55,22 +56,15 @@ struct _GstFramelinkSrc
   guint channel;
   gint timeout;
 
-  GstBuffer *buffer;
-  GstClockTime acq_start_time;
-
   GstCaps *caps;
   gint height;
   gint gst_stride;
   VCECLB_RawPixelInfoEx pixInfo;
-
-  GMutex mutex;
-  GCond cond;
-  gboolean stop_requested;
 };
 
 struct _GstFramelinkSrcClass
 {
-  GstPushSrcClass base_framelinksrc_class;
+  GstVisionGrabberSrcClass base_framelinksrc_class;
 };
 
 GType gst_framelinksrc_get_type (void);
@@ -35,7 +35,6 @@
 #endif
 
 #include <gst/gst.h>
-#include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
 #ifdef HAVE_ORC
@@ -64,11 +63,9 @@ static gboolean gst_imperxsdisrc_start (GstBaseSrc * src);
 static gboolean gst_imperxsdisrc_stop (GstBaseSrc * src);
 static GstCaps *gst_imperxsdisrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_imperxsdisrc_set_caps (GstBaseSrc * src, GstCaps * caps);
-static gboolean gst_imperxsdisrc_unlock (GstBaseSrc * src);
-static gboolean gst_imperxsdisrc_unlock_stop (GstBaseSrc * src);
 
-static GstFlowReturn gst_imperxsdisrc_create (GstPushSrc * src,
-    GstBuffer ** buf);
+static gboolean gst_imperxsdisrc_start_acquisition (GstVisionGrabberSrc *
+    src);
 
 static GstCaps *gst_imperxsdisrc_create_caps (GstImperxSdiSrc * src);
 enum
@@ -76,7 +73,10 @@ enum
   PROP_0,
   PROP_NUM_CAPTURE_BUFFERS,
   PROP_BOARD,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_DROPPED_FRAMES,
+  PROP_QUEUE_DROPPED_FRAMES,
+  PROP_DMA_ERRORS
 };
 
 #define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 3
@@ -94,7 +94,8 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstImperxSdiSrc, gst_imperxsdisrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstImperxSdiSrc, gst_imperxsdisrc,
+    GST_TYPE_VISION_GRABBER_SRC);
 
 static void
 gst_imperxsdisrc_class_init (GstImperxSdiSrcClass * klass)
@@ -102,7 +103,8 @@ gst_imperxsdisrc_class_init (GstImperxSdiSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   gobject_class->set_property = gst_imperxsdisrc_set_property;
   gobject_class->get_property = gst_imperxsdisrc_get_property;
@@ -121,11 +123,9 @@ gst_imperxsdisrc_class_init (GstImperxSdiSrcClass * klass)
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_imperxsdisrc_stop);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_imperxsdisrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_imperxsdisrc_set_caps);
-  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_imperxsdisrc_unlock);
-  gstbasesrc_class->unlock_stop =
-      GST_DEBUG_FUNCPTR (gst_imperxsdisrc_unlock_stop);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_imperxsdisrc_create);
+  grabber_class->start_acquisition =
+      GST_DEBUG_FUNCPTR (gst_imperxsdisrc_start_acquisition);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_NUM_CAPTURE_BUFFERS,
@@ -143,7 +143,31 @@ gst_imperxsdisrc_class_init (GstImperxSdiSrcClass * klass)
           "Timeout in ms (0 to use default)", 0, G_MAXINT,
           DEFAULT_PROP_TIMEOUT,
           (GParamFlags) (G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE)));
+  g_object_class_install_property (gobject_class, PROP_DROPPED_FRAMES,
+      g_param_spec_uint64 ("dropped-frames", "Dropped frames",
+          "Number of frames lost before reaching the host; deprecated, use "
+          "frames-dropped of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DROPPED_FRAMES,
+      g_param_spec_uint64 ("queue-dropped-frames", "Queue dropped frames",
+          "Number of frames dropped because the queue was full; deprecated, "
+          "use frames-overwritten of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_DMA_ERRORS,
+      g_param_spec_uint64 ("dma-errors", "DMA errors",
+          "Number of frames discarded because of a DMA error",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+}
 
+static void
+gst_imperxsdisrc_update_timeout (GstImperxSdiSrc * src)
+{
+  GST_VISION_GRABBER_SRC (src)->timeout =
+      (GstClockTime) (src->timeout > 0 ? src->timeout : DEFAULT_PROP_TIMEOUT) *
+      GST_MSECOND;
 }
 
 static void
@@ -157,9 +181,17 @@ gst_imperxsdisrc_reset (GstImperxSdiSrc * src)
     gst_caps_unref (src->caps);
     src->caps = NULL;
   }
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
+
+  g_mutex_lock (&src->mutex);
+  src->last_frame_number = 0;
+  src->buffers_processed = 0;
+  src->total_dma_errors = 0;
+  g_mutex_unlock (&src->mutex);
+
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
   }
 
   src->width = 0;
@@ -171,22 +203,15 @@ gst_imperxsdisrc_reset (GstImperxSdiSrc * src)
 static void
 gst_imperxsdisrc_init (GstImperxSdiSrc * src)
 {
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
-
   /* initialize member variables */
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
   src->board = DEFAULT_PROP_BOARD;
   src->timeout = DEFAULT_PROP_TIMEOUT;
+  gst_imperxsdisrc_update_timeout (src);
 
   g_mutex_init (&src->mutex);
-  g_cond_init (&src->cond);
-  src->stop_requested = FALSE;
   src->caps = NULL;
-  src->buffer = NULL;
+  src->pool = NULL;
 
   gst_imperxsdisrc_reset (src);
 }
@@ -214,6 +239,7 @@ gst_imperxsdisrc_set_property (GObject * object, guint property_id,
       break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
+      gst_imperxsdisrc_update_timeout (src);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -226,9 +252,11 @@ gst_imperxsdisrc_get_property (GObject * object, guint property_id,
     GValue * value, GParamSpec * pspec)
 {
   GstImperxSdiSrc *src;
+  GstVisionStats *stats;
 
   g_return_if_fail (GST_IS_IMPERX_SDI_SRC (object));
   src = GST_IMPERX_SDI_SRC (object);
+  stats = &GST_VISION_GRABBER_SRC (src)->stats;
 
   switch (property_id) {
     case PROP_NUM_CAPTURE_BUFFERS:
@@ -240,6 +268,21 @@ gst_imperxsdisrc_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_int (value, src->timeout);
       break;
+    case PROP_DROPPED_FRAMES:
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_dropped);
+      g_mutex_unlock (&stats->lock);
+      break;
+    case PROP_QUEUE_DROPPED_FRAMES:
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_overwritten);
+      g_mutex_unlock (&stats->lock);
+      break;
+    case PROP_DMA_ERRORS:
+      g_mutex_lock (&src->mutex);
+      g_value_set_uint64 (value, src->total_dma_errors);
+      g_mutex_unlock (&src->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -256,9 +299,6 @@ gst_imperxsdisrc_dispose (GObject * object)
 
   /* clean up as possible.  may be called multiple times */
 
-  g_mutex_clear (&src->mutex);
-  g_cond_clear (&src->cond);
-
   G_OBJECT_CLASS (gst_imperxsdisrc_parent_class)->dispose (object);
 }
 
@@ -277,10 +317,7 @@ gst_imperxsdisrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
+  g_mutex_clear (&src->mutex);
 
   G_OBJECT_CLASS (gst_imperxsdisrc_parent_class)->finalize (object);
 }
@@ -325,6 +362,9 @@ gst_imperxsdisrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  if (!GST_BASE_SRC_CLASS (gst_imperxsdisrc_parent_class)->start (bsrc))
+    return FALSE;
+
   /* enumerate devices */
   enumData.cbSize = sizeof (VCESDI_EnumData);
   hDevEnum = VCESDI_EnumInit ();
@@ -509,8 +549,9 @@ gst_imperxsdisrc_create_buffer_from_frameinfo (GstImperxSdiSrc * src,
     VCESDI_FrameInfo * pFrameInfo)
 {
   GstMapInfo minfo;
-  GstBuffer *buf;
+  GstBuffer *buf = NULL;
   int buffer_size;
+  GstBufferPoolAcquireParams params = { };
 
   if (src->is_interlaced
       && src->camera_data.Format != VCESDI_OutputFormat_YCrCb10) {
@@ -521,7 +562,33 @@ gst_imperxsdisrc_create_buffer_from_frameinfo (GstImperxSdiSrc * src,
     buffer_size = src->height * src->gst_stride;
   }
 
-  buf = gst_buffer_new_and_alloc (buffer_size);
+  /* The SDK reuses its DMA buffer as soon as the callback returns and has
+   * no way to hold it, so frames are copied into pooled memory rather than
+   * wrapped. Never wait on the pool from the callback. */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  if (src->pool == NULL) {
+    GstStructure *config;
+    guint queue_size;
+
+    /* enough for a full queue and the buffer being pushed */
+    g_object_get (src, "queue-size", &queue_size, NULL);
+    src->pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (src->pool);
+    gst_buffer_pool_config_set_params (config, NULL, buffer_size,
+        queue_size + 1, 0);
+    if (!gst_buffer_pool_set_config (src->pool, config) ||
+        !gst_buffer_pool_set_active (src->pool, TRUE)) {
+      GST_WARNING_OBJECT (src, "Failed to activate buffer pool");
+      gst_object_unref (src->pool);
+      src->pool = NULL;
+    }
+  }
+  if (src->pool) {
+    gst_buffer_pool_acquire_buffer (src->pool, &buf, &params);
+  }
+  if (buf == NULL) {
+    buf = gst_buffer_new_and_alloc (buffer_size);
+  }
 
   /* Copy image to buffer from surface */
   gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
@@ -587,69 +654,65 @@ static void __stdcall
 gst_imperxsdisrc_callback (void *lpUserData, VCESDI_FrameInfo * pFrameInfo)
 {
   GstImperxSdiSrc *src = GST_IMPERX_SDI_SRC (lpUserData);
-  gint dropped_frames;
-  static guint32 last_frame_number = 0;
-  static guint64 buffers_processed = 0;
-  static guint64 total_dropped_frames = 0;
+  GstVisionGrabberFrame frame;
+  gint frame_diff;
 
   g_assert (src != NULL);
 
   /* check for DMA errors */
-  if (pFrameInfo->dma_status == DMA_STATUS_FRAME_DROPED) {
-    /* TODO: save this in dropped frame total? */
-    GST_WARNING_OBJECT (src, "Frame dropped from DMA system.");
-    return;
-  } else if (pFrameInfo->dma_status == DMA_STATUS_FIFO_OVERRUN) {
-    GST_WARNING_OBJECT (src, "DMA system reports FIFO overrun");
-    return;
-  } else if (pFrameInfo->dma_status == DMA_STATUS_ABORTED) {
-    GST_WARNING_OBJECT (src, "DMA system reports acquisition was aborted");
-    return;
-  } else if (pFrameInfo->dma_status == DMA_STATUS_DICONNECTED) {
-    GST_WARNING_OBJECT (src, "DMA system reports camera is disconnected");
-    return;
-  } else if (pFrameInfo->dma_status != DMA_STATUS_OK) {
-    GST_WARNING_OBJECT (src, "DMA system reports unknown error");
+  if (pFrameInfo->dma_status != DMA_STATUS_OK) {
+    if (pFrameInfo->dma_status == DMA_STATUS_FRAME_DROPED) {
+      GST_WARNING_OBJECT (src, "Frame dropped from DMA system.");
+    } else if (pFrameInfo->dma_status == DMA_STATUS_FIFO_OVERRUN) {
+      GST_WARNING_OBJECT (src, "DMA system reports FIFO overrun");
+    } else if (pFrameInfo->dma_status == DMA_STATUS_ABORTED) {
+      GST_WARNING_OBJECT (src, "DMA system reports acquisition was aborted");
+    } else if (pFrameInfo->dma_status == DMA_STATUS_DICONNECTED) {
+      GST_WARNING_OBJECT (src, "DMA system reports camera is disconnected");
+    } else {
+      GST_WARNING_OBJECT (src, "DMA system reports unknown error");
+    }
+    g_mutex_lock (&src->mutex);
+    src->total_dma_errors++;
+    g_mutex_unlock (&src->mutex);
     return;
   }
 
-  /* check for dropped frames and disrupted signal */
-  dropped_frames = (pFrameInfo->number - last_frame_number) - 1;
-  if (dropped_frames > 0) {
-    total_dropped_frames += dropped_frames;
-    GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-        total_dropped_frames);
-  } else if (dropped_frames < 0) {
+  /* the SDK reuses its DMA buffer once we return, so the frame is pushed as
+   * an already converted buffer */
+  gst_vision_grabber_frame_init (&frame);
+  frame.buffer = gst_imperxsdisrc_create_buffer_from_frameinfo (src,
+      pFrameInfo);
+  frame.frame_number = pFrameInfo->number;
+
+  g_mutex_lock (&src->mutex);
+
+  /* gaps are counted by the base class from the frame number, a step back
+   * means the signal was disrupted and frame timestamps restarted */
+  frame_diff = (gint) (pFrameInfo->number - src->last_frame_number);
+  if (src->buffers_processed > 0 && frame_diff <= 0) {
+    GstClockTime now =
+        gst_vision_grabber_src_get_clock_time (GST_VISION_GRABBER_SRC (src));
+
     GST_WARNING_OBJECT (src,
         "Signal disrupted, frames likely dropped and timestamps inaccurate");
 
     /* frame timestamps reset, so adjust start time, accuracy reduced */
-    src->acq_start_time =
-        gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src))) -
-        pFrameInfo->timestamp * GST_USECOND;
+    if (GST_CLOCK_TIME_IS_VALID (now)) {
+      src->acq_start_time = now - pFrameInfo->timestamp * GST_USECOND;
+    }
   }
-  last_frame_number = pFrameInfo->number;
-
-  g_mutex_lock (&src->mutex);
+  src->last_frame_number = pFrameInfo->number;
+  ++src->buffers_processed;
 
-  if (src->buffer) {
-    /* TODO: save this in dropped frame total? */
-    GST_WARNING_OBJECT (src,
-        "Got new buffer before old handled, dropping old.");
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
+  if (GST_CLOCK_TIME_IS_VALID (src->acq_start_time)) {
+    frame.clock_time =
+        src->acq_start_time + pFrameInfo->timestamp * GST_USECOND;
   }
 
-  src->buffer = gst_imperxsdisrc_create_buffer_from_frameinfo (src, pFrameInfo);
-
-  GST_BUFFER_TIMESTAMP (src->buffer) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      src->acq_start_time + pFrameInfo->timestamp * GST_USECOND);
-  GST_BUFFER_OFFSET (src->buffer) = buffers_processed;
-  ++buffers_processed;
-
-  g_cond_signal (&src->cond);
   g_mutex_unlock (&src->mutex);
+
+  gst_vision_grabber_src_push_frame (GST_VISION_GRABBER_SRC (src), &frame);
 }
 
 static gboolean
@@ -713,6 +776,23 @@ gst_imperxsdisrc_start_grab (GstImperxSdiSrc * src)
   return TRUE;
 }
 
+static gboolean
+gst_imperxsdisrc_start_acquisition (GstVisionGrabberSrc * grabber)
+{
+  GstImperxSdiSrc *src = GST_IMPERX_SDI_SRC (grabber);
+
+  GST_LOG_OBJECT (src, "starting acquisition");
+  src->acq_start_time = gst_vision_grabber_src_get_clock_time (grabber);
+  if (!gst_imperxsdisrc_start_grab (src)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Failed to start grabbing"), (NULL));
+    return FALSE;
+  }
+  src->acq_started = TRUE;
+
+  return TRUE;
+}
+
 static gboolean
 gst_imperxsdisrc_stop (GstBaseSrc * bsrc)
 {
@@ -730,6 +810,9 @@ gst_imperxsdisrc_stop (GstBaseSrc * bsrc)
     src->acq_started = FALSE;
   }
 
+  /* frames are converted buffers, nothing points into DMA memory */
+  GST_BASE_SRC_CLASS (gst_imperxsdisrc_parent_class)->stop (bsrc);
+
   if (src->grabber) {
     err = VCESDI_ReleaseDMAAccess (src->grabber, PORT_VIDEO);
     if (err) {
@@ -799,80 +882,6 @@ unsupported_caps:
   return FALSE;
 }
 
-static gboolean
-gst_imperxsdisrc_unlock (GstBaseSrc * bsrc)
-{
-  GstImperxSdiSrc *src = GST_IMPERX_SDI_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock");
-
-  g_mutex_lock (&src->mutex);
-  src->stop_requested = TRUE;
-  g_cond_signal (&src->cond);
-  g_mutex_unlock (&src->mutex);
-
-  return TRUE;
-}
-
-static gboolean
-gst_imperxsdisrc_unlock_stop (GstBaseSrc * bsrc)
-{
-  GstImperxSdiSrc *src = GST_IMPERX_SDI_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock_stop");
-
-  src->stop_requested = FALSE;
-
-  return TRUE;
-}
-
-static GstFlowReturn
-gst_imperxsdisrc_create (GstPushSrc * psrc, GstBuffer ** buf)
-{
-  GstImperxSdiSrc *src = GST_IMPERX_SDI_SRC (psrc);
-  gint64 end_time;
-
-  GST_LOG_OBJECT (src, "create");
-
-  /* Start acquisition if not already started */
-  if (G_UNLIKELY (!src->acq_started)) {
-    GST_LOG_OBJECT (src, "starting acquisition");
-    src->acq_start_time =
-        gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src)));
-    if (!gst_imperxsdisrc_start_grab (src)) {
-      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-          ("Failed to start grabbing"), (NULL));
-      return GST_FLOW_ERROR;
-    }
-    src->acq_started = TRUE;
-  }
-
-  /* wait for a buffer to be ready */
-  g_mutex_lock (&src->mutex);
-  end_time = g_get_monotonic_time () + src->timeout * G_TIME_SPAN_MILLISECOND;
-  while (!src->buffer && !src->stop_requested) {
-    if (!g_cond_wait_until (&src->cond, &src->mutex, end_time)) {
-      g_mutex_unlock (&src->mutex);
-      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-          ("Timeout, no data received after %d ms", src->timeout), (NULL));
-      return GST_FLOW_ERROR;
-    }
-  }
-  *buf = src->buffer;
-  src->buffer = NULL;
-  g_mutex_unlock (&src->mutex);
-
-  if (src->stop_requested) {
-    if (*buf != NULL) {
-      gst_buffer_unref (*buf);
-      *buf = NULL;
-    }
-    return GST_FLOW_FLUSHING;
-  }
-
-  return GST_FLOW_OK;
-}
-
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
@@ -20,7 +20,7 @@
 #ifndef _GST_IMPERX_SDI_SRC_H_
 #define _GST_IMPERX_SDI_SRC_H_
 
-#include <gst/base/gstpushsrc.h>
+#include "gstvisiongrabbersrc.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -41,7 +41,7 @@ typedef struct _GstImperxSdiSrcClass GstImperxSdiSrcClass;
 
 struct _GstImperxSdiSrc
 {
-  GstPushSrc base_imperxsdisrc;
+  GstVisionGrabberSrc base_imperxsdisrc;
 
   gboolean acq_started;
 
@@ -54,9 +54,15 @@ struct _GstImperxSdiSrc
   guint board;
   gint timeout;
 
-  GstBuffer *buffer;
+  /* frames are converted into pooled buffers in the callback */
+  GstBufferPool *pool;
   GstClockTime acq_start_time;
 
+  /* frame accounting, protected by mutex */
+  guint32 last_frame_number;
+  guint64 buffers_processed;
+  guint64 total_dma_errors;
+
   GstCaps *caps;
   GstVideoFormat format;
   gint width;
@@ -67,13 +73,11 @@ struct _GstImperxSdiSrc
   gint imperx_stride;
 
   GMutex mutex;
-  GCond cond;
-  gboolean stop_requested;
 };
 
 struct _GstImperxSdiSrcClass
 {
-  GstPushSrcClass base_imperxsdisrc_class;
+  GstVisionGrabberSrcClass base_imperxsdisrc_class;
 };
 
 GType gst_imperxsdisrc_get_type (void);
@@ -62,12 +62,22 @@ static GstFlowReturn gst_kayasink_render (GstBaseSink * basesink,
     GstBuffer * buffer);
 static gboolean gst_kayasink_unlock (GstBaseSink * basesink);
 static gboolean gst_kayasink_unlock_stop (GstBaseSink * basesink);
+static gboolean gst_kayasink_propose_allocation (GstBaseSink * basesink,
+    GstQuery * query);
 
 static void gst_kayasink_camera_callback (GstKayaSink * sink,
     STREAM_HANDLE streamHandle);
 static void gst_kayasink_device_event_callback (GstKayaSink * sink,
     KYDEVICE_EVENT * pEvent);
 static gboolean gst_kayasink_set_kaya_caps (GstKayaSink * sink, GstCaps * caps);
+static gboolean gst_kayasink_create_stream (GstKayaSink * sink);
+static void gst_kayasink_destroy_stream (GstKayaSink * sink,
+    gboolean close_camera);
+static gint gst_kayasink_acquire_slot (GstKayaSink * sink,
+    GstBufferPool * pool, gint timeout);
+static void gst_kayasink_finish_slot (GstKayaSink * sink, gint index);
+static void gst_kayasink_return_slot (GstKayaSink * sink, gint index,
+    GstBuffer * buffer);
 
 enum
 {
@@ -109,6 +119,166 @@ GST_DEBUG_CATEGORY_STATIC (kayasink_debug);
 
 G_DEFINE_TYPE (GstKayaSink, gst_kayasink, GST_TYPE_BASE_SINK);
 
+/* Buffer pool whose buffers are the Kaya stream buffers themselves. Buffers
+ * are handed out in the order the stream sends them, and only return to the
+ * pool once they have been sent. When the stream is destroyed while upstream
+ * still holds buffers, the pool takes over the stream, and on stop also the
+ * camera and its framegrabber reference, and releases them once the last
+ * buffer has been released. */
+typedef struct
+{
+  GstBufferPool parent;
+  GstKayaSink *sink;
+  STREAM_HANDLE stream_handle;
+  CAMHANDLE cam_handle;
+  GstKayaSinkFramegrabber *fg_data;
+} GstKayaSinkPool;
+
+typedef struct
+{
+  GstBufferPoolClass parent_class;
+} GstKayaSinkPoolClass;
+
+#define GST_TYPE_KAYASINK_POOL (gst_kayasink_pool_get_type())
+#define GST_KAYASINK_POOL(obj) ((GstKayaSinkPool *) (obj))
+
+static GType gst_kayasink_pool_get_type (void);
+
+G_DEFINE_TYPE (GstKayaSinkPool, gst_kayasink_pool, GST_TYPE_BUFFER_POOL);
+
+static GQuark gst_kayasink_slot_quark;
+
+/* close a camera and drop its framegrabber reference, closing the
+ * framegrabber with the last one */
+static void
+gst_kayasink_close_camera (GstKayaSink * sink, CAMHANDLE cam_handle,
+    GstKayaSinkFramegrabber * fg_data)
+{
+  if (cam_handle != INVALID_CAMHANDLE) {
+    KYFG_CameraClose (cam_handle);
+  }
+
+  if (fg_data) {
+    g_mutex_lock (&fg_data->fg_mutex);
+    GST_DEBUG_OBJECT (sink, "Framegrabber open with refcount=%d",
+        fg_data->ref_count);
+    fg_data->ref_count--;
+    if (fg_data->ref_count == 0) {
+      GST_DEBUG_OBJECT (sink, "Framegrabber ref dropped to 0, closing");
+      KYFG_Close (fg_data->fg_handle);
+      fg_data->fg_handle = INVALID_FGHANDLE;
+    }
+    g_mutex_unlock (&fg_data->fg_mutex);
+  }
+}
+
+static gboolean
+gst_kayasink_pool_start (GstBufferPool * bpool)
+{
+  /* buffers already exist as stream buffers, nothing to preallocate */
+  return TRUE;
+}
+
+static gboolean
+gst_kayasink_pool_stop (GstBufferPool * bpool)
+{
+  return TRUE;
+}
+
+static void
+gst_kayasink_pool_flush_start (GstBufferPool * bpool)
+{
+  GstKayaSink *sink = GST_KAYASINK_POOL (bpool)->sink;
+
+  /* wake up acquire_buffer */
+  g_mutex_lock (&sink->mutex);
+  g_cond_broadcast (&sink->cond);
+  g_mutex_unlock (&sink->mutex);
+}
+
+static GstFlowReturn
+gst_kayasink_pool_acquire_buffer (GstBufferPool * bpool, GstBuffer ** buffer,
+    GstBufferPoolAcquireParams * params)
+{
+  GstKayaSink *sink = GST_KAYASINK_POOL (bpool)->sink;
+  gboolean dontwait = params &&
+      (params->flags & GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT);
+  gint index;
+
+  index = gst_kayasink_acquire_slot (sink, bpool, dontwait ? 0 : -1);
+  if (index < 0) {
+    return dontwait ? GST_FLOW_EOS : GST_FLOW_FLUSHING;
+  }
+
+  g_mutex_lock (&sink->mutex);
+  *buffer = sink->slot_buffers[index];
+  sink->slot_buffers[index] = NULL;
+  g_mutex_unlock (&sink->mutex);
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_kayasink_pool_release_buffer (GstBufferPool * bpool, GstBuffer * buffer)
+{
+  GstKayaSink *sink = GST_KAYASINK_POOL (bpool)->sink;
+  gint index = GPOINTER_TO_INT (gst_mini_object_get_qdata (GST_MINI_OBJECT
+          (buffer), gst_kayasink_slot_quark)) - 1;
+
+  g_mutex_lock (&sink->mutex);
+  if (bpool != sink->pool) {
+    /* stream was destroyed while upstream held this buffer */
+    g_mutex_unlock (&sink->mutex);
+    gst_buffer_unref (buffer);
+    return;
+  }
+  g_mutex_unlock (&sink->mutex);
+
+  gst_kayasink_return_slot (sink, index, buffer);
+}
+
+static void
+gst_kayasink_pool_finalize (GObject * object)
+{
+  GstKayaSinkPool *pool = GST_KAYASINK_POOL (object);
+
+  if (pool->stream_handle != INVALID_STREAMHANDLE) {
+    GST_DEBUG_OBJECT (pool->sink, "Last buffer of old pool released, "
+        "deleting stream");
+    KYFG_StreamDelete (pool->stream_handle);
+  }
+
+  /* the stream must be deleted before its camera is closed */
+  gst_kayasink_close_camera (pool->sink, pool->cam_handle, pool->fg_data);
+
+  gst_object_unref (pool->sink);
+
+  G_OBJECT_CLASS (gst_kayasink_pool_parent_class)->finalize (object);
+}
+
+static void
+gst_kayasink_pool_class_init (GstKayaSinkPoolClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBufferPoolClass *pool_class = GST_BUFFER_POOL_CLASS (klass);
+
+  gobject_class->finalize = gst_kayasink_pool_finalize;
+
+  pool_class->start = gst_kayasink_pool_start;
+  pool_class->stop = gst_kayasink_pool_stop;
+  pool_class->flush_start = gst_kayasink_pool_flush_start;
+  pool_class->acquire_buffer = gst_kayasink_pool_acquire_buffer;
+  pool_class->release_buffer = gst_kayasink_pool_release_buffer;
+}
+
+static void
+gst_kayasink_pool_init (GstKayaSinkPool * pool)
+{
+  pool->stream_handle = INVALID_STREAMHANDLE;
+  pool->cam_handle = INVALID_CAMHANDLE;
+  pool->fg_data = NULL;
+}
+
 static void
 gst_kayasink_class_init (GstKayaSinkClass * klass)
 {
@@ -137,6 +307,10 @@ gst_kayasink_class_init (GstKayaSinkClass * klass)
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_kayasink_render);
   gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_kayasink_unlock);
   gstbasesink_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_kayasink_unlock_stop);
+  gstbasesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_kayasink_propose_allocation);
+
+  gst_kayasink_slot_quark = g_quark_from_static_string ("GstKayaSinkSlot");
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_INTERFACE_INDEX,
@@ -158,7 +332,7 @@ gst_kayasink_class_init (GstKayaSinkClass * klass)
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_TIMEOUT,
       g_param_spec_int ("timeout", "Timeout (ms)",
-          "Timeout in ms (0 to use default)", 0, G_MAXINT,
+          "Timeout in ms to wait for a free stream buffer (0 to wait forever)", 0, G_MAXINT,
           DEFAULT_PROP_TIMEOUT,
           (GParamFlags) (G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE)));
   g_object_class_install_property (gobject_class, PROP_PROJECT_FILE,
@@ -199,24 +373,13 @@ gst_kayasink_cleanup (GstKayaSink * sink)
     KYFG_CameraCallbackUnregister (sink->cam_handle,
         gst_kayasink_camera_callback);
     KYFG_CameraStop (sink->cam_handle);
-    KYFG_CameraClose (sink->cam_handle);
-    sink->stream_handle = INVALID_STREAMHANDLE;
-    sink->cam_handle = INVALID_CAMHANDLE;
+    /* hands the camera to the pool if upstream still holds buffers */
+    gst_kayasink_destroy_stream (sink, TRUE);
   }
 
-  if (sink->fg_data) {
-    g_mutex_lock (&sink->fg_data->fg_mutex);
-    GST_DEBUG_OBJECT (sink, "Framegrabber open with refcount=%d",
-        sink->fg_data->ref_count);
-    sink->fg_data->ref_count--;
-    if (sink->fg_data->ref_count == 0) {
-      GST_DEBUG_OBJECT (sink, "Framegrabber ref dropped to 0, closing");
-      KYFG_Close (sink->fg_data->fg_handle);
-      sink->fg_data->fg_handle = INVALID_FGHANDLE;
-    }
-    g_mutex_unlock (&sink->fg_data->fg_mutex);
-    sink->fg_data = NULL;
-  }
+  gst_kayasink_close_camera (sink, sink->cam_handle, sink->fg_data);
+  sink->cam_handle = INVALID_CAMHANDLE;
+  sink->fg_data = NULL;
 }
 
 static void
@@ -232,7 +395,14 @@ gst_kayasink_init (GstKayaSink * sink)
   sink->wait_for_receiver = TRUE;
   sink->wait_timeout = 10000;
 
-  sink->queue = g_async_queue_new ();
+  sink->stream_handle = INVALID_STREAMHANDLE;
+  sink->pool = NULL;
+  sink->num_slots = 0;
+  sink->slot_ptrs = NULL;
+  sink->slot_states = NULL;
+  sink->slot_buffers = NULL;
+  sink->fill_index = 0;
+  sink->next_send_index = 0;
 
   sink->receiver_connected = FALSE;
 
@@ -528,9 +698,292 @@ gst_kayasink_set_caps (GstBaseSink * basesink, GstCaps * caps)
 
   GST_DEBUG_OBJECT (sink, "Caps being set");
 
+  if (sink->stream_handle != INVALID_STREAMHANDLE) {
+    if (sink->receiver_connected) {
+      GST_ELEMENT_ERROR (sink, LIBRARY, FAILED,
+          ("Can't change caps while receiver is connected"), (NULL));
+      return FALSE;
+    }
+    gst_kayasink_destroy_stream (sink, FALSE);
+  }
+
   if (!gst_kayasink_set_kaya_caps (sink, caps))
     return FALSE;
 
+  if (!gst_kayasink_create_stream (sink))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gst_kayasink_create_stream (GstKayaSink * sink)
+{
+  FGSTATUS ret;
+  guint i;
+
+  ret = KYFG_StreamCreateAndAlloc (sink->cam_handle, &sink->stream_handle,
+      sink->num_render_buffers, 0);
+  if (ret != FGSTATUS_OK || sink->stream_handle == INVALID_STREAMHANDLE) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, FAILED,
+        ("Failed to create stream"), (NULL));
+    sink->stream_handle = INVALID_STREAMHANDLE;
+    return FALSE;
+  }
+
+  sink->frame_size = KYFG_StreamGetSize (sink->stream_handle);
+  sink->kaya_stride = (gint) (sink->frame_size / sink->vinfo.height);
+  GST_DEBUG_OBJECT (sink, "Created stream with %d buffers of %"
+      G_GINT64_FORMAT " bytes, stride %d", sink->num_render_buffers,
+      sink->frame_size, sink->kaya_stride);
+
+  g_mutex_lock (&sink->mutex);
+  sink->num_slots = sink->num_render_buffers;
+  sink->slot_ptrs = g_new0 (guint8 *, sink->num_slots);
+  sink->slot_states = g_new0 (GstKayaSinkSlotState, sink->num_slots);
+  sink->slot_buffers = g_new0 (GstBuffer *, sink->num_slots);
+  for (i = 0; i < sink->num_slots; ++i) {
+    gsize size = MIN (sink->frame_size, GST_VIDEO_INFO_SIZE (&sink->vinfo));
+
+    sink->slot_ptrs[i] = (guint8 *) KYFG_StreamGetPtr (sink->stream_handle, i);
+    sink->slot_buffers[i] = gst_buffer_new ();
+    gst_buffer_append_memory (sink->slot_buffers[i],
+        gst_memory_new_wrapped ((GstMemoryFlags) 0, sink->slot_ptrs[i],
+            sink->frame_size, 0, size, NULL, NULL));
+    gst_mini_object_set_qdata (GST_MINI_OBJECT (sink->slot_buffers[i]),
+        gst_kayasink_slot_quark, GINT_TO_POINTER (i + 1), NULL);
+    sink->slot_states[i] = GST_KAYASINK_SLOT_FREE;
+  }
+  sink->fill_index = 0;
+  sink->next_send_index = 0;
+
+  /* upstream can only write directly into stream buffers when they are
+   * laid out the way GstVideoInfo expects, otherwise render converts */
+  if (sink->kaya_stride == GST_VIDEO_INFO_PLANE_STRIDE (&sink->vinfo, 0) &&
+      sink->frame_size >= (gint64) GST_VIDEO_INFO_SIZE (&sink->vinfo)) {
+    GstKayaSinkPool *pool = (GstKayaSinkPool *)
+        g_object_new (GST_TYPE_KAYASINK_POOL, NULL);
+    pool->sink = (GstKayaSink *) gst_object_ref (sink);
+    sink->pool = GST_BUFFER_POOL (pool);
+  } else {
+    GST_DEBUG_OBJECT (sink, "Stream stride %d differs from video stride %d, "
+        "frames will be copied", sink->kaya_stride,
+        GST_VIDEO_INFO_PLANE_STRIDE (&sink->vinfo, 0));
+  }
+  g_mutex_unlock (&sink->mutex);
+
+  return TRUE;
+}
+
+/* With close_camera, a pool that takes over the stream also takes over the
+ * camera and framegrabber reference, so they are closed after the stream is
+ * deleted. */
+void
+gst_kayasink_destroy_stream (GstKayaSink * sink, gboolean close_camera)
+{
+  GstBufferPool *pool;
+  guint i;
+
+  g_mutex_lock (&sink->mutex);
+  for (i = 0; i < sink->num_slots; ++i) {
+    if (sink->slot_buffers[i]) {
+      gst_buffer_unref (sink->slot_buffers[i]);
+    }
+  }
+  g_free (sink->slot_ptrs);
+  g_free (sink->slot_states);
+  g_free (sink->slot_buffers);
+  sink->slot_ptrs = NULL;
+  sink->slot_states = NULL;
+  sink->slot_buffers = NULL;
+  sink->num_slots = 0;
+  g_cond_broadcast (&sink->cond);
+
+  /* outstanding pool buffers are freed when upstream releases them */
+  pool = sink->pool;
+  sink->pool = NULL;
+  g_mutex_unlock (&sink->mutex);
+
+  if (sink->stream_handle != INVALID_STREAMHANDLE) {
+    if (pool) {
+      /* upstream may still be writing into stream memory, the pool deletes
+       * the stream when it has been drained */
+      GST_KAYASINK_POOL (pool)->stream_handle = sink->stream_handle;
+      if (close_camera) {
+        GST_KAYASINK_POOL (pool)->cam_handle = sink->cam_handle;
+        GST_KAYASINK_POOL (pool)->fg_data = sink->fg_data;
+        sink->cam_handle = INVALID_CAMHANDLE;
+        sink->fg_data = NULL;
+      }
+    } else {
+      KYFG_StreamDelete (sink->stream_handle);
+    }
+    sink->stream_handle = INVALID_STREAMHANDLE;
+  }
+
+  if (pool) {
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
+  }
+}
+
+/* Must be called with the mutex held. The stream sends its buffers round
+ * robin without waiting for us, so while a receiver is connected a slot is
+ * only filled right after it was sent, which leaves the time it takes to
+ * send all other slots to fill it. Slots are filled in sending order. */
+static gboolean
+gst_kayasink_slot_fillable_unlocked (GstKayaSink * sink, guint index)
+{
+  if (sink->slot_states[index] != GST_KAYASINK_SLOT_FREE ||
+      sink->slot_buffers[index] == NULL) {
+    return FALSE;
+  }
+
+  if (sink->receiver_connected && sink->num_slots > 1) {
+    return index ==
+        (sink->next_send_index + sink->num_slots - 1) % sink->num_slots;
+  }
+
+  return TRUE;
+}
+
+/* Wait up to timeout ms (-1 for no limit) for the next stream buffer to
+ * fill, returns -1 on timeout, stop or flush */
+gint
+gst_kayasink_acquire_slot (GstKayaSink * sink, GstBufferPool * pool,
+    gint timeout)
+{
+  gint64 end_time = g_get_monotonic_time () +
+      timeout * G_TIME_SPAN_MILLISECOND;
+  gint index;
+
+  g_mutex_lock (&sink->mutex);
+  while (TRUE) {
+    if (sink->num_slots == 0 || sink->stop_requested ||
+        (pool && (pool != sink->pool || GST_BUFFER_POOL_IS_FLUSHING (pool)))) {
+      g_mutex_unlock (&sink->mutex);
+      return -1;
+    }
+
+    index = (gint) sink->fill_index;
+    if (gst_kayasink_slot_fillable_unlocked (sink, index)) {
+      break;
+    }
+
+    if (timeout == 0) {
+      g_mutex_unlock (&sink->mutex);
+      return -1;
+    } else if (timeout < 0) {
+      g_cond_wait (&sink->cond, &sink->mutex);
+    } else if (!g_cond_wait_until (&sink->cond, &sink->mutex, end_time)) {
+      g_mutex_unlock (&sink->mutex);
+      return -1;
+    }
+  }
+
+  sink->slot_states[index] = GST_KAYASINK_SLOT_FILLING;
+  sink->fill_index = (sink->fill_index + 1) % sink->num_slots;
+  g_mutex_unlock (&sink->mutex);
+
+  return index;
+}
+
+/* Must be called with the mutex held. A slot can only be refilled once it
+ * is free and its buffer is back from upstream, so whoever completes the
+ * second of the two wakes up acquire_slot. */
+static void
+gst_kayasink_free_slot_unlocked (GstKayaSink * sink, gint index)
+{
+  sink->slot_states[index] = GST_KAYASINK_SLOT_FREE;
+  if (sink->slot_buffers[index]) {
+    g_cond_broadcast (&sink->cond);
+  }
+}
+
+/* Called from render only, mark a stream buffer as filled, or free if
+ * nobody will send it */
+void
+gst_kayasink_finish_slot (GstKayaSink * sink, gint index)
+{
+  g_mutex_lock (&sink->mutex);
+  if (sink->slot_states[index] == GST_KAYASINK_SLOT_FILLING) {
+    if (sink->receiver_connected) {
+      sink->slot_states[index] = GST_KAYASINK_SLOT_READY;
+    } else {
+      gst_kayasink_free_slot_unlocked (sink, index);
+    }
+  }
+  g_mutex_unlock (&sink->mutex);
+}
+
+/* Give back a stream buffer without sending it, and its GstBuffer if it was
+ * handed out through the pool. Buffers that were rendered stay ready. */
+void
+gst_kayasink_return_slot (GstKayaSink * sink, gint index, GstBuffer * buffer)
+{
+  g_mutex_lock (&sink->mutex);
+  if (buffer) {
+    sink->slot_buffers[index] = buffer;
+  }
+  switch (sink->slot_states[index]) {
+    case GST_KAYASINK_SLOT_FILLING:
+      /* dropped, flushed or never rendered */
+      gst_kayasink_free_slot_unlocked (sink, index);
+      break;
+    case GST_KAYASINK_SLOT_FREE:
+      /* rendered and already sent while upstream still held the buffer */
+      if (buffer) {
+        g_cond_broadcast (&sink->cond);
+      }
+      break;
+    case GST_KAYASINK_SLOT_READY:
+      /* rendered, the camera callback frees it once sent */
+      break;
+  }
+  g_mutex_unlock (&sink->mutex);
+}
+
+gboolean
+gst_kayasink_propose_allocation (GstBaseSink * basesink, GstQuery * query)
+{
+  GstKayaSink *sink = GST_KAYASINK (basesink);
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstVideoInfo info;
+  GstCaps *caps;
+  gboolean need_pool;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (caps == NULL || !gst_video_info_from_caps (&info, caps)) {
+    return FALSE;
+  }
+
+  g_mutex_lock (&sink->mutex);
+  if (sink->pool && GST_VIDEO_INFO_FORMAT (&info) ==
+      GST_VIDEO_INFO_FORMAT (&sink->vinfo) &&
+      GST_VIDEO_INFO_SIZE (&info) == GST_VIDEO_INFO_SIZE (&sink->vinfo)) {
+    pool = (GstBufferPool *) gst_object_ref (sink->pool);
+  }
+  g_mutex_unlock (&sink->mutex);
+
+  if (pool == NULL) {
+    GST_DEBUG_OBJECT (sink, "Not offering stream buffer pool, will copy");
+    return TRUE;
+  }
+
+  if (need_pool && !gst_buffer_pool_is_active (pool)) {
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, info.size, 0,
+        sink->num_slots);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_WARNING_OBJECT (sink, "Failed to configure stream buffer pool");
+    }
+  }
+
+  gst_query_add_allocation_pool (query, need_pool ? pool : NULL, info.size,
+      0, sink->num_slots);
+  gst_object_unref (pool);
+
   return TRUE;
 }
 
@@ -606,6 +1059,54 @@ error:
   return FALSE;
 }
 
+static GstFlowReturn
+gst_kayasink_copy_to_slot (GstKayaSink * sink, GstBuffer * buffer)
+{
+  GstVideoFrame frame;
+  guint8 *src, *dst;
+  gint src_stride, row_size, i, index;
+
+  index = gst_kayasink_acquire_slot (sink, NULL,
+      sink->timeout ? sink->timeout : -1);
+  if (index < 0) {
+    if (sink->stop_requested) {
+      GST_DEBUG_OBJECT (sink, "stop requested, flushing");
+      return GST_FLOW_FLUSHING;
+    }
+    GST_ELEMENT_WARNING (sink, RESOURCE, FAILED,
+        ("No stream buffer was sent in %d ms, dropping frame", sink->timeout),
+        (NULL));
+    return GST_FLOW_OK;
+  }
+
+  if (!gst_video_frame_map (&frame, &sink->vinfo, buffer, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, FAILED,
+        ("Failed to map buffer"), (NULL));
+    gst_kayasink_return_slot (sink, index, NULL);
+    return GST_FLOW_ERROR;
+  }
+
+  GST_LOG_OBJECT (sink, "Copying frame to stream buffer %d", index);
+
+  /* convert from whatever stride upstream used to the stream stride */
+  src = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+  src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+  dst = sink->slot_ptrs[index];
+  row_size = MIN (src_stride, sink->kaya_stride);
+  if (src_stride == sink->kaya_stride) {
+    memcpy (dst, src, (gsize) row_size * sink->vinfo.height);
+  } else {
+    for (i = 0; i < sink->vinfo.height; ++i) {
+      memcpy (dst + i * sink->kaya_stride, src + i * src_stride, row_size);
+    }
+  }
+  gst_video_frame_unmap (&frame);
+
+  gst_kayasink_finish_slot (sink, index);
+
+  return GST_FLOW_OK;
+}
+
 GstFlowReturn
 gst_kayasink_render (GstBaseSink * basesink, GstBuffer * buffer)
 {
@@ -663,9 +1164,15 @@ gst_kayasink_render (GstBaseSink * basesink, GstBuffer * buffer)
   //}
   //g_mutex_unlock (&sink->mutex);
 
-  g_async_queue_push (sink->queue, gst_buffer_ref (buffer));
+  if (sink->pool && buffer->pool == sink->pool) {
+    /* upstream rendered directly into a stream buffer, it is sent even if
+     * upstream still holds it, and returns to the pool after both */
+    gst_kayasink_finish_slot (sink, GPOINTER_TO_INT (gst_mini_object_get_qdata
+            (GST_MINI_OBJECT (buffer), gst_kayasink_slot_quark)) - 1);
+    return GST_FLOW_OK;
+  }
 
-  return GST_FLOW_OK;
+  return gst_kayasink_copy_to_slot (sink, buffer);
 }
 
 gboolean
@@ -675,7 +1182,7 @@ gst_kayasink_unlock (GstBaseSink * basesink)
 
   g_mutex_lock (&sink->mutex);
   sink->stop_requested = TRUE;
-  g_cond_signal (&sink->cond);
+  g_cond_broadcast (&sink->cond);
   g_mutex_unlock (&sink->mutex);
 
   return TRUE;
@@ -703,13 +1210,11 @@ gst_kayasink_device_event_callback (GstKayaSink * sink, KYDEVICE_EVENT * pEvent)
           ((KYDEVICE_EVENT_CAMERA_START *) pEvent)->camHandle;
       if (eventCameraHandle == sink->cam_handle) {
         GST_DEBUG_OBJECT (sink, "Detected remote request to start generation");
-        //StartGeneration();
-        ret =
-            KYFG_StreamCreateAndAlloc (sink->cam_handle, &sink->stream_handle,
-            sink->num_render_buffers, 0);
-        if (ret != FGSTATUS_OK) {
+        /* stream is created when caps are set */
+        if (sink->stream_handle == INVALID_STREAMHANDLE) {
           GST_ELEMENT_WARNING (sink, RESOURCE, FAILED,
-              ("Failed to create stream"), (NULL));
+              ("Receiver requested stream before caps were negotiated"),
+              (NULL));
           return;
         }
 
@@ -718,7 +1223,8 @@ gst_kayasink_device_event_callback (GstKayaSink * sink, KYDEVICE_EVENT * pEvent)
 
         g_mutex_lock (&sink->mutex);
         sink->receiver_connected = TRUE;
-        g_cond_signal (&sink->cond);
+        sink->next_send_index = 0;
+        g_cond_broadcast (&sink->cond);
         g_mutex_unlock (&sink->mutex);
       } else {
         GST_WARNING_OBJECT (sink,
@@ -729,14 +1235,13 @@ gst_kayasink_device_event_callback (GstKayaSink * sink, KYDEVICE_EVENT * pEvent)
   }
 }
 
+/* Called by the driver each time a stream buffer has been sent. This must
+ * never block, so it only recycles the buffer that was just sent. */
 void
 gst_kayasink_camera_callback (GstKayaSink * sink, STREAM_HANDLE streamHandle)
 {
-  uint32_t currentIndex;        // Indicates the Nth frame that was currently send.
-  void *ptr;                    // Pointer to current frame the data
-  int64_t size;                 // Size of each frame in bytes
-  GstBuffer *buf;
-  GstMapInfo minfo;
+  guint32 currentIndex;         // Indicates the Nth frame that was currently send.
+  guint i;
 
   if (!streamHandle) {
     // callback with streamHandle == 0 indicates that stream generation has stopped
@@ -745,7 +1250,13 @@ gst_kayasink_camera_callback (GstKayaSink * sink, STREAM_HANDLE streamHandle)
 
     g_mutex_lock (&sink->mutex);
     sink->receiver_connected = FALSE;
-    g_cond_signal (&sink->cond);
+    /* nothing will be sent anymore, so ready buffers can be refilled */
+    for (i = 0; i < sink->num_slots; ++i) {
+      if (sink->slot_states[i] == GST_KAYASINK_SLOT_READY) {
+        gst_kayasink_free_slot_unlocked (sink, i);
+      }
+    }
+    g_cond_broadcast (&sink->cond);
     g_mutex_unlock (&sink->mutex);
 
     return;
@@ -753,32 +1264,30 @@ gst_kayasink_camera_callback (GstKayaSink * sink, STREAM_HANDLE streamHandle)
 
   currentIndex = KYFG_StreamGetFrameIndex (streamHandle);
 
-  ptr = KYFG_StreamGetPtr (streamHandle, currentIndex);
-  size = KYFG_StreamGetSize (streamHandle);
-
-  GST_DEBUG_OBJECT (sink, "Copying new frame to index %d", currentIndex);
-
-  //g_mutex_lock(&sink->mutex);
-
-  //while (g_async_queue_length(sink->queue) == 0 && !sink->flushing) {
-  //    g_cond_wait(&sink->cond, &sink->mutex);
-  //}
-  //if (sink->flushing) {
-  //    return;
-  //}
-  buf =
-      GST_BUFFER (g_async_queue_timeout_pop (sink->queue,
-          sink->timeout * 1000));
-  if (!buf) {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_READ,
-        ("Failed to get buffer in %d ms", sink->timeout), (NULL));
+  g_mutex_lock (&sink->mutex);
+  if (currentIndex >= sink->num_slots) {
+    g_mutex_unlock (&sink->mutex);
     return;
   }
 
-  gst_buffer_map (buf, &minfo, GST_MAP_READ);
-  /* TODO: fix stride? */
-  g_assert (minfo.size <= (gsize) size);
-  memcpy (ptr, minfo.data, minfo.size);
-  gst_buffer_unmap (buf, &minfo);
-  gst_buffer_unref (buf);
+  /* the slot just sent is the one that is sent last again */
+  sink->next_send_index = (currentIndex + 1) % sink->num_slots;
+  g_cond_broadcast (&sink->cond);
+
+  switch (sink->slot_states[currentIndex]) {
+    case GST_KAYASINK_SLOT_READY:
+      GST_LOG_OBJECT (sink, "Sent frame %d", currentIndex);
+      gst_kayasink_free_slot_unlocked (sink, currentIndex);
+      break;
+    case GST_KAYASINK_SLOT_FILLING:
+      /* filling took longer than sending all other slots */
+      GST_WARNING_OBJECT (sink, "Frame %d sent while still being filled",
+          currentIndex);
+      break;
+    case GST_KAYASINK_SLOT_FREE:
+      GST_LOG_OBJECT (sink, "No new frame, frame %d sent again",
+          currentIndex);
+      break;
+  }
+  g_mutex_unlock (&sink->mutex);
 }
@@ -43,6 +43,12 @@ typedef struct _GstKayaSinkClass GstKayaSinkClass;
 
 typedef struct _GstKayaSinkFramegrabber GstKayaSinkFramegrabber;
 
+typedef enum {
+    GST_KAYASINK_SLOT_FREE,     /* sent, can be filled once it is fill_index */
+    GST_KAYASINK_SLOT_FILLING,  /* handed to upstream or render to fill */
+    GST_KAYASINK_SLOT_READY     /* filled, waiting to be sent */
+} GstKayaSinkSlotState;
+
 struct _GstKayaSink
 {
   GstBaseSink base;
@@ -65,7 +71,17 @@ struct _GstKayaSink
   gboolean receiver_connected;
   GstVideoInfo vinfo;
 
-  GAsyncQueue* queue;
+  /* stream buffers, upstream writes into them directly through pool */
+  GstBufferPool* pool;
+  guint num_slots;
+  guint8** slot_ptrs;
+  GstKayaSinkSlotState* slot_states;
+  GstBuffer** slot_buffers;
+  /* slots are filled in the order the stream sends them */
+  guint fill_index;
+  guint next_send_index;
+  gint64 frame_size;
+  gint kaya_stride;
   
   GMutex mutex;
   GCond cond;
@@ -65,10 +65,12 @@ static gboolean gst_kayasrc_start (GstBaseSrc * src);
 static gboolean gst_kayasrc_stop (GstBaseSrc * src);
 static GstCaps *gst_kayasrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_kayasrc_set_caps (GstBaseSrc * src, GstCaps * caps);
-static gboolean gst_kayasrc_unlock (GstBaseSrc * src);
-static gboolean gst_kayasrc_unlock_stop (GstBaseSrc * src);
 
-static GstFlowReturn gst_kayasrc_create (GstPushSrc * src, GstBuffer ** buf);
+static gboolean gst_kayasrc_start_acquisition (GstVisionGrabberSrc * src);
+static void gst_kayasrc_release_frame (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame);
+static GstFlowReturn gst_kayasrc_prepare_buffer (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame, GstBuffer * buf);
 
 static void gst_kayasrc_stream_buffer_callback (STREAM_BUFFER_HANDLE
     buffer_handle, void *context);
@@ -86,7 +88,9 @@ enum
   PROP_PROJECT_FILE,
   PROP_XML_FILE,
   PROP_EXPOSURE_TIME,
-  PROP_EXECUTE_COMMAND
+  PROP_EXECUTE_COMMAND,
+  PROP_QUEUED_FRAMES,
+  PROP_QUEUE_DROPPED_FRAMES
 };
 
 #define DEFAULT_PROP_INTERFACE_INDEX 0
@@ -108,7 +112,8 @@ static GstStaticPadTemplate gst_kayasrc_src_template =
         ("{ GRAY8, GRAY16_LE, GRAY16_BE, BGRA, UYVY }") ";"
         GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER8 ("{ bggr, grbg, rggb, gbrg }") ";"
         GST_GENICAM_PIXEL_FORMAT_MAKE_BAYER16
-        ("{ bggr16, grbg16, rggb16, gbrg16 }", "1234")
+        ("{ bggr16, grbg16, rggb16, gbrg16 }", "1234") ";"
+        GST_GENICAM_PIXEL_FORMAT_CAPS_PACKED
     )
     );
 
@@ -120,7 +125,7 @@ static GstStaticCaps unix_reference = GST_STATIC_CAPS ("timestamp/x-unix");
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstKayaSrc, gst_kayasrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstKayaSrc, gst_kayasrc, GST_TYPE_VISION_GRABBER_SRC);
 
 static void
 gst_kayasrc_class_init (GstKayaSrcClass * klass)
@@ -128,7 +133,8 @@ gst_kayasrc_class_init (GstKayaSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
   int i;
 
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "kayasrc", 0,
@@ -150,10 +156,12 @@ gst_kayasrc_class_init (GstKayaSrcClass * klass)
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_kayasrc_stop);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_kayasrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_kayasrc_set_caps);
-  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_kayasrc_unlock);
-  gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_kayasrc_unlock_stop);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_kayasrc_create);
+  grabber_class->start_acquisition =
+      GST_DEBUG_FUNCPTR (gst_kayasrc_start_acquisition);
+  grabber_class->release_frame = GST_DEBUG_FUNCPTR (gst_kayasrc_release_frame);
+  grabber_class->prepare_buffer =
+      GST_DEBUG_FUNCPTR (gst_kayasrc_prepare_buffer);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_INTERFACE_INDEX,
@@ -202,6 +210,16 @@ gst_kayasrc_class_init (GstKayaSrcClass * klass)
           DEFAULT_PROP_EXECUTE_COMMAND,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_QUEUED_FRAMES,
+      g_param_spec_uint64 ("queued-frames", "Queued frames",
+          "Number of frames received from the grabber and queued", 0,
+          G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DROPPED_FRAMES,
+      g_param_spec_uint64 ("queue-dropped-frames", "Queue dropped frames",
+          "Number of frames dropped because the queue was full", 0,
+          G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
 
   for (i = 0; i < KAYA_SRC_MAX_FG_HANDLES; i++) {
     klass->fg_data[i].fg_handle = INVALID_FGHANDLE;
@@ -212,6 +230,14 @@ gst_kayasrc_class_init (GstKayaSrcClass * klass)
   }
 }
 
+static void
+gst_kayasrc_update_timeout (GstKayaSrc * src)
+{
+  GST_VISION_GRABBER_SRC (src)->timeout =
+      (GstClockTime) (src->timeout > 0 ? src->timeout : DEFAULT_PROP_TIMEOUT) *
+      GST_MSECOND;
+}
+
 static void
 gst_kayasrc_cleanup (GstKayaSrc * src)
 {
@@ -220,9 +246,12 @@ gst_kayasrc_cleanup (GstKayaSrc * src)
   src->frame_size = 0;
   src->frame_count = 0;
   src->dropped_frames = 0;
-  src->stop_requested = FALSE;
-  src->acquisition_started = FALSE;
   src->kaya_base = GST_CLOCK_TIME_NONE;
+  gst_vision_clock_mapper_init (&src->clock_mapper, 1e9, 64, 0);
+
+  GST_OBJECT_LOCK (src);
+  src->total_queued = 0;
+  GST_OBJECT_UNLOCK (src);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -258,17 +287,22 @@ gst_kayasrc_cleanup (GstKayaSrc * src)
     g_mutex_unlock (&src->fg_data->fg_mutex);
     src->fg_data = NULL;
   }
+
+  /* buffers still held downstream point into the array, release checks
+   * against it before requeuing */
+  g_mutex_lock (&src->mutex);
+  if (src->buffer_handles) {
+    gst_vision_grabber_src_free_when_released (GST_VISION_GRABBER_SRC (src),
+        g_free, src->buffer_handles);
+  }
+  src->buffer_handles = NULL;
+  src->num_buffer_handles = 0;
+  g_mutex_unlock (&src->mutex);
 }
 
 static void
 gst_kayasrc_init (GstKayaSrc * src)
 {
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
-
   /* initialize member variables */
   src->interface_index = DEFAULT_PROP_INTERFACE_INDEX;
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
@@ -277,16 +311,19 @@ gst_kayasrc_init (GstKayaSrc * src)
   src->xml_file = DEFAULT_PROP_PROJECT_FILE;
   src->exposure_time = DEFAULT_PROP_EXPOSURE_TIME;
   src->execute_command = DEFAULT_PROP_EXECUTE_COMMAND;
+  gst_kayasrc_update_timeout (src);
 
-  src->queue = g_async_queue_new ();
   src->caps = NULL;
 
   src->fg_data = NULL;
   src->cam_handle = INVALID_CAMHANDLE;
   src->stream_handle = INVALID_STREAMHANDLE;
   src->buffer_handles = NULL;
+  src->num_buffer_handles = 0;
+  g_mutex_init (&src->mutex);
 
   src->kaya_base = GST_CLOCK_TIME_NONE;
+  gst_vision_clock_mapper_init (&src->clock_mapper, 1e9, 64, 0);
 }
 
 static void
@@ -331,6 +368,7 @@ gst_kayasrc_set_property (GObject * object, guint property_id,
       break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
+      gst_kayasrc_update_timeout (src);
       break;
     case PROP_PROJECT_FILE:
       g_free (src->project_file);
@@ -389,6 +427,18 @@ gst_kayasrc_get_property (GObject * object, guint property_id,
     case PROP_EXECUTE_COMMAND:
       g_value_set_string (value, src->execute_command);
       break;
+    case PROP_QUEUED_FRAMES:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint64 (value, src->total_queued);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_QUEUE_DROPPED_FRAMES:{
+      GstVisionStats *stats = &GST_VISION_GRABBER_SRC (src)->stats;
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_overwritten);
+      g_mutex_unlock (&stats->lock);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -423,6 +473,8 @@ gst_kayasrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
+  g_mutex_clear (&src->mutex);
+
   G_OBJECT_CLASS (gst_kayasrc_parent_class)->finalize (object);
 }
 
@@ -444,6 +496,9 @@ gst_kayasrc_start (GstBaseSrc * bsrc)
 
   gst_kayasrc_cleanup (src);
 
+  if (!GST_BASE_SRC_CLASS (gst_kayasrc_parent_class)->start (bsrc))
+    return FALSE;
+
   /* find and list all KAYA interfaces */
   num_ifaces = KYFG_Scan (NULL, 0);
   if (num_ifaces == 0) {
@@ -603,10 +658,10 @@ gst_kayasrc_start (GstBaseSrc * bsrc)
   KYFG_StreamGetInfo (src->stream_handle, KY_STREAM_INFO_BUF_ALIGNMENT,
       &frame_alignment, NULL, NULL);
 
-  if (src->buffer_handles) {
-    g_free (src->buffer_handles);
-  }
+  g_mutex_lock (&src->mutex);
   src->buffer_handles = g_new (STREAM_BUFFER_HANDLE, src->num_capture_buffers);
+  src->num_buffer_handles = src->num_capture_buffers;
+  g_mutex_unlock (&src->mutex);
   for (i = 0; i < src->num_capture_buffers; ++i) {
     void *frame = _aligned_malloc (src->frame_size, frame_alignment);
     ret =
@@ -654,7 +709,6 @@ gst_kayasrc_start (GstBaseSrc * bsrc)
     return FALSE;
   }
 
-  src->stop_requested = FALSE;
   src->dropped_frames = 0;
 
   return TRUE;
@@ -674,6 +728,9 @@ gst_kayasrc_stop (GstBaseSrc * bsrc)
 
   gst_kayasrc_cleanup (src);
 
+  /* the callback is unregistered, discard what it queued */
+  GST_BASE_SRC_CLASS (gst_kayasrc_parent_class)->stop (bsrc);
+
   return TRUE;
 }
 
@@ -712,10 +769,19 @@ gst_kayasrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
 
   GST_DEBUG_OBJECT (src, "The caps being set are %" GST_PTR_FORMAT, caps);
 
-  gst_video_info_from_caps (&vinfo, caps);
+  /* Bayer and packed formats aren't video/x-raw, but are still known */
+  if (gst_structure_has_name (s, "video/x-raw")) {
+    gst_video_info_from_caps (&vinfo, caps);
+
+    if (GST_VIDEO_INFO_FORMAT (&vinfo) == GST_VIDEO_FORMAT_UNKNOWN) {
+      goto unsupported_caps;
+    }
+  } else {
+    int endianness;
 
-  if (GST_VIDEO_INFO_FORMAT (&vinfo) == GST_VIDEO_FORMAT_UNKNOWN) {
-    goto unsupported_caps;
+    if (!gst_genicam_pixel_format_from_caps (caps, &endianness)) {
+      goto unsupported_caps;
+    }
   }
 
   return TRUE;
@@ -725,44 +791,23 @@ unsupported_caps:
   return FALSE;
 }
 
-static gboolean
-gst_kayasrc_unlock (GstBaseSrc * bsrc)
-{
-  GstKayaSrc *src = GST_KAYA_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock");
-
-  src->stop_requested = TRUE;
-
-  return TRUE;
-}
-
-static gboolean
-gst_kayasrc_unlock_stop (GstBaseSrc * bsrc)
-{
-  GstKayaSrc *src = GST_KAYA_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock_stop");
-
-  src->stop_requested = FALSE;
-
-  return TRUE;
-}
-
-typedef struct
-{
-  GstKayaSrc *src;
-  STREAM_BUFFER_HANDLE buf_handle;
-  guint32 buf_id;
-} VideoFrame;
-
 static void
-buffer_release (void *data)
+gst_kayasrc_release_frame (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * frame)
 {
-  VideoFrame *frame = (VideoFrame *) data;
-  GST_TRACE_OBJECT (frame->src, "Releasing buffer id=%d", frame->buf_id);
-  KYFG_BufferToQueue (frame->buf_handle, KY_ACQ_QUEUE_INPUT);
-  g_free (frame);
+  GstKayaSrc *src = GST_KAYA_SRC (grabber);
+  STREAM_BUFFER_HANDLE *handle = (STREAM_BUFFER_HANDLE *) frame->user_data;
+
+  /* requeue even while flushing, or the grabber runs out of buffers, but not
+   * buffers of a stream that has been torn down */
+  g_mutex_lock (&src->mutex);
+  if (handle >= src->buffer_handles &&
+      handle < src->buffer_handles + src->num_buffer_handles) {
+    GST_TRACE_OBJECT (src, "Releasing buffer id=%d",
+        (gint) (handle - src->buffer_handles));
+    KYFG_BufferToQueue (*handle, KY_ACQ_QUEUE_INPUT);
+  }
+  g_mutex_unlock (&src->mutex);
 }
 
 static void
@@ -770,12 +815,13 @@ gst_kayasrc_stream_buffer_callback (STREAM_BUFFER_HANDLE buffer_handle,
     void *context)
 {
   GstKayaSrc *src = GST_KAYA_SRC (context);
-  GstBuffer *buf;
+  GstVisionGrabberSrc *grabber = GST_VISION_GRABBER_SRC (context);
+  GstVisionGrabberFrame frame;
   unsigned char *data;
   guint32 buf_id;
-  GstClockTime timestamp;
-  VideoFrame *vf;
-  GstClock *clock;
+  guint64 timestamp;
+  GstClockTime clock_time;
+  guint i;
 
   KYFG_BufferGetInfo (buffer_handle, KY_STREAM_BUFFER_INFO_TIMESTAMP,
       &timestamp, NULL, NULL);
@@ -787,48 +833,47 @@ gst_kayasrc_stream_buffer_callback (STREAM_BUFFER_HANDLE buffer_handle,
   GST_TRACE_OBJECT (src, "Got buffer id=%d, total_num=%d", buf_id,
       src->frame_count);
 
-  vf = g_new0 (VideoFrame, 1);
-  vf->src = src;
-  vf->buf_handle = buffer_handle;
-  vf->buf_id = buf_id;
-  buf =
-      gst_buffer_new_wrapped_full ((GstMemoryFlags) GST_MEMORY_FLAG_NO_SHARE,
-      (gpointer) data, src->frame_size, 0, src->frame_size, vf,
-      (GDestroyNotify) buffer_release);
-
-  GST_BUFFER_OFFSET (buf) = src->frame_count;
-  src->frame_count++;
+  gst_vision_grabber_frame_init (&frame);
+  frame.data = data;
+  frame.size = src->frame_size;
+  /* the release goes back through the handle array */
+  for (i = 0; i < src->num_buffer_handles; i++) {
+    if (src->buffer_handles[i] == buffer_handle) {
+      frame.user_data = &src->buffer_handles[i];
+      break;
+    }
+  }
+  /* grabber drops are read from DropFrameCounter, the base class only has
+   * to number the frames */
+  frame.frame_number = src->frame_count++;
 
   if (src->kaya_base == GST_CLOCK_TIME_NONE) {
-    /* assume delay between these two calls is negligible */
-    src->kaya_base = KYFG_GetGrabberValueInt (src->cam_handle, "Timestamp");
+    /* frame timestamp and wall clock are both taken in this callback, so the
+     * offset is off by no more than the callback latency */
+    src->kaya_base = timestamp;
     src->unix_base = g_get_real_time () * 1000;
   }
-#if GST_CHECK_VERSION(1,14,0)
-  {
-    GstClockTime unix_ts = src->unix_base + (timestamp - src->kaya_base);
-    gst_buffer_add_reference_timestamp_meta (buf,
-        gst_static_caps_get (&unix_reference), unix_ts, GST_CLOCK_TIME_NONE);
-    GST_LOG_OBJECT (src, "Buffer #%d, adding unix timestamp: %llu",
-        GST_BUFFER_OFFSET (buf), unix_ts);
-    /*{
-       GDateTime *frame_time, *tmpdt;
-       tmpdt = g_date_time_new_from_unix_utc (0);
-       frame_time = g_date_time_add_seconds(tmpdt, (gdouble)unix_ts / GST_SECOND);
-       g_date_time_unref (tmpdt);
-       GST_LOG ("Unix timestamp added is: %s.%d", g_date_time_format (frame_time, "%Y-%m-%d %H:%M:%S"), g_date_time_get_microsecond(frame_time));
-       g_date_time_unref (frame_time);
-       } */
+
+  /* frame timestamp is in grabber ns, map it onto the pipeline clock through
+   * a fit over recent frames so grabber drift is corrected. Frames arriving
+   * before there is a clock are left untimestamped. */
+  clock_time = gst_vision_grabber_src_get_clock_time (grabber);
+  if (GST_CLOCK_TIME_IS_VALID (clock_time)) {
+    guint64 num_resets = src->clock_mapper.num_resets;
+    frame.clock_time =
+        gst_vision_clock_mapper_add_sample (&src->clock_mapper, timestamp,
+        clock_time);
+    if (src->clock_mapper.num_resets != num_resets) {
+      GST_DEBUG_OBJECT (src, "Grabber timestamps jumped, resetting mapping");
+    }
   }
-#endif
 
-  clock = gst_element_get_clock (GST_ELEMENT (src));
-  GST_BUFFER_TIMESTAMP (buf) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      gst_clock_get_time (clock));
-  gst_object_unref (clock);
+  GST_OBJECT_LOCK (src);
+  src->total_queued++;
+  GST_OBJECT_UNLOCK (src);
 
-  g_async_queue_push (src->queue, buf);
+  /* a frame dropped by a full queue is requeued to the stream right away */
+  gst_vision_grabber_src_push_frame (grabber, &frame);
 }
 
 static void
@@ -837,14 +882,32 @@ gst_kayasrc_stream_callback (void *context, STREAM_HANDLE stream_handle)
   GstKayaSrc *src = GST_KAYA_SRC (context);
 }
 
+static gboolean
+gst_kayasrc_start_acquisition (GstVisionGrabberSrc * grabber)
+{
+  GstKayaSrc *src = GST_KAYA_SRC (grabber);
+  FGSTATUS ret;
+
+  GST_DEBUG_OBJECT (src, "starting acquisition");
+  ret = KYFG_CameraStart (src->cam_handle, src->stream_handle, 0);
+  if (ret != FGSTATUS_OK) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
+        ("Failed to start camera acquisition"), (NULL));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static GstFlowReturn
-gst_kayasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
+gst_kayasrc_prepare_buffer (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * frame, GstBuffer * buf)
 {
-  GstKayaSrc *src = GST_KAYA_SRC (psrc);
+  GstKayaSrc *src = GST_KAYA_SRC (grabber);
+  STREAM_BUFFER_HANDLE *handle = (STREAM_BUFFER_HANDLE *) frame->user_data;
   gint64 dropped_frames = 0;
   static FILE *temperature_file = NULL;
   static gint64 temp_log_last_time = 0;
-  GST_LOG_OBJECT (src, "create");
 
   if (g_getenv ("GST_KAYA_FPGA_TEMP_LOG")) {
     if (temperature_file == NULL) {
@@ -889,25 +952,22 @@ gst_kayasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     }
   }
 
-  if (!src->acquisition_started) {
-    FGSTATUS ret;
-    GST_DEBUG_OBJECT (src, "starting acquisition");
-    ret = KYFG_CameraStart (src->cam_handle, src->stream_handle, 0);
-    if (ret != FGSTATUS_OK) {
-      GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
-          ("Failed to start camera acquisition"), (NULL));
-      goto error;
-    }
-    src->acquisition_started = TRUE;
-  }
-
-  *buf =
-      GST_BUFFER (g_async_queue_timeout_pop (src->queue, src->timeout * 1000));
-  if (!*buf) {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
-        ("Failed to get buffer in %d ms", src->timeout), (NULL));
-    goto error;
+#if GST_CHECK_VERSION(1,14,0)
+  /* the grabber buffer isn't requeued before the GstBuffer is freed, so its
+   * timestamp can still be read */
+  if (handle) {
+    guint64 timestamp;
+    GstClockTime unix_ts;
+
+    KYFG_BufferGetInfo (*handle, KY_STREAM_BUFFER_INFO_TIMESTAMP,
+        &timestamp, NULL, NULL);
+    unix_ts = src->unix_base + (timestamp - src->kaya_base);
+    gst_buffer_add_reference_timestamp_meta (buf,
+        gst_static_caps_get (&unix_reference), unix_ts, GST_CLOCK_TIME_NONE);
+    GST_LOG_OBJECT (src, "Buffer #%d, adding unix timestamp: %llu",
+        GST_BUFFER_OFFSET (buf), unix_ts);
   }
+#endif
 
   dropped_frames =
       KYFG_GetGrabberValueInt (src->cam_handle, "DropFrameCounter");
@@ -915,6 +975,7 @@ gst_kayasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     GstStructure *info_msg;
     gint64 just_dropped = dropped_frames - src->dropped_frames;
     src->dropped_frames = dropped_frames;
+    gst_vision_stats_add_dropped (&grabber->stats, just_dropped);
 
     GST_WARNING_OBJECT (src, "Just dropped %d frames (%d total)", just_dropped,
         src->dropped_frames);
@@ -925,19 +986,7 @@ gst_kayasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
         "timestamp", GST_TYPE_CLOCK_TIME, GST_BUFFER_TIMESTAMP (buf), NULL);
     gst_element_post_message (GST_ELEMENT (src),
         gst_message_new_element (GST_OBJECT (src), info_msg));
-    src->dropped_frames = dropped_frames;
-  }
-
-  if (src->stop_requested) {
-    if (*buf != NULL) {
-      gst_buffer_unref (*buf);
-      *buf = NULL;
-    }
-    return GST_FLOW_FLUSHING;
   }
 
   return GST_FLOW_OK;
-
-error:
-  return GST_FLOW_ERROR;
 }
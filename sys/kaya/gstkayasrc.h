@@ -20,10 +20,11 @@
 #ifndef _GST_KAYA_SRC_H_
 #define _GST_KAYA_SRC_H_
 
-#include <gst/base/gstpushsrc.h>
-
 #include <KYFGLib.h>
 
+#include "gstvisiongrabbersrc.h"
+#include "visionclockmapper.h"
+
 #define KAYA_SRC_MAX_FG_HANDLES 16
 
 G_BEGIN_DECLS
@@ -43,15 +44,20 @@ typedef struct _GstKayaSrcFramegrabber GstKayaSrcFramegrabber;
 
 struct _GstKayaSrc
 {
-  GstPushSrc base_kayasrc;
+  GstVisionGrabberSrc base_kayasrc;
 
   /* handles */
   GstKayaSrcFramegrabber *fg_data;
   CAMHANDLE cam_handle;
   STREAM_HANDLE stream_handle;
-  STREAM_BUFFER_HANDLE *buffer_handles;
   size_t frame_size;
 
+  /* announced buffers of the current stream, frames point into this array,
+   * protected by mutex so a release can tell whether its stream is gone */
+  STREAM_BUFFER_HANDLE *buffer_handles;
+  guint num_buffer_handles;
+  GMutex mutex;
+
   /* properties */
   guint interface_index;
   guint device_index;
@@ -62,16 +68,19 @@ struct _GstKayaSrc
   gfloat exposure_time;
   gchar *execute_command;
 
-  gboolean acquisition_started;
   guint64 frame_count;
-  gboolean stop_requested;
   gint64 dropped_frames;
 
   GstCaps *caps;
-  GAsyncQueue *queue;
 
+  /* frames pushed by the callback, protected by the object lock */
+  guint64 total_queued;
+
+  /* grabber timestamps, latched from the first frame for the unix
+   * reference meta, and mapped onto the pipeline clock for the PTS */
   GstClockTime unix_base;
   GstClockTime kaya_base;
+  GstVisionClockMapper clock_mapper;
 };
 
 struct _GstKayaSrcFramegrabber
@@ -85,7 +94,7 @@ struct _GstKayaSrcFramegrabber
 
 struct _GstKayaSrcClass
 {
-  GstPushSrcClass base_kayasrc_class;
+  GstVisionGrabberSrcClass base_kayasrc_class;
 
   GstKayaSrcFramegrabber fg_data[KAYA_SRC_MAX_FG_HANDLES];
 };
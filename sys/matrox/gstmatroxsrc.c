@@ -35,7 +35,6 @@
 #endif
 
 #include <gst/gst.h>
-#include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
 #include "gstmatroxsrc.h"
@@ -55,10 +54,10 @@ static gboolean gst_matroxsrc_start (GstBaseSrc * src);
 static gboolean gst_matroxsrc_stop (GstBaseSrc * src);
 static GstCaps *gst_matroxsrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_matroxsrc_set_caps (GstBaseSrc * src, GstCaps * caps);
-static gboolean gst_matroxsrc_unlock (GstBaseSrc * src);
-static gboolean gst_matroxsrc_unlock_stop (GstBaseSrc * src);
 
-static GstFlowReturn gst_matroxsrc_create (GstPushSrc * src, GstBuffer ** buf);
+static gboolean gst_matroxsrc_start_acquisition (GstVisionGrabberSrc * src);
+static void gst_matroxsrc_release_frame (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame);
 
 static GstCaps *gst_matroxsrc_create_caps (GstMatroxSrc * src);
 static MIL_INT MFTYPE
@@ -89,17 +88,21 @@ enum
   PROP_CONFIG_FILE,
   PROP_NUM_CAPTURE_BUFFERS,
   PROP_TIMEOUT,
-  PROP_BAYER_MODE
+  PROP_BAYER_MODE,
+  PROP_DROPPED_FRAMES
 };
 
 #define DEFAULT_PROP_SYSTEM 0
 #define DEFAULT_PROP_BOARD -1
 #define DEFAULT_PROP_CHANNEL -1
 #define DEFAULT_PROP_CONFIG_FILE "M_DEFAULT"
-#define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 2
+#define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 4
 #define DEFAULT_PROP_TIMEOUT 1000
 #define DEFAULT_PROP_BAYER_MODE GST_MATROX_BAYER_MODE_BAYER
 
+/* grab buffers always left to MdigProcess, the rest may be held downstream */
+#define GST_MATROXSRC_RESERVED_BUFFERS 2
+
 
 #define GST_TYPE_MATROX_BAYER_MODE (gst_matrox_bayer_mode_get_type())
 static GType
@@ -162,7 +165,7 @@ static GstStaticPadTemplate gst_matroxsrc_src_template =
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
-        ("{ GRAY8, GRAY16_LE, GRAY16_BE, BGRA }") ";"
+        ("{ GRAY8, GRAY16_LE, GRAY16_BE, BGRx, YUY2 }") ";"
         VIDEO_CAPS_MAKE_BAYER8 ("{ bggr, grbg, rggb, gbrg }") ";"
         VIDEO_CAPS_MAKE_BAYER16 ("{ bggr, grbg, rggb, gbrg }")
     )
@@ -170,7 +173,7 @@ static GstStaticPadTemplate gst_matroxsrc_src_template =
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstMatroxSrc, gst_matroxsrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstMatroxSrc, gst_matroxsrc, GST_TYPE_VISION_GRABBER_SRC);
 
 static MIL_ID g_milapp = M_NULL;
 static int g_milapp_use_count = 0;
@@ -208,7 +211,8 @@ gst_matroxsrc_class_init (GstMatroxSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   gobject_class->set_property = gst_matroxsrc_set_property;
   gobject_class->get_property = gst_matroxsrc_get_property;
@@ -227,10 +231,10 @@ gst_matroxsrc_class_init (GstMatroxSrcClass * klass)
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_matroxsrc_stop);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_matroxsrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_matroxsrc_set_caps);
-  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_matroxsrc_unlock);
-  gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_matroxsrc_unlock_stop);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_matroxsrc_create);
+  grabber_class->start_acquisition =
+      GST_DEBUG_FUNCPTR (gst_matroxsrc_start_acquisition);
+  grabber_class->release_frame = GST_DEBUG_FUNCPTR (gst_matroxsrc_release_frame);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_SYSTEM,
@@ -268,57 +272,93 @@ gst_matroxsrc_class_init (GstMatroxSrcClass * klass)
           GST_TYPE_MATROX_BAYER_MODE, DEFAULT_PROP_BAYER_MODE,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DROPPED_FRAMES,
+      g_param_spec_uint64 ("dropped-frames", "Dropped frames",
+          "Number of frames lost before reaching the host; deprecated, use "
+          "frames-dropped of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+}
+
+static void
+gst_matroxsrc_update_timeout (GstMatroxSrc * src)
+{
+  GST_VISION_GRABBER_SRC (src)->timeout =
+      (GstClockTime) (src->timeout > 0 ? src->timeout : DEFAULT_PROP_TIMEOUT) *
+      GST_MSECOND;
+}
+
+static void
+gst_matroxsrc_free_mil (MIL_ID * grab_buffer_list, guint num_buffers,
+    MIL_ID digitizer, MIL_ID system)
+{
+  guint i;
+
+  if (grab_buffer_list) {
+    for (i = 0; i < num_buffers; ++i) {
+      if (grab_buffer_list[i]) {
+        MbufFree (grab_buffer_list[i]);
+      }
+    }
+    g_free (grab_buffer_list);
+  }
+
+  if (digitizer) {
+    MdigFree (digitizer);
+  }
+
+  if (system) {
+    MsysFree (system);
+  }
+}
+
+/* MIL objects of a stopped acquisition, freed once no buffer wraps a grab
+ * buffer anymore */
+typedef struct
+{
+  MIL_ID *grab_buffer_list;
+  guint num_buffers;
+  MIL_ID digitizer;
+  MIL_ID system;
+} GstMatroxSrcMilObjects;
+
+static void
+gst_matroxsrc_free_mil_objects (GstMatroxSrcMilObjects * objects)
+{
+  gst_matroxsrc_free_mil (objects->grab_buffer_list, objects->num_buffers,
+      objects->digitizer, objects->system);
+  g_free (objects);
 }
 
 static void
 gst_matroxsrc_reset (GstMatroxSrc * src)
 {
-  gint i;
   src->acq_started = FALSE;
 
   src->height = 0;
   src->gst_stride = 0;
 
+  g_mutex_lock (&src->mutex);
+  src->buffers_processed = 0;
+  src->last_frames_missed = 0;
+  src->num_held = 0;
+  g_mutex_unlock (&src->mutex);
+
   if (src->caps) {
     gst_caps_unref (src->caps);
     src->caps = NULL;
   }
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
-
-  if (src->MilGrabBufferList) {
-    for (i = 0; i < src->num_capture_buffers; ++i) {
-      if (src->MilGrabBufferList[i]) {
-        MbufFree (src->MilGrabBufferList[i]);
-        src->MilGrabBufferList[i] = NULL;
-      }
-    }
-    g_free (src->MilGrabBufferList);
-    src->MilGrabBufferList = NULL;
-  }
 
-  if (src->MilDigitizer) {
-    MdigFree (src->MilDigitizer);
-    src->MilDigitizer = M_NULL;
-  }
-
-  if (src->MilSystem) {
-    MsysFree (src->MilSystem);
-    src->MilSystem = M_NULL;
-  }
+  gst_matroxsrc_free_mil (src->MilGrabBufferList, src->num_capture_buffers,
+      src->MilDigitizer, src->MilSystem);
+  src->MilGrabBufferList = NULL;
+  src->MilDigitizer = M_NULL;
+  src->MilSystem = M_NULL;
 }
 
 static void
 gst_matroxsrc_init (GstMatroxSrc * src)
 {
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
-
   /* initialize member variables */
   src->system = DEFAULT_PROP_SYSTEM;
   src->board = DEFAULT_PROP_BOARD;
@@ -326,13 +366,12 @@ gst_matroxsrc_init (GstMatroxSrc * src)
   src->config_file = g_strdup (DEFAULT_PROP_CONFIG_FILE);
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
   src->timeout = DEFAULT_PROP_TIMEOUT;
+  gst_matroxsrc_update_timeout (src);
   src->bayer_mode = DEFAULT_PROP_BAYER_MODE;
 
   g_mutex_init (&src->mutex);
-  g_cond_init (&src->cond);
-  src->stop_requested = FALSE;
   src->caps = NULL;
-  src->buffer = NULL;
+  src->num_held = 0;
 
   src->MilApplication = M_NULL;
   src->MilSystem = M_NULL;
@@ -379,6 +418,7 @@ gst_matroxsrc_set_property (GObject * object, guint property_id,
       break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
+      gst_matroxsrc_update_timeout (src);
       break;
     case PROP_BAYER_MODE:
       src->bayer_mode = g_value_get_enum (value);
@@ -420,6 +460,13 @@ gst_matroxsrc_get_property (GObject * object, guint property_id,
     case PROP_BAYER_MODE:
       g_value_set_enum (value, src->bayer_mode);
       break;
+    case PROP_DROPPED_FRAMES:{
+      GstVisionStats *stats = &GST_VISION_GRABBER_SRC (src)->stats;
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_dropped);
+      g_mutex_unlock (&stats->lock);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -436,9 +483,6 @@ gst_matroxsrc_dispose (GObject * object)
 
   /* clean up as possible.  may be called multiple times */
 
-  g_mutex_clear (&src->mutex);
-  g_cond_clear (&src->cond);
-
   G_OBJECT_CLASS (gst_matroxsrc_parent_class)->dispose (object);
 }
 
@@ -454,6 +498,7 @@ gst_matroxsrc_finalize (GObject * object)
   g_free (src->config_file);
 
   gst_matroxsrc_reset (src);
+  g_mutex_clear (&src->mutex);
 
   gst_matroxsrc_milapp_unref ();
 
@@ -477,6 +522,9 @@ gst_matroxsrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  if (!GST_BASE_SRC_CLASS (gst_matroxsrc_parent_class)->start (bsrc))
+    return FALSE;
+
   if (src->MilApplication == M_NULL) {
     GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
         ("Failed to allocate a MIL application"), (NULL));
@@ -601,8 +649,15 @@ gst_matroxsrc_start (GstBaseSrc * bsrc)
       goto error;
     }
   } else if (n_bands == 3) {
-    /* TODO: handle non-Solios color formats */
-    src->video_format = GST_VIDEO_FORMAT_BGRx;
+    /* grab in the digitizer's native packed layout so frames can be pushed
+     * without a host-side conversion */
+    if (MdigInquire (src->MilDigitizer, M_COLOR_MODE, M_NULL) == M_YUV) {
+      src->video_format = GST_VIDEO_FORMAT_YUY2;
+      src->mil_color_format = M_PACKED + M_YUV16_YUYV;
+    } else {
+      src->video_format = GST_VIDEO_FORMAT_BGRx;
+      src->mil_color_format = M_PACKED + M_BGR32;
+    }
   }
 
   /* note that we abuse formats with Bayer */
@@ -626,7 +681,7 @@ gst_matroxsrc_start (GstBaseSrc * bsrc)
           n_bands,
           width,
           height,
-          src->mil_type, M_IMAGE + M_GRAB + M_PROC + M_PACKED + M_BGR32,
+          src->mil_type, M_IMAGE + M_GRAB + M_PROC + src->mil_color_format,
           &src->MilGrabBufferList[i]);
     }
 
@@ -661,6 +716,28 @@ gst_matroxsrc_stop (GstBaseSrc * bsrc)
     src->acq_started = FALSE;
   }
 
+  /* unlocks the grab buffers of frames still queued */
+  GST_BASE_SRC_CLASS (gst_matroxsrc_parent_class)->stop (bsrc);
+
+  /* grab buffers can't be freed while downstream still references them,
+   * so leave the MIL objects to the last buffer released */
+  g_mutex_lock (&src->mutex);
+  if (src->MilSystem) {
+    GstMatroxSrcMilObjects *objects = g_new (GstMatroxSrcMilObjects, 1);
+
+    GST_DEBUG_OBJECT (src, "%d buffers still held downstream", src->num_held);
+    objects->grab_buffer_list = src->MilGrabBufferList;
+    objects->num_buffers = src->num_capture_buffers;
+    objects->digitizer = src->MilDigitizer;
+    objects->system = src->MilSystem;
+    src->MilGrabBufferList = NULL;
+    src->MilDigitizer = M_NULL;
+    src->MilSystem = M_NULL;
+    gst_vision_grabber_src_free_when_released (GST_VISION_GRABBER_SRC (src),
+        (GDestroyNotify) gst_matroxsrc_free_mil_objects, objects);
+  }
+  g_mutex_unlock (&src->mutex);
+
   gst_matroxsrc_reset (src);
 
   return TRUE;
@@ -703,59 +780,95 @@ gst_matroxsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
 }
 
 static gboolean
-gst_matroxsrc_unlock (GstBaseSrc * bsrc)
+gst_matroxsrc_start_acquisition (GstVisionGrabberSrc * grabber)
 {
-  GstMatroxSrc *src = GST_MATROX_SRC (bsrc);
+  GstMatroxSrc *src = GST_MATROX_SRC (grabber);
 
-  GST_LOG_OBJECT (src, "unlock");
+  GST_LOG_OBJECT (src, "starting acquisition");
 
-  g_mutex_lock (&src->mutex);
-  src->stop_requested = TRUE;
-  g_cond_signal (&src->cond);
-  g_mutex_unlock (&src->mutex);
+  MdigProcess (src->MilDigitizer, src->MilGrabBufferList,
+      src->num_capture_buffers, M_START, M_DEFAULT, gst_matroxsrc_callback,
+      src);
+
+  src->acq_started = TRUE;
 
   return TRUE;
 }
 
-static gboolean
-gst_matroxsrc_unlock_stop (GstBaseSrc * bsrc)
+static void
+gst_matroxsrc_release_frame (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * frame)
 {
-  GstMatroxSrc *src = GST_MATROX_SRC (bsrc);
+  GstMatroxSrc *src = GST_MATROX_SRC (grabber);
+  MIL_ID buffer_id = (MIL_ID) (gintptr) frame->user_data;
+  guint i;
 
-  GST_LOG_OBJECT (src, "unlock_stop");
+  GST_TRACE_OBJECT (src, "Releasing MIL buffer %d", (gint) buffer_id);
 
-  src->stop_requested = FALSE;
-
-  return TRUE;
+  /* grab buffers of a stopped acquisition are still allocated, they are
+   * only freed once every frame is released */
+  g_mutex_lock (&src->mutex);
+  MbufControl (buffer_id, M_UNLOCK, M_DEFAULT);
+  for (i = 0; src->MilGrabBufferList && i < src->num_capture_buffers; ++i) {
+    if (src->MilGrabBufferList[i] == buffer_id) {
+      src->num_held--;
+      break;
+    }
+  }
+  g_mutex_unlock (&src->mutex);
 }
 
-static GstBuffer *
-gst_matroxsrc_create_buffer_from_id (GstMatroxSrc * src, MIL_ID buffer_id)
+/* called with mutex held */
+static void
+gst_matroxsrc_fill_frame (GstMatroxSrc * src, MIL_ID buffer_id,
+    GstVisionGrabberFrame * frame)
 {
   GstMapInfo minfo;
   GstBuffer *buf;
+  void *host_address = NULL;
+  MIL_INT pitch_byte;
+  gsize size = src->height * src->gst_stride;
+
+  MbufInquire (buffer_id, M_HOST_ADDRESS, &host_address);
+  pitch_byte = MbufInquire (buffer_id, M_PITCH_BYTE, M_NULL);
+
+  /* wrap the grab buffer if it matches the output layout and enough buffers
+   * remain for MdigProcess to keep grabbing into; the lock holds it out of
+   * the grab list until the frame is released */
+  if (host_address != NULL && pitch_byte == src->gst_stride &&
+      src->num_held + GST_MATROXSRC_RESERVED_BUFFERS <=
+      src->num_capture_buffers) {
+    MbufControl (buffer_id, M_LOCK, M_DEFAULT);
+    src->num_held++;
+
+    GST_TRACE_OBJECT (src, "Wrapping MIL buffer %d (%d held)",
+        (gint) buffer_id, src->num_held);
+
+    frame->data = host_address;
+    frame->size = size;
+    frame->user_data = (gpointer) (gintptr) buffer_id;
+    return;
+  }
 
-  /* TODO: use allocator or use from pool */
-  buf = gst_buffer_new_and_alloc (src->height * src->gst_stride);
+  buf = gst_buffer_new_and_alloc (size);
 
   /* map buffer so we can copy to it */
   gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
   GST_LOG_OBJECT (src,
       "GstBuffer size=%d, gst_stride=%d", minfo.size, src->gst_stride);
 
-  /* copy MilBuffer to GstBuffer, possibly performing conversion in the process */
+  /* copy MilBuffer to GstBuffer in its native layout */
   if (src->video_format == GST_VIDEO_FORMAT_GRAY8 ||
       src->video_format == GST_VIDEO_FORMAT_GRAY16_LE ||
       src->video_format == GST_VIDEO_FORMAT_GRAY16_BE) {
     MbufGet (buffer_id, minfo.data);
   } else {
-    /* TODO: add support for planar color and YUV */
-    MbufGetColor (buffer_id, M_PACKED | M_BGR32, M_ALL_BANDS, minfo.data);
+    MbufGetColor (buffer_id, src->mil_color_format, M_ALL_BANDS, minfo.data);
   }
 
   gst_buffer_unmap (buf, &minfo);
 
-  return buf;
+  frame->buffer = buf;
 }
 
 
@@ -763,109 +876,44 @@ static MIL_INT MFTYPE
 gst_matroxsrc_callback (MIL_INT HookType, MIL_ID EventId, void *UserDataPtr)
 {
   GstMatroxSrc *src = GST_MATROX_SRC (UserDataPtr);
+  GstVisionGrabberSrc *grabber = GST_VISION_GRABBER_SRC (UserDataPtr);
+  GstVisionGrabberFrame frame;
   MIL_ID ModifiedBufferId;
+  MIL_INT frames_missed = 0;
   gint dropped_frames;
-  static guint64 last_frame_number = 0;
-  static guint64 buffers_processed = 0;
-  static guint64 total_dropped_frames = 0;
-  GstClock *clock;
-  GstClockTime clock_time;
 
   g_assert (src != NULL);
 
-  clock = gst_element_get_clock (GST_ELEMENT (src));
-  clock_time = gst_clock_get_time (clock);
-  gst_object_unref (clock);
+  gst_vision_grabber_frame_init (&frame);
+  frame.clock_time = gst_vision_grabber_src_get_clock_time (grabber);
 
   /* Retrieve the MIL_ID of the grabbed buffer. */
   MdigGetHookInfo (EventId, M_MODIFIED_BUFFER + M_BUFFER_ID, &ModifiedBufferId);
 
-  ///* check for dropped frames and disrupted signal */
-  //dropped_frames = (pFrameInfo->number - last_frame_number) - 1;
-  //if (dropped_frames > 0) {
-  //  total_dropped_frames += dropped_frames;
-  //  GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-  //      total_dropped_frames);
-  //} else if (dropped_frames < 0) {
-  //  GST_WARNING_OBJECT (src,
-  //      "Signal disrupted, frames likely dropped and timestamps inaccurate");
-
-  //  /* frame timestamps reset, so adjust start time, accuracy reduced */
-  //  src->acq_start_time =
-  //      gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src))) -
-  //      pFrameInfo->timestamp * GST_USECOND;
-  //}
-  //last_frame_number = pFrameInfo->number;
+  /* frames the digitizer had no free grab buffer for */
+  MdigInquire (src->MilDigitizer, M_PROCESS_FRAME_MISSED, &frames_missed);
 
   g_mutex_lock (&src->mutex);
 
-  if (src->buffer) {
-    /* TODO: save this in dropped frame total? */
-    GST_WARNING_OBJECT (src,
-        "Got new buffer before old handled, dropping old.");
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
+  /* check for dropped frames */
+  dropped_frames = (gint) (frames_missed - src->last_frames_missed);
+  if (dropped_frames > 0) {
+    gst_vision_stats_add_dropped (&grabber->stats, dropped_frames);
+    GST_WARNING_OBJECT (src, "Dropped %d frames", dropped_frames);
   }
+  src->last_frames_missed = frames_missed;
 
-  src->buffer = gst_matroxsrc_create_buffer_from_id (src, ModifiedBufferId);
-
-  GST_BUFFER_TIMESTAMP (src->buffer) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      clock_time);
-  GST_BUFFER_OFFSET (src->buffer) = buffers_processed;
-  ++buffers_processed;
+  gst_matroxsrc_fill_frame (src, ModifiedBufferId, &frame);
+  frame.frame_number = src->buffers_processed;
+  ++src->buffers_processed;
 
-  g_cond_signal (&src->cond);
   g_mutex_unlock (&src->mutex);
 
-  return M_NULL;
-}
-
-static GstFlowReturn
-gst_matroxsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
-{
-  GstMatroxSrc *src = GST_MATROX_SRC (psrc);
-  gint64 end_time;
-
-  GST_LOG_OBJECT (src, "create");
-
-  /* Start acquisition if not already started */
-  if (G_UNLIKELY (!src->acq_started)) {
-    GST_LOG_OBJECT (src, "starting acquisition");
-    src->acq_start_time =
-        gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src)));
-
-    MdigProcess (src->MilDigitizer, src->MilGrabBufferList,
-        src->num_capture_buffers, M_START, M_DEFAULT, gst_matroxsrc_callback,
-        src);
+  /* a frame dropped by the overflow policy is released, which takes the
+   * mutex */
+  gst_vision_grabber_src_push_frame (grabber, &frame);
 
-    src->acq_started = TRUE;
-  }
-
-  /* wait for a buffer to be ready */
-  g_mutex_lock (&src->mutex);
-  end_time = g_get_monotonic_time () + src->timeout * G_TIME_SPAN_MILLISECOND;
-  while (!src->buffer && !src->stop_requested) {
-    if (!g_cond_wait_until (&src->cond, &src->mutex, end_time)) {
-      g_mutex_unlock (&src->mutex);
-      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-          ("Timeout, no data received after %d ms", src->timeout), (NULL));
-      return GST_FLOW_ERROR;
-    }
-  }
-  *buf = src->buffer;
-  src->buffer = NULL;
-  g_mutex_unlock (&src->mutex);
-
-  if (src->stop_requested) {
-    if (*buf != NULL) {
-      gst_buffer_unref (*buf);
-      *buf = NULL;
-    }
-    return GST_FLOW_FLUSHING;
-  }
-
-  return GST_FLOW_OK;
+  return M_NULL;
 }
 
 static gboolean
@@ -20,10 +20,10 @@
 #ifndef _GST_MATROX_SRC_H_
 #define _GST_MATROX_SRC_H_
 
-#include <gst/base/gstpushsrc.h>
-
 #include <mil.h>
 
+#include "gstvisiongrabbersrc.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_MATROX_SRC   (gst_matroxsrc_get_type())
@@ -43,7 +43,7 @@ typedef enum {
 
 struct _GstMatroxSrc
 {
-  GstPushSrc base_matroxsrc;
+  GstVisionGrabberSrc base_matroxsrc;
 
   gboolean acq_started;
 
@@ -62,23 +62,27 @@ struct _GstMatroxSrc
   gint timeout;
   GstMatroxBayerModeEnum bayer_mode;
 
-  GstBuffer *buffer;
-  GstClockTime acq_start_time;
+  /* frame accounting, protected by mutex */
+  guint64 buffers_processed;
+  MIL_INT last_frames_missed;
+
+  /* grab buffers of the current acquisition wrapped downstream and locked
+   * against reuse, protected by mutex */
+  guint num_held;
 
   GstCaps *caps;
   gint height;
   gint gst_stride;
   MIL_INT mil_type;
+  MIL_INT mil_color_format;
   GstVideoFormat video_format;
 
   GMutex mutex;
-  GCond cond;
-  gboolean stop_requested;
 };
 
 struct _GstMatroxSrcClass
 {
-  GstPushSrcClass base_matroxsrc_class;
+  GstVisionGrabberSrcClass base_matroxsrc_class;
 };
 
 GType gst_matroxsrc_get_type (void);
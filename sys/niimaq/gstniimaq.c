@@ -69,10 +69,11 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, GRAY16_LE, GRAY16_BE }"))
     );
 
-G_DEFINE_TYPE (GstNiImaqSrc, gst_niimaqsrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstNiImaqSrc, gst_niimaqsrc, GST_TYPE_VISION_GRABBER_SRC);
 
 /* GObject virtual methods */
 static void gst_niimaqsrc_dispose (GObject * object);
+static void gst_niimaqsrc_finalize (GObject * object);
 static void gst_niimaqsrc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_niimaqsrc_get_property (GObject * object, guint prop_id,
@@ -81,13 +82,13 @@ static void gst_niimaqsrc_get_property (GObject * object, guint prop_id,
 /* GstBaseSrc virtual methods */
 static gboolean gst_niimaqsrc_start (GstBaseSrc * bsrc);
 static gboolean gst_niimaqsrc_stop (GstBaseSrc * bsrc);
-static gboolean gst_niimaqsrc_query (GstBaseSrc * bsrc, GstQuery * query);
 static GstCaps *gst_niimaqsrc_get_caps (GstBaseSrc * bsrc, GstCaps * filter);
 static gboolean gst_niimaqsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps);
 
-/* GstPushSrc virtual methods */
-static GstFlowReturn gst_niimaqsrc_create (GstPushSrc * psrc,
-    GstBuffer ** buffer);
+/* GstVisionGrabberSrc virtual methods */
+static gboolean gst_niimaqsrc_start_acquisition (GstVisionGrabberSrc * grabber);
+static GstFlowReturn gst_niimaqsrc_prepare_buffer (GstVisionGrabberSrc *
+    grabber, GstVisionGrabberFrame * frame, GstBuffer * buf);
 
 /* GstNiImaq methods */
 static GstCaps *gst_niimaqsrc_get_cam_caps (GstNiImaqSrc * src);
@@ -128,13 +129,6 @@ gst_niimaqsrc_aq_done_callback (SESSION_ID sid, IMG_ERR err,
   return 0;                     /* don't re-arm */
 }
 
-typedef struct _GstNiImaqSrcTimeEntry GstNiImaqSrcTimeEntry;
-struct _GstNiImaqSrcTimeEntry
-{
-  guint64 frame_index;
-  GstClockTime clock_time;
-};
-
 /* This will be called "at the start of acquisition into each image buffer."
  * If acquisition blocks because we don't copy buffers fast enough, the number
  * of times this function is called will be less than the IMAQ cumulative
@@ -146,21 +140,100 @@ gst_niimaqsrc_frame_start_callback (SESSION_ID sid, IMG_ERR err,
   GstNiImaqSrc *src = GST_NIIMAQSRC (userdata);
   GstNiImaqSrcTimeEntry *time_entry;
 
-  time_entry = g_new (GstNiImaqSrcTimeEntry, 1);
-
-  /* get clock time */
+  /* the entry is only read once its buffer is complete, by then this
+   * callback has moved on to the next slot */
+  time_entry = &src->time_entries[src->imaqFrameStartNum % src->bufsize];
   time_entry->clock_time =
-      gst_clock_get_time (gst_element_get_clock (GST_ELEMENT (src)));
+      gst_vision_grabber_src_get_clock_time (GST_VISION_GRABBER_SRC (src));
   time_entry->frame_index = src->imaqFrameStartNum;
 
-  g_async_queue_push (src->time_queue, time_entry);
-
   src->imaqFrameStartNum++;
 
   /* return 1 to rearm the callback */
   return 1;
 }
 
+/* only called from the buffer complete callback, copies the oldest buffer
+ * not copied yet and pushes it to the base class */
+static gboolean
+gst_niimaqsrc_copy_frame (GstNiImaqSrc * src)
+{
+  GstVisionGrabberFrame frame;
+  GstNiImaqSrcTimeEntry *time_entry;
+  uInt32 copied_number;
+  uInt32 copied_index;
+  Int32 rval;
+  GstMapInfo minfo;
+
+  gst_vision_grabber_frame_init (&frame);
+
+  GST_LOG_OBJECT (src, "Allocating memory for IMAQ buffer #%d, size %d",
+      src->cumbufnum, src->framesize);
+  frame.buffer = gst_buffer_new_and_alloc (src->framesize);
+
+  gst_buffer_map (frame.buffer, &minfo, GST_MAP_WRITE);
+  rval = imgSessionCopyAreaByNumber (src->sid, src->cumbufnum, 0, 0,
+      src->height, src->width, minfo.data, src->rowpixels,
+      IMG_OVERWRITE_GET_OLDEST, &copied_number, &copied_index);
+  gst_buffer_unmap (frame.buffer, &minfo);
+  if (rval) {
+    gst_niimaqsrc_report_imaq_error (rval);
+    GST_WARNING_OBJECT (src, "Failed to copy buffer %d", src->cumbufnum);
+    gst_buffer_unref (frame.buffer);
+    return FALSE;
+  }
+
+  if (copied_number != src->cumbufnum) {
+    GST_DEBUG_OBJECT (src, "Asked to copy buffer #%d but was given #%d",
+        src->cumbufnum, copied_number);
+  }
+
+  /* set cumulative buffer number to get next frame */
+  src->cumbufnum = copied_number + 1;
+
+  /* the base class counts the frames we were too late for as dropped */
+  frame.frame_number = copied_number;
+
+  time_entry = &src->time_entries[copied_number % src->bufsize];
+  if (time_entry->frame_index == copied_number) {
+    frame.clock_time = time_entry->clock_time;
+  } else {
+    GST_DEBUG_OBJECT (src, "No clocktime for frame %d, callback failed?",
+        copied_number);
+  }
+
+  /* a copy, so a full queue never holds back the IMAQ ring */
+  gst_vision_grabber_src_push_frame (GST_VISION_GRABBER_SRC (src), &frame);
+
+  return TRUE;
+}
+
+/* Called when a buffer is complete. The ring is overwritten once it wraps,
+ * so frames are copied out here rather than in create. Signals may be
+ * coalesced, so everything up to the last valid buffer is copied. */
+uInt32
+gst_niimaqsrc_buffer_complete_callback (SESSION_ID sid, IMG_ERR err,
+    IMG_SIGNAL_TYPE signal_type, uInt32 signal_identifier, void *userdata)
+{
+  GstNiImaqSrc *src = GST_NIIMAQSRC (userdata);
+  uInt32 last_valid;
+  Int32 rval;
+
+  rval = imgGetAttribute (src->sid, IMG_ATTR_LAST_VALID_BUFFER, &last_valid);
+  if (rval) {
+    gst_niimaqsrc_report_imaq_error (rval);
+    return 1;
+  }
+
+  while ((gint32) (last_valid - src->cumbufnum) >= 0) {
+    if (!gst_niimaqsrc_copy_frame (src))
+      break;
+  }
+
+  /* return 1 to rearm the callback */
+  return 1;
+}
+
 /* TODO: reimplement this when device discovery is added, see #678402 */
 #if 0
 /**
@@ -256,10 +329,12 @@ gst_niimaqsrc_class_init (GstNiImaqSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   /* install GObject vmethod implementations */
   gobject_class->dispose = gst_niimaqsrc_dispose;
+  gobject_class->finalize = gst_niimaqsrc_finalize;
   gobject_class->set_property = gst_niimaqsrc_set_property;
   gobject_class->get_property = gst_niimaqsrc_get_property;
 
@@ -296,36 +371,36 @@ gst_niimaqsrc_class_init (GstNiImaqSrcClass * klass)
   /* install GstBaseSrc vmethod implementations */
   gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_niimaqsrc_start);
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_niimaqsrc_stop);
-  gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_niimaqsrc_query);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_niimaqsrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_niimaqsrc_set_caps);
 
-  /* install GstPushSrc vmethod implementations */
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_niimaqsrc_create);
+  /* install GstVisionGrabberSrc vmethod implementations */
+  grabber_class->start_acquisition =
+      GST_DEBUG_FUNCPTR (gst_niimaqsrc_start_acquisition);
+  grabber_class->prepare_buffer =
+      GST_DEBUG_FUNCPTR (gst_niimaqsrc_prepare_buffer);
 }
 
+/* the base class waits as long as IMAQ does for a frame, for ever until the
+ * driver default is known */
 static void
-gst_niimaqsrc_init (GstNiImaqSrc * src)
+gst_niimaqsrc_update_timeout (GstNiImaqSrc * src)
 {
-  GstPad *srcpad = GST_BASE_SRC_PAD (src);
+  GST_VISION_GRABBER_SRC (src)->timeout = src->timeout > 0 ?
+      (GstClockTime) src->timeout * GST_MSECOND : GST_CLOCK_TIME_NONE;
+}
 
+static void
+gst_niimaqsrc_init (GstNiImaqSrc * src)
+{
   GST_DEBUG_OBJECT (src, "init");
 
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
-
-  src->time_queue = g_async_queue_new ();
-
   /* initialize properties */
   src->bufsize = DEFAULT_PROP_RING_BUFFER_COUNT;
   src->interface_name = g_strdup (DEFAULT_PROP_DEVICE);
   src->is_signed = DEFAULT_PROP_IS_SIGNED;
   src->timeout = DEFAULT_PROP_TIMEOUT;
-
-  src->clock = NULL;
+  gst_niimaqsrc_update_timeout (src);
 }
 
 /**
@@ -347,12 +422,20 @@ gst_niimaqsrc_dispose (GObject * object)
   g_free (src->interface_name);
   src->interface_name = NULL;
 
-  g_async_queue_unref (src->time_queue);
-
   /* chain dispose fuction of parent class */
   G_OBJECT_CLASS (gst_niimaqsrc_parent_class)->dispose (object);
 }
 
+static void
+gst_niimaqsrc_finalize (GObject * object)
+{
+  GstNiImaqSrc *src = GST_NIIMAQSRC (object);
+
+  g_free (src->time_entries);
+
+  G_OBJECT_CLASS (gst_niimaqsrc_parent_class)->finalize (object);
+}
+
 static void
 gst_niimaqsrc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -373,6 +456,7 @@ gst_niimaqsrc_set_property (GObject * object, guint prop_id,
       break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
+      gst_niimaqsrc_update_timeout (src);
       break;
     default:
       break;
@@ -447,7 +531,6 @@ gst_niimaqsrc_reset (GstNiImaqSrc * src)
   /* initialize member variables */
   src->cumbufnum = 0;
   src->imaqFrameStartNum = 0;
-  src->n_dropped_frames = 0;
   src->sid = 0;
   src->iid = 0;
   src->session_started = FALSE;
@@ -459,19 +542,14 @@ gst_niimaqsrc_reset (GstNiImaqSrc * src)
   g_free (src->buflist);
   src->buflist = NULL;
 
-  if (src->time_queue) {
-    g_async_queue_unref (src->time_queue);
-  }
-  src->time_queue = g_async_queue_new ();
-
-  if (src->clock) {
-    gst_object_unref (src->clock);
-  }
+  g_free (src->time_entries);
+  src->time_entries = NULL;
 }
 
 static gboolean
-gst_niimaqsrc_start_acquisition (GstNiImaqSrc * src)
+gst_niimaqsrc_start_acquisition (GstVisionGrabberSrc * grabber)
 {
+  GstNiImaqSrc *src = GST_NIIMAQSRC (grabber);
   int i;
   gint32 rval;
 
@@ -479,6 +557,10 @@ gst_niimaqsrc_start_acquisition (GstNiImaqSrc * src)
 
   GST_DEBUG_OBJECT (src, "Starting acquisition");
 
+  /* assume delay between these two calls is negligible */
+  src->unix_base = g_get_real_time () * 1000;
+  src->stream_base = gst_vision_grabber_src_get_clock_time (grabber);
+
   /* try to open the camera five times */
   for (i = 0; i < 5; i++) {
     rval = imgSessionStartAcquisition (src->sid);
@@ -494,95 +576,24 @@ gst_niimaqsrc_start_acquisition (GstNiImaqSrc * src)
   /* we tried five times and failed, so we error */
   gst_niimaqsrc_close_interface (src);
 
+  GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+      ("Unable to start acquisition."), (NULL));
   return FALSE;
 }
 
 static GstFlowReturn
-gst_niimaqsrc_create (GstPushSrc * psrc, GstBuffer ** buffer)
+gst_niimaqsrc_prepare_buffer (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * frame, GstBuffer * buf)
 {
-  GstNiImaqSrc *src = GST_NIIMAQSRC (psrc);
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstClockTime timestamp = GST_CLOCK_TIME_NONE;
-  uInt32 copied_number;
-  uInt32 copied_index;
-  Int32 rval;
-  uInt32 dropped;
+  GstNiImaqSrc *src = GST_NIIMAQSRC (grabber);
   GstMapInfo minfo;
 
-  GST_LOG_OBJECT (src, "create");
-
-  /* start the IMAQ acquisition session if we haven't done so yet */
-  if (!src->session_started) {
-    if (!gst_niimaqsrc_start_acquisition (src)) {
-      GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-          ("Unable to start acquisition."), (NULL));
-      return GST_FLOW_ERROR;
-    }
-
-    src->clock = gst_element_get_clock (GST_ELEMENT (src));
-    /* assume delay between these two calls is negligible */
-    src->unix_base = g_get_real_time () * 1000;
-    src->stream_base = gst_clock_get_time (src->clock);
-  }
-
-  GST_LOG_OBJECT (src, "Allocating memory for IMAQ buffer #%d, size %d",
-      src->cumbufnum, src->framesize);
-  ret =
-      GST_BASE_SRC_CLASS (gst_niimaqsrc_parent_class)->alloc (GST_BASE_SRC
-      (src), 0, src->framesize, buffer);
-  if (ret != GST_FLOW_OK) {
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        ("Failed to allocate buffer"),
-        ("Failed to get downstream pad to allocate buffer"));
-    goto error;
-  }
-
-  gst_buffer_map (*buffer, &minfo, GST_MAP_WRITE);
-  rval = imgSessionCopyAreaByNumber (src->sid, src->cumbufnum, 0, 0,
-      src->height, src->width, minfo.data, src->rowpixels,
-      IMG_OVERWRITE_GET_OLDEST, &copied_number, &copied_index);
-  gst_buffer_unmap (*buffer, &minfo);
-  if (rval) {
-    gst_niimaqsrc_report_imaq_error (rval);
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        ("failed to copy buffer %d", src->cumbufnum),
-        ("failed to copy buffer %d", src->cumbufnum));
-    goto error;
-  }
-
-  while (timestamp == GST_CLOCK_TIME_NONE) {
-    /* wait 100 ms, shouldn't be needed if callback is working as expected */
-    GstNiImaqSrcTimeEntry *entry =
-        (GstNiImaqSrcTimeEntry *) g_async_queue_timeout_pop (src->time_queue,
-        100000);
-    if (entry == NULL) {
-      GST_WARNING_OBJECT (src, "No timestamps received, callback failed?");
-      break;
-    }
-
-    if (entry->frame_index < copied_number) {
-      GST_DEBUG_OBJECT (src,
-          "Got clocktime for frame %d while handling frame %d, frames dropped?",
-          entry->frame_index, copied_number);
-      g_free (entry);
-      continue;
-    } else if (entry->frame_index > copied_number) {
-      GST_DEBUG_OBJECT (src,
-          "Failed to get clocktime for frame %d, got one for frame %d instead",
-          copied_number, entry->frame_index);
-      g_free (entry);
-      break;
-    }
-    timestamp = entry->clock_time;
-    g_free (entry);
-  }
-
-  /* TODO: do this above to reduce copying overhead */
+  /* TODO: do this while copying to reduce overhead */
   if (src->is_signed) {
     gint16 *srcp;
     guint16 *dstp;
     guint i;
-    gst_buffer_map (*buffer, &minfo, GST_MAP_READWRITE);
+    gst_buffer_map (buf, &minfo, GST_MAP_READWRITE);
     srcp = minfo.data;
     dstp = minfo.data;
 
@@ -592,51 +603,23 @@ gst_niimaqsrc_create (GstPushSrc * psrc, GstBuffer ** buffer)
     for (i = 0; i < minfo.size / 2; i++)
       *dstp++ = *srcp++ + 32768;
 
-    gst_buffer_unmap (*buffer, &minfo);
+    gst_buffer_unmap (buf, &minfo);
   }
 
-  GST_BUFFER_OFFSET (*buffer) = copied_number;
-  GST_BUFFER_OFFSET_END (*buffer) = copied_number + 1;
-  GST_BUFFER_TIMESTAMP (*buffer) =
-      timestamp - gst_element_get_base_time (GST_ELEMENT (src));
 #if GST_CHECK_VERSION(1,14,0)
-  {
-    GstClockTime unix_ts = src->unix_base + (timestamp - src->stream_base);
-    gst_buffer_add_reference_timestamp_meta (*buffer,
+  if (GST_CLOCK_TIME_IS_VALID (frame->clock_time) &&
+      GST_CLOCK_TIME_IS_VALID (src->stream_base)) {
+    GstClockTime unix_ts =
+        src->unix_base + (frame->clock_time - src->stream_base);
+    gst_buffer_add_reference_timestamp_meta (buf,
         gst_static_caps_get (&unix_reference), unix_ts, GST_CLOCK_TIME_NONE);
-    GST_LOG_OBJECT (src, "Buffer #%d, adding unix timestamp: %llu",
-        GST_BUFFER_OFFSET (buffer), unix_ts);
-    /*{
-       GDateTime *frame_time, *tmpdt;
-       tmpdt = g_date_time_new_from_unix_utc (0);
-       frame_time = g_date_time_add_seconds(tmpdt, (gdouble)unix_ts / GST_SECOND);
-       g_date_time_unref (tmpdt);
-       GST_LOG ("Unix timestamp added is: %s.%d", g_date_time_format (frame_time, "%Y-%m-%d %H:%M:%S"), g_date_time_get_microsecond(frame_time));
-       g_date_time_unref (frame_time);
-       } */
+    GST_LOG_OBJECT (src, "Buffer #%" G_GUINT64_FORMAT
+        ", adding unix timestamp: %" G_GUINT64_FORMAT,
+        GST_BUFFER_OFFSET (buf), unix_ts);
   }
 #endif
 
-  dropped = copied_number - src->cumbufnum;
-  if (dropped > 0) {
-    src->n_dropped_frames += dropped;
-    GST_WARNING_OBJECT (src,
-        "Asked to copy buffer #%d but was given #%d; just dropped %d frames (%d total)",
-        src->cumbufnum, copied_number, dropped, src->n_dropped_frames);
-  }
-
-  /* set cumulative buffer number to get next frame */
-  src->cumbufnum = copied_number + 1;
-
-  return ret;
-
-error:
-  {
-    /* make sure we return an error */
-    if (ret == GST_FLOW_OK)
-      ret = GST_FLOW_ERROR;
-    return ret;
-  }
+  return GST_FLOW_OK;
 }
 
 /**
@@ -734,6 +717,9 @@ gst_niimaqsrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  if (!GST_BASE_SRC_CLASS (gst_niimaqsrc_parent_class)->start (bsrc))
+    return FALSE;
+
   gst_niimaqsrc_reset (src);
 
   GST_LOG_OBJECT (src, "Opening IMAQ interface: %s", src->interface_name);
@@ -771,6 +757,12 @@ gst_niimaqsrc_start (GstBaseSrc * bsrc)
   for (i = 0; i < src->bufsize; i++) {
     src->buflist[i] = 0;
   }
+
+  src->time_entries = g_new (GstNiImaqSrcTimeEntry, src->bufsize);
+  for (i = 0; i < src->bufsize; i++) {
+    src->time_entries[i].frame_index = G_MAXUINT64;
+    src->time_entries[i].clock_time = GST_CLOCK_TIME_NONE;
+  }
   /* CAUTION: if this is ever changed to manually allocate memory, we must
      be careful about allocating 64-bit addresses, as some IMAQ cards don't
      support this, and can give a runtime error. See above call to
@@ -789,6 +781,9 @@ gst_niimaqsrc_start (GstBaseSrc * bsrc)
   rval = imgSessionWaitSignalAsync2 (src->sid, IMG_SIGNAL_STATUS,
       IMG_FRAME_START, IMG_SIGNAL_STATE_RISING,
       gst_niimaqsrc_frame_start_callback, src);
+  rval |= imgSessionWaitSignalAsync2 (src->sid, IMG_SIGNAL_STATUS,
+      IMG_BUF_COMPLETE, IMG_SIGNAL_STATE_RISING,
+      gst_niimaqsrc_buffer_complete_callback, src);
   rval |= imgSessionWaitSignalAsync2 (src->sid, IMG_SIGNAL_STATUS,
       IMG_AQ_IN_PROGRESS, IMG_SIGNAL_STATE_RISING,
       gst_niimaqsrc_aq_in_progress_callback, src);
@@ -817,13 +812,16 @@ gst_niimaqsrc_start (GstBaseSrc * bsrc)
     src->timeout = timeout;
     GST_DEBUG_OBJECT (src, "Current timeout is %d msecs", timeout);
   }
+  gst_niimaqsrc_update_timeout (src);
 
   return TRUE;
 
 error:
   gst_niimaqsrc_close_interface (src);
 
-  return FALSE;;
+  GST_BASE_SRC_CLASS (gst_niimaqsrc_parent_class)->stop (bsrc);
+
+  return FALSE;
 
 }
 
@@ -859,6 +857,10 @@ gst_niimaqsrc_stop (GstBaseSrc * bsrc)
     GST_DEBUG_OBJECT (src, "Acquisition stopped");
   }
 
+  GST_BASE_SRC_CLASS (gst_niimaqsrc_parent_class)->stop (bsrc);
+
+  /* frames are copied out of the IMAQ ring in the callback, so nothing
+   * downstream still points into it */
   result &= gst_niimaqsrc_close_interface (src);
 
   gst_niimaqsrc_reset (src);
@@ -866,41 +868,6 @@ gst_niimaqsrc_stop (GstBaseSrc * bsrc)
   return result;
 }
 
-static gboolean
-gst_niimaqsrc_query (GstBaseSrc * bsrc, GstQuery * query)
-{
-  GstNiImaqSrc *src = GST_NIIMAQSRC (bsrc);
-  gboolean res;
-
-  switch (GST_QUERY_TYPE (query)) {
-    case GST_QUERY_LATENCY:{
-      if (!src->session_started) {
-        GST_WARNING_OBJECT (src, "Can't give latency since device isn't open!");
-        res = FALSE;
-      } else {
-        GstClockTime min_latency, max_latency;
-        /* TODO: this is a ballpark figure, estimate from FVAL times */
-        min_latency = 33 * GST_MSECOND;
-        max_latency = 33 * GST_MSECOND * src->bufsize;
-
-        GST_LOG_OBJECT (src,
-            "report latency min %" GST_TIME_FORMAT " max %" GST_TIME_FORMAT,
-            GST_TIME_ARGS (min_latency), GST_TIME_ARGS (max_latency));
-
-        gst_query_set_latency (query, TRUE, min_latency, max_latency);
-
-        res = TRUE;
-      }
-    }
-    default:
-      res =
-          GST_BASE_SRC_CLASS (gst_niimaqsrc_parent_class)->query (bsrc, query);
-      break;
-  }
-
-  return res;
-}
-
 static GstCaps *
 gst_niimaqsrc_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
 {
@@ -23,11 +23,12 @@
 #define __GST_NIIMAQSRC_H__
 
 #include <gst/gst.h>
-#include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
 #include <niimaq.h>
 
+#include "gstvisiongrabbersrc.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_NIIMAQSRC \
@@ -46,8 +47,15 @@ G_BEGIN_DECLS
 typedef struct _GstNiImaqSrc GstNiImaqSrc;
 typedef struct _GstNiImaqSrcClass GstNiImaqSrcClass;
 
+/* pipeline clock time at the start of a frame, from the frame start
+ * callback */
+typedef struct {
+  guint64 frame_index;
+  GstClockTime clock_time;
+} GstNiImaqSrcTimeEntry;
+
 struct _GstNiImaqSrc {
-  GstPushSrc element;
+  GstVisionGrabberSrc element;
 
   /* properties */
   gchar *interface_name;
@@ -62,25 +70,26 @@ struct _GstNiImaqSrc {
   gint framesize;
   int rowpixels;
 
+  /* only touched by the frame start callback */
   guint64 imaqFrameStartNum;
+  /* only touched by the buffer complete callback */
   uInt32 cumbufnum;
-  gint64 n_dropped_frames;
-  
+
+  /* indexed by frame number modulo bufsize */
+  GstNiImaqSrcTimeEntry *time_entries;
+
   guint32** buflist;
   INTERFACE_ID iid;
   SESSION_ID sid;
 
   gboolean session_started;
 
-  GAsyncQueue *time_queue;
-
-  GstClock *clock;
   GstClockTime stream_base;
   GstClockTime unix_base;
 };
 
 struct _GstNiImaqSrcClass {
-  GstPushSrcClass parent_class;
+  GstVisionGrabberSrcClass parent_class;
 
   /* probed interfaces */
   GList *interfaces;
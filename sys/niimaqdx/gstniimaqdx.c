@@ -56,7 +56,9 @@ enum
   PROP_RING_BUFFER_COUNT,
   PROP_ATTRIBUTES,
   PROP_BAYER_AS_GRAY,
-  PROP_IS_CONTROLLER
+  PROP_IS_CONTROLLER,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_DEVICE "cam0"
@@ -71,6 +73,7 @@ G_DEFINE_TYPE (GstNiImaqDxSrc, gst_niimaqdxsrc, GST_TYPE_PUSH_SRC);
 
 /* GObject virtual methods */
 static void gst_niimaqdxsrc_dispose (GObject * object);
+static void gst_niimaqdxsrc_finalize (GObject * object);
 static void gst_niimaqdxsrc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_niimaqdxsrc_get_property (GObject * object, guint prop_id,
@@ -83,6 +86,8 @@ static gboolean gst_niimaqdxsrc_query (GstBaseSrc * src, GstQuery * query);
 static GstCaps *gst_niimaqdxsrc_get_caps (GstBaseSrc * bsrc,
     GstCaps * caps_filter);
 static gboolean gst_niimaqdxsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps);
+static gboolean gst_niimaqdxsrc_decide_allocation (GstBaseSrc * bsrc,
+    GstQuery * query);
 
 /* GstPushSrc virtual methods */
 static GstFlowReturn gst_niimaqdxsrc_fill (GstPushSrc * src, GstBuffer * buf);
@@ -105,13 +110,6 @@ gst_niimaqdxsrc_report_imaq_error (IMAQdxError code)
   return code;
 }
 
-typedef struct _GstNiImaqDxSrcTimeEntry GstNiImaqDxSrcTimeEntry;
-struct _GstNiImaqDxSrcTimeEntry
-{
-  guint64 frame_index;
-  GstClockTime clock_time;
-};
-
 /* This will be called "when a frame done event occurs", so not start of frame */
 uInt32 NI_FUNC
 gst_niimaqdxsrc_frame_done_callback (IMAQdxSession session, uInt32 bufferNumber,
@@ -119,14 +117,16 @@ gst_niimaqdxsrc_frame_done_callback (IMAQdxSession session, uInt32 bufferNumber,
 {
   GstNiImaqDxSrc *src = GST_NIIMAQDXSRC (userdata);
   GstNiImaqDxSrcTimeEntry *time_entry;
-
-  time_entry = g_new (GstNiImaqDxSrcTimeEntry, 1);
+  GstClockTime clock_time;
 
   /* get clock time */
-  time_entry->clock_time = gst_clock_get_time (src->clock);
-  time_entry->frame_index = bufferNumber;
+  clock_time = gst_clock_get_time (src->clock);
 
-  g_async_queue_push (src->time_queue, time_entry);
+  GST_OBJECT_LOCK (src);
+  time_entry = &src->time_ring[bufferNumber % src->time_ring_size];
+  time_entry->clock_time = clock_time;
+  time_entry->frame_index = bufferNumber;
+  GST_OBJECT_UNLOCK (src);
 
   /* return 1 to rearm the callback */
   return 1;
@@ -434,6 +434,7 @@ gst_niimaqdxsrc_class_init (GstNiImaqDxSrcClass * klass)
 
   /* install GObject vmethod implementations */
   gobject_class->dispose = gst_niimaqdxsrc_dispose;
+  gobject_class->finalize = gst_niimaqdxsrc_finalize;
   gobject_class->set_property = gst_niimaqdxsrc_set_property;
   gobject_class->get_property = gst_niimaqdxsrc_get_property;
 
@@ -461,6 +462,8 @@ gst_niimaqdxsrc_class_init (GstNiImaqDxSrcClass * klass)
           "True for controller mode, false for listener mode",
           DEFAULT_PROP_IS_CONTROLLER,
           G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
   {
     GstCaps *caps = gst_caps_new_empty ();
     int i;
@@ -485,6 +488,8 @@ gst_niimaqdxsrc_class_init (GstNiImaqDxSrcClass * klass)
   gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_niimaqdxsrc_query);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_niimaqdxsrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_niimaqdxsrc_set_caps);
+  gstbasesrc_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_niimaqdxsrc_decide_allocation);
 
   /* install GstPushSrc vmethod implementations */
   gstpushsrc_class->fill = GST_DEBUG_FUNCPTR (gst_niimaqdxsrc_fill);
@@ -516,9 +521,9 @@ gst_niimaqdxsrc_init (GstNiImaqDxSrc * src)
   src->is_controller = DEFAULT_PROP_IS_CONTROLLER;
 
   /* initialize pointers, then call reset to initialize the rest */
-  src->temp_buffer = NULL;
-  src->time_queue = NULL;
+  src->time_ring = NULL;
   src->clock = NULL;
+  gst_vision_stats_init (&src->stats);
   gst_niimaqdxsrc_reset (src);
 }
 
@@ -539,13 +544,23 @@ gst_niimaqdxsrc_dispose (GObject * object)
   g_free (src->device_name);
   src->device_name = NULL;
 
-  /* unref objects */
-  g_async_queue_unref (src->time_queue);
+  g_free (src->time_ring);
+  src->time_ring = NULL;
 
   /* chain dispose fuction of parent class */
   G_OBJECT_CLASS (gst_niimaqdxsrc_parent_class)->dispose (object);
 }
 
+static void
+gst_niimaqdxsrc_finalize (GObject * object)
+{
+  GstNiImaqDxSrc *src = GST_NIIMAQDXSRC (object);
+
+  gst_vision_stats_clear (&src->stats);
+
+  G_OBJECT_CLASS (gst_niimaqdxsrc_parent_class)->finalize (object);
+}
+
 static void
 gst_niimaqdxsrc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -572,6 +587,9 @@ gst_niimaqdxsrc_set_property (GObject * object, guint prop_id,
     case PROP_IS_CONTROLLER:
       src->is_controller = g_value_get_boolean (value);
       break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       break;
   }
@@ -599,6 +617,12 @@ gst_niimaqdxsrc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_IS_CONTROLLER:
       g_value_set_boolean (value, src->is_controller);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -612,7 +636,7 @@ gst_niimaqdxsrc_reset (GstNiImaqDxSrc * src)
 
   /* initialize member variables */
   src->cumbufnum = 0;
-  src->n_dropped_frames = 0;
+  gst_vision_stats_reset (&src->stats);
   src->session = 0;
   src->session_started = FALSE;
   src->width = 0;
@@ -621,16 +645,20 @@ gst_niimaqdxsrc_reset (GstNiImaqDxSrc * src)
   src->dx_framesize = 0;
   src->gst_row_stride = 0;
   src->gst_framesize = 0;
+  src->gst_format = GST_VIDEO_FORMAT_UNKNOWN;
+  src->video_meta_supported = FALSE;
   src->caps_info = NULL;
   src->pixel_format[0] = 0;
 
-  g_free (src->temp_buffer);
-  src->temp_buffer = NULL;
-
-  if (src->time_queue) {
-    g_async_queue_unref (src->time_queue);
-  }
-  src->time_queue = g_async_queue_new ();
+  /* IMAQdx can only return frames still in its ring, so twice the ring size
+   * is enough that an entry is never overwritten before it is looked up */
+  GST_OBJECT_LOCK (src);
+  g_free (src->time_ring);
+  src->time_ring_size = 2 * src->ringbuffer_count;
+  src->time_ring = g_new (GstNiImaqDxSrcTimeEntry, src->time_ring_size);
+  memset (src->time_ring, 0xff,
+      src->time_ring_size * sizeof (GstNiImaqDxSrcTimeEntry));
+  GST_OBJECT_UNLOCK (src);
 
   if (src->clock) {
     gst_object_unref (src->clock);
@@ -680,6 +708,7 @@ gst_niimaqdxsrc_fill (GstPushSrc * psrc, GstBuffer * buf)
   uInt32 dropped;
   gboolean do_align_stride;
   GstMapInfo minfo;
+  GstClockTime now;
 
   /* start the IMAQ acquisition session if we haven't done so yet */
   if (!src->session_started) {
@@ -711,27 +740,55 @@ gst_niimaqdxsrc_fill (GstPushSrc * psrc, GstBuffer * buf)
 
   do_align_stride = src->dx_row_stride != src->gst_row_stride;
 
-  if (!do_align_stride) {
-    gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
-    // we have properly aligned strides, copy directly to buffer
-    rval = IMAQdxGetImageData (src->session, minfo.data,
-        minfo.size, IMAQdxBufferNumberModeBufferNumber,
-        src->cumbufnum, &copied_number);
-    gst_buffer_unmap (buf, &minfo);
-  } else {
-    // we don't have aligned strides, copy to temp buffer
-    rval = IMAQdxGetImageData (src->session, src->temp_buffer,
-        src->dx_framesize, IMAQdxBufferNumberModeBufferNumber,
-        src->cumbufnum, &copied_number);
-  }
+  /* extract straight into the buffer, which is at least as large as the
+   * frame at IMAQdx's native stride */
+  gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
+  g_assert (minfo.size >= src->dx_framesize);
+  rval = IMAQdxGetImageData (src->session, minfo.data,
+      src->dx_framesize, IMAQdxBufferNumberModeBufferNumber,
+      src->cumbufnum, &copied_number);
 
   if (rval) {
+    gst_buffer_unmap (buf, &minfo);
+    if (rval == IMAQdxErrorTimeout)
+      gst_vision_stats_add_timeout (&src->stats);
     gst_niimaqdxsrc_report_imaq_error (rval);
     GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
         ("failed to copy buffer %d", src->cumbufnum), (NULL));
     return GST_FLOW_ERROR;
   }
 
+  // adjust for row stride if needed (must be multiple of 4)
+  if (do_align_stride) {
+    if (src->video_meta_supported &&
+        src->gst_format != GST_VIDEO_FORMAT_UNKNOWN &&
+        src->gst_format != GST_VIDEO_FORMAT_ENCODED) {
+      gsize offset[GST_VIDEO_MAX_PLANES] = { 0 };
+      gint stride[GST_VIDEO_MAX_PLANES] = { src->dx_row_stride };
+
+      gst_buffer_unmap (buf, &minfo);
+      GST_LOG_OBJECT (src, "Row stride not aligned, adding video meta with "
+          "stride %d", src->dx_row_stride);
+      gst_buffer_set_size (buf, src->dx_framesize);
+      gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE,
+          src->gst_format, src->width, src->height, 1, offset, stride);
+    } else {
+      int i;
+
+      /* spread rows out in place, last row first so none are overwritten */
+      GST_LOG_OBJECT (src,
+          "Row stride not aligned, moving %d -> %d",
+          src->dx_row_stride, src->gst_row_stride);
+      g_assert (minfo.size >= src->gst_framesize);
+      for (i = src->height - 1; i > 0; i--)
+        memmove (minfo.data + i * src->gst_row_stride,
+            minfo.data + i * src->dx_row_stride, src->dx_row_stride);
+      gst_buffer_unmap (buf, &minfo);
+    }
+  } else {
+    gst_buffer_unmap (buf, &minfo);
+  }
+
   if (src->cumbufnum == 0 && src->cumbufnum != copied_number) {
     /* with some cameras we always lose the first few frames, don't report
        these as dropped frames */
@@ -743,51 +800,22 @@ gst_niimaqdxsrc_fill (GstPushSrc * psrc, GstBuffer * buf)
   if (src->is_jpeg) {
     /* JPEG sources don't seem to give reliable callbacks, just pull clock */
     timestamp = gst_clock_get_time (src->clock);
-  }
+  } else {
+    GstNiImaqDxSrcTimeEntry *entry;
 
-  while (timestamp == GST_CLOCK_TIME_NONE) {
-    /* wait 100 ms, shouldn't be needed if callback is working as expected */
-    GstNiImaqDxSrcTimeEntry *entry =
-        (GstNiImaqDxSrcTimeEntry *) g_async_queue_timeout_pop (src->time_queue,
-        100000);
-    if (entry == NULL) {
-      GST_WARNING_OBJECT (src, "No timestamps received, callback failed?");
-      break;
+    GST_OBJECT_LOCK (src);
+    entry = &src->time_ring[copied_number % src->time_ring_size];
+    if (entry->frame_index == copied_number) {
+      timestamp = entry->clock_time;
     }
+    GST_OBJECT_UNLOCK (src);
 
-    if (entry->frame_index < copied_number) {
-      GST_LOG_OBJECT (src,
-          "Discarding timestamp for frame %d while searching for frame %d",
-          entry->frame_index, copied_number);
-      g_free (entry);
-      continue;
-    } else if (entry->frame_index > copied_number) {
-      GST_WARNING_OBJECT (src,
-          "Failed to get clocktime for frame %d, got one for frame %d instead",
-          copied_number, entry->frame_index);
-      g_free (entry);
-      break;
+    if (timestamp == GST_CLOCK_TIME_NONE) {
+      /* callback hasn't run yet for this frame, current time is close */
+      GST_DEBUG_OBJECT (src, "No timestamp for frame %d, callback late?",
+          copied_number);
+      timestamp = gst_clock_get_time (src->clock);
     }
-    timestamp = entry->clock_time;
-    g_free (entry);
-  }
-
-  // adjust for row stride if needed (must be multiple of 4)
-  if (do_align_stride) {
-    int i;
-    guint8 *tmpbuf = src->temp_buffer;
-    guint8 *dst;
-
-    gst_buffer_map (buf, &minfo, GST_MAP_WRITE);
-    dst = minfo.data;
-    GST_LOG_OBJECT (src,
-        "Row stride not aligned, copying %d -> %d",
-        src->dx_row_stride, src->gst_row_stride);
-    g_assert (minfo.size >= src->gst_framesize);
-    for (i = 0; i < src->height; i++)
-      memcpy (dst + i * src->gst_row_stride, tmpbuf + i * src->dx_row_stride,
-          src->dx_row_stride);
-    gst_buffer_unmap (buf, &minfo);
   }
 
   /* make guess of duration from timestamp and cumulative buffer number */
@@ -824,15 +852,20 @@ gst_niimaqdxsrc_fill (GstPushSrc * psrc, GstBuffer * buf)
   dropped = copied_number - src->cumbufnum;
   if (dropped > 0) {
     GstStructure *infoStruct;
+    guint64 total_dropped;
 
-    src->n_dropped_frames += dropped;
+    gst_vision_stats_add_dropped (&src->stats, dropped);
+    g_mutex_lock (&src->stats.lock);
+    total_dropped = src->stats.frames_dropped;
+    g_mutex_unlock (&src->stats.lock);
     GST_WARNING_OBJECT (src,
-        "Asked to copy buffer #%d but was given #%d; just dropped %d frames (%d total)",
-        src->cumbufnum, copied_number, dropped, src->n_dropped_frames);
+        "Asked to copy buffer #%d but was given #%d; just dropped %d frames (%"
+        G_GUINT64_FORMAT " total)", src->cumbufnum, copied_number, dropped,
+        total_dropped);
 
     infoStruct = gst_structure_new ("dropped-frame-info",
         "num-dropped-frames", G_TYPE_INT, dropped,
-        "total-dropped-frames", G_TYPE_INT, src->n_dropped_frames,
+        "total-dropped-frames", G_TYPE_INT, (gint) total_dropped,
         "timestamp", GST_TYPE_CLOCK_TIME, GST_BUFFER_TIMESTAMP (buf), NULL);
     gst_element_post_message (GST_ELEMENT (src),
         gst_message_new_element (GST_OBJECT (src), infoStruct));
@@ -841,6 +874,11 @@ gst_niimaqdxsrc_fill (GstPushSrc * psrc, GstBuffer * buf)
   /* set cumulative buffer number to get next frame */
   src->cumbufnum = copied_number + 1;
 
+  now = gst_clock_get_time (src->clock);
+  gst_vision_stats_add_delivered (&src->stats,
+      gst_vision_stats_latency (timestamp, now));
+  gst_vision_stats_post (&src->stats, GST_ELEMENT (src), now, NULL);
+
   return GST_FLOW_OK;
 }
 
@@ -1256,13 +1294,18 @@ gst_niimaqdxsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
 
   src->gst_framesize = src->gst_row_stride * src->height;
 
+  /* bayer and JPEG have no GstVideoFormat to describe with GstVideoMeta */
+  {
+    GstVideoInfo vinfo;
+    if (gst_video_info_from_caps (&vinfo, caps))
+      src->gst_format = GST_VIDEO_INFO_FORMAT (&vinfo);
+    else
+      src->gst_format = GST_VIDEO_FORMAT_UNKNOWN;
+  }
+
   /* TODO: don't use default_alloc, app can change blocksize */
   gst_base_src_set_blocksize (bsrc, src->gst_framesize);
 
-  if (src->temp_buffer)
-    g_free (src->temp_buffer);
-  src->temp_buffer = g_malloc (src->dx_framesize);
-
   GST_DEBUG ("Size %dx%d", src->width, src->height);
 
   GST_LOG_OBJECT (src, "Caps set, framesize=%d", src->dx_framesize);
@@ -1270,6 +1313,22 @@ gst_niimaqdxsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
   return TRUE;
 }
 
+static gboolean
+gst_niimaqdxsrc_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstNiImaqDxSrc *src = GST_NIIMAQDXSRC (bsrc);
+
+  /* if downstream understands GstVideoMeta frames can keep IMAQdx's stride
+   * instead of being realigned */
+  src->video_meta_supported =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  GST_DEBUG_OBJECT (src, "Downstream %s GstVideoMeta",
+      src->video_meta_supported ? "supports" : "doesn't support");
+
+  return GST_BASE_SRC_CLASS (gst_niimaqdxsrc_parent_class)->decide_allocation
+      (bsrc, query);
+}
+
 /**
 * gst_niimaqdxsrc_close_interface:
 * src: #GstNiImaqDxSrc instance
@@ -28,6 +28,8 @@
 
 #include <niimaqdx.h>
 
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_NIIMAQDXSRC \
@@ -46,6 +48,13 @@ G_BEGIN_DECLS
 typedef struct _GstNiImaqDxSrc GstNiImaqDxSrc;
 typedef struct _GstNiImaqDxSrcClass GstNiImaqDxSrcClass;
 
+/* clock time of a frame done event, indexed by buffer number */
+typedef struct
+{
+  guint64 frame_index;
+  GstClockTime clock_time;
+} GstNiImaqDxSrcTimeEntry;
+
 typedef struct
 {
     const char *pixel_format;
@@ -74,18 +83,22 @@ struct _GstNiImaqDxSrc {
   gint dx_framesize;
   int gst_row_stride;
   gint gst_framesize;
-  guint8 *temp_buffer;
+  GstVideoFormat gst_format;
+  gboolean video_meta_supported;
   const ImaqDxCapsInfo *caps_info;
   gboolean is_jpeg;
 
   uInt32 cumbufnum;
-  gint64 n_dropped_frames;
-  
+
+  GstVisionStats stats;
+
   IMAQdxSession session;
 
   gboolean session_started;
 
-  GAsyncQueue *time_queue;
+  /* written by frame done callback, protected by the object lock */
+  GstNiImaqDxSrcTimeEntry *time_ring;
+  guint time_ring_size;
 
   GstClock *clock;
   GstClockTime stream_base;
@@ -41,7 +41,6 @@
 #endif
 
 #include <gst/gst.h>
-#include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
 
 #include "gstphoenixsrc.h"
@@ -62,7 +61,9 @@ static gboolean gst_phoenixsrc_stop (GstBaseSrc * src);
 static GstCaps *gst_phoenixsrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_phoenixsrc_set_caps (GstBaseSrc * src, GstCaps * caps);
 
-static GstFlowReturn gst_phoenixsrc_create (GstPushSrc * src, GstBuffer ** buf);
+static gboolean gst_phoenixsrc_start_acquisition (GstVisionGrabberSrc * src);
+static GstFlowReturn gst_phoenixsrc_prepare_buffer (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame, GstBuffer * buf);
 
 static GstCaps *gst_phoenixsrc_create_caps (GstPhoenixSrc * src);
 enum
@@ -79,6 +80,9 @@ enum
 #define DEFAULT_PROP_BOARD 0
 #define DEFAULT_PROP_CHANNEL 0
 
+/* PHX_TIMEOUT_DMA, the base class waits as long for a frame */
+#define DMA_TIMEOUT_MS 1000
+
 /* pad templates */
 
 static GstStaticPadTemplate gst_phoenixsrc_src_template =
@@ -96,7 +100,7 @@ static GstStaticPadTemplate gst_phoenixsrc_src_template =
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstPhoenixSrc, gst_phoenixsrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstPhoenixSrc, gst_phoenixsrc, GST_TYPE_VISION_GRABBER_SRC);
 
 static void
 gst_phoenixsrc_class_init (GstPhoenixSrcClass * klass)
@@ -104,7 +108,8 @@ gst_phoenixsrc_class_init (GstPhoenixSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   gobject_class->set_property = gst_phoenixsrc_set_property;
   gobject_class->get_property = gst_phoenixsrc_get_property;
@@ -124,7 +129,10 @@ gst_phoenixsrc_class_init (GstPhoenixSrcClass * klass)
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_phoenixsrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_phoenixsrc_set_caps);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_phoenixsrc_create);
+  grabber_class->start_acquisition =
+      GST_DEBUG_FUNCPTR (gst_phoenixsrc_start_acquisition);
+  grabber_class->prepare_buffer =
+      GST_DEBUG_FUNCPTR (gst_phoenixsrc_prepare_buffer);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_CAMERA_CONFIG_FILEPATH,
@@ -151,35 +159,21 @@ gst_phoenixsrc_class_init (GstPhoenixSrcClass * klass)
 static void
 gst_phoenixsrc_init (GstPhoenixSrc * phoenixsrc)
 {
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (phoenixsrc), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (phoenixsrc), GST_FORMAT_TIME);
-
   /* initialize member variables */
   phoenixsrc->config_filepath = g_strdup (DEFAULT_PROP_CAMERA_CONFIG_FILEPATH);
   phoenixsrc->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
 
   phoenixsrc->first_phoenix_ts = GST_CLOCK_TIME_NONE;
-  phoenixsrc->frame_start_times =
-      g_new (guint64, phoenixsrc->num_capture_buffers);
-  phoenixsrc->frame_end_times =
-      g_new (guint64, phoenixsrc->num_capture_buffers);
-  phoenixsrc->buffer_ready = FALSE;
-  phoenixsrc->timeout_occurred = FALSE;
   phoenixsrc->fifo_overflow_occurred = FALSE;
+  gst_vision_clock_mapper_init (&phoenixsrc->clock_mapper, 1e9, 64, 0);
 
-  phoenixsrc->buffer_ready_count = 0;
-  phoenixsrc->buffer_processed_count = 0;
-  phoenixsrc->frame_end_count = 0;
-  phoenixsrc->frame_start_count = 0;
-  /*phoenixsrc->frame_count = 0; */
+  phoenixsrc->buffer_timing = NULL;
+  phoenixsrc->buffer_addrs = NULL;
+  phoenixsrc->pool = NULL;
 
   phoenixsrc->hCamera = 0;
 
-  g_mutex_init (&phoenixsrc->mutex);
-  g_cond_init (&phoenixsrc->cond);
+  GST_VISION_GRABBER_SRC (phoenixsrc)->timeout = DMA_TIMEOUT_MS * GST_MSECOND;
 }
 
 void
@@ -203,14 +197,6 @@ gst_phoenixsrc_set_property (GObject * object, guint property_id,
             (NULL));
       } else {
         phoenixsrc->num_capture_buffers = g_value_get_uint (value);
-
-        g_free (phoenixsrc->frame_start_times);
-        phoenixsrc->frame_start_times =
-            g_new (guint64, phoenixsrc->num_capture_buffers);
-
-        g_free (phoenixsrc->frame_end_times);
-        phoenixsrc->frame_end_times =
-            g_new (guint64, phoenixsrc->num_capture_buffers);
       }
       break;
     case PROP_BOARD:
@@ -277,22 +263,31 @@ gst_phoenixsrc_finalize (GObject * object)
   phoenixsrc = GST_PHOENIX_SRC (object);
 
   /* clean up object here */
-  g_free (phoenixsrc->frame_start_times);
-  g_free (phoenixsrc->frame_end_times);
+  g_free (phoenixsrc->buffer_timing);
+  g_free (phoenixsrc->buffer_addrs);
+  if (phoenixsrc->pool) {
+    gst_buffer_pool_set_active (phoenixsrc->pool, FALSE);
+    gst_object_unref (phoenixsrc->pool);
+  }
 
   G_OBJECT_CLASS (gst_phoenixsrc_parent_class)->finalize (object);
 }
 
+/* only called from phx_callback */
 static inline GstClockTime
 gst_phoenix_get_timestamp (GstPhoenixSrc * phoenixsrc)
 {
   ui32 dwParam;
   guint64 timestamp;
 
-  /* get time in microseconds from start of acquisition */
-  /* TODO: check for rollover */
+  /* get time in microseconds from start of acquisition, extending the 32-bit
+   * counter which wraps after about 71 minutes */
   PHX_ParameterGet (phoenixsrc->hCamera, PHX_EVENTCOUNT, &dwParam);
-  timestamp = (guint64) 1000 *dwParam;
+  if (dwParam < phoenixsrc->last_event_count) {
+    phoenixsrc->event_count_high += G_GUINT64_CONSTANT (1) << 32;
+  }
+  phoenixsrc->last_event_count = dwParam;
+  timestamp = (guint64) 1000 *(phoenixsrc->event_count_high + dwParam);
 
   if (phoenixsrc->first_phoenix_ts == GST_CLOCK_TIME_NONE) {
     phoenixsrc->first_phoenix_ts = timestamp;
@@ -300,61 +295,192 @@ gst_phoenix_get_timestamp (GstPhoenixSrc * phoenixsrc)
   return timestamp - phoenixsrc->first_phoenix_ts;
 }
 
+/* only called from phx_callback, returns the capture buffer index of a DMA
+ * buffer address. Addresses not seen yet are taken to be the next buffer in
+ * ring order. */
+static guint
+gst_phoenixsrc_lookup_buffer (GstPhoenixSrc * phoenixsrc, gpointer address)
+{
+  guint i, index;
+
+  for (i = 0; i < phoenixsrc->num_capture_buffers; i++) {
+    if (phoenixsrc->buffer_addrs[i] == address)
+      return i;
+  }
+
+  index = phoenixsrc->buffer_ready_count % phoenixsrc->num_capture_buffers;
+  phoenixsrc->buffer_addrs[index] = address;
+  GST_DEBUG_OBJECT (phoenixsrc, "Buffer %u is at %p", index, address);
+
+  return index;
+}
+
+/* only called from phx_callback. Acquisition doesn't block, so the board
+ * overwrites a DMA buffer once it has gone round all of them; the frame is
+ * copied out right away and its DMA buffer released. */
+static void
+gst_phoenixsrc_push_frame (GstPhoenixSrc * phoenixsrc)
+{
+  GstVisionGrabberSrc *grabber = GST_VISION_GRABBER_SRC (phoenixsrc);
+  GstVisionGrabberFrame frame;
+  GstPhoenixSrcFrameTiming *timing;
+  GstBufferPoolAcquireParams params = { 0, };
+  etStat eStat = PHX_OK;        /* Phoenix status variable */
+  stImageBuff phx_buffer;
+  GstClockTime clock_time;
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  GstMapInfo minfo;
+  guint8 *src;
+  gint i;
+
+  eStat = PHX_Acquire (phoenixsrc->hCamera, PHX_BUFFER_GET, &phx_buffer);
+  if (PHX_OK != eStat) {
+    /* the gap in frame numbers is counted as a drop */
+    GST_WARNING_OBJECT (phoenixsrc, "Failed to get buffer");
+    return;
+  }
+
+  /* the record of the frame written to this buffer, a frame that has
+   * started since then went into another buffer */
+  timing = &phoenixsrc->buffer_timing[gst_phoenixsrc_lookup_buffer (phoenixsrc,
+          phx_buffer.pvAddress)];
+  phoenixsrc->buffer_ready_count++;
+
+  gst_vision_grabber_frame_init (&frame);
+
+  /* the pool is allocated in set_caps, and grows rather than waits when
+   * downstream holds all of its buffers */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  if (phoenixsrc->pool == NULL ||
+      gst_buffer_pool_acquire_buffer (phoenixsrc->pool, &frame.buffer,
+          &params) != GST_FLOW_OK) {
+    GST_WARNING_OBJECT (phoenixsrc, "No buffer for frame %" G_GUINT64_FORMAT,
+        timing->frame_number);
+    PHX_Acquire (phoenixsrc->hCamera, PHX_BUFFER_RELEASE, NULL);
+    return;
+  }
+
+  /* Copy image to buffer from surface */
+  gst_buffer_map (frame.buffer, &minfo, GST_MAP_WRITE);
+  src = (guint8 *) phx_buffer.pvAddress;
+  if (phoenixsrc->phx_stride == (guint) phoenixsrc->gst_stride) {
+    memcpy (minfo.data, src, (gsize) phoenixsrc->gst_stride *
+        phoenixsrc->height);
+  } else {
+    for (i = 0; i < phoenixsrc->height; i++) {
+      memcpy (minfo.data + i * phoenixsrc->gst_stride,
+          src + i * phoenixsrc->phx_stride, phoenixsrc->gst_stride);
+    }
+  }
+  gst_buffer_unmap (frame.buffer, &minfo);
+
+  /* Having processed the data, release the buffer ready for further image data */
+  PHX_Acquire (phoenixsrc->hCamera, PHX_BUFFER_RELEASE, NULL);
+
+  GST_LOG_OBJECT (phoenixsrc, "Frame %" G_GUINT64_FORMAT
+      " at %p, event count %" G_GUINT64_FORMAT, timing->frame_number,
+      phx_buffer.pvAddress, timing->event_count);
+
+  frame.frame_number = timing->frame_number;
+
+  if (GST_CLOCK_TIME_IS_VALID (timing->start_time) &&
+      GST_CLOCK_TIME_IS_VALID (timing->end_time) &&
+      timing->end_time >= timing->start_time) {
+    duration = timing->end_time - timing->start_time;
+  }
+  GST_BUFFER_DURATION (frame.buffer) = duration;
+
+  /* board time counts from the start of acquisition. Frame end is the event
+   * closest to this callback, so it is what gets mapped onto the pipeline
+   * clock, then the timestamp is centered on the frame valid period. */
+  clock_time = gst_vision_grabber_src_get_clock_time (grabber);
+  if (GST_CLOCK_TIME_IS_VALID (clock_time) &&
+      GST_CLOCK_TIME_IS_VALID (timing->end_time)) {
+    frame.clock_time =
+        gst_vision_clock_mapper_add_sample (&phoenixsrc->clock_mapper,
+        timing->end_time, clock_time);
+    if (GST_CLOCK_TIME_IS_VALID (duration) && frame.clock_time >= duration / 2)
+      frame.clock_time -= duration / 2;
+  }
+
+  gst_vision_grabber_src_push_frame (grabber, &frame);
+}
+
+/* only called from phx_callback, returns the record of the frame that
+ * started last, or NULL before the first one */
+static GstPhoenixSrcFrameTiming *
+gst_phoenixsrc_current_timing (GstPhoenixSrc * phoenixsrc)
+{
+  if (phoenixsrc->frame_start_count == 0)
+    return NULL;
+
+  return &phoenixsrc->buffer_timing[(phoenixsrc->frame_start_count - 1) %
+      phoenixsrc->num_capture_buffers];
+}
+
+/* only called from phx_callback, the board writes the frame to the next
+ * buffer in ring order */
+static void
+gst_phoenixsrc_frame_start (GstPhoenixSrc * phoenixsrc, GstClockTime ct)
+{
+  GstPhoenixSrcFrameTiming *timing =
+      &phoenixsrc->buffer_timing[phoenixsrc->frame_start_count %
+      phoenixsrc->num_capture_buffers];
+
+  timing->frame_number = phoenixsrc->frame_start_count++;
+  timing->event_count =
+      phoenixsrc->event_count_high + phoenixsrc->last_event_count;
+  timing->start_time = ct;
+  timing->end_time = GST_CLOCK_TIME_NONE;
+}
+
 /* Callback function to handle image capture events. */
 void
 phx_callback (tHandle hCamera, ui32 dwMask, void *pvParams)
 {
   GstPhoenixSrc *phoenixsrc = GST_PHOENIX_SRC (pvParams);
   GstClockTime ct = gst_phoenix_get_timestamp (phoenixsrc);
-  gboolean signal_create_func = FALSE;
-  guint n;
+  GstPhoenixSrcFrameTiming *current =
+      gst_phoenixsrc_current_timing (phoenixsrc);
+  gboolean start_first;
 
-  g_mutex_lock (&phoenixsrc->mutex);
-
-  /* Note that more than one interrupt can be sent, so no "else if" */
+  /* Note that more than one interrupt can be sent, so no "else if". Events
+   * of the frame being captured come before a frame start, unless no frame
+   * is being captured, then frame start and end are of the same frame. */
+  start_first = (PHX_INTRPT_FRAME_START & dwMask) &&
+      (PHX_INTRPT_FRAME_END & dwMask) &&
+      (current == NULL || GST_CLOCK_TIME_IS_VALID (current->end_time));
 
   /* called when frame valid signal goes high */
-  if (PHX_INTRPT_FRAME_START & dwMask) {
-    /* FIXME: this will work until frames are dropped */
-    n = phoenixsrc->frame_start_count % phoenixsrc->num_capture_buffers;
-    phoenixsrc->frame_start_times[n] = ct;
-
-    phoenixsrc->frame_start_count++;
+  if (start_first) {
+    gst_phoenixsrc_frame_start (phoenixsrc, ct);
+    current = gst_phoenixsrc_current_timing (phoenixsrc);
   }
 
   /* called when frame valid signal goes low */
-  if (PHX_INTRPT_FRAME_END & dwMask) {
-    /* FIXME: this will work until frames are dropped */
-    n = (phoenixsrc->frame_end_count - 1) % phoenixsrc->num_capture_buffers;
-    phoenixsrc->frame_end_times[n] = ct;
-
-    phoenixsrc->frame_end_count++;
+  if ((PHX_INTRPT_FRAME_END & dwMask) && current) {
+    current->end_time = ct;
   }
 
   if (PHX_INTRPT_BUFFER_READY & dwMask) {
-    /* we have a buffer */
-    phoenixsrc->buffer_ready = TRUE;
-    phoenixsrc->buffer_ready_count++;
-    signal_create_func = TRUE;
+    gst_phoenixsrc_push_frame (phoenixsrc);
+  }
+
+  if ((PHX_INTRPT_FRAME_START & dwMask) && !start_first) {
+    gst_phoenixsrc_frame_start (phoenixsrc, ct);
   }
 
   if (PHX_INTRPT_TIMEOUT & dwMask) {
-    /* TODO: we could offer to try and ABORT then re-START capture */
-    phoenixsrc->timeout_occurred = TRUE;
-    signal_create_func = TRUE;
+    /* no frame is pushed, so create runs into the same timeout and fails */
+    GST_WARNING_OBJECT (phoenixsrc, "DMA timeout");
   }
 
-  if (PHX_INTRPT_FIFO_OVERFLOW & dwMask) {
+  if (PHX_INTRPT_FIFO_OVERFLOW & dwMask && !phoenixsrc->fifo_overflow_occurred) {
+    /* TODO: we could offer to try and ABORT then re-START capture */
     phoenixsrc->fifo_overflow_occurred = TRUE;
-    signal_create_func = TRUE;
+    GST_ELEMENT_ERROR (phoenixsrc, RESOURCE, FAILED,
+        (("Acquisition failure due to FIFO overflow.")), (NULL));
   }
-
-
-
-  if (signal_create_func)
-    g_cond_signal (&phoenixsrc->cond);
-  g_mutex_unlock (&phoenixsrc->mutex);
-  /* after unlocking, _create will check for these errors and copy data */
 }
 
 static gboolean
@@ -368,6 +494,9 @@ gst_phoenixsrc_start (GstBaseSrc * src)
 
   GST_DEBUG_OBJECT (phoenixsrc, "start");
 
+  if (!GST_BASE_SRC_CLASS (gst_phoenixsrc_parent_class)->start (src))
+    return FALSE;
+
   if (phoenixsrc->config_filepath == NULL) {
     GST_WARNING_OBJECT (phoenixsrc,
         "No config file set, using default 640x480x8bpp");
@@ -460,8 +589,25 @@ gst_phoenixsrc_start (GstBaseSrc * src)
   eParamValue = phoenixsrc->num_capture_buffers;
   PHX_ParameterSet (phoenixsrc->hCamera, PHX_ACQ_NUM_IMAGES, &eParamValue);
 
+  /* the board allocates the DMA buffers, their addresses are learned as
+   * phx_callback gets them */
+  g_free (phoenixsrc->buffer_timing);
+  phoenixsrc->buffer_timing =
+      g_new0 (GstPhoenixSrcFrameTiming, phoenixsrc->num_capture_buffers);
+  g_free (phoenixsrc->buffer_addrs);
+  phoenixsrc->buffer_addrs =
+      g_new0 (gpointer, phoenixsrc->num_capture_buffers);
+
+  phoenixsrc->first_phoenix_ts = GST_CLOCK_TIME_NONE;
+  phoenixsrc->last_event_count = 0;
+  phoenixsrc->event_count_high = 0;
+  phoenixsrc->frame_start_count = 0;
+  phoenixsrc->buffer_ready_count = 0;
+  phoenixsrc->fifo_overflow_occurred = FALSE;
+  gst_vision_clock_mapper_reset (&phoenixsrc->clock_mapper);
+
   /* Setup a one second timeout value (milliseconds) */
-  dwParamValue = 1000;
+  dwParamValue = DMA_TIMEOUT_MS;
   eStat =
       PHX_ParameterSet (phoenixsrc->hCamera, PHX_TIMEOUT_DMA,
       (void *) &dwParamValue);
@@ -504,6 +650,8 @@ Error:
   if (phoenixsrc->hCamera)
     PHX_CameraRelease (&phoenixsrc->hCamera);
 
+  GST_BASE_SRC_CLASS (gst_phoenixsrc_parent_class)->stop (src);
+
   return FALSE;
 }
 
@@ -514,17 +662,26 @@ gst_phoenixsrc_stop (GstBaseSrc * src)
 
   GST_DEBUG_OBJECT (phoenixsrc, "stop");
 
-  if (phoenixsrc->hCamera) {
-    /* Stop the acquisition */
-    /* TODO: should we use PHX_STOP (finished current image) instead? */
+  /* Stop the acquisition, so phx_callback no longer pushes frames */
+  /* TODO: should we use PHX_STOP (finished current image) instead? */
+  if (phoenixsrc->hCamera)
     PHX_Acquire (phoenixsrc->hCamera, PHX_ABORT, NULL);
 
-    /* Deallocates hardware and software resources, setting handle to null */
+  GST_BASE_SRC_CLASS (gst_phoenixsrc_parent_class)->stop (src);
+
+  /* frames are copied out of the DMA buffers in phx_callback, so nothing
+   * downstream still points into them */
+  /* Deallocates hardware and software resources, setting handle to null */
+  if (phoenixsrc->hCamera)
     PHX_CameraRelease (&phoenixsrc->hCamera);
+
+  if (phoenixsrc->pool) {
+    gst_buffer_pool_set_active (phoenixsrc->pool, FALSE);
+    gst_object_unref (phoenixsrc->pool);
+    phoenixsrc->pool = NULL;
   }
 
-  phoenixsrc->dropped_frame_count = 0;
-  /*phoenixsrc->last_time_code = -1; */
+  phoenixsrc->acq_started = FALSE;
 
   return TRUE;
 }
@@ -761,6 +918,33 @@ gst_phoenixsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
     goto unsupported_caps;
   }
 
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+  }
+
+  /* phx_callback copies each frame into one of these, one more than the
+   * grabber queue holds so the driver thread rarely has to allocate */
+  {
+    GstStructure *config;
+    guint queue_size;
+
+    g_object_get (src, "queue-size", &queue_size, NULL);
+
+    src->pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (src->pool);
+    gst_buffer_pool_config_set_params (config, NULL,
+        (guint) src->gst_stride * src->height, queue_size + 1, 0);
+    if (!gst_buffer_pool_set_config (src->pool, config) ||
+        !gst_buffer_pool_set_active (src->pool, TRUE)) {
+      GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS,
+          ("Failed to allocate buffer pool"), (NULL));
+      gst_object_unref (src->pool);
+      src->pool = NULL;
+      return FALSE;
+    }
+  }
+
   return TRUE;
 
 unsupported_caps:
@@ -830,127 +1014,35 @@ gst_phoenixsrc_log_fpga_temperature (GstPhoenixSrc * src)
   }
 }
 
-static GstFlowReturn
-gst_phoenixsrc_create (GstPushSrc * src, GstBuffer ** buf)
+static gboolean
+gst_phoenixsrc_start_acquisition (GstVisionGrabberSrc * src)
 {
   GstPhoenixSrc *phoenixsrc = GST_PHOENIX_SRC (src);
   etStat eStat = PHX_OK;        /* Phoenix status variable */
-  ui32 dwParamValue = 0;        /* Phoenix Get/Set intermediate variable */
-  stImageBuff phx_buffer;
-  guint dropped_frame_count = 0;
-  guint new_dropped_frames;
-  gint i;
-  guint n;
-  GstMapInfo minfo;
 
-  GST_LOG_OBJECT (src, "create");
+  GST_LOG_OBJECT (src, "starting acquisition");
 
-  gst_phoenixsrc_log_fpga_temperature (src);
+  /* make class instance pointer available to the callback, and flush cache */
+  PHX_ParameterSet (phoenixsrc->hCamera,
+      PHX_EVENT_CONTEXT | PHX_CACHE_FLUSH, (void *) phoenixsrc);
 
-  /* Start acquisition */
-  if (!phoenixsrc->acq_started) {
-    GST_LOG_OBJECT (src, "starting acquisition");
-
-    /* make class instance pointer available to the callback, and flush cache */
-    PHX_ParameterSet (phoenixsrc->hCamera,
-        PHX_EVENT_CONTEXT | PHX_CACHE_FLUSH, (void *) phoenixsrc);
-
-    /* Now start our capture */
-    eStat = PHX_Acquire (phoenixsrc->hCamera, PHX_START, (void *) phx_callback);
-    if (PHX_OK != eStat) {
-      GST_ELEMENT_ERROR (phoenixsrc, RESOURCE, FAILED,
-          (("Failed to start acquisition.")), (NULL));
-      return GST_FLOW_ERROR;    /* TODO: make sure _stop is called if this happens to release resources */
-    }
-    phoenixsrc->acq_started = TRUE;
-  }
-
-  /* about to read/write variables modified by phx_callback */
-  g_mutex_lock (&phoenixsrc->mutex);
-
-  /* wait for callback (we should always get at least a timeout( */
-  g_cond_wait (&phoenixsrc->cond, &phoenixsrc->mutex);
-
-  if (phoenixsrc->fifo_overflow_occurred) {
-    /* TODO: we could offer to try and ABORT then re-START capture */
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        (("Acquisition failure due to FIFO overflow.")), (NULL));
-    g_mutex_unlock (&phoenixsrc->mutex);
-    return GST_FLOW_ERROR;
-  }
-
-  if (phoenixsrc->timeout_occurred) {
-    /* TODO: we could offer to try and ABORT then re-START capture */
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        (("Acquisition failure due to timeout.")), (NULL));
-    g_mutex_unlock (&phoenixsrc->mutex);
-    return GST_FLOW_ERROR;
-  }
-
-  if (!phoenixsrc->buffer_ready) {
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        (("You should not see this error, something very bad happened.")),
-        (NULL));
-    g_mutex_unlock (&phoenixsrc->mutex);
-    return GST_FLOW_ERROR;
-  }
-
-  GST_LOG_OBJECT (phoenixsrc,
-      "Processing new buffer %d (Frame start: %d), ready-processed = %d",
-      phoenixsrc->buffer_ready_count, phoenixsrc->frame_start_count,
-      phoenixsrc->buffer_ready_count - phoenixsrc->buffer_processed_count);
-  phoenixsrc->buffer_ready = FALSE;
-
-  /* frame_start is always >= buffer_ready */
-  dropped_frame_count =
-      phoenixsrc->frame_start_count - phoenixsrc->buffer_ready_count;
-
-  g_mutex_unlock (&phoenixsrc->mutex);
-
-  eStat = PHX_Acquire (phoenixsrc->hCamera, PHX_BUFFER_GET, &phx_buffer);
+  /* Now start our capture */
+  eStat = PHX_Acquire (phoenixsrc->hCamera, PHX_START, (void *) phx_callback);
   if (PHX_OK != eStat) {
-    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-        (("Failed to get buffer.")), (NULL));
-    return GST_FLOW_ERROR;
+    GST_ELEMENT_ERROR (phoenixsrc, RESOURCE, FAILED,
+        (("Failed to start acquisition.")), (NULL));
+    return FALSE;
   }
+  phoenixsrc->acq_started = TRUE;
 
-  /* TODO: use allocator or use from Phoenix pool */
-  *buf = gst_buffer_new_and_alloc (phoenixsrc->height * phoenixsrc->gst_stride);
-
-  /* Copy image to buffer from surface TODO: use orc_memcpy */
-  gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
-  GST_LOG_OBJECT (phoenixsrc,
-      "GstBuffer size=%d, gst_stride=%d, phx_stride=%d", minfo.size,
-      phoenixsrc->gst_stride, phoenixsrc->phx_stride);
-  for (i = 0; i < phoenixsrc->height; i++) {
-    memcpy (minfo.data + i * phoenixsrc->gst_stride,
-        ((guint8 *) phx_buffer.pvAddress) + i * phoenixsrc->phx_stride,
-        phoenixsrc->gst_stride);
-  }
-  gst_buffer_unmap (*buf, &minfo);
+  return TRUE;
+}
 
-  /* Having processed the data, release the buffer ready for further image data */
-  eStat = PHX_Acquire (phoenixsrc->hCamera, PHX_BUFFER_RELEASE, NULL);
-  phoenixsrc->buffer_processed_count++;
-
-  /* check for dropped frames (can only detect more than one) */
-  new_dropped_frames = dropped_frame_count - phoenixsrc->dropped_frame_count;
-  if (new_dropped_frames > 0) {
-    phoenixsrc->dropped_frame_count = dropped_frame_count;
-    GST_WARNING ("Dropped %d frames (%d total)", new_dropped_frames,
-        phoenixsrc->dropped_frame_count);
-    /* TODO: emit message here about dropped frames */
-  }
-
-  /* use time from capture board */
-  n = (phoenixsrc->buffer_processed_count -
-      1) % phoenixsrc->num_capture_buffers;
-  GST_BUFFER_TIMESTAMP (*buf) = phoenixsrc->frame_start_times[n];
-  GST_BUFFER_DURATION (*buf) =
-      GST_CLOCK_DIFF (phoenixsrc->frame_start_times[n],
-      phoenixsrc->frame_end_times[n]);
-  GST_BUFFER_OFFSET (*buf) = phoenixsrc->buffer_processed_count - 1;
-  GST_BUFFER_OFFSET_END (*buf) = GST_BUFFER_OFFSET (*buf);
+static GstFlowReturn
+gst_phoenixsrc_prepare_buffer (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame, GstBuffer * buf)
+{
+  gst_phoenixsrc_log_fpga_temperature (GST_PHOENIX_SRC (src));
 
   return GST_FLOW_OK;
 }
@@ -20,12 +20,14 @@
 #ifndef _GST_PHOENIX_SRC_H_
 #define _GST_PHOENIX_SRC_H_
 
-#include <gst/base/gstpushsrc.h>
+#include "gstvisiongrabbersrc.h"
 
 // TODO: if/elif for linux/mac/etc
 #define _PHX_WIN32
 #include <phx_api.h>
 
+#include "common/visionclockmapper.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_PHOENIX_SRC   (gst_phoenixsrc_get_type())
@@ -49,11 +51,20 @@ typedef enum {
   
 } GstPhoenixSrcConnector;
 
+/* timing of a frame, recorded by phx_callback for the DMA buffer the frame
+ * is written to */
+typedef struct
+{
+  guint64 frame_number;         /* frame start sequence number */
+  guint64 event_count;          /* event counter at frame start, in us */
+  GstClockTime start_time;
+  GstClockTime end_time;
+} GstPhoenixSrcFrameTiming;
+
 struct _GstPhoenixSrc
 {
-  GstPushSrc base_phoenixsrc;
+  GstVisionGrabberSrc base_phoenixsrc;
 
-  gint dropped_frame_count;
   gboolean acq_started;
 
   /* camera handle */
@@ -65,28 +76,31 @@ struct _GstPhoenixSrc
   guint board;
   guint channel;
 
+  /* only touched by phx_callback */
   GstClockTime first_phoenix_ts;
-  guint64 *frame_start_times;
-  guint64 *frame_end_times;
-  gboolean buffer_ready;
-  guint buffer_ready_count;
-  guint frame_start_count;
-  guint frame_end_count;
-  guint buffer_processed_count;
-  gboolean timeout_occurred;
+  ui32 last_event_count;
+  guint64 event_count_high;
+  guint64 frame_start_count;
+  guint64 buffer_ready_count;
+  /* indexed by capture buffer, the board fills them in ring order */
+  GstPhoenixSrcFrameTiming *buffer_timing;
+  /* DMA buffer address of each capture buffer index, learned as
+   * PHX_BUFFER_GET returns them */
+  gpointer *buffer_addrs;
+  GstVisionClockMapper clock_mapper;
   gboolean fifo_overflow_occurred;
 
   gint height;
   gint gst_stride;
   guint phx_stride;
 
-  GMutex mutex;
-  GCond cond;
+  /* frames are copied into these from phx_callback */
+  GstBufferPool *pool;
 };
 
 struct _GstPhoenixSrcClass
 {
-  GstPushSrcClass base_phoenixsrc_class;
+  GstVisionGrabberSrcClass base_phoenixsrc_class;
 };
 
 GType gst_phoenixsrc_get_type (void);
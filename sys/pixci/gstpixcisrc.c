@@ -68,7 +68,9 @@ enum
   PROP_NUM_CAPTURE_BUFFERS,
   PROP_BOARD,
   PROP_CHANNEL,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_PROP_FORMAT_NAME GST_PIXCI_VIDEO_FORMAT_RS_170
@@ -269,6 +271,8 @@ gst_pixcisrc_class_init (GstPixciSrcClass * klass)
           "Timeout in milliseconds (0 for default)", 0, G_MAXUINT,
           DEFAULT_PROP_TIMEOUT,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static void
@@ -305,6 +309,8 @@ gst_pixcisrc_init (GstPixciSrc * src)
 
   g_mutex_init (&src->mutex);
   g_cond_init (&src->cond);
+
+  gst_vision_stats_init (&src->stats);
 }
 
 void
@@ -351,6 +357,9 @@ gst_pixcisrc_set_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       src->timeout = g_value_get_uint (value);
       break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -388,6 +397,12 @@ gst_pixcisrc_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_uint (value, src->timeout);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -422,6 +437,8 @@ gst_pixcisrc_finalize (GObject * object)
   g_free (src->frame_start_times);
   g_free (src->frame_end_times);
 
+  gst_vision_stats_clear (&src->stats);
+
   G_OBJECT_CLASS (gst_pixcisrc_parent_class)->finalize (object);
 }
 
@@ -560,7 +577,7 @@ gst_pixcisrc_stop (GstBaseSrc * bsrc)
 
   /* TODO: stop acq/release cam? */
 
-  src->dropped_frame_count = 0;
+  gst_vision_stats_reset (&src->stats);
   /*pixcisrc->last_time_code = -1; */
 
   return TRUE;
@@ -672,8 +689,7 @@ static GstFlowReturn
 gst_pixcisrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 {
   GstPixciSrc *src = GST_PIXCI_SRC (psrc);
-  guint dropped_frame_count = 0;
-  guint new_dropped_frames;
+  GstClock *clock;
   gint i;
   guint n;
   GstMapInfo minfo;
@@ -729,6 +745,8 @@ gst_pixcisrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   //g_mutex_unlock (&src->mutex);
   pxerr = pxd_doSnap (src->unitmap, buffer, src->timeout);
   if (pxerr) {
+    if (pxerr == PXERTIMEOUT)
+      gst_vision_stats_add_timeout (&src->stats);
     GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
         (("Failed to get buffer.")), (NULL));
     return GST_FLOW_ERROR;
@@ -755,15 +773,6 @@ gst_pixcisrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   /* Having processed the data, release the buffer ready for further image data */
   //src->buffer_processed_count++;
 
-  /* check for dropped frames (can only detect more than one) */
-  //new_dropped_frames = dropped_frame_count - src->dropped_frame_count;
-  //if (new_dropped_frames > 0) {
-  //  src->dropped_frame_count = dropped_frame_count;
-  //  GST_WARNING ("Dropped %d frames (%d total)", new_dropped_frames,
-  //      src->dropped_frame_count);
-  //  /* TODO: emit message here about dropped frames */
-  //}
-
   /* use time from capture board */
   //n = (src->buffer_processed_count -
   //    1) % src->num_capture_buffers;
@@ -774,6 +783,16 @@ gst_pixcisrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   //GST_BUFFER_OFFSET (*buf) = src->buffer_processed_count - 1;
   //GST_BUFFER_OFFSET_END (*buf) = GST_BUFFER_OFFSET (*buf);
 
+  /* each frame is snapped on demand, so nothing can be dropped and there is
+   * no capture time to measure latency from */
+  gst_vision_stats_add_delivered (&src->stats, GST_CLOCK_TIME_NONE);
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock) {
+    gst_vision_stats_post (&src->stats, GST_ELEMENT (src),
+        gst_clock_get_time (clock), NULL);
+    gst_object_unref (clock);
+  }
+
   return GST_FLOW_OK;
 }
 
@@ -25,6 +25,8 @@
 #include <windows.h>
 #include <xcliball.h>
 
+#include "common/visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_PIXCI_SRC   (gst_pixcisrc_get_type())
@@ -98,7 +100,6 @@ struct _GstPixciSrc
 {
   GstPushSrc base_pixcisrc;
 
-  gint dropped_frame_count;
   gboolean acq_started;
 
   /* camera handle */
@@ -130,6 +131,8 @@ struct _GstPixciSrc
   gint gst_stride;
   guint px_stride;
 
+  GstVisionStats stats;
+
   GMutex mutex;
   GCond cond;
 };
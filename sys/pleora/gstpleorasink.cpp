@@ -62,6 +62,8 @@ static gboolean gst_pleorasink_set_caps (GstBaseSink * basesink,
     GstCaps * caps);
 static GstFlowReturn gst_pleorasink_render (GstBaseSink * basesink,
     GstBuffer * buffer);
+static gboolean gst_pleorasink_propose_allocation (GstBaseSink * basesink,
+    GstQuery * query);
 static gboolean gst_pleorasink_unlock (GstBaseSink * basesink);
 static gboolean gst_pleorasink_unlock_stop (GstBaseSink * basesink);
 
@@ -83,7 +85,8 @@ enum
   PROP_AUTO_MULTICAST,
   PROP_MULTICAST_GROUP,
   PROP_MULTICAST_PORT,
-  PROP_PACKET_SIZE
+  PROP_PACKET_SIZE,
+  PROP_MAX_KLV_SIZE
 };
 
 #define DEFAULT_PROP_NUM_INTERNAL_BUFFERS 3
@@ -99,6 +102,7 @@ enum
 #define DEFAULT_PROP_MULTICAST_GROUP "239.192.1.1"
 #define DEFAULT_PROP_MULTICAST_PORT 1042
 #define DEFAULT_PROP_PACKET_SIZE  1492
+#define DEFAULT_PROP_MAX_KLV_SIZE 4096
 
 /* pad templates */
 
@@ -144,6 +148,8 @@ gst_pleorasink_class_init (GstPleoraSinkClass * klass)
   gstbasesink_class->stop = GST_DEBUG_FUNCPTR (gst_pleorasink_stop);
   gstbasesink_class->set_caps = GST_DEBUG_FUNCPTR (gst_pleorasink_set_caps);
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_pleorasink_render);
+  gstbasesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_pleorasink_propose_allocation);
   gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_pleorasink_unlock);
   gstbasesink_class->unlock_stop =
       GST_DEBUG_FUNCPTR (gst_pleorasink_unlock_stop);
@@ -204,6 +210,12 @@ gst_pleorasink_class_init (GstPleoraSinkClass * klass)
           DEFAULT_PROP_OUTPUT_KLV,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_MAX_KLV_SIZE,
+      g_param_spec_uint ("max-klv-size", "Maximum KLV size",
+          "Chunk space in bytes reserved for KLV in each frame, larger KLV "
+          "is dropped", 0, G_MAXUINT16, DEFAULT_PROP_MAX_KLV_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
 #endif
   g_object_class_install_property (gobject_class, PROP_AUTO_MULTICAST,
       g_param_spec_boolean ("auto-multicast", "Auto multicast",
@@ -246,6 +258,7 @@ gst_pleorasink_init (GstPleoraSink * sink)
   sink->multicast_group = g_strdup (DEFAULT_PROP_MULTICAST_GROUP);
   sink->multicast_port = DEFAULT_PROP_MULTICAST_PORT;
   sink->packet_size = DEFAULT_PROP_PACKET_SIZE;
+  sink->max_klv_size = DEFAULT_PROP_MAX_KLV_SIZE;
 
   sink->camera_connected = FALSE;
 
@@ -254,6 +267,7 @@ gst_pleorasink_init (GstPleoraSink * sink)
 
   sink->source = new GstStreamingChannelSource ();
   sink->source->SetSink (sink);
+  sink->source->SetKlvEnabled ((bool) sink->output_klv);
   sink->device = new PvSoftDeviceGEV ();
 
   g_mutex_init (&sink->mutex);
@@ -305,6 +319,9 @@ gst_pleorasink_set_property (GObject * object, guint property_id,
       sink->output_klv = g_value_get_boolean (value);
       sink->source->SetKlvEnabled ((bool) sink->output_klv);
       break;
+    case PROP_MAX_KLV_SIZE:
+      sink->max_klv_size = g_value_get_uint (value);
+      break;
     case PROP_AUTO_MULTICAST:
       sink->auto_multicast = g_value_get_boolean (value);
       break;
@@ -360,6 +377,9 @@ gst_pleorasink_get_property (GObject * object, guint property_id,
     case PROP_OUTPUT_KLV:
       g_value_set_boolean (value, sink->output_klv);
       break;
+    case PROP_MAX_KLV_SIZE:
+      g_value_set_uint (value, sink->max_klv_size);
+      break;
     case PROP_AUTO_MULTICAST:
       g_value_set_boolean (value, sink->auto_multicast);
       break;
@@ -702,12 +722,33 @@ gst_pleorasink_render (GstBaseSink * basesink, GstBuffer * buffer)
     return GST_FLOW_FLUSHING;
   }
 
-  /* TODO: should we ever error out? */
-  sink->source->SetBuffer (buffer);
+  if (!sink->source->SetBuffer (buffer)) {
+    GST_ELEMENT_ERROR (sink, STREAM, FAILED,
+        ("Failed to send frame"), ("Buffer doesn't match the caps"));
+    return GST_FLOW_ERROR;
+  }
 
   return GST_FLOW_OK;
 }
 
+/* Frames are sent from upstream memory when it has room for the chunk data
+ * after the image, so ask for that as padding */
+gboolean
+gst_pleorasink_propose_allocation (GstBaseSink * basesink, GstQuery * query)
+{
+  GstPleoraSink *sink = GST_PLEORASINK (basesink);
+  GstAllocationParams params;
+
+  gst_allocation_params_init (&params);
+  params.padding = sink->source->GetRequiredChunkSize ();
+  gst_query_add_allocation_param (query, NULL, &params);
+
+  /* any stride PvImage can describe as row padding is sent as is */
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  return TRUE;
+}
+
 gboolean
 gst_pleorasink_unlock (GstBaseSink * basesink)
 {
@@ -54,6 +54,7 @@ struct _GstPleoraSink
   gchar *serial;
   gchar *mac;
   gboolean output_klv;
+  guint max_klv_size;
   guint32 packet_size;
   gboolean auto_multicast;
   gchar *multicast_group;
@@ -68,10 +68,18 @@ static GstCaps *gst_pleorasrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_pleorasrc_set_caps (GstBaseSrc * src, GstCaps * caps);
 static gboolean gst_pleorasrc_unlock (GstBaseSrc * src);
 static gboolean gst_pleorasrc_unlock_stop (GstBaseSrc * src);
+static gboolean gst_pleorasrc_decide_allocation (GstBaseSrc * src,
+    GstQuery * query);
 
 static GstFlowReturn gst_pleorasrc_create (GstPushSrc * src, GstBuffer ** buf);
 
 static PvBuffer *gst_pleorasrc_get_pvbuffer (GstPleoraSrc * src);
+static gboolean gst_pleorasrc_update_caps (GstPleoraSrc * src,
+    PvBuffer * pvbuffer);
+static gboolean gst_pleorasrc_start_receive_thread (GstPleoraSrc * src);
+static void gst_pleorasrc_stop_receive_thread (GstPleoraSrc * src);
+static GstFlowReturn gst_pleorasrc_pop_frame (GstPleoraSrc * src,
+    GstPleoraSrcFrame * frame);
 
 enum
 {
@@ -87,7 +95,17 @@ enum
   PROP_PACKET_SIZE,
   PROP_CONFIG_FILE,
   PROP_CONFIG_FILE_CONNECT,
-  PROP_OUTPUT_KLV
+  PROP_OUTPUT_KLV,
+  PROP_HW_TIMESTAMP,
+  PROP_STATS_INTERVAL,
+  PROP_DROPPED_FRAMES,
+  PROP_RESENT_PACKETS,
+  PROP_MISSING_PACKETS,
+  PROP_QUEUE_SIZE,
+  PROP_OVERFLOW,
+  PROP_MAX_LATENCY,
+  PROP_QUEUE_DROPPED_FRAMES,
+  PROP_STATS
 };
 
 #define DEFAULT_PROP_DEVICE ""
@@ -102,6 +120,32 @@ enum
 #define DEFAULT_PROP_CONFIG_FILE ""
 #define DEFAULT_PROP_CONFIG_FILE_CONNECT TRUE
 #define DEFAULT_PROP_OUTPUT_KLV FALSE
+#define DEFAULT_PROP_HW_TIMESTAMP TRUE
+#define DEFAULT_PROP_QUEUE_SIZE 2
+#define DEFAULT_PROP_OVERFLOW GST_PLEORASRC_OVERFLOW_DROP_OLDEST
+#define DEFAULT_PROP_MAX_LATENCY 0
+
+#define GST_TYPE_PLEORASRC_OVERFLOW (gst_pleorasrc_overflow_get_type())
+static GType
+gst_pleorasrc_overflow_get_type (void)
+{
+  static GType pleorasrc_overflow_type = 0;
+  static const GEnumValue pleorasrc_overflow[] = {
+    {GST_PLEORASRC_OVERFLOW_DROP_OLDEST, "Drop oldest queued frame",
+        "drop-oldest"},
+    {GST_PLEORASRC_OVERFLOW_DROP_NEWEST, "Drop newly received frame",
+        "drop-newest"},
+    {GST_PLEORASRC_OVERFLOW_BLOCK, "Stop receiving until there is room",
+        "block"},
+    {0, NULL, NULL},
+  };
+
+  if (!pleorasrc_overflow_type) {
+    pleorasrc_overflow_type =
+        g_enum_register_static ("GstPleoraSrcOverflow", pleorasrc_overflow);
+  }
+  return pleorasrc_overflow_type;
+}
 
 #define VIDEO_CAPS_MAKE_BAYER8(format)                     \
     "video/x-bayer, "                                        \
@@ -164,6 +208,8 @@ gst_pleorasrc_class_init (GstPleoraSrcClass * klass)
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_pleorasrc_set_caps);
   gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_pleorasrc_unlock);
   gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_pleorasrc_unlock_stop);
+  gstbasesrc_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_pleorasrc_decide_allocation);
 
   gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_pleorasrc_create);
 
@@ -234,6 +280,51 @@ gst_pleorasrc_class_init (GstPleoraSrcClass * klass)
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
 #endif
+  g_object_class_install_property (gobject_class, PROP_HW_TIMESTAMP,
+      g_param_spec_boolean ("hardware-timestamp", "Hardware timestamp",
+          "Timestamp buffers using the device timestamp, mapped onto the "
+          "pipeline clock", DEFAULT_PROP_HW_TIMESTAMP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
+  g_object_class_install_property (gobject_class, PROP_DROPPED_FRAMES,
+      g_param_spec_uint64 ("dropped-frames", "Dropped frames",
+          "Number of frames lost before reaching the host; deprecated, use "
+          "frames-dropped of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_RESENT_PACKETS,
+      g_param_spec_uint64 ("resent-packets", "Resent packets",
+          "Number of packets recovered through resend requests", 0,
+          G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_MISSING_PACKETS,
+      g_param_spec_uint64 ("missing-packets", "Missing packets",
+          "Number of packets that were never received", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_SIZE,
+      g_param_spec_uint ("queue-size", "Queue size",
+          "Number of received frames to queue for the streaming thread, "
+          "should be less than num-capture-buffers", 1, G_MAXUINT,
+          DEFAULT_PROP_QUEUE_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_OVERFLOW,
+      g_param_spec_enum ("overflow", "Overflow policy",
+          "What to do when a frame is received and the queue is full",
+          GST_TYPE_PLEORASRC_OVERFLOW, DEFAULT_PROP_OVERFLOW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_MAX_LATENCY,
+      g_param_spec_uint64 ("max-latency", "Maximum latency (ns)",
+          "Drop queued frames older than this (0 for no limit)", 0,
+          G_MAXUINT64, DEFAULT_PROP_MAX_LATENCY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DROPPED_FRAMES,
+      g_param_spec_uint64 ("queue-dropped-frames", "Queue dropped frames",
+          "Number of received frames dropped by the overflow policy or "
+          "max-latency", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void
@@ -243,8 +334,13 @@ gst_pleorasrc_reset (GstPleoraSrc * src)
   src->stream = NULL;
   src->pipeline = NULL;
 
-  src->last_frame_count = 0;
-  src->total_dropped_frames = 0;
+  src->last_block_id = G_MAXUINT64;
+  src->block_offset = 0;
+  src->total_resent_packets = 0;
+  src->total_missing_packets = 0;
+  gst_vision_stats_reset (&src->stats);
+
+  gst_vision_clock_mapper_init (&src->clock_mapper, 1e9, 64, 0);
 
   if (src->caps) {
     gst_caps_unref (src->caps);
@@ -254,6 +350,8 @@ gst_pleorasrc_reset (GstPleoraSrc * src)
   src->pv_pixel_type = PvPixelUndefined;
   src->width = 0;
   src->height = 0;
+  src->gst_format = GST_VIDEO_FORMAT_UNKNOWN;
+  src->video_meta_supported = FALSE;
 }
 
 static void
@@ -277,11 +375,27 @@ gst_pleorasrc_init (GstPleoraSrc * src)
   src->config_file = g_strdup (DEFAULT_PROP_CONFIG_FILE);
   src->config_file_connect = DEFAULT_PROP_CONFIG_FILE_CONNECT;
   src->output_klv = DEFAULT_PROP_OUTPUT_KLV;
+  src->hw_timestamp = DEFAULT_PROP_HW_TIMESTAMP;
+  src->queue_size = DEFAULT_PROP_QUEUE_SIZE;
+  src->overflow = DEFAULT_PROP_OVERFLOW;
+  src->max_latency = DEFAULT_PROP_MAX_LATENCY;
 
   src->stop_requested = FALSE;
   src->caps = NULL;
 
-  src->pvbuffer = NULL;
+  src->first_frame.pvbuffer = NULL;
+
+  src->receive_thread = NULL;
+  g_mutex_init (&src->ring_mutex);
+  g_cond_init (&src->ring_cond);
+  src->ring = NULL;
+  src->ring_size = 0;
+  src->ring_head = 0;
+  src->ring_count = 0;
+  src->receive_stop = FALSE;
+  src->receive_flow = GST_FLOW_OK;
+
+  gst_vision_stats_init (&src->stats);
 
   gst_pleorasrc_reset (src);
 }
@@ -334,6 +448,24 @@ gst_pleorasrc_set_property (GObject * object, guint property_id,
     case PROP_OUTPUT_KLV:
       src->output_klv = g_value_get_boolean (value);
       break;
+    case PROP_HW_TIMESTAMP:
+      src->hw_timestamp = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
+    case PROP_QUEUE_SIZE:
+      src->queue_size = g_value_get_uint (value);
+      break;
+    case PROP_OVERFLOW:
+      g_mutex_lock (&src->ring_mutex);
+      src->overflow = (GstPleoraSrcOverflowEnum) g_value_get_enum (value);
+      g_cond_broadcast (&src->ring_cond);
+      g_mutex_unlock (&src->ring_mutex);
+      break;
+    case PROP_MAX_LATENCY:
+      src->max_latency = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -386,6 +518,44 @@ gst_pleorasrc_get_property (GObject * object, guint property_id,
     case PROP_OUTPUT_KLV:
       g_value_set_boolean (value, src->output_klv);
       break;
+    case PROP_HW_TIMESTAMP:
+      g_value_set_boolean (value, src->hw_timestamp);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_QUEUE_SIZE:
+      g_value_set_uint (value, src->queue_size);
+      break;
+    case PROP_OVERFLOW:
+      g_value_set_enum (value, src->overflow);
+      break;
+    case PROP_MAX_LATENCY:
+      g_value_set_uint64 (value, src->max_latency);
+      break;
+    case PROP_QUEUE_DROPPED_FRAMES:
+      g_mutex_lock (&src->stats.lock);
+      g_value_set_uint64 (value, src->stats.frames_overwritten);
+      g_mutex_unlock (&src->stats.lock);
+      break;
+    case PROP_DROPPED_FRAMES:
+      g_mutex_lock (&src->stats.lock);
+      g_value_set_uint64 (value, src->stats.frames_dropped);
+      g_mutex_unlock (&src->stats.lock);
+      break;
+    case PROP_RESENT_PACKETS:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint64 (value, src->total_resent_packets);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case PROP_MISSING_PACKETS:
+      GST_OBJECT_LOCK (src);
+      g_value_set_uint64 (value, src->total_missing_packets);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -424,6 +594,10 @@ gst_pleorasrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
+  g_mutex_clear (&src->ring_mutex);
+  g_cond_clear (&src->ring_cond);
+  gst_vision_stats_clear (&src->stats);
+
   G_OBJECT_CLASS (gst_pleorasrc_parent_class)->finalize (object);
 }
 
@@ -1254,6 +1428,7 @@ gst_pleorasrc_start (GstBaseSrc * bsrc)
 {
   GstPleoraSrc *src = GST_PLEORA_SRC (bsrc);
   PvResult pvRes;
+  gdouble tick_frequency;
 
   GST_DEBUG_OBJECT (src, "start");
 
@@ -1262,6 +1437,24 @@ gst_pleorasrc_start (GstBaseSrc * bsrc)
     goto error;
   }
 
+  /* U3V timestamps are in ns, GEV devices report their tick frequency */
+  tick_frequency = 1e9;
+  if (dynamic_cast < PvDeviceGEV * >(src->device) != NULL) {
+    int64_t freq = 0;
+    pvRes =
+        src->device->GetParameters ()->GetIntegerValue
+        ("GevTimestampTickFrequency", freq);
+    if (pvRes.IsOK () && freq > 0) {
+      tick_frequency = (gdouble) freq;
+    } else {
+      GST_DEBUG_OBJECT (src, "Couldn't get timestamp tick frequency, "
+          "assuming 1 GHz until drift correction converges");
+    }
+  }
+  GST_DEBUG_OBJECT (src, "Device timestamp tick frequency is %.0f Hz",
+      tick_frequency);
+  gst_vision_clock_mapper_init (&src->clock_mapper, tick_frequency, 64, 0);
+
   /* Note: the pipeline must be initialized before we start acquisition */
   GST_DEBUG_OBJECT (src, "Starting pipeline");
   pvRes = src->pipeline->Start ();
@@ -1305,15 +1498,29 @@ gst_pleorasrc_start (GstBaseSrc * bsrc)
     }
   }
 
+  if (!gst_pleorasrc_start_receive_thread (src)) {
+    goto error;
+  }
+
   /* grab first buffer so we can set caps before _create */
-  src->pvbuffer = gst_pleorasrc_get_pvbuffer (src);
-  if (!src->pvbuffer) {
+  if (gst_pleorasrc_pop_frame (src, &src->first_frame) != GST_FLOW_OK) {
+    /* error already sent */
+    goto error;
+  }
+
+  if (!gst_pleorasrc_update_caps (src, src->first_frame.pvbuffer)) {
     goto error;
   }
 
   return TRUE;
 
 error:
+  gst_pleorasrc_stop_receive_thread (src);
+
+  if (src->pipeline && src->pipeline->IsStarted ()) {
+    src->pipeline->Stop ();
+  }
+
   if (src->pipeline) {
     delete src->pipeline;
     src->pipeline = NULL;
@@ -1351,6 +1558,8 @@ gst_pleorasrc_stop (GstBaseSrc * bsrc)
 
     src->device->StreamDisable ();
   }
+
+  gst_pleorasrc_stop_receive_thread (src);
   src->pipeline->Stop ();
 
   if (src->pipeline) {
@@ -1414,6 +1623,7 @@ gst_pleorasrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
 
   if (GST_VIDEO_INFO_FORMAT (&vinfo) != GST_VIDEO_FORMAT_UNKNOWN) {
     src->height = GST_VIDEO_INFO_HEIGHT (&vinfo);
+    src->gst_format = GST_VIDEO_INFO_FORMAT (&vinfo);
 
     if (GST_VIDEO_INFO_FORMAT (&vinfo) != GST_VIDEO_FORMAT_ENCODED) {
       src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE (&vinfo, 0);
@@ -1444,6 +1654,22 @@ unsupported_caps:
   return FALSE;
 }
 
+static gboolean
+gst_pleorasrc_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstPleoraSrc *src = GST_PLEORA_SRC (bsrc);
+
+  /* if downstream understands GstVideoMeta we can push PvBuffers with the
+   * device stride instead of copying to the default stride */
+  src->video_meta_supported =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  GST_DEBUG_OBJECT (src, "Downstream %s GstVideoMeta",
+      src->video_meta_supported ? "supports" : "doesn't support");
+
+  return GST_BASE_SRC_CLASS (gst_pleorasrc_parent_class)->decide_allocation
+      (bsrc, query);
+}
+
 static gboolean
 gst_pleorasrc_unlock (GstBaseSrc * bsrc)
 {
@@ -1451,7 +1677,10 @@ gst_pleorasrc_unlock (GstBaseSrc * bsrc)
 
   GST_LOG_OBJECT (src, "unlock");
 
+  g_mutex_lock (&src->ring_mutex);
   src->stop_requested = TRUE;
+  g_cond_broadcast (&src->ring_cond);
+  g_mutex_unlock (&src->ring_mutex);
 
   return TRUE;
 }
@@ -1463,7 +1692,9 @@ gst_pleorasrc_unlock_stop (GstBaseSrc * bsrc)
 
   GST_LOG_OBJECT (src, "unlock_stop");
 
+  g_mutex_lock (&src->ring_mutex);
   src->stop_requested = FALSE;
+  g_mutex_unlock (&src->ring_mutex);
 
   return TRUE;
 }
@@ -1519,6 +1750,7 @@ pvbuffer_release (void *data)
     // TODO: should use a mutex in case _stop is being called at the same time
     frame->src->pipeline->ReleaseBuffer (frame->buffer);
   }
+  g_free (frame);
 }
 
 static PvBuffer *
@@ -1526,11 +1758,17 @@ gst_pleorasrc_get_pvbuffer (GstPleoraSrc * src)
 {
   PvResult pvRes, opRes;
   PvBuffer *pvbuffer;
-  PvImage *pvimage;
 
   while (TRUE) {
     pvRes = src->pipeline->RetrieveNextBuffer (&pvbuffer, src->timeout, &opRes);
     if (!pvRes.IsOK ()) {
+      if (src->receive_stop) {
+        /* timed out while being stopped, not an error */
+        return NULL;
+      }
+      if (pvRes.GetCode () == PvResult::Code::TIMEOUT) {
+        gst_vision_stats_add_timeout (&src->stats);
+      }
       GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
           ("Failed to retrieve buffer in timeout (%d ms): 0x%04x, '%s'",
               src->timeout, pvRes.GetCode (),
@@ -1556,7 +1794,215 @@ gst_pleorasrc_get_pvbuffer (GstPleoraSrc * src)
     break;
   }
 
-  pvimage = pvbuffer->GetImage ();
+  return pvbuffer;
+}
+
+/* Runs on the receive thread, drains the PvPipeline into the ring so a
+ * downstream stall doesn't hold up the eBUS pipeline */
+static gpointer
+gst_pleorasrc_receive_thread_func (gpointer data)
+{
+  GstPleoraSrc *src = GST_PLEORA_SRC (data);
+
+  while (TRUE) {
+    GstPleoraSrcFrame frame;
+    PvBuffer *dropped = NULL;
+    GstClock *clock;
+
+    if (src->receive_stop) {
+      break;
+    }
+
+    frame.pvbuffer = gst_pleorasrc_get_pvbuffer (src);
+    frame.clock_time = GST_CLOCK_TIME_NONE;
+
+    /* sample the clock as close to reception as possible */
+    clock = gst_element_get_clock (GST_ELEMENT (src));
+    if (clock) {
+      frame.clock_time = gst_clock_get_time (clock);
+      gst_object_unref (clock);
+    }
+
+    g_mutex_lock (&src->ring_mutex);
+    if (frame.pvbuffer == NULL) {
+      /* error already posted */
+      if (!src->receive_stop) {
+        src->receive_flow = GST_FLOW_ERROR;
+      }
+      g_cond_broadcast (&src->ring_cond);
+      g_mutex_unlock (&src->ring_mutex);
+      break;
+    }
+
+    while (src->ring_count == src->ring_size &&
+        src->overflow == GST_PLEORASRC_OVERFLOW_BLOCK && !src->receive_stop) {
+      g_cond_wait (&src->ring_cond, &src->ring_mutex);
+    }
+
+    if (src->receive_stop) {
+      g_mutex_unlock (&src->ring_mutex);
+      src->pipeline->ReleaseBuffer (frame.pvbuffer);
+      break;
+    }
+
+    if (src->ring_count == src->ring_size) {
+      if (src->overflow == GST_PLEORASRC_OVERFLOW_DROP_NEWEST) {
+        dropped = frame.pvbuffer;
+        frame.pvbuffer = NULL;
+      } else {
+        dropped = src->ring[src->ring_head].pvbuffer;
+        src->ring_head = (src->ring_head + 1) % src->ring_size;
+        src->ring_count--;
+      }
+      gst_vision_stats_add_overwritten (&src->stats, 1);
+    }
+
+    if (frame.pvbuffer) {
+      src->ring[(src->ring_head + src->ring_count) % src->ring_size] = frame;
+      src->ring_count++;
+      g_cond_broadcast (&src->ring_cond);
+    }
+    g_mutex_unlock (&src->ring_mutex);
+
+    if (dropped) {
+      GST_DEBUG_OBJECT (src, "Queue full, dropped frame with block ID %"
+          G_GUINT64_FORMAT, (guint64) dropped->GetBlockID ());
+      src->pipeline->ReleaseBuffer (dropped);
+    }
+  }
+
+  GST_DEBUG_OBJECT (src, "Receive thread exiting");
+
+  return NULL;
+}
+
+static gboolean
+gst_pleorasrc_start_receive_thread (GstPleoraSrc * src)
+{
+  GError *error = NULL;
+
+  if (src->queue_size >= src->num_capture_buffers) {
+    GST_WARNING_OBJECT (src, "queue-size (%d) should be less than "
+        "num-capture-buffers (%d), or the eBUS pipeline may run out of "
+        "buffers", src->queue_size, src->num_capture_buffers);
+  }
+
+  /* queue-size may change while playing, the ring keeps its size */
+  src->ring_size = src->queue_size;
+  src->ring = g_new0 (GstPleoraSrcFrame, src->ring_size);
+  src->ring_head = 0;
+  src->ring_count = 0;
+  src->receive_stop = FALSE;
+  src->receive_flow = GST_FLOW_OK;
+
+  src->receive_thread =
+      g_thread_try_new ("pleorasrc-receive", gst_pleorasrc_receive_thread_func,
+      src, &error);
+  if (src->receive_thread == NULL) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Failed to start receive thread: %s", error->message), (NULL));
+    g_error_free (error);
+    g_free (src->ring);
+    src->ring = NULL;
+    src->ring_size = 0;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_pleorasrc_stop_receive_thread (GstPleoraSrc * src)
+{
+  if (src->receive_thread) {
+    g_mutex_lock (&src->ring_mutex);
+    src->receive_stop = TRUE;
+    g_cond_broadcast (&src->ring_cond);
+    g_mutex_unlock (&src->ring_mutex);
+
+    /* thread wakes up at the latest after the retrieve timeout */
+    g_thread_join (src->receive_thread);
+    src->receive_thread = NULL;
+  }
+
+  /* hand queued buffers back to the eBUS pipeline */
+  if (src->ring) {
+    while (src->ring_count > 0) {
+      src->pipeline->ReleaseBuffer (src->ring[src->ring_head].pvbuffer);
+      src->ring_head = (src->ring_head + 1) % src->ring_size;
+      src->ring_count--;
+    }
+    g_free (src->ring);
+    src->ring = NULL;
+    src->ring_size = 0;
+  }
+
+  if (src->first_frame.pvbuffer) {
+    src->pipeline->ReleaseBuffer (src->first_frame.pvbuffer);
+    src->first_frame.pvbuffer = NULL;
+  }
+}
+
+/* Runs on the streaming thread, waits for the next queued frame and drops
+ * any that have been queued longer than max-latency */
+static GstFlowReturn
+gst_pleorasrc_pop_frame (GstPleoraSrc * src, GstPleoraSrcFrame * frame)
+{
+  while (TRUE) {
+    GstClockTime max_latency;
+    GstClock *clock;
+
+    g_mutex_lock (&src->ring_mutex);
+    while (src->ring_count == 0 && !src->stop_requested &&
+        src->receive_flow == GST_FLOW_OK) {
+      g_cond_wait (&src->ring_cond, &src->ring_mutex);
+    }
+
+    if (src->stop_requested) {
+      g_mutex_unlock (&src->ring_mutex);
+      return GST_FLOW_FLUSHING;
+    }
+
+    if (src->ring_count == 0) {
+      GstFlowReturn ret = src->receive_flow;
+      g_mutex_unlock (&src->ring_mutex);
+      return ret;
+    }
+
+    *frame = src->ring[src->ring_head];
+    src->ring_head = (src->ring_head + 1) % src->ring_size;
+    src->ring_count--;
+    gst_vision_stats_set_queue_depth (&src->stats, src->ring_count);
+    g_cond_broadcast (&src->ring_cond);
+    g_mutex_unlock (&src->ring_mutex);
+
+    max_latency = src->max_latency;
+    if (max_latency == 0 || !GST_CLOCK_TIME_IS_VALID (frame->clock_time)) {
+      return GST_FLOW_OK;
+    }
+
+    clock = gst_element_get_clock (GST_ELEMENT (src));
+    if (clock == NULL) {
+      return GST_FLOW_OK;
+    }
+    GstClockTime now = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+
+    if (now < frame->clock_time + max_latency) {
+      return GST_FLOW_OK;
+    }
+
+    GST_DEBUG_OBJECT (src, "Dropping frame queued for %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (now - frame->clock_time));
+    gst_vision_stats_add_overwritten (&src->stats, 1);
+    src->pipeline->ReleaseBuffer (frame->pvbuffer);
+  }
+}
+
+static gboolean
+gst_pleorasrc_update_caps (GstPleoraSrc * src, PvBuffer * pvbuffer)
+{
+  PvImage *pvimage = pvbuffer->GetImage ();
 
   if (src->pv_pixel_type != pvimage->GetPixelType () ||
       src->width != pvimage->GetWidth () ||
@@ -1587,16 +2033,100 @@ gst_pleorasrc_get_pvbuffer (GstPleoraSrc * src)
       src->height = pvimage->GetHeight ();
 
       guint32 pixel_bpp = PvGetPixelBitCount (pvimage->GetPixelType ());
-      src->pleora_stride = (pvimage->GetWidth () * pixel_bpp) / 8;
+      src->pleora_stride = (pvimage->GetWidth () * pixel_bpp) / 8 +
+          pvimage->GetPaddingX ();
     } else {
       GST_ELEMENT_ERROR (src, RESOURCE, FAILED, ("Pixel type %d not supported",
               pvimage->GetPixelType ()), (NULL));
-      src->pipeline->ReleaseBuffer (pvbuffer);
-      return NULL;
+      return FALSE;
     }
   }
 
-  return pvbuffer;
+  return TRUE;
+}
+
+/* Set buffer offset from the block ID and count frames lost in gaps */
+static void
+gst_pleorasrc_check_block_id (GstPleoraSrc * src, guint64 block_id,
+    GstBuffer * buf)
+{
+  guint64 delta;
+
+  if (src->last_block_id == G_MAXUINT64) {
+    src->block_offset = block_id;
+  } else {
+    if (block_id > src->last_block_id) {
+      delta = block_id - src->last_block_id;
+    } else if (src->last_block_id > G_MAXUINT16 / 2
+        && src->last_block_id <= G_MAXUINT16 && block_id < G_MAXUINT16 / 2) {
+      /* GEV 1.x block IDs are 16 bit and skip 0 when wrapping */
+      delta = block_id + G_MAXUINT16 - src->last_block_id;
+    } else {
+      GST_WARNING_OBJECT (src, "Block ID non-monotonic (%" G_GUINT64_FORMAT
+          " after %" G_GUINT64_FORMAT "), signal disrupted?", block_id,
+          src->last_block_id);
+      delta = 1;
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    }
+
+    if (delta > 1) {
+      gst_vision_stats_add_dropped (&src->stats, delta - 1);
+      GST_WARNING_OBJECT (src, "Dropped %" G_GUINT64_FORMAT " frame(s)",
+          delta - 1);
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    }
+    src->block_offset += delta;
+  }
+  src->last_block_id = block_id;
+
+  GST_BUFFER_OFFSET (buf) = src->block_offset;
+  GST_BUFFER_OFFSET_END (buf) = src->block_offset + 1;
+}
+
+/* Accumulate packet counters and periodically post them to the bus along
+ * with the common acquisition statistics */
+static void
+gst_pleorasrc_update_stats (GstPleoraSrc * src, PvBuffer * pvbuffer,
+    GstClockTime capture_time, GstClockTime clock_time)
+{
+  GstClockTime latency = GST_CLOCK_TIME_NONE;
+  GstClock *clock;
+  guint64 resent_packets, missing_packets, dropped_frames;
+
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock != NULL) {
+    latency = gst_vision_stats_latency (capture_time,
+        gst_clock_get_time (clock));
+    gst_object_unref (clock);
+  }
+  gst_vision_stats_add_delivered (&src->stats, latency);
+
+  GST_OBJECT_LOCK (src);
+  src->total_resent_packets += pvbuffer->GetPacketsRecoveredCount ();
+  src->total_missing_packets += pvbuffer->GetLostPacketCount ();
+  resent_packets = src->total_resent_packets;
+  missing_packets = src->total_missing_packets;
+  GST_OBJECT_UNLOCK (src);
+
+  if (!gst_vision_stats_post (&src->stats, GST_ELEMENT (src), clock_time,
+          "timestamp", G_TYPE_UINT64, clock_time,
+          "block-id", G_TYPE_UINT64, src->last_block_id,
+          "resent-packets", G_TYPE_UINT64, resent_packets,
+          "missing-packets", G_TYPE_UINT64, missing_packets, NULL))
+    return;
+
+  /* existing applications watch for this one */
+  g_mutex_lock (&src->stats.lock);
+  dropped_frames = src->stats.frames_dropped;
+  g_mutex_unlock (&src->stats.lock);
+  gst_element_post_message (GST_ELEMENT (src),
+      gst_message_new_element (GST_OBJECT (src),
+          gst_structure_new ("pleorasrc-stats",
+              "timestamp", G_TYPE_UINT64, clock_time,
+              "block-id", G_TYPE_UINT64, src->last_block_id,
+              "dropped-frames", G_TYPE_UINT64, dropped_frames,
+              "resent-packets", G_TYPE_UINT64, resent_packets,
+              "missing-packets", G_TYPE_UINT64, missing_packets, NULL)));
 }
 
 static GstFlowReturn
@@ -1606,28 +2136,39 @@ gst_pleorasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   PvResult pvRes;
   GstClock *clock;
   GstClockTime clock_time;
+  GstPleoraSrcFrame frame;
   PvBuffer *pvbuffer;
   PvImage *pvimage;
 
   GST_LOG_OBJECT (src, "create");
 
-  if (src->pvbuffer) {
+  if (src->first_frame.pvbuffer) {
     /* we have a buffer from _start to handle */
-    pvbuffer = src->pvbuffer;
-    src->pvbuffer = NULL;
+    frame = src->first_frame;
+    src->first_frame.pvbuffer = NULL;
   } else {
-    pvbuffer = gst_pleorasrc_get_pvbuffer (src);
-  }
+    GstFlowReturn ret = gst_pleorasrc_pop_frame (src, &frame);
+    if (ret != GST_FLOW_OK) {
+      /* error already posted */
+      return ret;
+    }
 
-  if (!pvbuffer) {
-    /* error already posted */
-    return GST_FLOW_ERROR;
+    if (!gst_pleorasrc_update_caps (src, frame.pvbuffer)) {
+      src->pipeline->ReleaseBuffer (frame.pvbuffer);
+      return GST_FLOW_ERROR;
+    }
   }
+  pvbuffer = frame.pvbuffer;
 
-  /* wrap or copy image data to buffer */
+  /* wrap or copy image data to buffer, bayer has no GstVideoFormat so it
+   * can't be described by GstVideoMeta */
   pvimage = pvbuffer->GetImage ();
   gpointer data = pvimage->GetDataPointer ();
-  if (src->pleora_stride == src->gst_stride) {
+  gboolean use_video_meta = src->pleora_stride != src->gst_stride &&
+      src->video_meta_supported &&
+      src->gst_format != GST_VIDEO_FORMAT_ENCODED &&
+      src->gst_format != GST_VIDEO_FORMAT_UNKNOWN;
+  if (src->pleora_stride == src->gst_stride || use_video_meta) {
     VideoFrame *vf = g_new0 (VideoFrame, 1);
     vf->src = src;
     vf->buffer = pvbuffer;
@@ -1638,6 +2179,16 @@ gst_pleorasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
         gst_buffer_new_wrapped_full ((GstMemoryFlags) GST_MEMORY_FLAG_READONLY,
         (gpointer) data, data_size, 0, data_size, vf,
         (GDestroyNotify) pvbuffer_release);
+
+    if (use_video_meta) {
+      gsize offset[GST_VIDEO_MAX_PLANES] = { 0 };
+      gint stride[GST_VIDEO_MAX_PLANES] = { src->pleora_stride };
+
+      GST_LOG_OBJECT (src, "Row stride not aligned, adding video meta with "
+          "stride %d", src->pleora_stride);
+      gst_buffer_add_video_meta_full (*buf, GST_VIDEO_FRAME_FLAG_NONE,
+          src->gst_format, src->width, src->height, 1, offset, stride);
+    }
   } else {
     GstMapInfo minfo;
 
@@ -1649,21 +2200,43 @@ gst_pleorasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 
     guint8 *s = (guint8 *) data;
     guint8 *d;
+    /* device rows may carry padding beyond the image width */
+    gint row_size = MIN (src->pleora_stride, src->gst_stride);
 
     gst_buffer_map (*buf, &minfo, GST_MAP_WRITE);
     d = minfo.data;
 
-    g_assert (minfo.size >= src->pleora_stride * src->height);
+    g_assert (minfo.size >= row_size * src->height);
     for (int i = 0; i < src->height; i++)
-      memcpy (d + i * src->gst_stride, s + i * src->pleora_stride,
-          src->pleora_stride);
+      memcpy (d + i * src->gst_stride, s + i * src->pleora_stride, row_size);
     gst_buffer_unmap (*buf, &minfo);
   }
 
-  /* TODO: use PvBuffer timestamps */
-  clock = gst_element_get_clock (GST_ELEMENT (src));
-  clock_time = gst_clock_get_time (clock);
-  gst_object_unref (clock);
+  /* frames received before we had a clock have no retrieval time */
+  clock_time = frame.clock_time;
+  if (!GST_CLOCK_TIME_IS_VALID (clock_time)) {
+    clock = gst_element_get_clock (GST_ELEMENT (src));
+    if (clock) {
+      clock_time = gst_clock_get_time (clock);
+      gst_object_unref (clock);
+    }
+  }
+
+  /* map device ticks through a fit over recent frames, so the retrieval
+   * jitter of a single frame doesn't end up in its timestamp */
+  if (src->hw_timestamp && pvbuffer->GetTimestamp () != 0 &&
+      GST_CLOCK_TIME_IS_VALID (clock_time)) {
+    guint64 num_resets = src->clock_mapper.num_resets;
+    clock_time =
+        gst_vision_clock_mapper_add_sample (&src->clock_mapper,
+        pvbuffer->GetTimestamp (), clock_time);
+    if (src->clock_mapper.num_resets != num_resets) {
+      GST_DEBUG_OBJECT (src, "Device timestamps jumped, resetting mapping");
+    }
+  }
+
+  gst_pleorasrc_check_block_id (src, pvbuffer->GetBlockID (), *buf);
+  gst_pleorasrc_update_stats (src, pvbuffer, frame.clock_time, clock_time);
 
 #ifdef GST_PLUGINS_VISION_ENABLE_KLV
   if (src->output_klv && pvbuffer->HasChunks ()) {
@@ -1719,41 +2292,14 @@ gst_pleorasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   }
 #endif // GST_PLUGINS_VISION_ENABLE_KLV
 
-  if (src->pleora_stride != src->gst_stride) {
+  if (src->pleora_stride != src->gst_stride && !use_video_meta) {
     src->pipeline->ReleaseBuffer (pvbuffer);
     pvbuffer = NULL;
   }
 
-  /* check for dropped frames and disrupted signal */
-  //dropped_frames = (circ_handle.FrameCount - src->last_frame_count) - 1;
-  //if (dropped_frames > 0) {
-  //  src->total_dropped_frames += dropped_frames;
-  //  GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-  //      src->total_dropped_frames);
-  //} else if (dropped_frames < 0) {
-  //  GST_WARNING_OBJECT (src, "Frame count non-monotonic, signal disrupted?");
-  //}
-  //src->last_frame_count = circ_handle.FrameCount;
-
-  /* create GstBuffer then release circ buffer back to acquisition */
-  //*buf = gst_pleorasrc_create_buffer_from_circ_handle (src, &circ_handle);
-  //ret =
-  //    BiCirStatusSet (src->board, &src->buffer_array, circ_handle, BIAVAILABLE);
-  //if (ret != BI_OK) {
-  //  GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
-  //      ("Failed to release buffer: %s", gst_pleorasrc_get_error_string (src,
-  //              ret)), (NULL));
-  //  return GST_FLOW_ERROR;
-  //}
-
-  /* TODO: understand why timestamps for circ_handle are sometimes 0 */
-  //GST_BUFFER_TIMESTAMP (*buf) =
-  //    GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-  //    src->acq_start_time + circ_handle.HiResTimeStamp.totalSec * GST_SECOND);
+  /* without a clock the buffer has no timestamp */
   GST_BUFFER_TIMESTAMP (*buf) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      clock_time);
-  //GST_BUFFER_OFFSET (*buf) = circ_handle.FrameCount - 1;
+      gst_vision_clock_mapper_running_time (GST_ELEMENT (src), clock_time);
 
   if (src->stop_requested) {
     if (*buf != NULL) {
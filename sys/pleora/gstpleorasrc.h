@@ -21,11 +21,15 @@
 #define _GST_PLEORA_SRC_H_
 
 #include <gst/base/gstpushsrc.h>
+#include <gst/video/video.h>
 
 #include <PvDevice.h>
 #include <PvPipeline.h>
 #include <PvStream.h>
 
+#include "visionclockmapper.h"
+#include "visionstats.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_PLEORA_SRC   (gst_pleorasrc_get_type())
@@ -37,6 +41,19 @@ G_BEGIN_DECLS
 typedef struct _GstPleoraSrc GstPleoraSrc;
 typedef struct _GstPleoraSrcClass GstPleoraSrcClass;
 
+typedef enum {
+    GST_PLEORASRC_OVERFLOW_DROP_OLDEST,
+    GST_PLEORASRC_OVERFLOW_DROP_NEWEST,
+    GST_PLEORASRC_OVERFLOW_BLOCK
+} GstPleoraSrcOverflowEnum;
+
+/* a retrieved PvBuffer and the clock time it was retrieved at */
+typedef struct
+{
+  PvBuffer *pvbuffer;
+  GstClockTime clock_time;
+} GstPleoraSrcFrame;
+
 struct _GstPleoraSrc
 {
   GstPushSrc base_pleorasrc;
@@ -45,7 +62,7 @@ struct _GstPleoraSrc
   PvPipeline *pipeline;
   PvDevice *device;
   PvStream *stream;
-  PvBuffer *pvbuffer;
+  GstPleoraSrcFrame first_frame;
   PvDeviceType device_type;
 
   /* properties */
@@ -61,9 +78,23 @@ struct _GstPleoraSrc
   gchar *config_file;
   gboolean config_file_connect;
   gboolean output_klv;
+  gboolean hw_timestamp;
+  guint queue_size;
+  GstPleoraSrcOverflowEnum overflow;
+  guint64 max_latency;
+
+  /* block ID tracking, offset continues counting across 16-bit wraps */
+  guint64 last_block_id;
+  guint64 block_offset;
+
+  /* acquisition statistics, packet counters are protected by the object
+   * lock */
+  GstVisionStats stats;
+  guint64 total_resent_packets;
+  guint64 total_missing_packets;
 
-  guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  /* device tick to pipeline clock mapping */
+  GstVisionClockMapper clock_mapper;
 
   GstCaps *caps;
   PvPixelType pv_pixel_type;
@@ -71,6 +102,19 @@ struct _GstPleoraSrc
   gint height;
   gint gst_stride;
   gint pleora_stride;
+  GstVideoFormat gst_format;
+  gboolean video_meta_supported;
+
+  /* receive thread, fills ring which create pops from */
+  GThread *receive_thread;
+  GMutex ring_mutex;
+  GCond ring_cond;
+  GstPleoraSrcFrame *ring;
+  guint ring_size;
+  guint ring_head;
+  guint ring_count;
+  gboolean receive_stop;
+  GstFlowReturn receive_flow;
 
   gboolean stop_requested;
 };
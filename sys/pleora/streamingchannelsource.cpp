@@ -28,9 +28,20 @@ GST_DEBUG_CATEGORY_EXTERN (pleorasink_debug);
 #define CHUNKLAYOUTID 0xABCD
 #define KLV_CHUNKID 0xFEDC
 
+/* PvBuffer that keeps the GstBuffer it is attached to alive until the
+ * transmitter hands it back */
+class GstPvBuffer:public PvBuffer
+{
+public:
+    GstPvBuffer () : mGstBuffer (NULL) {}
+
+    GstBuffer *mGstBuffer;
+    GstMapInfo mMapInfo;
+};
+
 GstStreamingChannelSource::GstStreamingChannelSource ()
 :  mAcquisitionBuffer (NULL), mBufferCount (0), mBufferValid (FALSE),
-    mChunkModeActive(TRUE), mChunkKlvEnabled(TRUE), mKlvChunkSize(0)
+    mChunkModeActive(TRUE), mChunkKlvEnabled(TRUE)
 {
 
 }
@@ -108,8 +119,9 @@ uint32_t GstStreamingChannelSource::GetRequiredChunkSize() const
 {
     if (mChunkModeActive && mChunkKlvEnabled) {
         /* chunk data must be multiple of 4 bytes, and 16 bytes extra seem
-           to be needed for chunk ID and length */
-        return GST_ROUND_UP_4 (mKlvChunkSize) + 16;
+           to be needed for chunk ID and length. Always reserve the maximum
+           so buffers never have to be reallocated when KLV size changes */
+        return GST_ROUND_UP_4 (mSink->max_klv_size) + 16;
     } else {
         return 0;
     }
@@ -129,19 +141,23 @@ PvBuffer * GstStreamingChannelSource::AllocBuffer ()
 {
   if (mBufferCount < mSink->num_internal_buffers) {
     mBufferCount++;
-    return new PvBuffer;
+    return new GstPvBuffer;
   }
   return NULL;
 }
 
 void GstStreamingChannelSource::FreeBuffer (PvBuffer * aBuffer)
 {
-  delete aBuffer;
+  DetachBuffer (aBuffer);
+  delete static_cast < GstPvBuffer * >(aBuffer);
   mBufferCount--;
 }
 
 PvResult GstStreamingChannelSource::QueueBuffer (PvBuffer * aBuffer)
 {
+  /* buffer has been transmitted, so upstream can have its memory back */
+  DetachBuffer (aBuffer);
+
   g_mutex_lock (&mSink->mutex);
   if (mAcquisitionBuffer == NULL) {
     // No buffer queued, accept it
@@ -223,7 +239,7 @@ GstStreamingChannelSource::ResizeBufferIfNeeded (PvBuffer * aBuffer)
 {
   uint32_t lRequiredChunkSize = GetRequiredChunkSize();
   PvImage *lImage = aBuffer->GetImage ();
-  if ((lImage->GetWidth () != mWidth) ||
+  if (!aBuffer->IsAllocated () ||(lImage->GetWidth () != mWidth) ||
       (lImage->GetHeight () != mHeight) ||
       (lImage->GetPixelType () != mPixelType) ||
       (lImage->GetMaximumChunkLength () != lRequiredChunkSize)) {
@@ -233,6 +249,140 @@ GstStreamingChannelSource::ResizeBufferIfNeeded (PvBuffer * aBuffer)
 }
 
 void
+GstStreamingChannelSource::GetLayout (GstBuffer * buf, gint & aStride,
+    gsize & aOffset) const
+{
+  GstVideoMeta *vmeta = gst_buffer_get_video_meta (buf);
+
+  if (vmeta) {
+    aStride = vmeta->stride[0];
+    aOffset = vmeta->offset[0];
+  } else {
+    aStride = GST_VIDEO_INFO_PLANE_STRIDE (&mSink->vinfo, 0);
+    aOffset = GST_VIDEO_INFO_PLANE_OFFSET (&mSink->vinfo, 0);
+  }
+}
+
+gboolean
+GstStreamingChannelSource::AttachBuffer (PvBuffer * aBuffer, GstBuffer * buf)
+{
+  GstPvBuffer *lBuffer = static_cast < GstPvBuffer * >(aBuffer);
+  uint32_t lChunkSize = GetRequiredChunkSize ();
+  gint stride, row_size;
+  gsize offset;
+  PvResult pvRes;
+
+  GetLayout (buf, stride, offset);
+
+  /* row padding is the only stride difference PvImage can describe */
+  row_size = mWidth * PvGetPixelBitCount (mPixelType) / 8;
+  if (stride < row_size || stride - row_size > G_MAXUINT16) {
+    return FALSE;
+  }
+
+  if (!gst_buffer_map (buf, &lBuffer->mMapInfo, GST_MAP_READ)) {
+    return FALSE;
+  }
+
+  if (lBuffer->mMapInfo.size <
+      offset + (gsize) stride * (mHeight - 1) + row_size) {
+    gst_buffer_unmap (buf, &lBuffer->mMapInfo);
+    return FALSE;
+  }
+
+  /* chunks are written right after the image, into the padding reserved
+     by the allocation we proposed */
+  if (lChunkSize > 0 && lBuffer->mMapInfo.maxsize <
+      offset + (gsize) stride * mHeight + lChunkSize) {
+    GST_LOG_OBJECT (mSink, "No room for chunk data after image, will copy");
+    gst_buffer_unmap (buf, &lBuffer->mMapInfo);
+    return FALSE;
+  }
+
+  if (aBuffer->IsAllocated ()) {
+    aBuffer->Free ();
+  }
+
+  pvRes = aBuffer->GetImage ()->Attach (lBuffer->mMapInfo.data + offset,
+      mWidth, mHeight, mPixelType, stride - row_size, 0, lChunkSize);
+  if (!pvRes.IsOK ()) {
+    GST_WARNING_OBJECT (mSink, "Failed to attach buffer, will copy: %s",
+        pvRes.GetDescription ().GetAscii ());
+    gst_buffer_unmap (buf, &lBuffer->mMapInfo);
+    return FALSE;
+  }
+
+  lBuffer->mGstBuffer = gst_buffer_ref (buf);
+
+  return TRUE;
+}
+
+void
+GstStreamingChannelSource::DetachBuffer (PvBuffer * aBuffer)
+{
+  GstPvBuffer *lBuffer = static_cast < GstPvBuffer * >(aBuffer);
+
+  if (lBuffer->mGstBuffer == NULL) {
+    return;
+  }
+
+  aBuffer->Detach ();
+  gst_buffer_unmap (lBuffer->mGstBuffer, &lBuffer->mMapInfo);
+  gst_buffer_unref (lBuffer->mGstBuffer);
+  lBuffer->mGstBuffer = NULL;
+}
+
+gboolean
+GstStreamingChannelSource::CopyBuffer (PvBuffer * aBuffer, GstBuffer * buf)
+{
+  GstMapInfo minfo;
+  gint stride, row_size, dst_stride;
+  gsize offset;
+  guint8 *dst;
+
+  ResizeBufferIfNeeded (aBuffer);
+
+  dst = aBuffer->GetDataPointer ();
+  if (!dst) {
+    GST_ERROR_OBJECT (mSink, "Have buffer to fill, but data pointer is invalid");
+    return FALSE;
+  }
+
+  GetLayout (buf, stride, offset);
+  row_size = mWidth * PvGetPixelBitCount (mPixelType) / 8;
+  dst_stride = row_size + aBuffer->GetImage ()->GetPaddingX ();
+
+  if (!gst_buffer_map (buf, &minfo, GST_MAP_READ)) {
+    GST_ERROR_OBJECT (mSink, "Failed to map buffer");
+    return FALSE;
+  }
+
+  if (stride < row_size ||
+      minfo.size < offset + (gsize) stride * (mHeight - 1) + row_size ||
+      aBuffer->GetSize () < (gsize) dst_stride * mHeight) {
+    GST_ERROR_OBJECT (mSink, "Buffer of %" G_GSIZE_FORMAT " bytes with "
+        "stride %d doesn't hold a %dx%d image", minfo.size, stride, mWidth,
+        mHeight);
+    gst_buffer_unmap (buf, &minfo);
+    return FALSE;
+  }
+
+  if (stride == dst_stride) {
+    memcpy (dst, minfo.data + offset, (gsize) stride * (mHeight - 1) +
+        row_size);
+  } else {
+    for (gint i = 0; i < mHeight; i++) {
+      memcpy (dst + (gsize) i * dst_stride,
+          minfo.data + offset + (gsize) i * stride, row_size);
+    }
+  }
+
+  gst_buffer_unmap (buf, &minfo);
+
+  return TRUE;
+}
+
+gboolean
 GstStreamingChannelSource::SetBuffer (GstBuffer * buf)
 {
   GByteArray * klv_byte_array = NULL;
@@ -244,48 +394,38 @@ GstStreamingChannelSource::SetBuffer (GstBuffer * buf)
   if (mAcquisitionBuffer == NULL) {
     GST_WARNING_OBJECT (mSink, "No PvBuffer available to fill, dropping frame");
     g_mutex_unlock (&mSink->mutex);
-    return;
+    return TRUE;
   }
 
   if (mBufferValid) {
     GST_WARNING_OBJECT (mSink,
         "Buffer already filled, dropping incoming frame");
     g_mutex_unlock (&mSink->mutex);
-    return;
+    return TRUE;
   }
 
-  if (mChunkKlvEnabled) {
+  if (mChunkModeActive && mChunkKlvEnabled) {
       klv_byte_array = GetKlvByteArray (buf);
-      if (klv_byte_array) {
-          mKlvChunkSize = klv_byte_array->len;
-      } else {
-          mKlvChunkSize = 0;
-      }
   }
 
-  ResizeBufferIfNeeded (mAcquisitionBuffer);
-
-  /* TODO: avoid memcpy (when strides align) by attaching to PvBuffer */
-  GstMapInfo minfo;
-  gst_buffer_map (buf, &minfo, GST_MAP_READ);
-
-
-  guint8 *dst = mAcquisitionBuffer->GetDataPointer ();
-  if (!dst) {
-    GST_ERROR_OBJECT (mSink, "Have buffer to fill, but data pointer is invalid");
-    g_mutex_unlock (&mSink->mutex);
-    return;
+  if (AttachBuffer (mAcquisitionBuffer, buf)) {
+      GST_LOG_OBJECT (mSink, "Attached buffer to PvBuffer");
+  } else if (!CopyBuffer (mAcquisitionBuffer, buf)) {
+      if (klv_byte_array) {
+          g_byte_array_unref (klv_byte_array);
+      }
+      g_mutex_unlock (&mSink->mutex);
+      return FALSE;
   }
-  g_assert (mAcquisitionBuffer->GetSize () >= minfo.size);
-  /* TODO: fix stride if needed */
-  memcpy (dst, minfo.data, minfo.size);
-
-  gst_buffer_unmap (buf, &minfo);
 
   mAcquisitionBuffer->ResetChunks();
   mAcquisitionBuffer->SetChunkLayoutID(CHUNKLAYOUTID);
 
-  if (mChunkKlvEnabled && klv_byte_array && klv_byte_array->len > 0) {
+  if (klv_byte_array &&
+      klv_byte_array->len > GST_ROUND_UP_4 (mSink->max_klv_size)) {
+    GST_WARNING_OBJECT (mSink, "KLV (len=%d) larger than max-klv-size (%d), "
+        "not sending", klv_byte_array->len, mSink->max_klv_size);
+  } else if (klv_byte_array && klv_byte_array->len > 0) {
     PvResult pvRes;
     pvRes = mAcquisitionBuffer->AddChunk (KLV_CHUNKID, (uint8_t*)klv_byte_array->data, klv_byte_array->len);
     if (pvRes.IsOK ()) {
@@ -305,6 +445,8 @@ GstStreamingChannelSource::SetBuffer (GstBuffer * buf)
   g_cond_signal (&mSink->cond);
 
   g_mutex_unlock (&mSink->mutex);
+
+  return TRUE;
 }
 
 GByteArray * GstStreamingChannelSource::GetKlvByteArray (GstBuffer * buf)
@@ -29,7 +29,11 @@ public:
     void SetSink (GstPleoraSink * sink);
     void SetCaps (GstCaps * caps);
     void ResizeBufferIfNeeded (PvBuffer * aBuffer);
-    void SetBuffer (GstBuffer * buf);
+    void GetLayout (GstBuffer * buf, gint & aStride, gsize & aOffset) const;
+    gboolean AttachBuffer (PvBuffer * aBuffer, GstBuffer * buf);
+    gboolean CopyBuffer (PvBuffer * aBuffer, GstBuffer * buf);
+    void DetachBuffer (PvBuffer * aBuffer);
+    gboolean SetBuffer (GstBuffer * buf);
 
     PvBuffer *AllocBuffer ();
     void FreeBuffer (PvBuffer * aBuffer);
@@ -65,6 +69,4 @@ private:
 
     bool mChunkModeActive;
     bool mChunkKlvEnabled;
-
-    gint mKlvChunkSize;
 };
\ No newline at end of file
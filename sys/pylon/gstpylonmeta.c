@@ -0,0 +1,112 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstpylonmeta.h"
+
+GType
+gst_pylon_chunk_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstPylonChunkMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+static gboolean
+gst_pylon_chunk_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  GstPylonChunkMeta *cmeta = (GstPylonChunkMeta *) meta;
+
+  cmeta->flags = (GstPylonChunkMetaFlags) 0;
+  cmeta->block_id = 0;
+  cmeta->timestamp = 0;
+  cmeta->frame_counter = 0;
+  cmeta->exposure_time = 0.0;
+  cmeta->gain = 0.0;
+  cmeta->line_status = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_pylon_chunk_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstPylonChunkMeta *smeta = (GstPylonChunkMeta *) meta;
+  GstPylonChunkMeta *dmeta;
+
+  /* chunk data describes the whole frame, so only copy it along */
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  dmeta = gst_buffer_add_pylon_chunk_meta (dest);
+  if (!dmeta)
+    return FALSE;
+
+  dmeta->flags = smeta->flags;
+  dmeta->block_id = smeta->block_id;
+  dmeta->timestamp = smeta->timestamp;
+  dmeta->frame_counter = smeta->frame_counter;
+  dmeta->exposure_time = smeta->exposure_time;
+  dmeta->gain = smeta->gain;
+  dmeta->line_status = smeta->line_status;
+
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_pylon_chunk_meta_get_info (void)
+{
+  static const GstMetaInfo *pylon_chunk_meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & pylon_chunk_meta_info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_PYLON_CHUNK_META_API_TYPE, "GstPylonChunkMeta",
+        sizeof (GstPylonChunkMeta), gst_pylon_chunk_meta_init, NULL,
+        gst_pylon_chunk_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & pylon_chunk_meta_info,
+        (GstMetaInfo *) meta);
+  }
+  return pylon_chunk_meta_info;
+}
+
+/**
+ * gst_buffer_add_pylon_chunk_meta:
+ * @buffer: a #GstBuffer
+ *
+ * Attaches an empty #GstPylonChunkMeta to @buffer, the caller is expected
+ * to fill in the fields and set the corresponding flags.
+ *
+ * Returns: (transfer none): the #GstPylonChunkMeta on @buffer.
+ */
+GstPylonChunkMeta *
+gst_buffer_add_pylon_chunk_meta (GstBuffer * buffer)
+{
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  return (GstPylonChunkMeta *) gst_buffer_add_meta (buffer,
+      GST_PYLON_CHUNK_META_INFO, NULL);
+}
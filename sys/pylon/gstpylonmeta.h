@@ -0,0 +1,86 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PYLON_META_H_
+#define _GST_PYLON_META_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_PYLON_CHUNK_META_API_TYPE  (gst_pylon_chunk_meta_api_get_type())
+#define GST_PYLON_CHUNK_META_INFO      (gst_pylon_chunk_meta_get_info())
+
+typedef struct _GstPylonChunkMeta GstPylonChunkMeta;
+
+/**
+ * GstPylonChunkMetaFlags:
+ * @GST_PYLON_CHUNK_META_HAS_TIMESTAMP: @timestamp is valid
+ * @GST_PYLON_CHUNK_META_HAS_FRAME_COUNTER: @frame_counter is valid
+ * @GST_PYLON_CHUNK_META_HAS_EXPOSURE_TIME: @exposure_time is valid
+ * @GST_PYLON_CHUNK_META_HAS_GAIN: @gain is valid
+ * @GST_PYLON_CHUNK_META_HAS_LINE_STATUS: @line_status is valid
+ *
+ * Which fields of #GstPylonChunkMeta were present in the chunk data.
+ */
+typedef enum
+{
+  GST_PYLON_CHUNK_META_HAS_TIMESTAMP = (1 << 0),
+  GST_PYLON_CHUNK_META_HAS_FRAME_COUNTER = (1 << 1),
+  GST_PYLON_CHUNK_META_HAS_EXPOSURE_TIME = (1 << 2),
+  GST_PYLON_CHUNK_META_HAS_GAIN = (1 << 3),
+  GST_PYLON_CHUNK_META_HAS_LINE_STATUS = (1 << 4)
+} GstPylonChunkMetaFlags;
+
+/**
+ * GstPylonChunkMeta:
+ * @meta: parent #GstMeta
+ * @flags: which of the chunk fields are valid
+ * @block_id: stream block ID of the frame
+ * @timestamp: camera timestamp in ticks
+ * @frame_counter: camera frame counter
+ * @exposure_time: exposure time in microseconds
+ * @gain: gain in dB or raw units, depending on the camera
+ * @line_status: bit field of I/O line states
+ *
+ * Per-frame chunk data reported by a Basler camera.
+ */
+struct _GstPylonChunkMeta
+{
+  GstMeta meta;
+
+  GstPylonChunkMetaFlags flags;
+  guint64 block_id;
+  guint64 timestamp;
+  guint64 frame_counter;
+  gdouble exposure_time;
+  gdouble gain;
+  guint64 line_status;
+};
+
+GType gst_pylon_chunk_meta_api_get_type (void);
+const GstMetaInfo *gst_pylon_chunk_meta_get_info (void);
+
+GstPylonChunkMeta *gst_buffer_add_pylon_chunk_meta (GstBuffer * buffer);
+
+#define gst_buffer_get_pylon_chunk_meta(b) \
+  ((GstPylonChunkMeta *) gst_buffer_get_meta ((b), GST_PYLON_CHUNK_META_API_TYPE))
+
+G_END_DECLS
+
+#endif
@@ -36,6 +36,7 @@
 #endif
 
 #include "gstpylonsrc.h"
+#include "gstpylonmeta.h"
 #include <gst/gst.h>
 #include <glib.h>
 
@@ -100,6 +101,7 @@ static gboolean gst_pylonsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps);
 static GstFlowReturn gst_pylonsrc_create (GstPushSrc * bsrc, GstBuffer ** buf);
 
 static void gst_pylonsrc_update_caps (GstPylonSrc * src);
+static void gst_pylonsrc_trigger_wake (GstPylonSrc * src);
 static gchar *read_string_feature (GstPylonSrc * src, const char *feature);
 
 /* parameters */
@@ -181,6 +183,17 @@ typedef enum _GST_PYLONSRC_PROP
   PROP_CONFIGFILE,
   PROP_IGNOREDEFAULTS,
 
+  PROP_HWTIMESTAMP,
+  PROP_CHUNKMETADATA,
+  PROP_DROPPEDFRAMES,
+  PROP_TRIGGERRATE,
+  PROP_TRIGGERSINFLIGHT,
+  PROP_LOSTTRIGGERS,
+  PROP_TRIGGERLATENCYMEAN,
+  PROP_TRIGGERLATENCYMAX,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+
   PROP_NUM_PROPERTIES           // Yes, there is PROP_0 that represent nothing, so actually there are (PROP_NUMPROPS - 1) properties.
       // But this way you can intuitively access propFlags[] by index
 } GST_PYLONSRC_PROP;
@@ -261,6 +274,35 @@ static const char *const featBinning[2] =
 static const char *const featSize[2] = { "Width", "Height" };
 static const char *const featMaxSize[2] = { "WidthMax", "HeightMax" };
 
+typedef enum _GST_PYLONSRC_CHUNK
+{
+  CHUNK_TIMESTAMP,
+  CHUNK_FRAMECOUNTER,
+  CHUNK_EXPOSURETIME,
+  CHUNK_GAIN,
+  CHUNK_LINESTATUS,
+
+  CHUNK_NUM_CHUNKS
+} GST_PYLONSRC_CHUNK;
+
+G_STATIC_ASSERT ((int) CHUNK_NUM_CHUNKS == GST_PYLONSRC_NUM_CHUNKS);
+
+// ChunkSelector entries are the feature names without the "Chunk" prefix
+static const char *const featChunk[CHUNK_NUM_CHUNKS] =
+    { "ChunkTimestamp", "ChunkFramecounter", "ChunkExposureTime",
+  "ChunkGainAll", "ChunkLineStatusAll"
+};
+
+static const char *const featChunkAlias[CHUNK_NUM_CHUNKS] =
+    { "ChunkTimestamp", "ChunkCounterValue", "ChunkExposureTime",
+  "ChunkGain", "ChunkLineStatusAll"
+};
+
+static const _Bool featChunkIsFloat[CHUNK_NUM_CHUNKS] =
+    { FALSE, FALSE, TRUE, FALSE, FALSE };
+static const _Bool featChunkAliasIsFloat[CHUNK_NUM_CHUNKS] =
+    { FALSE, FALSE, TRUE, TRUE, FALSE };
+
 static const char *const featTransform[3][3] = {
   {"Gain00", "Gain01", "Gain02"},
   {"Gain10", "Gain11", "Gain12"},
@@ -363,6 +405,10 @@ ascii_strdown (gchar * *str, gssize len)
 #define DEFAULT_PROP_FRAMETRANSDELAY                  0
 #define DEFAULT_PROP_BANDWIDTHRESERVE                 10
 #define DEFAULT_PROP_BANDWIDTHRESERVEACC              10
+#define DEFAULT_PROP_HWTIMESTAMP                      TRUE
+#define DEFAULT_PROP_CHUNKMETADATA                    FALSE
+#define DEFAULT_PROP_TRIGGERRATE                      0.0
+#define DEFAULT_PROP_TRIGGERSINFLIGHT                 1
 
 /* pad templates */
 static GstStaticPadTemplate gst_pylonsrc_src_template =
@@ -777,6 +823,53 @@ gst_pylonsrc_class_init (GstPylonSrcClass * klass)
           "For situations when the network connection becomes unstable. A larger number of packet resends may be needed to transmit an image",
           1, 32, DEFAULT_PROP_BANDWIDTHRESERVEACC,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));     //TODO: Limits may be co-dependent on other transport layer parameters.
+  g_object_class_install_property (gobject_class, PROP_HWTIMESTAMP,
+      g_param_spec_boolean ("hardware-timestamp",
+          "Use camera timestamps",
+          "(true/false) Timestamp buffers from the camera's tick counter mapped onto the pipeline clock, instead of the time the frame was received. Falls back to the pipeline clock if the camera doesn't report timestamps.",
+          DEFAULT_PROP_HWTIMESTAMP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_CHUNKMETADATA,
+      g_param_spec_boolean ("chunk-metadata",
+          "Attach chunk data as metadata",
+          "(true/false) Enables chunk mode on the camera and attaches timestamp, frame counter, exposure time, gain and line status of each frame as GstPylonChunkMeta. Running the plugin without specifying this parameter will reset the value stored on the camera to false.",
+          DEFAULT_PROP_CHUNKMETADATA,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_DROPPEDFRAMES,
+      g_param_spec_uint64 ("dropped-frames", "Dropped frames",
+          "Number of frames lost before reaching the host; deprecated, use "
+          "frames-dropped of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_TRIGGERRATE,
+      g_param_spec_double ("trigger-rate", "Software trigger rate",
+          "(Hz) Rate at which software triggers are issued when continuous is false. At 0 a new trigger is issued as soon as fewer than triggers-in-flight frames are outstanding.",
+          0.0, 100000.0, DEFAULT_PROP_TRIGGERRATE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_TRIGGERSINFLIGHT,
+      g_param_spec_int ("triggers-in-flight", "Software triggers in flight",
+          "Maximum number of software triggers issued without having received their frames. Values above 1 let exposure overlap with delivery, the camera's trigger-wait status is checked before each additional trigger.",
+          1, GST_PYLONSRC_NUM_CAPTURE_BUFFERS, DEFAULT_PROP_TRIGGERSINFLIGHT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LOSTTRIGGERS,
+      g_param_spec_uint64 ("lost-triggers", "Lost software triggers",
+          "Number of software triggers for which no frame arrived within grab-timeout.",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_TRIGGERLATENCYMEAN,
+      g_param_spec_uint64 ("trigger-latency-mean",
+          "Mean trigger-to-exposure latency",
+          "(Nanoseconds) Mean time between issuing a software trigger and the start of its frame's exposure, by the camera timestamp. Needs hardware-timestamp.",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_TRIGGERLATENCYMAX,
+      g_param_spec_uint64 ("trigger-latency-max",
+          "Maximum trigger-to-exposure latency",
+          "(Nanoseconds) Largest time between issuing a software trigger and the start of its frame's exposure, by the camera timestamp. Needs hardware-timestamp.",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  gst_vision_stats_install_properties (gobject_class, PROP_STATS,
+      PROP_STATS_INTERVAL);
 }
 
 static gboolean
@@ -872,6 +965,33 @@ gst_pylonsrc_init (GstPylonSrc * src)
   src->frameTransDelay = DEFAULT_PROP_FRAMETRANSDELAY;
   src->bandwidthReserve = DEFAULT_PROP_BANDWIDTHRESERVE;
   src->bandwidthReserveAcc = DEFAULT_PROP_BANDWIDTHRESERVEACC;
+  src->hwTimestamp = DEFAULT_PROP_HWTIMESTAMP;
+  src->chunkMetadata = DEFAULT_PROP_CHUNKMETADATA;
+
+  src->chunkParser = NULL;
+  for (int i = 0; i < CHUNK_NUM_CHUNKS; i++) {
+    src->chunkNode[i] = NULL;
+  }
+  gst_vision_clock_mapper_init (&src->clockMapper, 1e9, 64, 0);
+  src->lastBlockId = 0;
+  src->shortBlockIds = FALSE;
+  gst_vision_stats_init (&src->stats);
+
+  src->triggerRate = DEFAULT_PROP_TRIGGERRATE;
+  src->triggersInFlight = DEFAULT_PROP_TRIGGERSINFLIGHT;
+  src->triggerThread = NULL;
+  g_mutex_init (&src->triggerMutex);
+  src->triggerWake = NULL;
+  src->triggerWaitObjects = NULL;
+  src->eventGrabber = NULL;
+  src->triggerStop = FALSE;
+  src->triggerReady = TRUE;
+  src->triggerHead = 0;
+  src->triggerCount = 0;
+  src->lostTriggers = 0;
+  src->triggerLatencyCount = 0;
+  src->triggerLatencySum = 0;
+  src->triggerLatencyMax = 0;
 
   for (int i = 0; i < PROP_NUM_PROPERTIES; i++) {
     src->propFlags[i] = GST_PYLONSRC_PROPST_DEFAULT;
@@ -1214,6 +1334,27 @@ gst_pylonsrc_set_property (GObject * object, guint property_id,
     case PROP_BANDWIDTHRESERVEACC:
       src->bandwidthReserveAcc = g_value_get_int (value);
       break;
+    case PROP_HWTIMESTAMP:
+      src->hwTimestamp = g_value_get_boolean (value);
+      break;
+    case PROP_CHUNKMETADATA:
+      src->chunkMetadata = g_value_get_boolean (value);
+      break;
+    case PROP_TRIGGERRATE:
+      g_mutex_lock (&src->triggerMutex);
+      src->triggerRate = g_value_get_double (value);
+      gst_pylonsrc_trigger_wake (src);
+      g_mutex_unlock (&src->triggerMutex);
+      break;
+    case PROP_TRIGGERSINFLIGHT:
+      g_mutex_lock (&src->triggerMutex);
+      src->triggersInFlight = g_value_get_int (value);
+      gst_pylonsrc_trigger_wake (src);
+      g_mutex_unlock (&src->triggerMutex);
+      break;
+    case PROP_STATS_INTERVAL:
+      gst_vision_stats_set_interval (&src->stats, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       return;
@@ -1449,6 +1590,45 @@ gst_pylonsrc_get_property (GObject * object, guint property_id,
     case PROP_BANDWIDTHRESERVEACC:
       g_value_set_int (value, src->bandwidthReserveAcc);
       break;
+    case PROP_HWTIMESTAMP:
+      g_value_set_boolean (value, src->hwTimestamp);
+      break;
+    case PROP_CHUNKMETADATA:
+      g_value_set_boolean (value, src->chunkMetadata);
+      break;
+    case PROP_DROPPEDFRAMES:
+      g_mutex_lock (&src->stats.lock);
+      g_value_set_uint64 (value, src->stats.frames_dropped);
+      g_mutex_unlock (&src->stats.lock);
+      break;
+    case PROP_TRIGGERRATE:
+      g_value_set_double (value, src->triggerRate);
+      break;
+    case PROP_TRIGGERSINFLIGHT:
+      g_value_set_int (value, src->triggersInFlight);
+      break;
+    case PROP_LOSTTRIGGERS:
+      g_mutex_lock (&src->triggerMutex);
+      g_value_set_uint64 (value, src->lostTriggers);
+      g_mutex_unlock (&src->triggerMutex);
+      break;
+    case PROP_TRIGGERLATENCYMEAN:
+      g_mutex_lock (&src->triggerMutex);
+      g_value_set_uint64 (value, src->triggerLatencyCount > 0 ?
+          src->triggerLatencySum / src->triggerLatencyCount : 0);
+      g_mutex_unlock (&src->triggerMutex);
+      break;
+    case PROP_TRIGGERLATENCYMAX:
+      g_mutex_lock (&src->triggerMutex);
+      g_value_set_uint64 (value, src->triggerLatencyMax);
+      g_mutex_unlock (&src->triggerMutex);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vision_stats_get_structure (&src->stats));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, gst_vision_stats_get_interval (&src->stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -3050,6 +3230,418 @@ error:
   return FALSE;
 }
 
+// Software triggers are issued from a dedicated thread, so the streaming
+// thread only waits for frames. The thread sleeps on the triggerWake wait
+// object and the event grabber until a frame is retrieved, the camera reports
+// the end of an exposure, the next trigger is due or a trigger times out.
+// Without camera events, the camera is taken to wait for a trigger again once
+// the frame of the previous one is retrieved.
+
+// Called with triggerMutex held
+static void
+gst_pylonsrc_trigger_wake (GstPylonSrc * src)
+{
+  if (src->triggerWake != NULL) {
+    PylonWaitObjectSignal (src->triggerWake);
+  }
+}
+
+// Enables ExposureEnd events, after which the camera accepts the next trigger
+static _Bool
+gst_pylonsrc_open_trigger_events (GstPylonSrc * src)
+{
+  GENAPIC_RESULT res;
+  size_t numChannels = 0;
+  PYLON_WAITOBJECT_HANDLE eventWait;
+
+  if (!feature_supported (src, "EventSelector") ||
+      PylonDeviceFeatureFromString (src->deviceHandle, "EventSelector",
+          "ExposureEnd") != GENAPI_E_OK) {
+    GST_DEBUG_OBJECT (src, "Camera doesn't send exposure end events");
+    return FALSE;
+  }
+  // Older GigE cameras call it GenICamEvent
+  if (PylonDeviceFeatureFromString (src->deviceHandle, "EventNotification",
+          "On") != GENAPI_E_OK &&
+      PylonDeviceFeatureFromString (src->deviceHandle, "EventNotification",
+          "GenICamEvent") != GENAPI_E_OK) {
+    GST_DEBUG_OBJECT (src, "Failed to enable exposure end events");
+    return FALSE;
+  }
+
+  res = PylonDeviceGetNumEventGrabberChannels (src->deviceHandle,
+      &numChannels);
+  if (res != GENAPI_E_OK || numChannels == 0) {
+    GST_DEBUG_OBJECT (src, "Camera has no event channel");
+    goto error;
+  }
+
+  res = PylonDeviceGetEventGrabber (src->deviceHandle, 0, &src->eventGrabber);
+  PYLONC_CHECK_ERROR (src, res);
+  res = PylonEventGrabberSetNumBuffers (src->eventGrabber,
+      GST_PYLONSRC_NUM_CAPTURE_BUFFERS);
+  PYLONC_CHECK_ERROR (src, res);
+  res = PylonEventGrabberOpen (src->eventGrabber);
+  PYLONC_CHECK_ERROR (src, res);
+  res = PylonEventGrabberGetWaitObject (src->eventGrabber, &eventWait);
+  if (res != GENAPI_E_OK ||
+      PylonWaitObjectsAdd (src->triggerWaitObjects, eventWait,
+          NULL) != GENAPI_E_OK) {
+    PylonEventGrabberClose (src->eventGrabber);
+    goto error;
+  }
+
+  GST_DEBUG_OBJECT (src, "Waiting for exposure end events between triggers");
+  return TRUE;
+
+error:
+  src->eventGrabber = NULL;
+  PylonDeviceFeatureFromString (src->deviceHandle, "EventNotification", "Off");
+  return FALSE;
+}
+
+static void
+gst_pylonsrc_close_trigger_events (GstPylonSrc * src)
+{
+  if (src->eventGrabber != NULL) {
+    PylonDeviceFeatureFromString (src->deviceHandle, "EventSelector",
+        "ExposureEnd");
+    PylonDeviceFeatureFromString (src->deviceHandle, "EventNotification",
+        "Off");
+    PylonEventGrabberClose (src->eventGrabber);
+    src->eventGrabber = NULL;
+  }
+}
+
+// Only the trigger thread retrieves events, each one is the end of an exposure
+static guint
+gst_pylonsrc_retrieve_trigger_events (GstPylonSrc * src)
+{
+  PylonEventResult_t event;
+  _Bool isReady = TRUE;
+  guint numEvents = 0;
+
+  while (PylonEventGrabberRetrieveEvent (src->eventGrabber, &event,
+          &isReady) == GENAPI_E_OK && isReady) {
+    if (event.ErrorCode != 0) {
+      GST_WARNING_OBJECT (src, "Event error: %s", event.ErrorDescription);
+    }
+    numEvents++;
+  }
+  return numEvents;
+}
+
+static gpointer
+gst_pylonsrc_trigger_thread_func (gpointer data)
+{
+  GstPylonSrc *src = GST_PYLONSRC (data);
+  const gint64 timeout = (gint64) src->grabtimeout * G_TIME_SPAN_MILLISECOND;
+  gint64 nextTrigger = g_get_monotonic_time ();
+
+  g_mutex_lock (&src->triggerMutex);
+  while (!src->triggerStop) {
+    const gint64 now = g_get_monotonic_time ();
+    gint64 deadline = G_MAXINT64;
+    uint32_t waitMs = PYLON_INFINITE;
+    size_t index = 0;
+    _Bool woken = FALSE;
+
+    PylonWaitObjectReset (src->triggerWake);
+
+    // Give up on the oldest trigger after grab-timeout
+    if (src->triggerCount > 0 &&
+        now - src->triggerTimes[src->triggerHead] >= timeout) {
+      src->triggerHead =
+          (src->triggerHead + 1) % GST_PYLONSRC_NUM_CAPTURE_BUFFERS;
+      src->triggerCount--;
+      src->triggerReady = TRUE;
+      src->lostTriggers++;
+      GST_WARNING_OBJECT (src, "No frame for software trigger after %d ms",
+          src->grabtimeout);
+      continue;
+    }
+
+    if (src->triggerCount >= (guint) src->triggersInFlight ||
+        !src->triggerReady) {
+      // Wait for a frame, or for the camera to finish exposing
+      if (src->triggerCount > 0) {
+        deadline = src->triggerTimes[src->triggerHead] + timeout;
+      }
+    } else if (src->triggerRate > 0.0 && now < nextTrigger) {
+      deadline = nextTrigger;
+    } else {
+      GENAPIC_RESULT res;
+      GstClock *clock;
+      GstClockTime clockTime = GST_CLOCK_TIME_NONE;
+
+      src->triggerReady = FALSE;
+      g_mutex_unlock (&src->triggerMutex);
+      res = PylonDeviceExecuteCommandFeature (src->deviceHandle,
+          "TriggerSoftware");
+      clock = gst_element_get_clock (GST_ELEMENT (src));
+      if (clock != NULL) {
+        clockTime = gst_clock_get_time (clock);
+        gst_object_unref (clock);
+      }
+      g_mutex_lock (&src->triggerMutex);
+
+      if (res != GENAPI_E_OK) {
+        GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+            ("Failed to issue software trigger"), (NULL));
+        break;
+      } else {
+        const guint tail = (src->triggerHead + src->triggerCount) %
+            GST_PYLONSRC_NUM_CAPTURE_BUFFERS;
+        src->triggerTimes[tail] = now;
+        src->triggerClockTimes[tail] = clockTime;
+        src->triggerCount++;
+
+        if (src->triggerRate > 0.0) {
+          const gint64 period = (gint64) (G_USEC_PER_SEC / src->triggerRate);
+          nextTrigger += period;
+          // Don't burst to catch up after a stall
+          if (nextTrigger < now) {
+            nextTrigger = now + period;
+          }
+        }
+        continue;
+      }
+    }
+
+    if (deadline != G_MAXINT64) {
+      // Round up, so a deadline isn't busy-waited on
+      waitMs = (uint32_t) MIN ((MAX (deadline - now, 0) +
+              G_TIME_SPAN_MILLISECOND - 1) / G_TIME_SPAN_MILLISECOND,
+          G_MAXUINT32 - 1);
+    }
+
+    g_mutex_unlock (&src->triggerMutex);
+    PylonWaitObjectsWaitForAny (src->triggerWaitObjects, waitMs, &index,
+        &woken);
+    if (woken && index == 1) {
+      const guint numEvents = gst_pylonsrc_retrieve_trigger_events (src);
+      g_mutex_lock (&src->triggerMutex);
+      if (numEvents > 0) {
+        src->triggerReady = TRUE;
+      }
+    } else {
+      g_mutex_lock (&src->triggerMutex);
+    }
+  }
+  g_mutex_unlock (&src->triggerMutex);
+
+  return NULL;
+}
+
+static _Bool
+gst_pylonsrc_start_trigger_thread (GstPylonSrc * src)
+{
+  GError *err = NULL;
+  GENAPIC_RESULT res;
+
+  res = PylonWaitObjectCreate (&src->triggerWake);
+  PYLONC_CHECK_ERROR (src, res);
+  res = PylonWaitObjectsCreate (&src->triggerWaitObjects);
+  PYLONC_CHECK_ERROR (src, res);
+  res = PylonWaitObjectsAdd (src->triggerWaitObjects, src->triggerWake, NULL);
+  PYLONC_CHECK_ERROR (src, res);
+  gst_pylonsrc_open_trigger_events (src);
+
+  g_mutex_lock (&src->triggerMutex);
+  src->triggerStop = FALSE;
+  src->triggerReady = TRUE;
+  src->triggerHead = 0;
+  src->triggerCount = 0;
+  src->lostTriggers = 0;
+  src->triggerLatencyCount = 0;
+  src->triggerLatencySum = 0;
+  src->triggerLatencyMax = 0;
+  g_mutex_unlock (&src->triggerMutex);
+
+  src->triggerThread = g_thread_try_new ("pylonsrc-trigger",
+      gst_pylonsrc_trigger_thread_func, src, &err);
+  if (src->triggerThread == NULL) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
+        ("Failed to start software trigger thread"), ("%s", err->message));
+    g_error_free (err);
+    return FALSE;
+  }
+  return TRUE;
+
+error:
+  return FALSE;
+}
+
+static void
+gst_pylonsrc_stop_trigger_thread (GstPylonSrc * src)
+{
+  if (src->triggerThread != NULL) {
+    g_mutex_lock (&src->triggerMutex);
+    src->triggerStop = TRUE;
+    gst_pylonsrc_trigger_wake (src);
+    g_mutex_unlock (&src->triggerMutex);
+
+    g_thread_join (src->triggerThread);
+    src->triggerThread = NULL;
+  }
+
+  gst_pylonsrc_close_trigger_events (src);
+  g_mutex_lock (&src->triggerMutex);
+  if (src->triggerWaitObjects != NULL) {
+    PylonWaitObjectsDestroy (src->triggerWaitObjects);
+    src->triggerWaitObjects = NULL;
+  }
+  if (src->triggerWake != NULL) {
+    PylonWaitObjectDestroy (src->triggerWake);
+    src->triggerWake = NULL;
+  }
+  g_mutex_unlock (&src->triggerMutex);
+}
+
+// Called for each retrieved frame with the pipeline clock time of its
+// exposure, if known. Frames arrive in trigger order, the frame belongs to the
+// last trigger issued before its exposure started, earlier triggers got no
+// frame.
+static void
+gst_pylonsrc_trigger_frame_done (GstPylonSrc * src, GstClockTime captureTime)
+{
+  g_mutex_lock (&src->triggerMutex);
+  if (GST_CLOCK_TIME_IS_VALID (captureTime)) {
+    while (src->triggerCount > 1) {
+      const guint next =
+          (src->triggerHead + 1) % GST_PYLONSRC_NUM_CAPTURE_BUFFERS;
+      if (!GST_CLOCK_TIME_IS_VALID (src->triggerClockTimes[next]) ||
+          src->triggerClockTimes[next] > captureTime) {
+        break;
+      }
+      src->triggerHead = next;
+      src->triggerCount--;
+      src->lostTriggers++;
+      GST_WARNING_OBJECT (src, "No frame for software trigger");
+    }
+  }
+
+  if (src->triggerCount > 0) {
+    const GstClockTime triggerTime =
+        src->triggerClockTimes[src->triggerHead];
+
+    src->triggerHead =
+        (src->triggerHead + 1) % GST_PYLONSRC_NUM_CAPTURE_BUFFERS;
+    src->triggerCount--;
+
+    // Trigger to start of exposure, only known with camera timestamps
+    if (GST_CLOCK_TIME_IS_VALID (captureTime) &&
+        GST_CLOCK_TIME_IS_VALID (triggerTime) && captureTime >= triggerTime) {
+      const GstClockTime latency = captureTime - triggerTime;
+
+      src->triggerLatencyCount++;
+      src->triggerLatencySum += latency;
+      if (latency > src->triggerLatencyMax) {
+        src->triggerLatencyMax = latency;
+      }
+      GST_LOG_OBJECT (src, "Trigger-to-exposure latency %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (latency));
+    }
+  }
+
+  // The exposure of this frame is over whether or not events arrive
+  src->triggerReady = TRUE;
+  gst_pylonsrc_trigger_wake (src);
+  g_mutex_unlock (&src->triggerMutex);
+}
+
+static _Bool
+gst_pylonsrc_set_chunks (GstPylonSrc * src)
+{
+  GENAPIC_RESULT res;
+
+  if (is_prop_implicit (src, PROP_CHUNKMETADATA)) {
+    if (feature_supported (src, "ChunkModeActive")) {
+      GST_DEBUG_OBJECT (src, "Setting chunk mode to %s",
+          boolalpha (src->chunkMetadata));
+      res =
+          PylonDeviceSetBooleanFeature (src->deviceHandle, "ChunkModeActive",
+          src->chunkMetadata);
+      PYLONC_CHECK_ERROR (src, res);
+
+      if (src->chunkMetadata) {
+        for (int i = 0; i < CHUNK_NUM_CHUNKS; i++) {
+          const char *name = featChunk[i];
+          gchar *entry =
+              g_strdup_printf ("EnumEntry_ChunkSelector_%s", name + 5);
+
+          if (!PylonDeviceFeatureIsAvailable (src->deviceHandle, entry)) {
+            g_free (entry);
+            name = featChunkAlias[i];
+            entry = g_strdup_printf ("EnumEntry_ChunkSelector_%s", name + 5);
+          }
+
+          if (PylonDeviceFeatureIsAvailable (src->deviceHandle, entry)) {
+            res =
+                PylonDeviceFeatureFromString (src->deviceHandle,
+                "ChunkSelector", name + 5);
+            if (res == GENAPI_E_OK) {
+              res =
+                  PylonDeviceSetBooleanFeature (src->deviceHandle, "ChunkEnable",
+                  TRUE);
+            }
+            if (res != GENAPI_E_OK) {
+              GST_WARNING_OBJECT (src, "Failed to enable chunk %s", name);
+            }
+          } else {
+            GST_WARNING_OBJECT (src, "Camera doesn't provide chunk %s",
+                featChunk[i]);
+          }
+          g_free (entry);
+        }
+      }
+    } else if (src->chunkMetadata) {
+      GST_WARNING_OBJECT (src, "Camera doesn't support chunk data");
+    }
+    reset_prop (src, PROP_CHUNKMETADATA);
+  }
+  return TRUE;
+
+error:
+  return FALSE;
+}
+
+// Look up chunk nodes once, so reading them per frame is local to the parser
+static _Bool
+gst_pylonsrc_create_chunk_parser (GstPylonSrc * src)
+{
+  GENAPIC_RESULT res;
+  NODEMAP_HANDLE hMap;
+
+  res = PylonDeviceCreateChunkParser (src->deviceHandle, &src->chunkParser);
+  PYLONC_CHECK_ERROR (src, res);
+
+  res = PylonDeviceGetNodeMap (src->deviceHandle, &hMap);
+  PYLONC_CHECK_ERROR (src, res);
+
+  for (int i = 0; i < CHUNK_NUM_CHUNKS; i++) {
+    NODE_HANDLE node = NULL;
+
+    res = GenApiNodeMapGetNode (hMap, featChunk[i], &node);
+    src->chunkIsFloat[i] = featChunkIsFloat[i];
+    if (res != GENAPI_E_OK || node == GENAPIC_INVALID_HANDLE) {
+      res = GenApiNodeMapGetNode (hMap, featChunkAlias[i], &node);
+      src->chunkIsFloat[i] = featChunkAliasIsFloat[i];
+    }
+
+    if (res == GENAPI_E_OK && node != GENAPIC_INVALID_HANDLE) {
+      src->chunkNode[i] = node;
+    } else {
+      src->chunkNode[i] = NULL;
+      GST_DEBUG_OBJECT (src, "Chunk %s not found in node map", featChunk[i]);
+    }
+  }
+  return TRUE;
+
+error:
+  return FALSE;
+}
+
 static gboolean
 gst_pylonsrc_configure_start_acquisition (GstPylonSrc * src)
 {
@@ -3177,14 +3769,45 @@ gst_pylonsrc_configure_start_acquisition (GstPylonSrc * src)
         src->payloadSize, (double) src->payloadSize / 1000000,
         (src->payloadSize * frameRate) / 1000000);
   }
+  // Camera timestamps are in ns on USB3 Vision, GigE reports the tick rate
+  {
+    double tickFrequency = 1e9;
+    if (PylonDeviceFeatureIsReadable (src->deviceHandle,
+            "GevTimestampTickFrequency")) {
+      int64_t frequency = 0;
+      res =
+          PylonDeviceGetIntegerFeature (src->deviceHandle,
+          "GevTimestampTickFrequency", &frequency);
+      if (res == GENAPI_E_OK && frequency > 0) {
+        tickFrequency = (double) frequency;
+      }
+    }
+    GST_DEBUG_OBJECT (src, "Camera timestamp tick frequency is %.0lf Hz",
+        tickFrequency);
+    gst_vision_clock_mapper_init (&src->clockMapper, tickFrequency, 64, 0);
+  }
+  src->lastBlockId = 0;
+  // Only GigE Vision 2 extended IDs are 64 bit on GigE cameras
+  src->shortBlockIds =
+      PylonDeviceFeatureIsImplemented (src->deviceHandle, "GevSCPSPacketSize");
+  if (src->shortBlockIds &&
+      PylonDeviceFeatureIsReadable (src->deviceHandle,
+          "GevGVSPExtendedIDMode")) {
+    char *const idMode = read_string_feature (src, "GevGVSPExtendedIDMode");
+    src->shortBlockIds = idMode == NULL || strcmp (idMode, "On") != 0;
+    g_free (idMode);
+  }
+  gst_vision_stats_reset (&src->stats);
+
+  if (src->chunkMetadata && !gst_pylonsrc_create_chunk_parser (src))
+    goto error;
+
   // Tell the camera to start recording
   res =
       PylonDeviceExecuteCommandFeature (src->deviceHandle, "AcquisitionStart");
   PYLONC_CHECK_ERROR (src, res);
-  if (!src->continuousMode) {
-    res =
-        PylonDeviceExecuteCommandFeature (src->deviceHandle, "TriggerSoftware");
-    PYLONC_CHECK_ERROR (src, res);
+  if (!src->continuousMode && !gst_pylonsrc_start_trigger_thread (src)) {
+    goto error;
   }
   src->failedFrames = 0;
   src->frameNumber = 0;
@@ -3836,6 +4459,18 @@ gst_pylonsrc_read_trigger (GstPylonSrc * src)
   }
 }
 
+static void
+gst_pylonsrc_read_chunks (GstPylonSrc * src)
+{
+  if (is_prop_not_set (src, PROP_CHUNKMETADATA)) {
+    GENAPIC_RESULT res =
+        read_bool_feature (src, "ChunkModeActive", &src->chunkMetadata);
+    if (res != GENAPI_E_OK) {
+      src->chunkMetadata = FALSE;
+    }
+  }
+}
+
 static void
 gst_pylonsrc_read_resolution_axis (GstPylonSrc * src, GST_PYLONSRC_AXIS axis)
 {
@@ -3951,6 +4586,7 @@ read_all_features (GstPylonSrc * src)
   gst_pylonsrc_read_exposure_gain_level (src);
   gst_pylonsrc_read_pgi (src);
   gst_pylonsrc_read_trigger (src);
+  gst_pylonsrc_read_chunks (src);
   gst_pylonsrc_read_resolution (src);
 }
 
@@ -4010,7 +4646,8 @@ gst_pylonsrc_set_properties (GstPylonSrc * src)
       gst_pylonsrc_set_auto_exp_gain_wb (src) &&
       gst_pylonsrc_set_color (src) &&
       gst_pylonsrc_set_exposure_gain_level (src) &&
-      gst_pylonsrc_set_pgi (src) && gst_pylonsrc_set_trigger (src);
+      gst_pylonsrc_set_pgi (src) && gst_pylonsrc_set_trigger (src) &&
+      gst_pylonsrc_set_chunks (src);
 }
 
 static gboolean
@@ -4033,6 +4670,9 @@ gst_pylonsrc_start (GstBaseSrc * bsrc)
       !gst_pylonsrc_connect_device (src) || !gst_pylonsrc_set_properties (src))
     goto error;
 
+  // Buffers are timestamped in create() when using camera timestamps
+  gst_base_src_set_do_timestamp (bsrc, !src->hwTimestamp);
+
   return TRUE;
 
 error:
@@ -4065,6 +4705,140 @@ error:
   return;
 }
 
+// Detect lost frames from gaps in the stream block ID
+static void
+gst_pylonsrc_check_block_id (GstPylonSrc * src, guint64 blockId,
+    GstBuffer * buf)
+{
+  if (blockId == G_MAXUINT64) {
+    // block ID not supported by transport layer
+    return;
+  }
+
+  if (src->frameNumber > 0) {
+    guint64 distance;
+
+    // GigE Vision block IDs are 16 bit and skip 0 when wrapping, so they
+    // count modulo 65535 from 1
+    if (src->shortBlockIds) {
+      distance = (blockId + G_MAXUINT16 - src->lastBlockId) % G_MAXUINT16;
+      if (distance > G_MAXUINT16 / 2) {
+        distance = 0;
+      }
+    } else {
+      distance = blockId - src->lastBlockId;
+      if (distance > G_MAXUINT64 / 2) {
+        distance = 0;
+      }
+    }
+
+    if (distance > 1) {
+      const guint64 dropped = distance - 1;
+      gst_vision_stats_add_dropped (&src->stats, dropped);
+      GST_WARNING_OBJECT (src,
+          "Dropped %" G_GUINT64_FORMAT " frame(s)", dropped);
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    } else if (distance == 0) {
+      GST_WARNING_OBJECT (src, "Block ID non-monotonic (%" G_GUINT64_FORMAT
+          " after %" G_GUINT64_FORMAT ")", blockId, src->lastBlockId);
+    }
+  }
+  src->lastBlockId = blockId;
+}
+
+static _Bool
+read_chunk_value (GstPylonSrc * src, GST_PYLONSRC_CHUNK chunk,
+    int64_t * intValue, double *floatValue)
+{
+  NODE_HANDLE node = src->chunkNode[chunk];
+  _Bool readable = FALSE;
+
+  if (node == NULL || GenApiNodeIsReadable (node, &readable) != GENAPI_E_OK
+      || !readable) {
+    return FALSE;
+  }
+
+  if (src->chunkIsFloat[chunk]) {
+    if (GenApiFloatGetValue (node, floatValue) != GENAPI_E_OK) {
+      return FALSE;
+    }
+    *intValue = (int64_t) * floatValue;
+  } else {
+    if (GenApiIntegerGetValue (node, intValue) != GENAPI_E_OK) {
+      return FALSE;
+    }
+    *floatValue = (double) *intValue;
+  }
+  return TRUE;
+}
+
+static void
+gst_pylonsrc_add_chunk_meta (GstPylonSrc * src, GstBuffer * buf,
+    const PylonGrabResult_t * grabResult)
+{
+  GstPylonChunkMeta *meta;
+  GENAPIC_RESULT res;
+  int64_t intValue;
+  double floatValue;
+
+  meta = gst_buffer_add_pylon_chunk_meta (buf);
+  meta->block_id = grabResult->BlockID;
+
+  if (grabResult->PayloadType != PayloadType_ChunkData) {
+    return;
+  }
+
+  res =
+      PylonChunkParserAttachBuffer (src->chunkParser, grabResult->pBuffer,
+      (size_t) grabResult->PayloadSize);
+  if (res != GENAPI_E_OK) {
+    GST_WARNING_OBJECT (src, "Failed to parse chunk data");
+    return;
+  }
+
+  if (read_chunk_value (src, CHUNK_TIMESTAMP, &intValue, &floatValue)) {
+    meta->timestamp = (guint64) intValue;
+    meta->flags |= GST_PYLON_CHUNK_META_HAS_TIMESTAMP;
+  }
+  if (read_chunk_value (src, CHUNK_FRAMECOUNTER, &intValue, &floatValue)) {
+    meta->frame_counter = (guint64) intValue;
+    meta->flags |= GST_PYLON_CHUNK_META_HAS_FRAME_COUNTER;
+  }
+  if (read_chunk_value (src, CHUNK_EXPOSURETIME, &intValue, &floatValue)) {
+    meta->exposure_time = floatValue;
+    meta->flags |= GST_PYLON_CHUNK_META_HAS_EXPOSURE_TIME;
+  }
+  if (read_chunk_value (src, CHUNK_GAIN, &intValue, &floatValue)) {
+    meta->gain = floatValue;
+    meta->flags |= GST_PYLON_CHUNK_META_HAS_GAIN;
+  }
+  if (read_chunk_value (src, CHUNK_LINESTATUS, &intValue, &floatValue)) {
+    meta->line_status = (guint64) intValue;
+    meta->flags |= GST_PYLON_CHUNK_META_HAS_LINE_STATUS;
+  }
+
+  PylonChunkParserDetachBuffer (src->chunkParser);
+}
+
+// Size of the image in a grab result, without chunk data after it
+static gsize
+gst_pylonsrc_image_size (GstPylonSrc * src,
+    const PylonGrabResult_t * grabResult)
+{
+  gsize size = 0;
+
+  if (src->pixel_format != NULL && grabResult->SizeX > 0 &&
+      grabResult->SizeY > 0) {
+    size = (gsize) (gst_genicam_pixel_format_get_stride (src->pixel_format,
+            G_BYTE_ORDER, grabResult->SizeX) + grabResult->PaddingX) *
+        grabResult->SizeY;
+  }
+  if (size == 0 || size > (gsize) src->payloadSize) {
+    size = src->payloadSize;
+  }
+  return size;
+}
+
 static GstFlowReturn
 gst_pylonsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
 {
@@ -4072,6 +4846,8 @@ gst_pylonsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   GENAPIC_RESULT res;
   PylonGrabResult_t grabResult;
   _Bool bufferReady;
+  GstClock *clock;
+  GstClockTime captureTime = GST_CLOCK_TIME_NONE;
 
   if (!gst_pylonsrc_set_properties (src)) {
     // TODO: Maybe just shot warning if setting is not critical
@@ -4087,6 +4863,7 @@ gst_pylonsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
   res = PylonWaitObjectWait (src->waitObject, src->grabtimeout, &bufferReady);
   PYLONC_CHECK_ERROR (src, res);
   if (!bufferReady) {
+    gst_vision_stats_add_timeout (&src->stats);
     GST_ERROR_OBJECT (src,
         "Camera couldn't prepare the buffer in time. Probably dead.");
     goto error;
@@ -4102,28 +4879,15 @@ gst_pylonsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     goto error;
   }
 
-  if (!src->continuousMode) {
-    // Trigger the next picture while we process this one
-    if (PylonDeviceFeatureIsAvailable (src->deviceHandle, "AcquisitionStatus")) {
-      _Bool isReady = FALSE;
-      do {
-        res =
-            PylonDeviceGetBooleanFeature (src->deviceHandle,
-            "AcquisitionStatus", &isReady);
-        PYLONC_CHECK_ERROR (src, res);
-      } while (!isReady);
-    }
-    res =
-        PylonDeviceExecuteCommandFeature (src->deviceHandle, "TriggerSoftware");
-    PYLONC_CHECK_ERROR (src, res);
-  }
   // Process the current buffer
   if (grabResult.Status == Grabbed || src->failedFrames < src->frameDropLimit) {
     VideoFrame *vf = (VideoFrame *) g_malloc0 (sizeof (VideoFrame));
+    const gsize imageSize = gst_pylonsrc_image_size (src, &grabResult);
 
+    // The chunk trailer stays out of the buffer, it is parsed into meta
     *buf =
         gst_buffer_new_wrapped_full ((GstMemoryFlags) GST_MEMORY_FLAG_READONLY,
-        (gpointer) grabResult.pBuffer, src->payloadSize, 0, src->payloadSize,
+        (gpointer) grabResult.pBuffer, src->payloadSize, 0, imageSize,
         vf, (GDestroyNotify) video_frame_free);
 
     vf->buffer_handle = grabResult.hBuffer;
@@ -4143,11 +4907,55 @@ gst_pylonsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     goto error;
   }
 
+  if (src->chunkMetadata && src->chunkParser != NULL) {
+    gst_pylonsrc_add_chunk_meta (src, *buf, &grabResult);
+  }
+
+  if (src->hwTimestamp) {
+    clock = gst_element_get_clock (GST_ELEMENT (src));
+    if (clock != NULL) {
+      GstClockTime clock_time = gst_clock_get_time (clock);
+      gst_object_unref (clock);
+
+      // Fit over recent frames so retrieval jitter doesn't end up in PTS
+      if (grabResult.TimeStamp != 0) {
+        clock_time =
+            gst_vision_clock_mapper_add_sample (&src->clockMapper,
+            grabResult.TimeStamp, clock_time);
+        captureTime = clock_time;
+      }
+      // Frames exposed before the pipeline started running get no PTS
+      GST_BUFFER_TIMESTAMP (*buf) =
+          gst_vision_clock_mapper_running_time (GST_ELEMENT (src),
+          clock_time);
+    }
+  }
+
+  if (!src->continuousMode) {
+    // Match the frame to its trigger by when its exposure started
+    gst_pylonsrc_trigger_frame_done (src, captureTime);
+  }
+
+  gst_pylonsrc_check_block_id (src, grabResult.BlockID, *buf);
+
   // Set frame offset
   GST_BUFFER_OFFSET (*buf) = src->frameNumber;
   src->frameNumber += 1;
   GST_BUFFER_OFFSET_END (*buf) = src->frameNumber;
 
+  // Latency is only known when the frame carries a camera timestamp
+  clock = gst_element_get_clock (GST_ELEMENT (src));
+  if (clock != NULL) {
+    GstClockTime now = gst_clock_get_time (clock);
+    gst_object_unref (clock);
+
+    gst_vision_stats_add_delivered (&src->stats,
+        gst_vision_stats_latency (captureTime, now));
+    gst_vision_stats_post (&src->stats, GST_ELEMENT (src), now, NULL);
+  } else {
+    gst_vision_stats_add_delivered (&src->stats, GST_CLOCK_TIME_NONE);
+  }
+
   return GST_FLOW_OK;
 error:
   return GST_FLOW_ERROR;
@@ -4192,6 +5000,9 @@ gst_pylonsrc_finalize (GObject * object)
   g_free (src->userid);
   g_free (src->configFile);
 
+  g_mutex_clear (&src->triggerMutex);
+  gst_vision_stats_clear (&src->stats);
+
 
   if (gst_pylonsrc_unref_pylon_environment () == 0) {
     GST_DEBUG_OBJECT (src, "Last object finalized");
@@ -4204,7 +5015,14 @@ gst_pylonsrc_finalize (GObject * object)
 void
 pylonc_disconnect_camera (GstPylonSrc * src)
 {
+  gst_pylonsrc_stop_trigger_thread (src);
+
   if (src->deviceConnected) {
+    if (src->chunkParser != NULL) {
+      PylonDeviceDestroyChunkParser (src->deviceHandle, src->chunkParser);
+      src->chunkParser = NULL;
+    }
+
     if (strcmp (src->reset, "after") == 0) {
       pylonc_reset_camera (src);
     }
@@ -23,6 +23,8 @@
 
 #include <gst/base/gstpushsrc.h>
 #include "pylonc/PylonC.h"
+#include "common/visionclockmapper.h"
+#include "common/visionstats.h"
 
 // pylonsrc plugin calls PylonInitialize when first plugin is created
 // and PylonTerminate when the last plugin is finalized.
@@ -39,7 +41,8 @@ enum
   GST_PYLONSRC_NUM_CAPTURE_BUFFERS = 10,
   GST_PYLONSRC_NUM_AUTO_FEATURES = 3,
   GST_PYLONSRC_NUM_LIMITED_FEATURES = 2,
-  GST_PYLONSRC_NUM_PROPS = 74
+  GST_PYLONSRC_NUM_CHUNKS = 5,
+  GST_PYLONSRC_NUM_PROPS = 84
 };
 
 typedef enum _GST_PYLONSRC_PROPERTY_STATE
@@ -86,11 +89,36 @@ struct _GstPylonSrc
   guint64 frameNumber;          // Fun note: At 120fps it will take around 4 billion years to overflow this variable.
   gint failedFrames;            // Count of concecutive frames that have failed.
 
+  // Chunk data and hardware timestamps
+  PYLON_CHUNKPARSER_HANDLE chunkParser;
+  NODE_HANDLE chunkNode[GST_PYLONSRC_NUM_CHUNKS];
+  _Bool chunkIsFloat[GST_PYLONSRC_NUM_CHUNKS];
+  GstVisionClockMapper clockMapper;    // Camera ticks to pipeline clock.
+  guint64 lastBlockId;
+  _Bool shortBlockIds;          // 16 bit GigE Vision block IDs.
+
+  GstVisionStats stats;         // Acquisition statistics, see visionstats.h.
+
+  // Software trigger scheduling
+  GThread *triggerThread;
+  GMutex triggerMutex;
+  PYLON_WAITOBJECT_HANDLE triggerWake;  // Signalled when the trigger state changes.
+  PYLON_WAITOBJECTS_HANDLE triggerWaitObjects;  // triggerWake and the event grabber.
+  PYLON_EVENTGRABBER_HANDLE eventGrabber;       // ExposureEnd events, NULL if unsupported.
+  _Bool triggerStop, triggerReady;
+  gint64 triggerTimes[GST_PYLONSRC_NUM_CAPTURE_BUFFERS];  // Monotonic time of each trigger in flight.
+  GstClockTime triggerClockTimes[GST_PYLONSRC_NUM_CAPTURE_BUFFERS];     // Pipeline clock time of each trigger in flight.
+  guint triggerHead, triggerCount;
+  guint64 lostTriggers;
+  guint64 triggerLatencyCount;
+  GstClockTime triggerLatencySum, triggerLatencyMax;
+
   // Plugin parameters
   _Bool setFPS, continuousMode, limitBandwidth, demosaicing, colorAdjustment;
   _Bool center[2];
   _Bool flip[2];
   _Bool ignoreDefaults;
+  _Bool hwTimestamp, chunkMetadata;
   double fps, blacklevel, gamma, sharpnessenhancement, noisereduction,
       brightnesstarget;
   double balance[3];
@@ -100,6 +128,8 @@ struct _GstPylonSrc
 
   GstPylonSrcLimitedFeature limitedFeature[GST_PYLONSRC_NUM_LIMITED_FEATURES];
 
+  double triggerRate;
+  gint triggersInFlight;
   gint maxBandwidth, testImage, frameDropLimit, grabtimeout, packetSize,
       interPacketDelay, frameTransDelay, bandwidthReserve, bandwidthReserveAcc;
   gint size[2];
@@ -57,10 +57,12 @@ static gboolean gst_qcamsrc_start (GstBaseSrc * src);
 static gboolean gst_qcamsrc_stop (GstBaseSrc * src);
 static GstCaps *gst_qcamsrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_qcamsrc_set_caps (GstBaseSrc * src, GstCaps * caps);
-static gboolean gst_qcamsrc_unlock (GstBaseSrc * src);
-static gboolean gst_qcamsrc_unlock_stop (GstBaseSrc * src);
 
-static GstFlowReturn gst_qcamsrc_create (GstPushSrc * src, GstBuffer ** buf);
+static void gst_qcamsrc_update_timeout (GstQcamSrc * src);
+static void gst_qcamsrc_release_frame (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame);
+static GstFlowReturn gst_qcamsrc_prepare_buffer (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame, GstBuffer * buf);
 
 static void gst_qcamsrc_frame_callback (void *userPtr, unsigned long userData,
     QCam_Err errcode, unsigned long flags);
@@ -79,7 +81,8 @@ enum
   PROP_Y,
   PROP_WIDTH,
   PROP_HEIGHT,
-  PROP_BINNING
+  PROP_BINNING,
+  PROP_DROPPED_FRAMES
 };
 
 #define DEFAULT_PROP_DEVICE_INDEX 0
@@ -95,6 +98,9 @@ enum
 #define DEFAULT_PROP_HEIGHT 0
 #define DEFAULT_PROP_BINNING 1
 
+/* frame buffers are page aligned for the camera's DMA */
+#define GST_QCAMSRC_FRAME_ALIGN 4096
+
 /* pad templates */
 static GstStaticPadTemplate gst_qcamsrc_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
@@ -106,7 +112,7 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstQcamSrc, gst_qcamsrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstQcamSrc, gst_qcamsrc, GST_TYPE_VISION_GRABBER_SRC);
 
 static int g_qcam_use_count = 0;
 
@@ -134,7 +140,8 @@ gst_qcamsrc_class_init (GstQcamSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "qcamsrc", 0,
       "QImaging QCam source");
@@ -155,10 +162,10 @@ gst_qcamsrc_class_init (GstQcamSrcClass * klass)
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_qcamsrc_stop);
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_qcamsrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_qcamsrc_set_caps);
-  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_qcamsrc_unlock);
-  gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_qcamsrc_unlock_stop);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_qcamsrc_create);
+  grabber_class->release_frame = GST_DEBUG_FUNCPTR (gst_qcamsrc_release_frame);
+  grabber_class->prepare_buffer =
+      GST_DEBUG_FUNCPTR (gst_qcamsrc_prepare_buffer);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_DEVICE_INDEX,
@@ -212,6 +219,27 @@ gst_qcamsrc_class_init (GstQcamSrcClass * klass)
       g_param_spec_int ("binning", "Binning", "Symmetrical binning", 1, 8,
           DEFAULT_PROP_BINNING,
           (GParamFlags) (G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE)));
+  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_DROPPED_FRAMES,
+      g_param_spec_uint64 ("dropped-frames", "Dropped frames",
+          "Number of frames lost before reaching the host; deprecated, use "
+          "frames-dropped of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+}
+
+/* capture frames of one stream, freed once downstream released them all */
+typedef struct
+{
+  GstQcamSrcFrame *frames;
+  guint8 *frame_memory;
+} GstQcamSrcFrameBlock;
+
+static void
+gst_qcamsrc_free_frame_block (GstQcamSrcFrameBlock * block)
+{
+  g_free (block->frames);
+  g_free (block->frame_memory);
+  g_slice_free (GstQcamSrcFrameBlock, block);
 }
 
 static void
@@ -229,19 +257,23 @@ gst_qcamsrc_reset (GstQcamSrc * src)
   src->height = DEFAULT_PROP_HEIGHT;
   src->binning = DEFAULT_PROP_BINNING;
 
-  src->last_frame_count = 0;
-  src->total_dropped_frames = 0;
-
   if (src->caps) {
     gst_caps_unref (src->caps);
     src->caps = NULL;
   }
 
-  if (src->queue) {
-    // TODO: remove dangling buffers
-    g_async_queue_unref (src->queue);
+  if (src->frames) {
+    GstQcamSrcFrameBlock *block = g_slice_new (GstQcamSrcFrameBlock);
+
+    /* buffers downstream may still wrap the frame memory */
+    block->frames = src->frames;
+    block->frame_memory = src->frame_memory;
+    gst_vision_grabber_src_free_when_released (GST_VISION_GRABBER_SRC (src),
+        (GDestroyNotify) gst_qcamsrc_free_frame_block, block);
   }
-  src->queue = g_async_queue_new ();
+  src->frames = NULL;
+  src->num_frames = 0;
+  src->frame_memory = NULL;
 }
 
 static void
@@ -251,20 +283,16 @@ gst_qcamsrc_init (GstQcamSrc * src)
 
   gst_qcamsrc_driver_ref ();
 
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
-
   /* initialize member variables */
   src->device_index = DEFAULT_PROP_DEVICE_INDEX;
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
   src->timeout = DEFAULT_PROP_TIMEOUT;
 
-  src->stop_requested = FALSE;
   src->caps = NULL;
-  src->queue = NULL;
+  src->frames = NULL;
+  src->frame_memory = NULL;
+
+  g_mutex_init (&src->mutex);
 
   gst_qcamsrc_reset (src);
 }
@@ -307,6 +335,7 @@ gst_qcamsrc_set_property (GObject * object, guint property_id,
       break;
     case PROP_TIMEOUT:
       src->timeout = g_value_get_int (value);
+      gst_qcamsrc_update_timeout (src);
       break;
     case PROP_EXPOSURE:
       src->exposure = g_value_get_uint (value);
@@ -390,6 +419,14 @@ gst_qcamsrc_get_property (GObject * object, guint property_id,
     case PROP_BINNING:
       g_value_set_int (value, src->binning);
       break;
+    case PROP_DROPPED_FRAMES:
+    {
+      GstVisionStats *stats = &GST_VISION_GRABBER_SRC (src)->stats;
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_dropped);
+      g_mutex_unlock (&stats->lock);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -424,20 +461,15 @@ gst_qcamsrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
+  g_mutex_clear (&src->mutex);
+
   gst_qcamsrc_driver_unref ();
 
   G_OBJECT_CLASS (gst_qcamsrc_parent_class)->finalize (object);
 }
 
-typedef struct
-{
-  GstQcamSrc *src;
-  QCam_Frame frame;
-  GstClockTime clock_time;
-} VideoFrame;
-
 static void
-video_frame_queue (VideoFrame * frame)
+video_frame_queue (GstQcamSrcFrame * frame)
 {
   QCam_Err err;
   g_assert (frame->src->handle);
@@ -447,32 +479,67 @@ video_frame_queue (VideoFrame * frame)
       &frame->frame,
       gst_qcamsrc_frame_callback,
       qcCallbackDone | qcCallbackExposeDone, frame, 0);
+  if (err != qerrSuccess) {
+    GST_WARNING_OBJECT (frame->src, "Failed to queue frame (errcode=%d)", err);
+  }
 }
 
 static void
-video_frame_release (void *data)
+gst_qcamsrc_release_frame (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * grabber_frame)
 {
-  VideoFrame *frame = (VideoFrame *) data;
-  if (!frame->src->stop_requested && frame->src->handle) {
+  GstQcamSrc *src = GST_QCAM_SRC (grabber);
+  GstQcamSrcFrame *frame = (GstQcamSrcFrame *) grabber_frame->user_data;
+
+  /* requeue even while flushing, or the camera runs out of frames, but not
+   * frames of a previous stream */
+  g_mutex_lock (&src->mutex);
+  if (src->handle && frame >= src->frames &&
+      frame < src->frames + src->num_frames) {
     video_frame_queue (frame);
   }
+  g_mutex_unlock (&src->mutex);
 }
 
-static VideoFrame *
-video_frame_create (GstQcamSrc * src, gsize buf_size)
+/* a frame can't arrive before its exposure is over, so that is added */
+static void
+gst_qcamsrc_update_timeout (GstQcamSrc * src)
 {
-  VideoFrame *frame = g_new (VideoFrame, 1);
-  frame->frame.pBuffer = g_malloc (buf_size);
+  GST_VISION_GRABBER_SRC (src)->timeout =
+      (GstClockTime) src->timeout * GST_MSECOND +
+      (GstClockTime) src->exposure * GST_USECOND;
+}
 
-  if (!frame->frame.pBuffer) {
-    GST_ERROR_OBJECT (src, "Failed to allocate buffer of size %d", buf_size);
-    g_free (frame);
-    return NULL;
+/* allocate all capture frames from one page aligned block, so they can be
+ * handed to the camera and wrapped downstream without copying */
+static gboolean
+gst_qcamsrc_alloc_frames (GstQcamSrc * src, gsize buf_size)
+{
+  gsize stride = GST_ROUND_UP_N (buf_size, GST_QCAMSRC_FRAME_ALIGN);
+  guint8 *aligned;
+  guint i;
+
+  src->frame_memory = (guint8 *) g_try_malloc (stride * src->num_capture_buffers
+      + GST_QCAMSRC_FRAME_ALIGN - 1);
+  if (!src->frame_memory) {
+    GST_ERROR_OBJECT (src, "Failed to allocate %d buffers of size %"
+        G_GSIZE_FORMAT, src->num_capture_buffers, buf_size);
+    return FALSE;
+  }
+  aligned = (guint8 *) GST_ROUND_UP_N ((guintptr) src->frame_memory,
+      GST_QCAMSRC_FRAME_ALIGN);
+
+  src->frames = g_new0 (GstQcamSrcFrame, src->num_capture_buffers);
+  src->num_frames = src->num_capture_buffers;
+  for (i = 0; i < src->num_frames; ++i) {
+    GstQcamSrcFrame *frame = &src->frames[i];
+    frame->src = src;
+    frame->frame.pBuffer = aligned + i * stride;
+    frame->frame.bufferSize = buf_size;
+    frame->clock_time = GST_CLOCK_TIME_NONE;
   }
-  frame->src = src;
-  frame->frame.bufferSize = buf_size;
 
-  return frame;
+  return TRUE;
 }
 
 
@@ -554,11 +621,19 @@ gst_qcamsrc_setup_stream (GstQcamSrc * src)
       "ROI configured with width,height,format,exposure,gain,offset=%d,%d,%d,%d,%d,%d,%d",
       width, height, imageFormat, exposure, gain, offset);
 
-  for (int i = 0; i < src->num_capture_buffers; ++i) {
+  {
     unsigned long buf_size;
     QCam_GetInfo (src->handle, qinfImageSize, &buf_size);
-    VideoFrame *frame = video_frame_create (src, buf_size);
-    video_frame_queue (frame);
+    if (!gst_qcamsrc_alloc_frames (src, buf_size)) {
+      GST_ELEMENT_ERROR (src, RESOURCE, NO_SPACE_LEFT,
+          ("Failed to allocate capture buffers"), (NULL));
+      QCam_CloseCamera (src->handle);
+      src->handle = NULL;
+      return FALSE;
+    }
+    for (guint i = 0; i < src->num_frames; ++i) {
+      video_frame_queue (&src->frames[i]);
+    }
   }
 
   {
@@ -595,6 +670,12 @@ gst_qcamsrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  /* the ring must exist before the camera calls back */
+  if (!GST_BASE_SRC_CLASS (gst_qcamsrc_parent_class)->start (bsrc))
+    goto error;
+
+  gst_qcamsrc_update_timeout (src);
+
   if (!gst_qcamsrc_setup_stream (src)) {
     /* error already sent */
     goto error;
@@ -612,10 +693,16 @@ gst_qcamsrc_stop (GstBaseSrc * bsrc)
   GstQcamSrc *src = GST_QCAM_SRC (bsrc);
   GST_DEBUG_OBJECT (src, "stop");
 
+  g_mutex_lock (&src->mutex);
   if (src->handle) {
     QCam_CloseCamera (src->handle);
     src->handle = NULL;
   }
+  g_mutex_unlock (&src->mutex);
+
+  /* discards queued frames, frame memory downstream still holds is freed
+   * when the last buffer is released */
+  GST_BASE_SRC_CLASS (gst_qcamsrc_parent_class)->stop (bsrc);
 
   gst_qcamsrc_reset (src);
 
@@ -658,78 +745,18 @@ gst_qcamsrc_set_caps (GstBaseSrc * bsrc, GstCaps * caps)
   return TRUE;
 }
 
-static gboolean
-gst_qcamsrc_unlock (GstBaseSrc * bsrc)
-{
-  GstQcamSrc *src = GST_QCAM_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock");
-
-  src->stop_requested = TRUE;
-
-  return TRUE;
-}
-
-static gboolean
-gst_qcamsrc_unlock_stop (GstBaseSrc * bsrc)
-{
-  GstQcamSrc *src = GST_QCAM_SRC (bsrc);
-
-  GST_LOG_OBJECT (src, "unlock_stop");
-
-  src->stop_requested = FALSE;
-
-  return TRUE;
-}
-
 static GstFlowReturn
-gst_qcamsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
+gst_qcamsrc_prepare_buffer (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * grabber_frame, GstBuffer * buf)
 {
-  GstQcamSrc *src = GST_QCAM_SRC (psrc);
-  VideoFrame *video_frame;
-  GST_LOG_OBJECT (src, "create");
-
-  video_frame =
-      (VideoFrame *) g_async_queue_timeout_pop (src->queue,
-      (guint64) src->timeout * 1000 + src->exposure);
-  if (!video_frame) {
-    if (!src->stop_requested) {
-      GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
-          ("Failed to get buffer in %d ms", src->timeout), (NULL));
-      return GST_FLOW_ERROR;
-    } else {
-      return GST_FLOW_FLUSHING;
-    }
-  }
-
-  *buf = gst_buffer_new_wrapped_full ((GstMemoryFlags)
-      GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS,
-      (gpointer) video_frame->frame.pBuffer, video_frame->frame.bufferSize, 0,
-      video_frame->frame.bufferSize, video_frame,
-      (GDestroyNotify) video_frame_release);
-
-
-  /* check for dropped frames and disrupted signal */
-  //dropped_frames = (circ_handle.FrameCount - src->last_frame_count) - 1;
-  //if (dropped_frames > 0) {
-  //  src->total_dropped_frames += dropped_frames;
-  //  GST_WARNING_OBJECT (src, "Dropped %d frames (%d total)", dropped_frames,
-  //      src->total_dropped_frames);
-  //} else if (dropped_frames < 0) {
-  //  GST_WARNING_OBJECT (src, "Frame count non-monotonic, signal disrupted?");
-  //}
-  //src->last_frame_count = circ_handle.FrameCount;
-
-  GST_BUFFER_TIMESTAMP (*buf) =
-      GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-      video_frame->clock_time);
-
-  if (src->stop_requested) {
-    if (*buf != NULL) {
-      gst_buffer_unref (*buf);
-      *buf = NULL;
-    }
-    return GST_FLOW_FLUSHING;
+  GstQcamSrc *src = GST_QCAM_SRC (grabber);
+  GstQcamSrcFrame *frame = (GstQcamSrcFrame *) grabber_frame->user_data;
+  GstClockTime half_exposure;
+
+  /* the clock was sampled when exposure ended, center PTS on the exposure */
+  half_exposure = (GstClockTime) frame->exposure * GST_USECOND / 2;
+  if (GST_BUFFER_PTS_IS_VALID (buf) && GST_BUFFER_PTS (buf) >= half_exposure) {
+    GST_BUFFER_PTS (buf) -= half_exposure;
   }
 
   if (src->handle && src->send_settings) {
@@ -738,6 +765,7 @@ gst_qcamsrc_create (GstPushSrc * psrc, GstBuffer ** buf)
     gst_qcamsrc_set_offset (src, src->offset);
     QCam_QueueSettings (src->handle, &src->qsettings, NULL, 0, 0, 0);
     src->send_settings = FALSE;
+    gst_qcamsrc_update_timeout (src);
   }
 
   return GST_FLOW_OK;
@@ -747,21 +775,38 @@ void
 gst_qcamsrc_frame_callback (void *userPtr, unsigned long userData,
     QCam_Err errcode, unsigned long flags)
 {
-  VideoFrame *frame = (VideoFrame *) (userPtr);
+  GstQcamSrcFrame *frame = (GstQcamSrcFrame *) (userPtr);
 
   if (flags & qcCallbackExposeDone) {
-    GstClock *clock = gst_element_get_clock (GST_ELEMENT (frame->src));
-    frame->clock_time = gst_clock_get_time (clock);
-    gst_object_unref (clock);
+    frame->clock_time =
+        gst_vision_grabber_src_get_clock_time (GST_VISION_GRABBER_SRC
+        (frame->src));
+    frame->exposure = frame->src->exposure;
     GST_TRACE_OBJECT (frame->src, "ExposeDone callback for frame 0x%x", frame);
   } else if (flags & qcCallbackDone) {
+    GstVisionGrabberFrame grabber_frame;
+
     GST_TRACE_OBJECT (frame->src, "FrameDone callback for frame 0x%x", frame);
 
+    gst_vision_grabber_frame_init (&grabber_frame);
+    grabber_frame.data = frame->frame.pBuffer;
+    grabber_frame.size = frame->frame.bufferSize;
+    grabber_frame.clock_time = frame->clock_time;
+    grabber_frame.frame_number = frame->frame.frameNumber;
+    grabber_frame.user_data = frame;
+
+    /* the frame's contents can't be trusted, it goes straight back to the
+     * camera */
     if (errcode != qerrSuccess) {
-      GST_WARNING_OBJECT (frame->src, "Error code in callback: %d", errcode);
+      GST_WARNING_OBJECT (frame->src, "Error code in callback: %d, dropping "
+          "frame", errcode);
+      gst_vision_grabber_src_drop_frame (GST_VISION_GRABBER_SRC (frame->src),
+          &grabber_frame);
+      return;
     }
 
-    g_async_queue_push (frame->src->queue, frame);
+    gst_vision_grabber_src_push_frame (GST_VISION_GRABBER_SRC (frame->src),
+        &grabber_frame);
   } else {
     g_assert_not_reached ();
   }
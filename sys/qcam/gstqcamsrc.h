@@ -20,10 +20,10 @@
 #ifndef _GST_QCAM_SRC_H_
 #define _GST_QCAM_SRC_H_
 
-#include <gst/base/gstpushsrc.h>
-
 #include <QCamApi.h>
 
+#include "gstvisiongrabbersrc.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_QCAM_SRC   (gst_qcamsrc_get_type())
@@ -35,9 +35,18 @@ G_BEGIN_DECLS
 typedef struct _GstQcamSrc GstQcamSrc;
 typedef struct _GstQcamSrcClass GstQcamSrcClass;
 
+/* a queued QCam frame and the time its exposure ended */
+typedef struct
+{
+  GstQcamSrc *src;
+  QCam_Frame frame;
+  GstClockTime clock_time;
+  guint exposure;
+} GstQcamSrcFrame;
+
 struct _GstQcamSrc
 {
-  GstPushSrc base_qcamsrc;
+  GstVisionGrabberSrc base_qcamsrc;
 
   /* camera handle */
   QCam_Handle handle;
@@ -58,20 +67,20 @@ struct _GstQcamSrc
   gint height;
   gint binning;
 
-  GAsyncQueue *queue;
-  GstClockTime base_time;
+  /* capture frames, all backed by one aligned allocation */
+  GstQcamSrcFrame *frames;
+  guint num_frames;
+  guint8 *frame_memory;
 
-  guint32 last_frame_count;
-  guint32 total_dropped_frames;
+  /* held while requeuing frames so the camera isn't closed meanwhile */
+  GMutex mutex;
 
   GstCaps *caps;
-
-  gboolean stop_requested;
 };
 
 struct _GstQcamSrcClass
 {
-  GstPushSrcClass base_qcamsrc_class;
+  GstVisionGrabberSrcClass base_qcamsrc_class;
 };
 
 GType gst_qcamsrc_get_type (void);
@@ -36,6 +36,11 @@
 
 #include <gst/video/video.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #include "aq2_prm_user.h"
 #include "corhw_prm_user.h"
 
@@ -47,6 +52,32 @@ GST_DEBUG_CATEGORY_STATIC (gst_saperasrc_debug);
 gboolean gst_saperasrc_create_objects (GstSaperaSrc * src);
 gboolean gst_saperasrc_destroy_objects (GstSaperaSrc * src);
 
+/* Extract one 10-bit channel from n packed 10-10-10 pixels */
+static void
+gst_saperasrc_extract_channel (guint16 * dst, const guint32 * packed, gint n,
+    guint shift)
+{
+  gint i = 0;
+
+#ifdef HAVE_SSE2
+  const __m128i mask = _mm_set1_epi32 (0x3ff);
+  const __m128i count = _mm_cvtsi32_si128 (shift);
+
+  /* 8 pixels at a time, values fit in 10 bits so signed packing is exact */
+  for (; i + 8 <= n; i += 8) {
+    __m128i lo = _mm_loadu_si128 ((const __m128i *) (packed + i));
+    __m128i hi = _mm_loadu_si128 ((const __m128i *) (packed + i + 4));
+    lo = _mm_and_si128 (_mm_srl_epi32 (lo, count), mask);
+    hi = _mm_and_si128 (_mm_srl_epi32 (hi, count), mask);
+    _mm_storeu_si128 ((__m128i *) (dst + i), _mm_packs_epi32 (lo, hi));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    dst[i] = (packed[i] >> shift) & 0x3ff;
+  }
+}
+
 class SapMyProcessing:public SapProcessing
 {
 public:
@@ -77,85 +108,26 @@ protected:
 
   gboolean push_buffer ()
   {
+    GstVisionGrabberFrame frame;
     void *pData;
-    GstMapInfo minfo;
+    int index = GetIndex ();
 
     // TODO: check for failure
-    src->sap_buffers->GetAddress (&pData);
-    int pitch = src->sap_buffers->GetPitch ();
-    int height = src->sap_buffers->GetHeight ();
-    gssize size = pitch * height;
-
-    GstBuffer *buf;
-    /* create a new buffer assign to it the clock time as timestamp */
-    buf = gst_buffer_new_and_alloc (size);
-
-    gst_buffer_set_size (buf, size);
+    src->sap_buffers->GetAddress (index, &pData);
 
-    GstClock *clock = gst_element_get_clock (GST_ELEMENT (src));
-    GST_BUFFER_TIMESTAMP (buf) =
-        GST_CLOCK_DIFF (gst_element_get_base_time (GST_ELEMENT (src)),
-        gst_clock_get_time (clock));
-    gst_object_unref (clock);
+    /* the buffer stays full, so the transfer skips it, until the frame is
+     * copied or dropped and release_frame empties it */
+    gst_vision_grabber_frame_init (&frame);
+    frame.data = pData;
+    frame.size = (gsize) src->sap_buffers->GetPitch () * src->height;
+    frame.clock_time =
+        gst_vision_grabber_src_get_clock_time (GST_VISION_GRABBER_SRC (src));
+    frame.user_data = GINT_TO_POINTER (index);
 
-    // TODO: define duration?
-    //GST_BUFFER_DURATION (buf) = duration;
+    GST_LOG_OBJECT (src, "Pushing buffer index %d", index);
 
-    if (!gst_buffer_map (buf, &minfo, GST_MAP_WRITE)) {
-      gst_buffer_unref (buf);
-      GST_ERROR_OBJECT (src, "Failed to map buffer");
-      return FALSE;
-    }
-    // TODO: optimize this
-    if (src->channel_extract == 0) {
-      if (pitch == src->gst_stride) {
-        memcpy (minfo.data, pData, size);
-      } else {
-        for (int line = 0; line < src->height; line++) {
-          memcpy (minfo.data + (line * src->gst_stride),
-              (guint8 *) pData + (line * pitch), pitch);
-        }
-      }
-    } else {
-      guint32 mask = 0x0, shift = 0;
-      if (src->channel_extract == 1) {
-        mask = 0x3ff00000;
-        shift = 20;
-      } else if (src->channel_extract == 2) {
-        mask = 0xffc00;
-        shift = 10;
-      } else if (src->channel_extract == 3) {
-        mask = 0x3ff;
-        shift = 0;
-      } else
-        g_assert_not_reached ();
-
-      guint32 *packed = (guint32 *) pData;
-      guint16 *dst = (guint16 *) minfo.data;
-      for (int r = 0; r < src->height; ++r) {
-        for (int c = 0; c < src->width; ++c) {
-          *dst = (*packed & mask) >> shift;
-          ++dst;
-          ++packed;
-        }
-      }
-    }
-
-    src->sap_buffers->ReleaseAddress (pData);
-
-    gst_buffer_unmap (buf, &minfo);
-
-    GST_DEBUG ("push_buffer => pts %" GST_TIME_FORMAT,
-        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
-
-    g_mutex_lock (&src->buffer_mutex);
-    if (src->buffer != NULL)
-      gst_buffer_unref (src->buffer);
-    src->buffer = buf;
-    g_cond_signal (&src->buffer_cond);
-    g_mutex_unlock (&src->buffer_mutex);
-
-    return TRUE;
+    return gst_vision_grabber_src_push_frame (GST_VISION_GRABBER_SRC (src),
+        &frame);
   }
 
 protected:
@@ -168,7 +140,9 @@ gst_saperasrc_xfer_callback (SapXferCallbackInfo * pInfo)
   GstSaperaSrc *src = (GstSaperaSrc *) pInfo->GetContext ();
 
   if (pInfo->IsTrash ()) {
-    /* TODO: update dropped buffer count */
+    /* processing didn't keep up, the frame went to the trash buffer */
+    gst_vision_stats_add_dropped (&GST_VISION_GRABBER_SRC (src)->stats, 1);
+    GST_DEBUG_OBJECT (src, "Frame acquired into trash buffer, dropped");
   } else {
     /* Process current buffer */
     src->sap_pro->Execute ();
@@ -304,8 +278,8 @@ gst_saperasrc_init_objects (GstSaperaSrc * src)
 
   SapLocation loc (src->server_index, src->resource_index);
   src->sap_acq = new SapAcquisition (loc, src->format_file);
-  /* TODO: allow configuring buffer count? */
-  src->sap_buffers = new SapBufferWithTrash (3, src->sap_acq);
+  src->sap_buffers =
+      new SapBufferWithTrash (src->num_capture_buffers, src->sap_acq);
   src->sap_xfer =
       new SapAcqToBuf (src->sap_acq, src->sap_buffers,
       gst_saperasrc_xfer_callback, src);
@@ -385,7 +359,8 @@ gst_saperasrc_create_objects (GstSaperaSrc * src)
       return FALSE;
     }
 
-    src->sap_pro->SetAutoEmpty (TRUE);
+    /* buffers are emptied by release_frame once the frame is copied */
+    src->sap_pro->SetAutoEmpty (FALSE);
   }
 
   return TRUE;
@@ -425,7 +400,10 @@ static gboolean gst_saperasrc_stop (GstBaseSrc * src);
 static GstCaps *gst_saperasrc_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_saperasrc_set_caps (GstBaseSrc * src, GstCaps * caps);
 
-static GstFlowReturn gst_saperasrc_create (GstPushSrc * src, GstBuffer ** buf);
+static void gst_saperasrc_release_frame (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame);
+static GstFlowReturn gst_saperasrc_fill (GstVisionGrabberSrc * src,
+    GstVisionGrabberFrame * frame, GstBuffer ** buf);
 
 static GstCaps *gst_saperasrc_create_caps (GstSaperaSrc * src);
 
@@ -436,11 +414,13 @@ enum
   PROP_NUM_CAPTURE_BUFFERS,
   PROP_SERVER_INDEX,
   PROP_RESOURCE_INDEX,
-  PROP_CHANNEL_EXTRACT
+  PROP_CHANNEL_EXTRACT,
+  PROP_TRASH_FRAMES,
+  PROP_OVERWRITTEN_FRAMES
 };
 
 #define DEFAULT_PROP_FORMAT_FILE ""
-#define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 2
+#define DEFAULT_PROP_NUM_CAPTURE_BUFFERS 3
 #define DEFAULT_PROP_SERVER_INDEX 1
 #define DEFAULT_PROP_RESOURCE_INDEX 0
 #define DEFAULT_PROP_CHANNEL_EXTRACT 0
@@ -457,7 +437,7 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 /* class initialization */
 
-G_DEFINE_TYPE (GstSaperaSrc, gst_saperasrc, GST_TYPE_PUSH_SRC);
+G_DEFINE_TYPE (GstSaperaSrc, gst_saperasrc, GST_TYPE_VISION_GRABBER_SRC);
 
 static void
 gst_saperasrc_class_init (GstSaperaSrcClass * klass)
@@ -465,7 +445,8 @@ gst_saperasrc_class_init (GstSaperaSrcClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
   GstBaseSrcClass *gstbasesrc_class = GST_BASE_SRC_CLASS (klass);
-  GstPushSrcClass *gstpushsrc_class = GST_PUSH_SRC_CLASS (klass);
+  GstVisionGrabberSrcClass *grabber_class =
+      GST_VISION_GRABBER_SRC_CLASS (klass);
 
   gobject_class->set_property = gst_saperasrc_set_property;
   gobject_class->get_property = gst_saperasrc_get_property;
@@ -485,7 +466,9 @@ gst_saperasrc_class_init (GstSaperaSrcClass * klass)
   gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_saperasrc_get_caps);
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR (gst_saperasrc_set_caps);
 
-  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_saperasrc_create);
+  grabber_class->release_frame =
+      GST_DEBUG_FUNCPTR (gst_saperasrc_release_frame);
+  grabber_class->fill = GST_DEBUG_FUNCPTR (gst_saperasrc_fill);
 
   /* Install GObject properties */
   g_object_class_install_property (gobject_class, PROP_FORMAT_FILE,
@@ -496,8 +479,8 @@ gst_saperasrc_class_init (GstSaperaSrcClass * klass)
               GST_PARAM_MUTABLE_READY)));
   g_object_class_install_property (gobject_class, PROP_NUM_CAPTURE_BUFFERS,
       g_param_spec_uint ("num-capture-buffers", "Number of capture buffers",
-          "Number of capture buffers", 1, G_MAXUINT,
-          DEFAULT_PROP_NUM_CAPTURE_BUFFERS,
+          "Number of capture buffers, in addition to the trash buffer", 1,
+          G_MAXUINT, DEFAULT_PROP_NUM_CAPTURE_BUFFERS,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
   g_object_class_install_property (gobject_class, PROP_SERVER_INDEX,
       g_param_spec_int ("server-index", "Server index",
@@ -513,12 +496,25 @@ gst_saperasrc_class_init (GstSaperaSrcClass * klass)
       g_param_spec_int ("color-channel", "Color channel", "Color channel", 0, 3,
           DEFAULT_PROP_CHANNEL_EXTRACT,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_TRASH_FRAMES,
+      g_param_spec_uint64 ("trash-frames", "Trash frames",
+          "Number of frames acquired into the trash buffer because all "
+          "capture buffers were busy, counted as lost before reaching the "
+          "host; deprecated, use frames-dropped of the stats property",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_OVERWRITTEN_FRAMES,
+      g_param_spec_uint64 ("overwritten-frames", "Overwritten frames",
+          "Number of frames dropped because the queue was full; deprecated, "
+          "use frames-overwritten of the stats property", 0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_DEPRECATED |
+              G_PARAM_STATIC_STRINGS)));
 }
 
 static void
 gst_saperasrc_reset (GstSaperaSrc * src)
 {
-  src->dropped_frame_count = 0;
   src->last_buffer_number = 0;
   src->acq_started = FALSE;
 
@@ -526,10 +522,6 @@ gst_saperasrc_reset (GstSaperaSrc * src)
     gst_caps_unref (src->caps);
     src->caps = NULL;
   }
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
 
   gst_saperasrc_destroy_objects (src);
 
@@ -558,21 +550,11 @@ gst_saperasrc_reset (GstSaperaSrc * src)
 static void
 gst_saperasrc_init (GstSaperaSrc * src)
 {
-  /* set source as live (no preroll) */
-  gst_base_src_set_live (GST_BASE_SRC (src), TRUE);
-
-  /* override default of BYTES to operate in time mode */
-  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_TIME);
-
   /* initialize member variables */
   src->format_file = g_strdup (DEFAULT_PROP_FORMAT_FILE);
   src->num_capture_buffers = DEFAULT_PROP_NUM_CAPTURE_BUFFERS;
 
-  g_mutex_init (&src->buffer_mutex);
-  g_cond_init (&src->buffer_cond);
-
   src->caps = NULL;
-  src->buffer = NULL;
 
   src->sap_acq = NULL;
   src->sap_buffers = NULL;
@@ -625,9 +607,11 @@ gst_saperasrc_get_property (GObject * object, guint property_id,
     GValue * value, GParamSpec * pspec)
 {
   GstSaperaSrc *src;
+  GstVisionStats *stats;
 
   g_return_if_fail (GST_IS_SAPERA_SRC (object));
   src = GST_SAPERA_SRC (object);
+  stats = &GST_VISION_GRABBER_SRC (src)->stats;
 
   switch (property_id) {
     case PROP_FORMAT_FILE:
@@ -645,6 +629,16 @@ gst_saperasrc_get_property (GObject * object, guint property_id,
     case PROP_CHANNEL_EXTRACT:
       g_value_set_int (value, src->channel_extract);
       break;
+    case PROP_TRASH_FRAMES:
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_dropped);
+      g_mutex_unlock (&stats->lock);
+      break;
+    case PROP_OVERWRITTEN_FRAMES:
+      g_mutex_lock (&stats->lock);
+      g_value_set_uint64 (value, stats->frames_overwritten);
+      g_mutex_unlock (&stats->lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -675,11 +669,6 @@ gst_saperasrc_finalize (GObject * object)
     src->caps = NULL;
   }
 
-  if (src->buffer) {
-    gst_buffer_unref (src->buffer);
-    src->buffer = NULL;
-  }
-
   G_OBJECT_CLASS (gst_saperasrc_parent_class)->finalize (object);
 }
 
@@ -693,6 +682,9 @@ gst_saperasrc_start (GstBaseSrc * bsrc)
 
   GST_DEBUG_OBJECT (src, "start");
 
+  if (!GST_BASE_SRC_CLASS (gst_saperasrc_parent_class)->start (bsrc))
+    return FALSE;
+
   if (!strlen (src->format_file)) {
     GST_ELEMENT_ERROR (src, RESOURCE, FAILED,
         ("Configuration file has not been specified"), (NULL));
@@ -777,6 +769,12 @@ gst_saperasrc_stop (GstBaseSrc * bsrc)
     return FALSE;
   }
 
+  /* stop the processing thread, then return the frames it queued while the
+   * buffers still exist */
+  if (src->sap_pro && *src->sap_pro)
+    src->sap_pro->Destroy ();
+  GST_BASE_SRC_CLASS (gst_saperasrc_parent_class)->stop (bsrc);
+
   gst_saperasrc_reset (src);
 
   return TRUE;
@@ -831,25 +829,88 @@ unsupported_caps:
   return FALSE;
 }
 
-static GstFlowReturn
-gst_saperasrc_create (GstPushSrc * psrc, GstBuffer ** buf)
+static void
+gst_saperasrc_release_frame (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * frame)
 {
-  GstSaperaSrc *src = GST_SAPERA_SRC (psrc);
+  GstSaperaSrc *src = GST_SAPERA_SRC (grabber);
+  int index = GPOINTER_TO_INT (frame->user_data);
 
-  GST_LOG_OBJECT (src, "create");
+  if (!src->sap_buffers || !*src->sap_buffers)
+    return;
+
+  src->sap_buffers->ReleaseAddress (frame->data);
+  src->sap_buffers->SetState (index, SapBuffer::StateEmpty);
+}
+
+static GstFlowReturn
+gst_saperasrc_fill (GstVisionGrabberSrc * grabber,
+    GstVisionGrabberFrame * frame, GstBuffer ** buf)
+{
+  GstSaperaSrc *src = GST_SAPERA_SRC (grabber);
+  GstMapInfo minfo;
+  GstBufferPool *pool;
+  guint8 *pData = (guint8 *) frame->data;
+  int pitch = src->sap_buffers->GetPitch ();
+  gssize size = (gssize) src->gst_stride * src->height;
 
   gst_saperasrc_log_fpga_temperature (src);
 
-  g_mutex_lock (&src->buffer_mutex);
-  while (src->buffer == NULL)
-    g_cond_wait (&src->buffer_cond, &src->buffer_mutex);
-  *buf = src->buffer;
-  src->buffer = NULL;
-  g_mutex_unlock (&src->buffer_mutex);
+  /* use the negotiated pool, falling back to allocating if downstream
+   * still holds all of its buffers */
+  *buf = NULL;
+  pool = gst_base_src_get_buffer_pool (GST_BASE_SRC (src));
+  if (pool) {
+    GstBufferPoolAcquireParams params = { GST_FORMAT_UNDEFINED, 0, 0,
+      GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT
+    };
+    if (gst_buffer_pool_acquire_buffer (pool, buf, &params) != GST_FLOW_OK)
+      *buf = NULL;
+    gst_object_unref (pool);
+  }
+  if (*buf == NULL || gst_buffer_get_size (*buf) < (gsize) size) {
+    if (*buf)
+      gst_buffer_unref (*buf);
+    *buf = gst_buffer_new_and_alloc (size);
+  }
+  gst_buffer_set_size (*buf, size);
+
+  if (!gst_buffer_map (*buf, &minfo, GST_MAP_WRITE)) {
+    gst_buffer_unref (*buf);
+    *buf = NULL;
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED, ("Failed to map buffer"),
+        (NULL));
+    return GST_FLOW_ERROR;
+  }
+
+  if (src->channel_extract == 0) {
+    if (pitch == src->gst_stride) {
+      memcpy (minfo.data, pData, size);
+    } else {
+      for (int line = 0; line < src->height; line++) {
+        memcpy (minfo.data + (line * src->gst_stride),
+            pData + (line * pitch), MIN (pitch, src->gst_stride));
+      }
+    }
+  } else {
+    guint shift = 0;
+    if (src->channel_extract == 1) {
+      shift = 20;
+    } else if (src->channel_extract == 2) {
+      shift = 10;
+    } else if (src->channel_extract == 3) {
+      shift = 0;
+    } else
+      g_assert_not_reached ();
+
+    for (int r = 0; r < src->height; ++r) {
+      gst_saperasrc_extract_channel (
+          (guint16 *) (minfo.data + r * src->gst_stride),
+          (const guint32 *) (pData + r * pitch), src->width, shift);
+    }
+  }
 
-  GST_DEBUG ("saperasrc_create => pts %" GST_TIME_FORMAT " duration %"
-      GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (*buf)),
-      GST_TIME_ARGS (GST_BUFFER_DURATION (*buf)));
+  gst_buffer_unmap (*buf, &minfo);
 
   return GST_FLOW_OK;
 }
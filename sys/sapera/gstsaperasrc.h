@@ -23,7 +23,8 @@
 #include <SapClassBasic.h>
 
 #include <gst/gst.h>
-#include <gst/base/gstpushsrc.h>
+
+#include "gstvisiongrabbersrc.h"
 
 G_BEGIN_DECLS
 
@@ -40,10 +41,9 @@ class SapMyProcessing;
 
 struct _GstSaperaSrc
 {
-  GstPushSrc base_saperasrc;
+  GstVisionGrabberSrc base_saperasrc;
 
   guint last_buffer_number;
-  gint dropped_frame_count;
   gboolean acq_started;
 
   /* Sapera objects */
@@ -60,20 +60,15 @@ struct _GstSaperaSrc
   gint resource_index;
   gint channel_extract;
 
-  GstBuffer *buffer;
-
   GstCaps *caps;
   gint width;
   gint height;
   gint gst_stride;
-
-  GMutex buffer_mutex;
-  GCond buffer_cond;
 };
 
 struct _GstSaperaSrcClass
 {
-  GstPushSrcClass base_saperasrc_class;
+  GstVisionGrabberSrcClass base_saperasrc_class;
 };
 
 GType gst_saperasrc_get_type (void);
@@ -0,0 +1,300 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/* Feeds GstVisionClockMapper a synthetic device clock that drifts against
+ * the host clock, with frames retrieved late by a random delay, and checks
+ * the mapped capture times stay within the retrieval jitter of the true ones
+ * for as long as the stream runs. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+
+#include "common/visionclockmapper.h"
+
+#define FRAME_PERIOD (GST_SECOND / 30)
+#define START_TIME (10 * GST_SECOND)
+/* frames are retrieved up to this long after capture */
+#define MAX_DELAY (1 * GST_MSECOND)
+/* late wakeups, far off the fit */
+#define LATE_DELAY (20 * GST_MSECOND)
+#define LATE_INTERVAL 97
+
+typedef struct
+{
+  gdouble tick_frequency;       /* nominal device ticks per second */
+  gdouble drift_ppm;            /* how much faster the device clock runs */
+  guint counter_bits;
+  guint64 tick_base;            /* device counter at frame 0 */
+} DeviceClock;
+
+typedef struct
+{
+  gdouble drift_ppm;            /* how much faster it runs than the host */
+  GstClockTimeDiff offset;      /* pipeline clock minus host time at 0 */
+} PipelineClock;
+
+static guint64
+device_ticks (const DeviceClock * dev, GstClockTime since_start)
+{
+  gdouble ticks = (gdouble) since_start / GST_SECOND * dev->tick_frequency *
+      (1.0 + dev->drift_ppm * 1e-6);
+  guint64 t = dev->tick_base + (guint64) ticks;
+
+  if (dev->counter_bits < 64)
+    t &= (G_GUINT64_CONSTANT (1) << dev->counter_bits) - 1;
+  return t;
+}
+
+static GstClockTime
+pipeline_time (const PipelineClock * pipe, GstClockTime host_time)
+{
+  if (pipe == NULL)
+    return host_time;
+
+  return host_time + pipe->offset +
+      (GstClockTimeDiff) ((gdouble) host_time * pipe->drift_ppm * 1e-6);
+}
+
+/* runs num_frames through the mapper, with frame early_late retrieved late
+ * too, and returns the largest distance of a mapped time from the middle of
+ * the retrieval delays of its frame once the window is full. A fit that
+ * removes the jitter keeps this under MAX_DELAY / 2, before that the nominal
+ * tick rate keeps it within MAX_DELAY. With a pipeline clock, samples carry
+ * host and pipeline time. */
+static GstClockTimeDiff
+run_stream (GstVisionClockMapper * mapper, const DeviceClock * dev,
+    const PipelineClock * pipe, guint num_frames, guint early_late,
+    guint * num_late)
+{
+  GRand *rand = g_rand_new_with_seed (42);
+  GstClockTime last = GST_CLOCK_TIME_NONE;
+  GstClockTimeDiff max_err = 0;
+  guint i;
+
+  *num_late = 0;
+  for (i = 0; i < num_frames; i++) {
+    GstClockTime since_start = (GstClockTime) i * FRAME_PERIOD;
+    GstClockTime capture = START_TIME + since_start;
+    GstClockTime delay, mapped;
+    GstClockTimeDiff err;
+
+    delay = (GstClockTime) g_rand_int_range (rand, 0, MAX_DELAY / GST_USECOND)
+        * GST_USECOND;
+    if ((i > 2 * GST_VISION_CLOCK_MAPPER_DEFAULT_WINDOW &&
+            i % LATE_INTERVAL == 0) || i == early_late) {
+      delay += LATE_DELAY;
+      (*num_late)++;
+    }
+
+    if (pipe != NULL) {
+      mapped = gst_vision_clock_mapper_add_sample_full (mapper,
+          device_ticks (dev, since_start), capture + delay,
+          pipeline_time (pipe, capture + delay));
+    } else {
+      mapped = gst_vision_clock_mapper_add_sample (mapper,
+          device_ticks (dev, since_start), capture + delay);
+    }
+
+    fail_unless (GST_CLOCK_TIME_IS_VALID (mapped));
+    if (GST_CLOCK_TIME_IS_VALID (last))
+      fail_unless (mapped >= last, "frame %u went backwards", i);
+    last = mapped;
+
+    /* nothing tells a late first frame from an early one */
+    if (i == 0 && early_late == 0)
+      continue;
+
+    err = ABS (GST_CLOCK_DIFF (pipeline_time (pipe,
+                capture + MAX_DELAY / 2), mapped));
+    if (i < mapper->window) {
+      fail_unless (err <= MAX_DELAY, "frame %u off by %" GST_STIME_FORMAT,
+          i, GST_STIME_ARGS (err));
+    } else {
+      max_err = MAX (max_err, err);
+    }
+  }
+
+  g_rand_free (rand);
+
+  return max_err;
+}
+
+GST_START_TEST (test_drift_bounded)
+{
+  GstVisionClockMapper mapper;
+  /* 1 MHz counter 100 ppm fast, after an hour it is 360 ms ahead */
+  DeviceClock dev = { 1e6, 100.0, 64, 123456789 };
+  GstClockTimeDiff max_err;
+  guint num_late;
+
+  gst_vision_clock_mapper_init (&mapper, dev.tick_frequency,
+      dev.counter_bits, 0);
+  max_err = run_stream (&mapper, &dev, NULL, 30 * 60 * 60, G_MAXUINT,
+      &num_late);
+
+  GST_INFO ("max error %" GST_STIME_FORMAT ", skew %f ppm, jitter %f ns",
+      GST_STIME_ARGS (max_err), gst_vision_clock_mapper_get_skew (&mapper),
+      gst_vision_clock_mapper_get_jitter (&mapper));
+
+  fail_unless (max_err <= MAX_DELAY / 2,
+      "error %" GST_STIME_FORMAT " not bounded", GST_STIME_ARGS (max_err));
+  fail_unless (mapper.num_outliers >= num_late);
+  fail_unless_equals_uint64 (mapper.num_resets, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_drift_bounded_across_rollover)
+{
+  GstVisionClockMapper mapper;
+  /* 24 bit counter at 1 MHz wraps every 16.7 s, running 250 ppm slow */
+  DeviceClock dev = { 1e6, -250.0, 24, 16000000 };
+  GstClockTimeDiff max_err;
+  guint num_late;
+
+  gst_vision_clock_mapper_init (&mapper, dev.tick_frequency,
+      dev.counter_bits, 0);
+  max_err = run_stream (&mapper, &dev, NULL, 30 * 60 * 10, G_MAXUINT,
+      &num_late);
+
+  fail_unless (max_err <= MAX_DELAY / 2,
+      "error %" GST_STIME_FORMAT " not bounded", GST_STIME_ARGS (max_err));
+  fail_unless (mapper.num_rollovers > 0);
+  fail_unless_equals_uint64 (mapper.num_resets, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_device_reset)
+{
+  GstVisionClockMapper mapper;
+  DeviceClock dev = { 1e9, 50.0, 64, 0 };
+  GstClockTime before, after;
+  guint num_late;
+
+  gst_vision_clock_mapper_init (&mapper, dev.tick_frequency,
+      dev.counter_bits, 0);
+  run_stream (&mapper, &dev, NULL, 100, G_MAXUINT, &num_late);
+  before = mapper.last_output;
+
+  /* counter starts over, the mapping follows the clock again */
+  after = gst_vision_clock_mapper_add_sample (&mapper, 0,
+      START_TIME + 100 * FRAME_PERIOD);
+
+  fail_unless_equals_uint64 (mapper.num_resets, 1);
+  fail_unless (after >= before);
+  fail_unless (ABS (GST_CLOCK_DIFF (START_TIME + 100 * FRAME_PERIOD,
+              after)) <= FRAME_PERIOD);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_early_outlier)
+{
+  GstVisionClockMapper mapper;
+  DeviceClock dev = { 1e6, 100.0, 64, 0 };
+  GstClockTimeDiff max_err;
+  guint num_late;
+
+  /* before the fit has enough samples to tell outliers by their RMS */
+  gst_vision_clock_mapper_init (&mapper, dev.tick_frequency,
+      dev.counter_bits, 0);
+  max_err = run_stream (&mapper, &dev, NULL, 30 * 60,
+      GST_VISION_CLOCK_MAPPER_MIN_FIT_SAMPLES / 2, &num_late);
+
+  fail_unless (max_err <= MAX_DELAY / 2,
+      "error %" GST_STIME_FORMAT " not bounded", GST_STIME_ARGS (max_err));
+  fail_unless (mapper.num_outliers >= num_late);
+  fail_unless_equals_uint64 (mapper.num_resets, 0);
+
+  /* the first sample is late, the next ones show it */
+  gst_vision_clock_mapper_init (&mapper, dev.tick_frequency,
+      dev.counter_bits, 0);
+  max_err = run_stream (&mapper, &dev, NULL, 30 * 60, 0, &num_late);
+
+  fail_unless (max_err <= MAX_DELAY / 2,
+      "error %" GST_STIME_FORMAT " not bounded", GST_STIME_ARGS (max_err));
+  fail_unless (mapper.num_outliers >= num_late);
+  fail_unless_equals_uint64 (mapper.num_resets, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pipeline_clock)
+{
+  GstVisionClockMapper mapper;
+  DeviceClock dev = { 1e6, 100.0, 64, 123456789 };
+  /* a network clock a few ms off the host, slaved at 20 ppm */
+  PipelineClock pipe = { 20.0, 3 * GST_MSECOND };
+  GstClockTimeDiff max_err;
+  guint num_late;
+
+  gst_vision_clock_mapper_init (&mapper, dev.tick_frequency,
+      dev.counter_bits, 0);
+  max_err = run_stream (&mapper, &dev, &pipe, 30 * 60 * 10, G_MAXUINT,
+      &num_late);
+
+  fail_unless (max_err <= MAX_DELAY / 2,
+      "error %" GST_STIME_FORMAT " not bounded", GST_STIME_ARGS (max_err));
+  fail_unless_equals_uint64 (mapper.num_resets, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_running_time)
+{
+  GstElement *element = gst_bin_new (NULL);
+
+  gst_element_set_base_time (element, START_TIME);
+
+  fail_unless_equals_uint64 (gst_vision_clock_mapper_running_time (element,
+          START_TIME + GST_SECOND), GST_SECOND);
+  fail_unless_equals_uint64 (gst_vision_clock_mapper_running_time (element,
+          START_TIME), 0);
+  /* mapped onto the clock before the element started running */
+  fail_unless_equals_uint64 (gst_vision_clock_mapper_running_time (element,
+          START_TIME - GST_MSECOND), GST_CLOCK_TIME_NONE);
+  fail_unless_equals_uint64 (gst_vision_clock_mapper_running_time (element,
+          GST_CLOCK_TIME_NONE), GST_CLOCK_TIME_NONE);
+
+  gst_object_unref (element);
+}
+
+GST_END_TEST;
+
+static Suite *
+visionclockmapper_suite (void)
+{
+  Suite *s = suite_create ("visionclockmapper");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_drift_bounded);
+  tcase_add_test (tc_chain, test_drift_bounded_across_rollover);
+  tcase_add_test (tc_chain, test_device_reset);
+  tcase_add_test (tc_chain, test_early_outlier);
+  tcase_add_test (tc_chain, test_pipeline_clock);
+  tcase_add_test (tc_chain, test_running_time);
+
+  return s;
+}
+
+GST_CHECK_MAIN (visionclockmapper);